@@ -0,0 +1,213 @@
+#include "allocprof.h"
+
+#ifdef YOURCOMPANY_ALLOCPROF
+
+#include <boost/thread/mutex.hpp>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace {
+
+struct Site
+{
+    const char* name;
+    std::atomic<uint64_t> entries;
+    std::atomic<uint64_t> allocations;
+    std::atomic<uint64_t> bytes;
+};
+
+// Constant-initialized: the hooks run before any constructor does.
+Site sites[AllocProfiler::MaxSites];
+std::atomic<int> site_count(1);
+thread_local int tls_site = AllocProfiler::Other;
+
+boost::mutex& sites_mtx()
+{
+    static boost::mutex mtx;
+    return mtx;
+}
+
+}
+
+int AllocProfiler::site(const char* name)
+{
+    boost::mutex::scoped_lock lock(sites_mtx());
+    int count = site_count.load(std::memory_order_relaxed);
+    for (int i = 1; i < count; ++i) {
+        if (!strcmp(sites[i].name, name))
+            return i;
+    }
+    if (count == MaxSites)
+        return Other;
+    sites[count].name = name;
+    site_count.store(count + 1, std::memory_order_release);
+    return count;
+}
+
+int AllocProfiler::enter(int site)
+{
+    int previous = tls_site;
+    tls_site = site;
+    sites[site].entries.fetch_add(1, std::memory_order_relaxed);
+    return previous;
+}
+
+void AllocProfiler::leave(int previous)
+{
+    tls_site = previous;
+}
+
+void AllocProfiler::record(std::size_t bytes)
+{
+    Site& site = sites[tls_site];
+    site.allocations.fetch_add(1, std::memory_order_relaxed);
+    site.bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+AllocProfiler::Counts AllocProfiler::counts(int site)
+{
+    Counts counts = { sites[site].entries.load(std::memory_order_relaxed),
+                      sites[site].allocations.load(std::memory_order_relaxed),
+                      sites[site].bytes.load(std::memory_order_relaxed) };
+    return counts;
+}
+
+AllocProfiler::Counts AllocProfiler::counts(const char* name)
+{
+    int count = site_count.load(std::memory_order_acquire);
+    for (int i = 1; i < count; ++i) {
+        if (!strcmp(sites[i].name, name))
+            return counts(i);
+    }
+    Counts none = { 0, 0, 0 };
+    return none;
+}
+
+std::string AllocProfiler::to_text()
+{
+    std::string text = "# site                          entries   allocations         bytes   allocs/entry\n";
+    char line[160];
+    int count = site_count.load(std::memory_order_acquire);
+    for (int i = 0; i < count; ++i) {
+        Counts c = counts(i);
+        if (i && !c.entries)
+            continue;
+        snprintf(line, sizeof(line), "%-28s %10llu %13llu %13llu %14.2f\n", i ? sites[i].name : "other",
+                 static_cast<unsigned long long>(c.entries), static_cast<unsigned long long>(c.allocations),
+                 static_cast<unsigned long long>(c.bytes),
+                 c.entries ? double(c.allocations) / c.entries : 0.0);
+        text += line;
+    }
+    return text;
+}
+
+bool AllocProfiler::write(const std::string& path)
+{
+    std::string text = to_text();
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file)
+        return false;
+    bool ok = fwrite(text.data(), 1, text.size(), file) == text.size();
+    return fclose(file) == 0 && ok;
+}
+
+#ifdef __GLIBC__
+
+// glibc lets the program define malloc and friends in place of its own,
+// which catches Qt's and boost's allocations as well as operator new's.
+extern "C" {
+
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+
+void* malloc(size_t size) __THROW
+{
+    AllocProfiler::record(size);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) __THROW
+{
+    AllocProfiler::record(count * size);
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) __THROW
+{
+    if (size)
+        AllocProfiler::record(size);
+    return __libc_realloc(ptr, size);
+}
+
+void* memalign(size_t alignment, size_t size) __THROW
+{
+    AllocProfiler::record(size);
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) __THROW
+{
+    AllocProfiler::record(size);
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** ptr, size_t alignment, size_t size) __THROW
+{
+    if (!alignment || alignment % sizeof(void*) || (alignment & (alignment - 1)))
+        return EINVAL;
+    AllocProfiler::record(size);
+    void* p = __libc_memalign(alignment, size);
+    if (!p)
+        return ENOMEM;
+    *ptr = p;
+    return 0;
+}
+
+}
+
+#else
+
+// Elsewhere only what goes through operator new is seen.
+void* operator new(std::size_t size)
+{
+    AllocProfiler::record(size);
+    if (void* p = malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    AllocProfiler::record(size);
+    return malloc(size ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& nothrow) noexcept
+{
+    return operator new(size, nothrow);
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    free(p);
+}
+
+#endif // __GLIBC__
+
+#endif // YOURCOMPANY_ALLOCPROF
@@ -0,0 +1,73 @@
+#ifndef ALLOCPROF_H
+#define ALLOCPROF_H
+
+// Heap allocations counted by the subsystem that made them.
+// Build with CONFIG += allocprof to compile it in; without it every macro
+// below expands to nothing. ALLOC_SCOPE(name) charges what the thread
+// allocates until the end of the block to name, the innermost scope
+// winning; anything outside a scope goes to "other". ALLOC_REPORT(path)
+// writes the table of sites.
+
+#ifdef YOURCOMPANY_ALLOCPROF
+
+#include <stdint.h>
+#include <string>
+
+class AllocProfiler
+{
+public:
+    enum { MaxSites = 64, Other = 0 };
+
+    struct Counts
+    {
+        uint64_t entries;       // times the scope was entered
+        uint64_t allocations;   // malloc, calloc, realloc, operator new...
+        uint64_t bytes;         // as requested
+    };
+
+    // The site for name, registered on first use; Other once the table is full.
+    static int site(const char* name);
+
+    // Returns the site that was current, for leave().
+    static int enter(int site);
+    static void leave(int previous);
+
+    // Called by the allocation hooks.
+    static void record(std::size_t bytes);
+
+    static Counts counts(int site);
+    static Counts counts(const char* name);
+
+    static std::string to_text();
+    static bool write(const std::string& path);
+};
+
+class AllocScope
+{
+    int previous;
+public:
+    explicit AllocScope(int site) :
+        previous(AllocProfiler::enter(site))
+    { }
+
+    ~AllocScope()
+    {
+        AllocProfiler::leave(previous);
+    }
+};
+
+#define ALLOC_CONCAT_IMPL(a, b) a##b
+#define ALLOC_CONCAT(a, b) ALLOC_CONCAT_IMPL(a, b)
+#define ALLOC_SCOPE(name) \
+    static const int ALLOC_CONCAT(alloc_site_, __LINE__) = AllocProfiler::site(name); \
+    AllocScope ALLOC_CONCAT(alloc_scope_, __LINE__)(ALLOC_CONCAT(alloc_site_, __LINE__))
+#define ALLOC_REPORT(path) AllocProfiler::write(path)
+
+#else
+
+#define ALLOC_SCOPE(name) ((void) 0)
+#define ALLOC_REPORT(path) false
+
+#endif // YOURCOMPANY_ALLOCPROF
+
+#endif // ALLOCPROF_H
@@ -0,0 +1,130 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Monotonic memory for the temporaries of one turn or one frame: allocate
+// bumps a pointer, deallocate does nothing and reset() takes everything
+// back at once. When a turn needed more than the first block, reset()
+// swaps the blocks for one block that large, so once the arena has seen
+// its largest turn it stops touching the heap altogether.
+class Arena
+{
+public:
+    explicit Arena(std::size_t first_block = 4096) :
+        head(NULL),
+        used(0),
+        total(0)
+    {
+        grow(first_block);
+    }
+
+    ~Arena()
+    {
+        release();
+    }
+
+    void* allocate(std::size_t size, std::size_t align = alignof(std::max_align_t))
+    {
+        std::size_t offset = (used + align - 1) & ~(align - 1);
+        if (offset + size > head->size) {
+            grow(size + align > head->size * 2 ? size + align : head->size * 2);
+            offset = (used + align - 1) & ~(align - 1);
+        }
+        used = offset + size;
+        return head->data() + offset;
+    }
+
+    void reset()
+    {
+        if (head->next) {
+            std::size_t size = total;
+            release();
+            grow(size);
+        }
+        used = 0;
+    }
+
+    // Bytes held from the heap, the high-water mark of the turns so far.
+    std::size_t capacity() const { return total; }
+
+private:
+    struct Block
+    {
+        Block* next;
+        std::size_t size;
+
+        uint8_t* data() { return reinterpret_cast<uint8_t*>(this + 1); }
+    };
+
+    Arena(const Arena&);
+    Arena& operator=(const Arena&);
+
+    void grow(std::size_t size)
+    {
+        Block* block = static_cast<Block*>(malloc(sizeof(Block) + size));
+        if (!block)
+            throw std::bad_alloc();
+        block->next = head;
+        block->size = size;
+        head = block;
+        used = 0;
+        total += size;
+    }
+
+    void release()
+    {
+        while (head) {
+            Block* next = head->next;
+            free(head);
+            head = next;
+        }
+        total = 0;
+    }
+
+    Block* head;
+    std::size_t used;       // in head
+    std::size_t total;
+};
+
+// Lets standard containers live in an Arena. Containers must not outlive
+// the arena's next reset().
+template <class T>
+class ArenaAllocator
+{
+public:
+    typedef T value_type;
+
+    explicit ArenaAllocator(Arena& _arena) : arena(&_arena) { }
+
+    template <class U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) { }
+
+    T* allocate(std::size_t n)
+    {
+        return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T*, std::size_t) { }
+
+    template <class U>
+    bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+
+    template <class U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
+
+private:
+    template <class U> friend class ArenaAllocator;
+
+    Arena* arena;
+};
+
+typedef std::basic_string<char, std::char_traits<char>, ArenaAllocator<char> > ArenaString;
+typedef std::vector<uint8_t, ArenaAllocator<uint8_t> > ArenaBytes;
+
+#endif // ARENA_H
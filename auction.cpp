@@ -0,0 +1,175 @@
+#include "auction.h"
+#include "connector.h"
+
+#include <algorithm>
+#include <chrono>
+
+AuctionClient::AuctionClient(QObject *parent) :
+    QObject(parent),
+    budget(0),
+    latency_count(0)
+{
+    current.id = 0;
+    current.current = 0;
+    current.step = 1;
+    current.my_bid = 0;
+    current.outcome = Closed;
+    for (int i = 0; i < Levels; ++i)
+        current.ready[i] = 0;
+    latencies_ns.resize(LatencySamples);
+}
+
+int AuctionClient::steps(int level)
+{
+    static const int level_steps[Levels] = { 1, 2, 5 };
+    return level >= 0 && level < Levels ? level_steps[level] : 0;
+}
+
+uint64_t AuctionClient::now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void AuctionClient::set_budget(int32_t money)
+{
+    {
+        boost::mutex::scoped_lock lock(mtx);
+        if (budget == money)
+            return;
+        budget = money;
+        prepare_bids();
+    }
+    emit changed();
+}
+
+bool AuctionClient::take_bid(int level, Frame &frame)
+{
+    boost::mutex::scoped_lock lock(mtx);
+    if (level < 0 || level >= Levels || !ready_frames[level])
+        return false;
+    // a second click on the same price would only be rejected by the server
+    if (!in_flight.empty() && in_flight.back().amount >= current.ready[level])
+        return false;
+    frame = ready_frames[level];
+    InFlight bid = { current.ready[level], now_ns() };
+    in_flight.push_back(bid);
+    return true;
+}
+
+AuctionClient::State AuctionClient::state() const
+{
+    boost::mutex::scoped_lock lock(mtx);
+    return current;
+}
+
+AuctionClient::Latency AuctionClient::latency() const
+{
+    std::vector<uint32_t> samples;
+    Latency result = Latency();
+    {
+        boost::mutex::scoped_lock lock(mtx);
+        result.count = latency_count;
+        if (!latency_count)
+            return result;
+        std::size_t kept = std::min<std::size_t>(latency_count, LatencySamples);
+        samples.assign(latencies_ns.begin(), latencies_ns.begin() + kept);
+        result.last_us = latencies_ns[(latency_count - 1) % LatencySamples] / 1000.0;
+    }
+    std::sort(samples.begin(), samples.end());
+    result.median_us = samples[samples.size() / 2] / 1000.0;
+    result.p99_us = samples[std::min(samples.size() - 1, samples.size() * 99 / 100)] / 1000.0;
+    result.max_us = samples.back() / 1000.0;
+    return result;
+}
+
+void AuctionClient::on_auction(const uint8_t *data, uint32_t size)
+{
+    uint32_t id;
+    wire::Text lot;
+    int32_t price, step;
+    if (!msg::Auction::decode(data, size, id, lot, price, step))
+        return;
+    {
+        boost::mutex::scoped_lock lock(mtx);
+        if (id != current.id || current.outcome != Open) {
+            current.id = id;
+            current.my_bid = 0;
+            in_flight.clear();
+            for (int i = 0; i < Levels; ++i)
+                ready_frames[i].reset();
+        }
+        current.lot.assign(lot.data, lot.size);
+        current.current = price;
+        current.step = std::max(1, step);
+        current.outcome = Open;
+        prepare_bids();
+    }
+    emit changed();
+}
+
+void AuctionClient::on_amount(const uint8_t *data, uint32_t size)
+{
+    uint64_t received = now_ns();
+    uint32_t id;
+    int32_t amount;
+    if (!msg::Amount::decode(data, size, id, amount))
+        return;
+    {
+        boost::mutex::scoped_lock lock(mtx);
+        if (id != current.id)
+            return;
+        current.current = std::max(current.current, amount);
+        // bids are acknowledged in order; anything below the ack was outbid
+        std::size_t acked = 0;
+        while (acked < in_flight.size() && in_flight[acked].amount <= amount) {
+            if (in_flight[acked].amount == amount) {
+                latencies_ns[latency_count++ % LatencySamples] =
+                        static_cast<uint32_t>(std::min<uint64_t>(received - in_flight[acked].sent_ns, 0xffffffffu));
+                current.my_bid = amount;
+            }
+            ++acked;
+        }
+        in_flight.erase(in_flight.begin(), in_flight.begin() + acked);
+        prepare_bids();
+    }
+    emit changed();
+}
+
+void AuctionClient::on_result(bool won, const uint8_t *data, uint32_t size)
+{
+    uint32_t id;
+    int32_t amount;
+    if (!(won ? msg::AuctionWin::decode(data, size, id, amount) : msg::AuctionLose::decode(data, size, id, amount)))
+        return;
+    {
+        boost::mutex::scoped_lock lock(mtx);
+        if (id != current.id)
+            return;
+        current.current = amount;
+        current.outcome = won ? Won : Lost;
+        in_flight.clear();
+        prepare_bids();
+    }
+    emit changed();
+}
+
+void AuctionClient::prepare_bids()
+{
+    for (int i = 0; i < Levels; ++i) {
+        int32_t amount = current.current + steps(i) * current.step;
+        if (current.outcome != Open || amount > budget) {
+            current.ready[i] = 0;
+            ready_frames[i].reset();
+            continue;
+        }
+        if (ready_frames[i] && current.ready[i] == amount)
+            continue;
+        wire::Buffer<msg::Amount::max_size> payload;
+        msg::Amount::encode(payload, current.id, amount);
+        boost::shared_ptr<std::vector<uint8_t> > frame(new std::vector<uint8_t>);
+        Connector::command_frame(msg::Amount::cmd, payload.data(), payload.size(), *frame);
+        current.ready[i] = amount;
+        ready_frames[i] = frame;
+    }
+}
@@ -0,0 +1,92 @@
+#ifndef AUCTION_H
+#define AUCTION_H
+
+#include <QObject>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Client side of the cmd_type_auction family. Server messages are applied
+// on the connector thread; after every change the frames for the next bid
+// levels are rebuilt and checked against the budget, so placing a bid from
+// the GUI is a pointer handoff with no formatting on the hot path. Each bid
+// is timestamped when it is handed to the socket and again when the server
+// acknowledges it.
+class AuctionClient : public QObject
+{
+    Q_OBJECT
+public:
+    enum { Levels = 3, LatencySamples = 4096 };
+
+    enum Outcome { Closed, Open, Won, Lost };
+
+    struct State
+    {
+        uint32_t id;
+        std::string lot;
+        int32_t current;        // highest acknowledged bid
+        int32_t step;
+        int32_t my_bid;         // our highest acknowledged bid
+        int32_t ready[Levels];  // amount behind each prepared frame, 0 if not allowed
+        Outcome outcome;
+    };
+
+    struct Latency
+    {
+        std::size_t count;
+        double last_us;
+        double median_us;
+        double p99_us;
+        double max_us;
+    };
+
+    typedef boost::shared_ptr<const std::vector<uint8_t> > Frame;
+
+    explicit AuctionClient(QObject *parent = 0);
+
+    // Bid level i raises the current price by steps(i) increments.
+    static int steps(int level);
+
+    static uint64_t now_ns();
+
+    // GUI thread
+    void set_budget(int32_t money);
+    // Takes the prepared frame for level and marks the bid as in flight.
+    bool take_bid(int level, Frame& frame);
+    State state() const;
+    Latency latency() const;
+
+    // Connector thread: payloads of the cmd_type_auction family, declared
+    // in protocol.h. Payloads that don't follow the layout are ignored.
+    //   cmd_type_auction       "id/lot/current/step"  an auction opened or moved
+    //   cmd_type_amount        "id/amount"            a bid was accepted as the highest
+    //   cmd_type_auction_win   "id/amount"
+    //   cmd_type_auction_lose  "id/amount"
+    void on_auction(const uint8_t* data, uint32_t size);
+    void on_amount(const uint8_t* data, uint32_t size);
+    void on_result(bool won, const uint8_t* data, uint32_t size);
+
+signals:
+    void changed();
+
+private:
+    struct InFlight
+    {
+        int32_t amount;
+        uint64_t sent_ns;
+    };
+
+    void prepare_bids();
+
+    mutable boost::mutex mtx;
+    State current;
+    int32_t budget;
+    Frame ready_frames[Levels];
+    std::vector<InFlight> in_flight;
+    std::vector<uint32_t> latencies_ns;     // ring of the last LatencySamples
+    std::size_t latency_count;
+};
+
+#endif // AUCTION_H
@@ -0,0 +1,76 @@
+#include "auctionpanel.h"
+
+#include <QGridLayout>
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QPushButton>
+
+AuctionPanel::AuctionPanel(AuctionClient *_auction, QWidget *parent) :
+    QWidget(parent),
+    auction(_auction)
+{
+    setWindowTitle(tr("Auction"));
+    QGridLayout* layout = new QGridLayout(this);
+    lot = new QLabel(this);
+    price = new QLabel(this);
+    status = new QLabel(this);
+    latency = new QLabel(this);
+    QFont big = price->font();
+    big.setPointSize(big.pointSize() * 2);
+    price->setFont(big);
+    layout->addWidget(lot, 0, 0, 1, AuctionClient::Levels);
+    layout->addWidget(price, 1, 0, 1, AuctionClient::Levels);
+    for (int i = 0; i < AuctionClient::Levels; ++i) {
+        bids[i] = new QPushButton(this);
+        bids[i]->setProperty("level", i);
+        bids[i]->setMinimumHeight(40);
+        connect(bids[i], SIGNAL(pressed()), this, SLOT(bid_clicked()));
+        layout->addWidget(bids[i], 2, i);
+    }
+    layout->addWidget(status, 3, 0, 1, AuctionClient::Levels);
+    layout->addWidget(latency, 4, 0, 1, AuctionClient::Levels);
+    connect(auction, SIGNAL(changed()), this, SLOT(refresh()), Qt::QueuedConnection);
+    refresh();
+}
+
+void AuctionPanel::bid_clicked()
+{
+    // pressed() rather than clicked(): the bid leaves on mouse down
+    emit bidRequested(sender()->property("level").toInt());
+}
+
+void AuctionPanel::refresh()
+{
+    AuctionClient::State state = auction->state();
+    lot->setText(tr("Lot: %1").arg(QString::fromStdString(state.lot)));
+    price->setText(tr("Price: %1").arg(state.current));
+    for (int i = 0; i < AuctionClient::Levels; ++i) {
+        bool ready = state.ready[i] != 0;
+        bids[i]->setEnabled(ready);
+        bids[i]->setText(ready ? tr("Bid %1").arg(state.ready[i]) : tr("+%1").arg(AuctionClient::steps(i) * state.step));
+    }
+
+    switch (state.outcome) {
+    case AuctionClient::Closed:
+        status->setText(tr("No auction"));
+        break;
+    case AuctionClient::Open:
+        status->setText(state.my_bid && state.my_bid == state.current ? tr("You are leading")
+                                                                       : tr("Open"));
+        break;
+    case AuctionClient::Won:
+        status->setText(tr("Won at %1").arg(state.current));
+        break;
+    case AuctionClient::Lost:
+        status->setText(tr("Lost at %1").arg(state.current));
+        break;
+    }
+
+    AuctionClient::Latency stats = auction->latency();
+    if (stats.count)
+        latency->setText(tr("Bid to ack: last %1 us, median %2 us, p99 %3 us (%4 bids)")
+                         .arg(stats.last_us, 0, 'f', 0).arg(stats.median_us, 0, 'f', 0)
+                         .arg(stats.p99_us, 0, 'f', 0).arg(stats.count));
+    else
+        latency->clear();
+}
@@ -0,0 +1,37 @@
+#ifndef AUCTIONPANEL_H
+#define AUCTIONPANEL_H
+
+#include "auction.h"
+#include <QWidget>
+
+class QLabel;
+class QPushButton;
+
+// Bidding window: the lot, the price to beat and one button per prepared
+// bid level. Buttons are enabled only while their frame is ready, so a
+// click never has to be validated or formatted before it is sent.
+class AuctionPanel : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit AuctionPanel(AuctionClient* _auction, QWidget *parent = 0);
+
+signals:
+    void bidRequested(int level);
+
+public slots:
+    void refresh();
+
+private slots:
+    void bid_clicked();
+
+private:
+    AuctionClient* auction;
+    QLabel* lot;
+    QLabel* price;
+    QLabel* status;
+    QLabel* latency;
+    QPushButton* bids[AuctionClient::Levels];
+};
+
+#endif // AUCTIONPANEL_H
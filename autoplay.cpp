@@ -0,0 +1,275 @@
+#include "autoplay.h"
+#include "allocprof.h"
+
+#include <boost/chrono.hpp>
+
+namespace rules {
+
+static int32_t line_materials(const GameState::Line& line)
+{
+    return line.product_type == GameState::ProductA ? 1 : 2;
+}
+
+bool buy_materials(GameState& state, int32_t count)
+{
+    if (count <= 0 || state.money <= 0)
+        return false;
+    state.money -= 2 * count;
+    state.materials += count;
+    return true;
+}
+
+bool load_line(GameState& state, std::size_t index)
+{
+    if (index >= state.lines.size())
+        return false;
+    GameState::Line& line = state.lines[index];
+    int32_t count = line_materials(line);
+    if (line.loaded || line.have_materials.empty() || state.materials < count)
+        return false;
+    state.materials -= count;
+    line.have_materials[0] = 1;
+    line.loaded = true;
+    return true;
+}
+
+void sell(GameState& state, ReportBuilder& report)
+{
+    int32_t count_a = 0, count_b = 0;
+    for (std::size_t i = 0; i < state.products.size(); ++i) {
+        if (state.products[i] == GameState::ProductA)
+            ++count_a;
+        else
+            ++count_b;
+    }
+    for (std::size_t j = 0; j < state.contracts.size();) {
+        GameState::Contract& contract = state.contracts[j];
+        if (contract.a > count_a || contract.b > count_b) {
+            ++j;
+            continue;
+        }
+        for (std::size_t i = 0; i < state.products.size();) {
+            if (state.products[i] == GameState::ProductA && contract.a > 0) {
+                state.products.erase(state.products.begin() + i);
+                --contract.a;
+                state.debit[0] += contract.price_a;
+                report.sale(contract.market, GameState::ProductA, contract.price_a);
+            } else if (state.products[i] == GameState::ProductB && contract.b > 0) {
+                state.products.erase(state.products.begin() + i);
+                --contract.b;
+                state.debit[0] += contract.price_b;
+                report.sale(contract.market, GameState::ProductB, contract.price_b);
+            } else {
+                ++i;
+            }
+        }
+        state.contracts.erase(state.contracts.begin() + j);
+    }
+}
+
+bool end_turn(GameState& state, ReportBuilder& report, YearReport& year)
+{
+    for (std::size_t i = 0; i < state.credit_lines.size(); ++i)
+        --state.credit_lines[i].time;
+    for (std::size_t i = 0; i < state.lines.size(); ++i) {
+        GameState::Line& line = state.lines[i];
+        report.line_turn(line.loaded);
+        std::vector<uint8_t>& slots = line.have_materials;
+        if (!slots.empty()) {
+            bool finished = slots.back() != 0;
+            if (finished)
+                state.products.push_back(line.product_type);
+            report.produced(line.product_type, finished ? 1 : 0);
+            for (std::size_t slot = slots.size() - 1; slot > 0; --slot) {
+                slots[slot] = slots[slot - 1];
+                slots[slot - 1] = 0;
+            }
+        }
+        line.loaded = false;
+    }
+    if (state.debit[3] > 0)
+        state.money += state.debit[3];
+    for (int i = 3; i > 0; --i) {
+        state.debit[i] = state.debit[i - 1];
+        state.debit[i - 1] = 0;
+    }
+    int64_t credit_outstanding = 0;
+    for (std::size_t i = 0; i < state.credit_lines.size(); ++i)
+        credit_outstanding += state.credit_lines[i].money;
+    report.end_turn(credit_outstanding);
+    ++state.turn;
+    if (--state.count_year)
+        return false;
+    // Market::recount_after and recount_before
+    for (std::size_t i = 0; i < state.markets.size(); ++i) {
+        GameState::Market& market = state.markets[i];
+        int32_t before = state.money;
+        if (market.time > 0 && state.money > 0 && market.selected)
+            --market.time;
+        if (market.time > 0 && state.money > 0 && market.selected)
+            state.money -= market.price;
+        report.market_fee(static_cast<int>(i), before - state.money);
+    }
+    state.count_year = 4;
+    report.finish_year(state.money, year);
+    return true;
+}
+
+}
+
+void GreedyPolicy::plan(const GameState& state, TurnPlan& plan)
+{
+    plan.sell = !state.products.empty() && !state.contracts.empty();
+    std::size_t wanted = 0;
+    for (std::size_t i = 0; i < state.contracts.size(); ++i)
+        wanted += state.contracts[i].a + state.contracts[i].b;
+    if (state.products.size() >= wanted)
+        return;
+    int32_t needed = 0;
+    for (std::size_t i = 0; i < state.lines.size(); ++i) {
+        if (state.lines[i].loaded)
+            continue;
+        needed += rules::line_materials(state.lines[i]);
+        plan.load_lines.push_back(i);
+    }
+    int32_t missing = needed - state.materials;
+    if (missing > 0 && state.money >= 2 * missing)
+        plan.buy_materials = missing;
+}
+
+AutoPlayer::AutoPlayer(std::size_t _max_queued) :
+    max_queued(_max_queued),
+    stopping(false),
+    rate(0)
+{
+}
+
+AutoPlayer::~AutoPlayer()
+{
+    stop();
+}
+
+void AutoPlayer::start(const GameState& _state, const ReportBuilder& _report,
+                       const boost::shared_ptr<TurnPolicy>& _policy, double turns_per_second)
+{
+    stop();
+    state = _state;
+    builder = _report;
+    policy = _policy;
+    {
+        boost::mutex::scoped_lock lock(mtx);
+        stopping = false;
+        rate = turns_per_second;
+        new_contracts.clear();
+        withdrawn_offers.clear();
+    }
+    worker = boost::thread(boost::bind(&AutoPlayer::run, this));
+}
+
+void AutoPlayer::stop()
+{
+    if (!worker.joinable())
+        return;
+    {
+        boost::mutex::scoped_lock lock(mtx);
+        stopping = true;
+    }
+    cv.notify_all();
+    worker.join();
+}
+
+void AutoPlayer::set_rate(double turns_per_second)
+{
+    {
+        boost::mutex::scoped_lock lock(mtx);
+        rate = turns_per_second;
+    }
+    cv.notify_all();
+}
+
+void AutoPlayer::add_contract(const GameState::Contract& contract)
+{
+    boost::mutex::scoped_lock lock(mtx);
+    new_contracts.push_back(contract);
+}
+
+void AutoPlayer::withdraw_offer(uint32_t offer)
+{
+    boost::mutex::scoped_lock lock(mtx);
+    withdrawn_offers.push_back(offer);
+}
+
+void AutoPlayer::take(Progress& taken)
+{
+    taken.turns.clear();
+    taken.years.clear();
+    taken.reports.clear();
+    {
+        boost::mutex::scoped_lock lock(mtx);
+        taken.turns.swap(progress.turns);
+        taken.years.swap(progress.years);
+        taken.reports.swap(progress.reports);
+    }
+    cv.notify_all();
+}
+
+void AutoPlayer::run()
+{
+    typedef boost::chrono::steady_clock Clock;
+    Clock::time_point due = Clock::now();
+    TurnPlan plan;
+    YearReport year;
+    for (;;) {
+        {
+            boost::mutex::scoped_lock lock(mtx);
+            while (!stopping && progress.turns.size() >= max_queued)
+                cv.wait(lock);
+            if (rate > 0) {
+                while (!stopping && Clock::now() < due)
+                    cv.wait_until(lock, due);
+            }
+            if (stopping)
+                return;
+            state.contracts.insert(state.contracts.end(), new_contracts.begin(), new_contracts.end());
+            new_contracts.clear();
+            for (std::size_t i = 0; i < withdrawn_offers.size(); ++i) {
+                for (std::size_t j = 0; j < state.contracts.size();) {
+                    if (state.contracts[j].offer == withdrawn_offers[i])
+                        state.contracts.erase(state.contracts.begin() + j);
+                    else
+                        ++j;
+                }
+            }
+            withdrawn_offers.clear();
+            Clock::time_point now = Clock::now();
+            // after a pause or a rate change keep the pace from here, don't catch up
+            due = rate > 0 && now - due < boost::chrono::seconds(1)
+                    ? due + boost::chrono::duration_cast<Clock::duration>(boost::chrono::duration<double>(1 / rate))
+                    : now;
+        }
+
+        bool closed;
+        {
+            ALLOC_SCOPE("autoplay.turn");
+            plan.clear();
+            policy->plan(state, plan);
+            if (plan.buy_materials)
+                rules::buy_materials(state, plan.buy_materials);
+            for (std::size_t i = 0; i < plan.load_lines.size(); ++i)
+                rules::load_line(state, plan.load_lines[i]);
+            if (plan.sell)
+                rules::sell(state, builder);
+            closed = rules::end_turn(state, builder, year);
+        }
+        // the turn as handed to the GUI, which keeps it in the history
+        ALLOC_SCOPE("autoplay.snapshot");
+        boost::shared_ptr<const GameState> played(new GameState(state));
+        boost::shared_ptr<const ReportBuilder> running(new ReportBuilder(builder));
+
+        boost::mutex::scoped_lock lock(mtx);
+        progress.turns.push_back(played);
+        progress.reports.push_back(running);
+        if (closed)
+            progress.years.push_back(year);
+    }
+}
@@ -0,0 +1,125 @@
+#ifndef AUTOPLAY_H
+#define AUTOPLAY_H
+
+#include "gamestate.h"
+#include "report.h"
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include <vector>
+
+// The turn rules MainWindow applies to its widgets, on a plain GameState,
+// so that turns can be played away from the GUI thread.
+namespace rules {
+
+// BuyMaterials: two money a unit, refused when there is no money.
+bool buy_materials(GameState& state, int32_t count);
+
+// DownloadMaterials on a line that isn't loaded yet this turn.
+bool load_line(GameState& state, std::size_t line);
+
+// SaleProducts: fills the contracts the products cover.
+void sell(GameState& state, ReportBuilder& report);
+
+// Step: runs the lines, collects debit and moves the year on. Returns true
+// when the turn closed a year, whose totals are then in year.
+bool end_turn(GameState& state, ReportBuilder& report, YearReport& year);
+
+}
+
+// What to do in a turn before it ends, applied in this order.
+struct TurnPlan
+{
+    int32_t buy_materials;
+    std::vector<std::size_t> load_lines;    // indexes into GameState::lines
+    bool sell;
+
+    TurnPlan() : buy_materials(0), sell(false) { }
+
+    // Empties the plan, keeping load_lines' memory for the next turn.
+    void clear()
+    {
+        buy_materials = 0;
+        load_lines.clear();
+        sell = false;
+    }
+};
+
+class TurnPolicy
+{
+public:
+    virtual ~TurnPolicy() { }
+
+    // Called on the auto-play thread before every turn with an empty plan.
+    virtual void plan(const GameState& state, TurnPlan& plan) = 0;
+};
+
+// Keeps every line loaded while the stock is short of what the contracts
+// ask for, buying the materials that takes when the money covers them, and
+// sells whenever there are contracts.
+class GreedyPolicy : public TurnPolicy
+{
+public:
+    void plan(const GameState& state, TurnPlan& plan);
+};
+
+// Plays turns on its own thread, turns_per_second of them or, with 0, as
+// many as it can. The GUI collects them with take() at its own pace, once
+// per displayed frame, so what it renders doesn't depend on how many turns
+// went by. At most max_queued turns wait for take(); the player pauses
+// until they are collected, which bounds both memory and the work a frame
+// has to do.
+class AutoPlayer
+{
+public:
+    enum { DefaultMaxQueued = 256 };
+
+    struct Progress
+    {
+        std::vector<boost::shared_ptr<const GameState> > turns;    // oldest first
+        std::vector<boost::shared_ptr<const ReportBuilder> > reports;  // the running year after each turn
+        std::vector<YearReport> years;                              // closed meanwhile
+    };
+
+    explicit AutoPlayer(std::size_t _max_queued = DefaultMaxQueued);
+    ~AutoPlayer();
+
+    void start(const GameState& state, const ReportBuilder& _report,
+               const boost::shared_ptr<TurnPolicy>& _policy, double turns_per_second);
+    // Waits for the turn being played; take() still has the last ones.
+    void stop();
+
+    bool running() const { return worker.joinable(); }
+
+    void set_rate(double turns_per_second);
+
+    // Accepted while playing; joins the state before the next turn.
+    void add_contract(const GameState::Contract& contract);
+    // Turned down by the server; the contract of that offer leaves the
+    // state before the next turn unless it has been filled already.
+    void withdraw_offer(uint32_t offer);
+
+    // Hands over the turns played since the last call.
+    void take(Progress& progress);
+
+    // The running year as the player left it, for after stop().
+    const ReportBuilder& report() const { return builder; }
+
+private:
+    void run();
+
+    std::size_t max_queued;
+    GameState state;                // player thread
+    ReportBuilder builder;          // player thread while running
+    boost::shared_ptr<TurnPolicy> policy;
+
+    boost::mutex mtx;
+    boost::condition_variable cv;
+    bool stopping;
+    double rate;
+    std::vector<GameState::Contract> new_contracts;
+    std::vector<uint32_t> withdrawn_offers;
+    Progress progress;
+    boost::thread worker;
+};
+
+#endif // AUTOPLAY_H
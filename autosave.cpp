@@ -0,0 +1,67 @@
+#include "autosave.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QSaveFile>
+
+Autosave::Autosave(const QString& _path) :
+    path(_path),
+    stopping(false),
+    worker(boost::bind(&Autosave::run, this))
+{
+}
+
+Autosave::~Autosave()
+{
+    {
+        boost::mutex::scoped_lock lock(mtx);
+        stopping = true;
+    }
+    pending_cv.notify_one();
+    worker.join();
+}
+
+void Autosave::submit(const boost::shared_ptr<const GameState>& state)
+{
+    {
+        boost::mutex::scoped_lock lock(mtx);
+        pending = state;
+    }
+    pending_cv.notify_one();
+}
+
+void Autosave::run()
+{
+    std::vector<uint8_t> encoded;
+    for (;;) {
+        boost::shared_ptr<const GameState> state;
+        {
+            boost::mutex::scoped_lock lock(mtx);
+            while (!pending && !stopping)
+                pending_cv.wait(lock);
+            if (!pending)
+                return;
+            state.swap(pending);
+        }
+
+        snapshot::encode(*state, encoded);
+        QSaveFile file(path);
+        if (!file.open(QIODevice::WriteOnly)
+                || file.write(reinterpret_cast<const char*>(&encoded[0]), encoded.size()) != qint64(encoded.size())
+                || !file.commit())
+            qWarning() << "Autosave to" << path << "failed:" << file.errorString();
+    }
+}
+
+bool Autosave::load(const QString& path, GameState& state)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly) || !file.size())
+        return false;
+    const uchar* data = file.map(0, file.size());
+    if (!data)
+        return false;
+    bool ok = snapshot::decode(data, static_cast<std::size_t>(file.size()), state);
+    file.unmap(const_cast<uchar*>(data));
+    return ok;
+}
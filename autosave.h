@@ -0,0 +1,37 @@
+#ifndef AUTOSAVE_H
+#define AUTOSAVE_H
+
+#include "gamestate.h"
+#include <QString>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+// Writes game snapshots on a background thread. submit() only hands over
+// the immutable snapshot; if the writer is still busy, the newest pending
+// snapshot replaces older ones. Files are replaced atomically, so a crash
+// mid-write leaves the previous autosave intact.
+class Autosave
+{
+public:
+    explicit Autosave(const QString& _path);
+    ~Autosave();
+
+    void submit(const boost::shared_ptr<const GameState>& state);
+
+    const QString& file_path() const { return path; }
+
+    // Decodes a snapshot straight from a memory mapping of the file.
+    static bool load(const QString& path, GameState& state);
+
+private:
+    void run();
+
+    QString path;
+    boost::mutex mtx;
+    boost::condition_variable pending_cv;
+    boost::shared_ptr<const GameState> pending;
+    bool stopping;
+    boost::thread worker;
+};
+
+#endif // AUTOSAVE_H
@@ -0,0 +1,50 @@
+#-------------------------------------------------
+#
+# Benchmarks for the client hot paths.
+#
+#   bench --json current.json
+#   bench --compare baseline.json current.json --threshold 10
+#
+# The coroutine benchmarks need C++20: qmake CONFIG+=coroutines
+# The allocation counts of bench_alloc need qmake CONFIG+=allocprof
+#
+#-------------------------------------------------
+
+QT       += core gui
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+CONFIG   += console c++11
+CONFIG   -= app_bundle
+
+TARGET = bench
+TEMPLATE = app
+
+include(../core.pri)
+
+coroutines {
+    CONFIG += c++2a
+    *-g++*: QMAKE_CXXFLAGS += -fcoroutines
+}
+
+SOURCES += main.cpp \
+    benchmark.cpp \
+    bench_client.cpp \
+    bench_state.cpp \
+    bench_auction.cpp \
+    bench_pipeline.cpp \
+    bench_session.cpp \
+    bench_transport.cpp \
+    bench_uring.cpp \
+    bench_spill.cpp \
+    bench_reconcile.cpp \
+    bench_resume.cpp \
+    bench_autoplay.cpp \
+    bench_bots.cpp \
+    bench_alloc.cpp \
+    bench_wire.cpp \
+    ../bots/greedybot.cpp
+
+HEADERS  += benchmark.h \
+    benchaccess.h \
+    benchserver.h
@@ -0,0 +1,130 @@
+#include "benchmark.h"
+#include "benchaccess.h"
+#include "benchserver.h"
+#include "allocprof.h"
+
+#include <atomic>
+#include <cstdio>
+
+// Heap allocations of a turn and of a frame once the game has settled.
+// The counts need the allocation profiler, qmake CONFIG+=allocprof;
+// without it only the timings are reported.
+
+namespace {
+
+#ifdef YOURCOMPANY_ALLOCPROF
+uint64_t allocations(const char* const* sites)
+{
+    uint64_t total = 0;
+    for (; *sites; ++sites)
+        total += AllocProfiler::counts(*sites).allocations;
+    return total;
+}
+
+void check_none(const char* bench, const char* what, double per_op)
+{
+    if (per_op > 0)
+        fprintf(stderr, "%s: %.3f heap allocations per %s in the steady state\n", bench, per_op, what);
+}
+#endif
+
+void replied(std::atomic<bool>* flag, uint8_t, const uint8_t*, uint32_t)
+{
+    *flag = true;
+}
+
+}
+
+// A turn as a player plays it: load every line, sell what the contracts
+// take and step, with four lines whose output the one new contract a turn
+// buys up. The turn, the sale and the year-end report must not allocate;
+// turn.snapshot is the history entry, autosave and economy point each turn
+// keeps, reported for reference.
+BENCHMARK(alloc_turn)
+{
+    MainWindow w;
+    BenchAccess::set_main_state(w);
+    BenchAccess::set_money(w, 1000000);
+    std::vector<ProductLine*> lines;
+    for (int l = 0; l < 4; ++l)
+        lines.push_back(BenchAccess::add_product_line(w, l % 2 ? "A" : "B", l < 2 ? "A" : "B"));
+
+    uint64_t turns = 0;
+    auto turn = [&] {
+        for (std::size_t l = 0; l < lines.size(); ++l)
+            lines[l]->MatPerTime.have_materials[0] = true;
+        BenchAccess::add_contract(w, 2, 5, 2, 7);
+        BenchAccess::sale_products(w);
+        BenchAccess::play_turn(w);
+        ++turns;
+    };
+    // a few years for the buffers and the arena to reach their size
+    for (int i = 0; i < 64; ++i)
+        turn();
+
+#ifdef YOURCOMPANY_ALLOCPROF
+    static const char* const turn_sites[] = { "turn", "turn.sale", "turn.publish", NULL };
+    static const char* const snapshot_sites[] = { "turn.snapshot", NULL };
+    uint64_t turn_before = allocations(turn_sites);
+    uint64_t snapshot_before = allocations(snapshot_sites);
+#endif
+    turns = 0;
+    Bench::Result& r = bench.run("alloc_turn/lines=4", turn);
+    r.counters["turn_arena_bytes"] = double(BenchAccess::turn_arena_capacity(w));
+#ifdef YOURCOMPANY_ALLOCPROF
+    r.counters["allocs_per_turn"] = double(allocations(turn_sites) - turn_before) / turns;
+    r.counters["snapshot_allocs_per_turn"] = double(allocations(snapshot_sites) - snapshot_before) / turns;
+    check_none("alloc_turn", "turn", r.counters["allocs_per_turn"]);
+#endif
+}
+
+// Bursts of 63 contract requests and one formed request through a Connector
+// to the stand-in server, waiting for the last reply: 64 frames out and 64
+// back. Sending, writing, reading and parsing must not allocate; the
+// formed request's reply handler entry is reported as request_allocs.
+BENCHMARK(alloc_frames)
+{
+    static StandInServer* server = new StandInServer;
+    static const std::string market = "A/";
+
+    GUIUpdater updater;
+    Connector connector(&updater);
+    connector.start("127.0.0.1", server->port(), "bench", "bench");
+    if (!wait_connected(connector)) {
+        fprintf(stderr, "alloc_frames: connection failed\n");
+        return;
+    }
+
+    std::atomic<bool> done(false);
+    uint64_t bursts = 0;
+    auto burst = [&] {
+        for (int i = 0; i < 63; ++i)
+            connector.command_send(cmd_type_get_contract, reinterpret_cast<const uint8_t*>(market.data()),
+                                   market.size());
+        done = false;
+        connector.request(cmd_type_formed, cmd_type_formed_ok, NULL, 0,
+                          boost::bind(&replied, &done, boost::placeholders::_1, boost::placeholders::_2,
+                                      boost::placeholders::_3));
+        while (!done)
+            boost::this_thread::yield();
+        ++bursts;
+    };
+    for (int i = 0; i < 16; ++i)
+        burst();
+
+#ifdef YOURCOMPANY_ALLOCPROF
+    static const char* const frame_sites[] = { "net.send", "net.write", "net.read", "net.parse", NULL };
+    static const char* const request_sites[] = { "net.request", NULL };
+    uint64_t frame_before = allocations(frame_sites);
+    uint64_t request_before = allocations(request_sites);
+#endif
+    bursts = 0;
+    Bench::Result& r = bench.run("alloc_frames/burst=64", burst);
+    r.counters["frames_per_op"] = 128;
+#ifdef YOURCOMPANY_ALLOCPROF
+    r.counters["allocs_per_frame"] = double(allocations(frame_sites) - frame_before) / (bursts * 128);
+    r.counters["request_allocs"] = double(allocations(request_sites) - request_before) / bursts;
+    check_none("alloc_frames", "frame", r.counters["allocs_per_frame"]);
+#endif
+    connector.stop();
+}
@@ -0,0 +1,124 @@
+#include "benchmark.h"
+#include "connector.h"
+
+#include <boost/asio.hpp>
+#include <boost/thread.hpp>
+#include <cstdio>
+
+namespace {
+
+using boost::asio::ip::tcp;
+
+// Stand-in auction server on the loopback interface: accepts one client and
+// acknowledges every cmd_type_amount bid by echoing it as the new price.
+class AuctionServer
+{
+public:
+    AuctionServer() :
+        acceptor(io_service, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0))
+    {
+        worker = boost::thread(boost::bind(&AuctionServer::run, this));
+    }
+
+    ~AuctionServer()
+    {
+        worker.join();
+    }
+
+    unsigned short port() const { return acceptor.local_endpoint().port(); }
+
+private:
+    void run()
+    {
+        tcp::socket socket(io_service);
+        acceptor.accept(socket);
+        socket.set_option(tcp::no_delay(true));
+        std::vector<uint8_t> payload, reply;
+        uint8_t header[7];
+        boost::system::error_code error;
+        for (;;) {
+            boost::asio::read(socket, boost::asio::buffer(header), error);
+            if (error)
+                return;
+            uint32_t size;
+            memcpy(&size, &header[2], 4);
+            payload.resize(size);
+            if (size)
+                boost::asio::read(socket, boost::asio::buffer(&payload[0], size), error);
+            if (error)
+                return;
+            if (header[6] != cmd_type_amount)
+                continue;
+            Connector::command_frame(cmd_type_amount, size ? &payload[0] : NULL, size, reply);
+            boost::asio::write(socket, boost::asio::buffer(reply), error);
+        }
+    }
+
+    boost::asio::io_service io_service;
+    tcp::acceptor acceptor;
+    boost::thread worker;
+};
+
+void open_auction(AuctionClient& auction)
+{
+    static const std::string opened = "1/Lot A/100/5";
+    auction.set_budget(0x7fffffff);
+    auction.on_auction(reinterpret_cast<const uint8_t*>(opened.data()), opened.size());
+}
+
+}
+
+BENCHMARK(auction)
+{
+    AuctionClient prepared;
+    open_auction(prepared);
+    int32_t price = 100;
+    AuctionClient::Frame frame;
+    // the ack in setup moves the price and prepares the next frames; only
+    // the click path is timed
+    bench.run("auction_bid_prepared", [&] {
+        char ack[32];
+        int length = snprintf(ack, sizeof(ack), "1/%d", price += 5);
+        prepared.on_amount(reinterpret_cast<const uint8_t*>(ack), length);
+    }, [&] {
+        prepared.take_bid(0, frame);
+        do_not_optimize(frame);
+    });
+
+    std::vector<uint8_t> formatted;
+    bench.run("auction_bid_formatted", [&] {
+        char payload[32];
+        int length = snprintf(payload, sizeof(payload), "%u/%d", 1u, price += 5);
+        Connector::command_frame(cmd_type_amount, reinterpret_cast<const uint8_t*>(payload), length, formatted);
+        do_not_optimize(formatted);
+    });
+
+    AuctionServer server;
+    boost::asio::io_service io_service;
+    tcp::socket socket(io_service);
+    socket.connect(tcp::endpoint(boost::asio::ip::address_v4::loopback(), server.port()));
+    socket.set_option(tcp::no_delay(true));
+
+    AuctionClient auction;
+    open_auction(auction);
+    std::vector<uint8_t> ack;
+    uint8_t header[7];
+    Bench::Result& r = bench.run("auction_bid_to_ack_loopback", [&] {
+        AuctionClient::Frame bid;
+        if (!auction.take_bid(0, bid))
+            return;
+        boost::asio::write(socket, boost::asio::buffer(*bid));
+        boost::asio::read(socket, boost::asio::buffer(header));
+        uint32_t size;
+        memcpy(&size, &header[2], 4);
+        ack.resize(size);
+        boost::asio::read(socket, boost::asio::buffer(&ack[0], size));
+        auction.on_amount(&ack[0], size);
+    });
+    AuctionClient::Latency latency = auction.latency();
+    r.counters["acked_bids"] = double(latency.count);
+    r.counters["median_us"] = latency.median_us;
+    r.counters["p99_us"] = latency.p99_us;
+    r.counters["max_us"] = latency.max_us;
+    socket.close();
+}
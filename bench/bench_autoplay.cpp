@@ -0,0 +1,124 @@
+#include "benchmark.h"
+#include "autoplay.h"
+#include "timeseries.h"
+#include "turnhistory.h"
+
+#include <boost/chrono.hpp>
+#include <algorithm>
+
+namespace {
+
+GameState factory(std::size_t lines, std::size_t contracts)
+{
+    GameState state;
+    state.money = 1000000;
+    state.materials = 0;
+    state.credit_max_time = 42;
+    state.count_year = 4;
+    for (std::size_t i = 0; i < lines; ++i) {
+        GameState::Line line;
+        line.product_type = i % 2;
+        line.line_type = i % 3 == 0;
+        line.loaded = false;
+        line.have_materials.assign(line.line_type == GameState::ProductA ? 4 : 2, 0);
+        state.lines.push_back(line);
+    }
+    for (int i = 0; i < 8; ++i) {
+        GameState::Market market = { "M" + std::to_string(i), 1, 4, i % 2 == 0 };
+        state.markets.push_back(market);
+    }
+    for (std::size_t i = 0; i < contracts; ++i) {
+        GameState::Contract contract = { 1, 5, 1, 7, -1, 0 };
+        state.contracts.push_back(contract);
+    }
+    return state;
+}
+
+struct FrameStats
+{
+    std::size_t turns;
+    std::size_t frames;
+    double work_ms_total;
+    double work_ms_max;
+
+    FrameStats() : turns(0), frames(0), work_ms_total(0), work_ms_max(0) { }
+};
+
+// What MainWindow::show_autoplay does once per displayed frame, short of
+// rendering: collect the turns and record every one of them.
+void play_frames(double rate, int frames, FrameStats& stats)
+{
+    typedef boost::chrono::steady_clock Clock;
+    const Clock::duration frame = boost::chrono::microseconds(16667);
+
+    ReportBuilder report;
+    report.begin_year(1, 1000000);
+    AutoPlayer player;
+    TurnHistory history;
+    TimeSeries economy;
+    AutoPlayer::Progress progress;
+    player.start(factory(4, 8), report, boost::shared_ptr<TurnPolicy>(new GreedyPolicy), rate);
+    Clock::time_point next = Clock::now() + frame;
+    for (int f = 0; f < frames; ++f) {
+        boost::this_thread::sleep_until(next);
+        next += frame;
+        uint64_t begin = Bench::thread_cpu_ns();
+        player.take(progress);
+        for (std::size_t i = 0; i < progress.turns.size(); ++i) {
+            history.record(*progress.turns[i]);
+            economy.append(*progress.turns[i]);
+        }
+        double work_ms = (Bench::thread_cpu_ns() - begin) / 1e6;
+        stats.turns += progress.turns.size();
+        stats.work_ms_total += work_ms;
+        stats.work_ms_max = std::max(stats.work_ms_max, work_ms);
+        ++stats.frames;
+    }
+    player.stop();
+}
+
+}
+
+// autoplay_turn is one policy decision plus the turn rules on the player
+// thread. autoplay_frames runs the player for 15 frames of a 60 Hz display
+// the way the window consumes it: unpaced, and at 1000 turns a second.
+// frame_work_ms is the CPU time the GUI thread spends per frame (taking the
+// turns and recording them in the history and the economy), which the
+// player's queue limit keeps bounded however fast turns are played.
+BENCHMARK(autoplay)
+{
+    {
+        GameState state = factory(4, 8);
+        ReportBuilder report;
+        report.begin_year(1, state.money);
+        GreedyPolicy policy;
+        YearReport year;
+        bench.run("autoplay_turn/lines=4", [&] {
+            TurnPlan plan;
+            policy.plan(state, plan);
+            rules::buy_materials(state, plan.buy_materials);
+            for (std::size_t i = 0; i < plan.load_lines.size(); ++i)
+                rules::load_line(state, plan.load_lines[i]);
+            if (plan.sell)
+                rules::sell(state, report);
+            rules::end_turn(state, report, year);
+            if (state.contracts.empty()) {
+                GameState::Contract contract = { 1, 5, 1, 7, -1, 0 };
+                state.contracts.assign(8, contract);
+            }
+            do_not_optimize(state.money);
+        });
+    }
+
+    static const double rates[] = { 0, 1000 };
+    for (std::size_t r = 0; r < sizeof(rates) / sizeof(rates[0]); ++r) {
+        FrameStats stats;
+        Bench::Result& result = bench.run(rates[r] ? "autoplay_frames/1000_per_s" : "autoplay_frames/unpaced", [&] {
+            play_frames(rates[r], 15, stats);
+        });
+        double seconds = stats.frames / 60.0;
+        result.counters["turns_per_s"] = stats.turns / seconds;
+        result.counters["frame_work_ms_mean"] = stats.work_ms_total / stats.frames;
+        result.counters["frame_work_ms_max"] = stats.work_ms_max;
+    }
+}
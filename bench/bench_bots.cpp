@@ -0,0 +1,151 @@
+#include "benchmark.h"
+#include "benchserver.h"
+#include "bothost.h"
+
+extern "C" const BotPlugin* yourcompany_bot_plugin(void);
+
+namespace {
+
+GameState bot_state()
+{
+    GameState state;
+    state.money = 1000;
+    state.materials = 0;
+    state.credit_max_time = 42;
+    state.count_year = 4;
+    for (int i = 0; i < 2; ++i) {
+        GameState::Line line = { static_cast<uint8_t>(i), static_cast<uint8_t>(i), false,
+                                 std::vector<uint8_t>(i == 0 ? 4 : 2, 0) };
+        state.lines.push_back(line);
+    }
+    return state;
+}
+
+// Accepts every offer it sees twice in its next turn.
+struct EagerBot
+{
+    std::vector<uint32_t> offers;
+};
+
+void* eager_create(uint32_t, const char*)
+{
+    return new EagerBot;
+}
+
+void eager_destroy(void* bot)
+{
+    delete static_cast<EagerBot*>(bot);
+}
+
+void eager_observe(void* instance, const BotEvent* events, uint32_t count)
+{
+    EagerBot* bot = static_cast<EagerBot*>(instance);
+    for (uint32_t i = 0; i < count; ++i) {
+        if (events[i].kind == BotEventContractOffer)
+            bot->offers.push_back(events[i].id);
+    }
+}
+
+void eager_decide(void* const* bots, const BotState*, uint32_t count,
+                  BotAction* actions, uint32_t max_actions, uint32_t* action_counts)
+{
+    for (uint32_t i = 0; i < count; ++i) {
+        EagerBot* bot = static_cast<EagerBot*>(bots[i]);
+        BotAction* out = actions + i * max_actions;
+        uint32_t n = 0;
+        for (std::size_t o = 0; o < bot->offers.size() && n + 2 <= max_actions; ++o) {
+            BotAction accept = { BotAcceptOffer, static_cast<int32_t>(bot->offers[o]) };
+            out[n++] = accept;
+            out[n++] = accept;
+        }
+        bot->offers.clear();
+        action_counts[i] = n;
+    }
+}
+
+const BotPlugin eager_plugin = {
+    BOT_ABI_VERSION,
+    "eager",
+    eager_create,
+    eager_destroy,
+    eager_observe,
+    eager_decide
+};
+
+}
+
+// One round of 1024 greedy bots (bots/greedybot.cpp) going out through a
+// Connector to the stand-in server, every four rounds with two contract
+// offers for them. batch=1,frame=0 asks the plugin about one bot at a time
+// and sends every bot's turn in a frame of its own; batch=64 has decide()
+// called for 64 bots at once and coalesces a shard's turns into frames of
+// up to 16 KB. latency is per bot, from the start of the round until the
+// frame with its turn is handed to the connector.
+BENCHMARK(bots)
+{
+    static StandInServer* server = new StandInServer;
+    static const std::size_t count = 1024;
+
+    GUIUpdater updater;
+    Connector connector(&updater);
+    connector.start("127.0.0.1", server->port(), "bench", "bench");
+    if (!wait_connected(connector)) {
+        fprintf(stderr, "bots: connection failed\n");
+        return;
+    }
+    boost::shared_ptr<BotLibrary> library(new BotLibrary(yourcompany_bot_plugin()));
+
+    std::vector<std::size_t> thread_counts(1, 1);
+    if (boost::thread::hardware_concurrency() > 1)
+        thread_counts.push_back(boost::thread::hardware_concurrency());
+    for (std::size_t t = 0; t < thread_counts.size(); ++t) {
+        for (int batched = 0; batched <= 1; ++batched) {
+            BotHost host(thread_counts[t], boost::bind(&Connector::frame_send, &connector, boost::placeholders::_1));
+            host.set_batch_size(batched ? 64 : 1);
+            host.set_max_frame_size(batched ? 16 * 1024 : 0);
+            GameState state = bot_state();
+            for (std::size_t i = 0; i < count; ++i)
+                host.add_bot(library, state, "min_price=5");
+            uint64_t round = 0;
+            std::string name = "bots_round/threads=" + std::to_string(thread_counts[t])
+                    + (batched ? ",batch=64,frame=16K" : ",batch=1,frame=0");
+            Bench::Result& r = bench.run(name, [&] {
+                if (round++ % BotHost::OfferRounds == 0) {
+                    host.offer_contract("1A5/1B7");
+                    host.offer_contract("2A6/0B0");
+                }
+                host.play_round();
+            });
+            BotHost::Stats stats = host.stats();
+            r.counters["decisions_per_s"] = stats.decisions / stats.seconds;
+            r.counters["latency_median_us"] = stats.latency.median_us;
+            r.counters["latency_p99_us"] = stats.latency.p99_us;
+            r.counters["frames_per_round"] = double(stats.frames) / stats.rounds;
+            r.counters["bytes_per_decision"] = double(stats.bytes) / stats.decisions;
+            r.counters["actions_per_decision"] = double(stats.actions) / stats.decisions;
+        }
+    }
+    connector.stop();
+}
+
+// Two bots on shards of their own accepting the same offer twice each in the
+// turn after it is made. Only the first acceptance may stand, so
+// contracts_per_offer has to stay at 1 and the other three are refused.
+BENCHMARK(bots_offer)
+{
+    boost::shared_ptr<BotLibrary> library(new BotLibrary(&eager_plugin));
+    BotHost host(2, [](const BotHost::Frame&) { });
+    GameState state = bot_state();
+    host.add_bot(library, state, "");
+    host.add_bot(library, state, "");
+    uint64_t offers = 0;
+    Bench::Result& r = bench.run("bots_offer/bots=2,accepts=2", [&] {
+        host.offer_contract("1A5/1B7");
+        ++offers;
+        host.play_round();
+    });
+    std::size_t contracts = host.state(0).contracts.size() + host.state(1).contracts.size();
+    BotHost::Stats stats = host.stats();
+    r.counters["contracts_per_offer"] = double(contracts) / offers;
+    r.counters["refused_per_offer"] = double(4 * offers - stats.actions) / offers;
+}
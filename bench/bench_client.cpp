@@ -0,0 +1,312 @@
+#include "benchmark.h"
+#include "benchaccess.h"
+#include "connector.h"
+#include "rostermodel.h"
+
+#include <QImage>
+#include <QThread>
+
+namespace {
+
+std::string bench_name(const char* group, const char* variant, std::size_t value)
+{
+    return std::string(group) + "/" + variant + "=" + std::to_string(value);
+}
+
+std::vector<uint8_t> server_stream(std::size_t frames)
+{
+    static const std::string usr_list = "alice\nbob\ncarol\ndave\neve\nmallory\ntrent\nvictor\n";
+    static const std::string contract = "3A5/2B7/A";
+    std::vector<uint8_t> stream, frame;
+    for (std::size_t i = 0; i < frames; ++i) {
+        switch (i % 3) {
+        case 0:
+            Connector::command_frame(cmd_type_get_usr_list,
+                                     reinterpret_cast<const uint8_t*>(usr_list.data()), usr_list.size(), frame);
+            break;
+        case 1:
+            Connector::command_frame(cmd_type_get_contract_ok,
+                                     reinterpret_cast<const uint8_t*>(contract.data()), contract.size(), frame);
+            break;
+        default:
+            Connector::command_frame(cmd_type_formed_ok, NULL, 0, frame);
+            break;
+        }
+        stream.insert(stream.end(), frame.begin(), frame.end());
+    }
+    return stream;
+}
+
+}
+
+BENCHMARK(base64_encode)
+{
+    static const std::size_t sizes[] = { 16, 64, 1024 };
+    for (std::size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        std::string input(sizes[i], 'x');
+        Bench::Result& r = bench.run(bench_name("base64_encode", "bytes", sizes[i]), [&] {
+            std::string encoded = base64_encode(input);
+            do_not_optimize(encoded);
+        });
+        r.counters["bytes_per_op"] = double(sizes[i]);
+    }
+}
+
+BENCHMARK(buffer_parse)
+{
+    static const std::size_t frames = 999;
+    static const std::size_t chunks[] = { 1, 7, 64, 2048, 0 };
+    std::vector<uint8_t> stream = server_stream(frames);
+    GUIUpdater updater;
+    Connector parser(&updater);
+    for (std::size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); ++i) {
+        std::size_t chunk = chunks[i] ? chunks[i] : stream.size();
+        Bench::Result& r = bench.run(bench_name("buffer_parse", "chunk", chunk), [&] {
+            for (std::size_t offset = 0; offset < stream.size(); offset += chunk)
+                parser.buffer_parse(&stream[offset], std::min(chunk, stream.size() - offset));
+        });
+        r.counters["frames_per_op"] = double(frames);
+        r.counters["bytes_per_op"] = double(stream.size());
+    }
+}
+
+BENCHMARK(command_frame)
+{
+    static const std::size_t sizes[] = { 0, 64, 4096 };
+    for (std::size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        std::vector<uint8_t> payload(sizes[i], 0x42);
+        Bench::Result& r = bench.run(bench_name("command_frame", "bytes", sizes[i]), [&] {
+            std::vector<uint8_t> frame;
+            Connector::command_frame(cmd_type_get_contract, payload.empty() ? NULL : &payload[0], payload.size(), frame);
+            do_not_optimize(frame);
+        });
+        r.counters["bytes_per_op"] = double(sizes[i] + 7);
+    }
+}
+
+BENCHMARK(sale_products)
+{
+    static const std::size_t inventories[] = { 100, 1000, 10000 };
+    MainWindow w;
+    for (std::size_t i = 0; i < sizeof(inventories) / sizeof(inventories[0]); ++i) {
+        std::size_t inventory = inventories[i];
+        Bench::Result& r = bench.run(bench_name("sale_products", "inventory", inventory), [&] {
+            std::vector<Product>& products = BenchAccess::products(w);
+            products.clear();
+            for (std::size_t p = 0; p < inventory; ++p) {
+                Product product;
+                product.type = p % 2 ? Product::TypeB : Product::TypeA;
+                products.push_back(product);
+            }
+            BenchAccess::clear_contracts(w);
+            for (std::size_t c = 0; c < inventory / 10; ++c)
+                BenchAccess::add_contract(w, 4, 3, 4, 5);
+        }, [&] {
+            BenchAccess::sale_products(w);
+        });
+        r.counters["products"] = double(inventory);
+    }
+}
+
+BENCHMARK(recount)
+{
+    static const std::size_t line_counts[] = { 10, 100, 1000 };
+    for (std::size_t i = 0; i < sizeof(line_counts) / sizeof(line_counts[0]); ++i) {
+        int materials = 0;
+        std::vector<Product> products;
+        std::vector<ProductLine*> lines;
+        for (std::size_t l = 0; l < line_counts[i]; ++l)
+            lines.push_back(new ProductLine(NULL, l % 2 ? "A" : "B", l % 3 ? "A" : "B", &materials, products));
+
+        Bench::Result& r = bench.run(bench_name("recount", "lines", line_counts[i]), [&] {
+            products.clear();
+            for (std::size_t l = 0; l < lines.size(); ++l) {
+                std::deque<bool>& have = lines[l]->MatPerTime.have_materials;
+                std::fill(have.begin(), have.end(), true);
+            }
+        }, [&] {
+            for (std::size_t l = 0; l < lines.size(); ++l)
+                lines[l]->MatPerTime.recount();
+        });
+        r.counters["lines"] = double(line_counts[i]);
+
+        for (std::size_t l = 0; l < lines.size(); ++l)
+            delete lines[l];
+    }
+}
+
+BENCHMARK(paint)
+{
+    MainWindow w;
+    w.resize(1100, 700);
+    QImage image(w.size(), QImage::Format_ARGB32_Premultiplied);
+
+    BenchAccess::set_main_state(w);
+    BenchAccess::set_money(w, 120);
+    BenchAccess::set_materials(w, 60);
+    for (int slot = 0; slot < 4; ++slot)
+        BenchAccess::set_debit(w, slot, 6);
+    BenchAccess::add_credit(w, 10, 20);
+    for (int p = 0; p < 60; ++p) {
+        Product product;
+        product.type = p % 2 ? Product::TypeB : Product::TypeA;
+        BenchAccess::products(w).push_back(product);
+    }
+    for (int l = 0; l < 4; ++l)
+        BenchAccess::add_product_line(w, l % 2 ? "A" : "B", l < 2 ? "A" : "B");
+
+    bench.run("paint/main", [&] {
+        w.render(&image);
+    });
+
+    int turn = 0;
+    bench.run("paint/main_money_changed", [&] {
+        BenchAccess::set_money(w, 120 + (++turn & 1));
+        w.render(&image);
+    });
+
+    BenchAccess::set_market_state(w);
+    bench.run("paint/market", [&] {
+        w.render(&image);
+    });
+}
+
+BENCHMARK(board_raster)
+{
+    MainWindow w;
+    w.resize(1100, 700);
+    QImage image(w.size(), QImage::Format_ARGB32_Premultiplied);
+
+    BenchAccess::set_main_state(w);
+    BenchAccess::set_money(w, 400);
+    BenchAccess::set_materials(w, 300);
+    for (int slot = 0; slot < 4; ++slot)
+        BenchAccess::set_debit(w, slot, 40);
+    for (int c = 0; c < 10; ++c)
+        BenchAccess::add_credit(w, c * 4, 20);
+    for (int p = 0; p < 300; ++p) {
+        Product product;
+        product.type = p % 2 ? Product::TypeB : Product::TypeA;
+        BenchAccess::products(w).push_back(product);
+    }
+    for (int l = 0; l < 4; ++l)
+        BenchAccess::add_product_line(w, l % 2 ? "A" : "B", l < 2 ? "A" : "B");
+
+    std::vector<int> thread_counts;
+    thread_counts.push_back(0);
+    for (int threads = 1; threads <= QThread::idealThreadCount(); threads *= 2)
+        thread_counts.push_back(threads);
+    if (thread_counts.back() != QThread::idealThreadCount())
+        thread_counts.push_back(QThread::idealThreadCount());
+
+    for (std::size_t i = 0; i < thread_counts.size(); ++i) {
+        int threads = thread_counts[i];
+        Bench::Result& r = bench.run(bench_name("board_raster", "threads", threads), [&] {
+            BenchAccess::render_board_frame(w, image, threads);
+        });
+        r.counters["raster_threads"] = threads;
+    }
+    BenchAccess::render_board_frame(w, image, 0);
+}
+
+BENCHMARK(market_view)
+{
+    static const std::size_t counts[] = { 4, 64, 256 };
+    static const Qt::GlobalColor colors[] = { Qt::red, Qt::blue, Qt::yellow, Qt::gray };
+    MainWindow w;
+    w.resize(1100, 700);
+    QImage image(w.size(), QImage::Format_ARGB32_Premultiplied);
+    BenchAccess::set_market_state(w);
+
+    for (std::size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); ++i) {
+        BenchAccess::clear_markets(w);
+        for (std::size_t m = 0; m < counts[i]; ++m) {
+            QRect rect(10 + int(m % 16) * 66, 50 + int(m / 16) * 40, 60, 60);
+            BenchAccess::add_market(w, "M" + std::to_string(m), rect, colors[m % 4]);
+        }
+        bench.run(bench_name("market_view", "markets", counts[i]), [&] {
+            w.render(&image);
+        });
+        std::size_t toggled = 0;
+        bench.run(bench_name("market_view_select", "markets", counts[i]), [&] {
+            BenchAccess::select_market(w, toggled % counts[i], toggled / counts[i] % 2 == 0);
+            ++toggled;
+            w.render(&image);
+        });
+    }
+}
+
+BENCHMARK(market_hit_test)
+{
+    static const std::size_t counts[] = { 16, 256, 4096 };
+    for (std::size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); ++i) {
+        std::vector<QRect> circles;
+        int per_row = 64;
+        for (std::size_t m = 0; m < counts[i]; ++m)
+            circles.push_back(QRect(int(m % per_row) * 22, int(m / per_row) * 22, 20, 20));
+        MarketGrid grid;
+        grid.build(circles);
+
+        std::vector<QPoint> clicks;
+        for (int c = 0; c < 1024; ++c)
+            clicks.push_back(QPoint((c * 7919) % (per_row * 22), (c * 104729) % (int(counts[i] / per_row + 1) * 22)));
+
+        std::size_t next = 0;
+        bench.run(bench_name("market_hit_test/grid", "markets", counts[i]), [&] {
+            int hit = grid.hit(clicks[next++ & 1023]);
+            do_not_optimize(hit);
+        });
+        bench.run(bench_name("market_hit_test/linear", "markets", counts[i]), [&] {
+            QPoint click = clicks[next++ & 1023];
+            int hit = -1;
+            for (std::size_t m = 0; m < circles.size(); ++m) {
+                if (MarketGrid::contains(circles[m], click))
+                    hit = int(m);
+            }
+            do_not_optimize(hit);
+        });
+    }
+}
+
+BENCHMARK(roster)
+{
+    static const std::size_t sizes[] = { 10, 1000, 100000 };
+    for (std::size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        RosterDelta snapshot = { RosterDelta::Snapshot, true, 0, std::string(), std::string() };
+        for (std::size_t u = 0; u < sizes[i]; ++u)
+            snapshot.name += "player" + std::to_string(u) + "\tready\n";
+
+        // what every roster change used to cost: the whole list on the wire and in the label
+        Roster full;
+        Bench::Result& f = bench.run(bench_name("roster_full_list", "users", sizes[i]), [&] {
+            full.apply(snapshot);
+            std::string text = full.to_text();
+            do_not_optimize(text);
+        });
+        f.counters["wire_bytes"] = double(snapshot.name.size() + 11);
+
+        // the delta path as the lobby sees it, with the list model attached
+        Roster roster;
+        RosterModel model(&roster);
+        roster.apply(snapshot);
+        RosterDelta join = { RosterDelta::Join, true, 0, "newcomer", "ready" };
+        RosterDelta leave = { RosterDelta::Leave, true, 0, "newcomer", std::string() };
+        uint32_t seq = 0;
+        std::vector<uint8_t> payload;
+        RosterDelta::frame_payload(join, payload);
+        Bench::Result& d = bench.run(bench_name("roster_delta", "users", sizes[i]), [&] {
+            join.seq = ++seq;
+            roster.apply(join);
+            leave.seq = ++seq;
+            do_not_optimize(roster.apply(leave));
+        });
+        d.counters["wire_bytes"] = double(payload.size() + 7);
+
+        std::vector<std::size_t> slots;
+        Bench::Result& p = bench.run(bench_name("roster_prefix_search", "users", sizes[i]), [&] {
+            roster.find_prefix("player99", slots);
+            do_not_optimize(slots);
+        });
+        p.counters["matches"] = double(slots.size());
+    }
+}
@@ -0,0 +1,81 @@
+#include "benchmark.h"
+#include "benchserver.h"
+
+namespace {
+
+// Counts replies and lets the benchmark wait for a number of them.
+class ReplyCounter
+{
+public:
+    ReplyCounter() : replies(0) { }
+
+    void on_reply(uint8_t, const uint8_t*, uint32_t)
+    {
+        boost::mutex::scoped_lock lock(mtx);
+        ++replies;
+        cv.notify_all();
+    }
+
+    bool wait_for(std::size_t count)
+    {
+        boost::mutex::scoped_lock lock(mtx);
+        while (replies < count) {
+            if (!cv.timed_wait(lock, boost::posix_time::seconds(10)))
+                return false;
+        }
+        return true;
+    }
+
+    void reset()
+    {
+        boost::mutex::scoped_lock lock(mtx);
+        replies = 0;
+    }
+
+private:
+    boost::mutex mtx;
+    boost::condition_variable cv;
+    std::size_t replies;
+};
+
+}
+
+BENCHMARK(pipeline)
+{
+    static const int one_way_ms = 10;
+    static const std::size_t requests = 16;
+    static const std::string market = "A/";
+    static StandInServer* server = new StandInServer;
+
+    for (int version = 1; version <= 2; ++version) {
+        LatencyProxy proxy(server->port(), one_way_ms);
+        GUIUpdater updater;
+        Connector connector(&updater);
+        connector.set_max_protocol(static_cast<uint8_t>(version));
+        connector.start("127.0.0.1", proxy.port(), "bench", "bench");
+        if (!wait_connected(connector) || connector.protocol_version() != version) {
+            fprintf(stderr, "pipeline: protocol %d connection failed\n", version);
+            return;
+        }
+
+        ReplyCounter counter;
+        Connector::ReplyHandler handler = boost::bind(&ReplyCounter::on_reply, &counter, boost::placeholders::_1,
+                                                       boost::placeholders::_2, boost::placeholders::_3);
+        std::string name = version == 1 ? "pipeline_contracts/sequential_v1" : "pipeline_contracts/pipelined_v2";
+        Bench::Result& r = bench.run(name, [&] {
+            counter.reset();
+            for (std::size_t i = 0; i < requests; ++i) {
+                connector.request(cmd_type_get_contract, cmd_type_get_contract_ok,
+                                  reinterpret_cast<const uint8_t*>(market.data()), market.size(), handler);
+                // protocol 1 cannot tell replies apart, so it keeps one request outstanding
+                if (version == 1)
+                    counter.wait_for(i + 1);
+            }
+            counter.wait_for(requests);
+        });
+        r.counters["requests_per_op"] = double(requests);
+        r.counters["rtt_ms"] = 2.0 * one_way_ms;
+        r.counters["requests_per_s"] = requests * 1e9 / r.ns_per_op;
+        connector.stop();
+    }
+}
@@ -0,0 +1,136 @@
+#include "benchmark.h"
+#include "benchserver.h"
+#include "reconcile.h"
+
+#include <algorithm>
+
+namespace {
+
+// The shape of MainWindow::Commitments.
+struct Commitments
+{
+    bool formed;
+    std::vector<uint32_t> offers;
+
+    Commitments() : formed(false) { }
+
+    static void form(Commitments& commitments) { commitments.formed = true; }
+    static void accept(Commitments& commitments, uint32_t offer) { commitments.offers.push_back(offer); }
+};
+
+// Waits for one reply at a time and remembers whether it was the expected one.
+class Ruling
+{
+public:
+    Ruling() : answered(false), accepted(false) { }
+
+    void on_reply(uint8_t expected, uint8_t cmd, const uint8_t*, uint32_t)
+    {
+        boost::mutex::scoped_lock lock(mtx);
+        answered = true;
+        accepted = cmd == expected;
+        cv.notify_all();
+    }
+
+    // 1 accepted, 0 turned down, -1 no answer
+    int wait()
+    {
+        boost::mutex::scoped_lock lock(mtx);
+        while (!answered) {
+            if (!cv.timed_wait(lock, boost::posix_time::seconds(10)))
+                return -1;
+        }
+        answered = false;
+        return accepted;
+    }
+
+private:
+    boost::mutex mtx;
+    boost::condition_variable cv;
+    bool answered;
+    bool accepted;
+};
+
+}
+
+// Pressing "Formed" over a link with a 20 ms round trip. visible_after_us is
+// the time from the click to the form state the player sees: applied at once
+// through the Reconciler, or only once cmd_type_formed_ok is back. Either way
+// an op lasts until the server has ruled. reconcile_reject then measures
+// rolling back the oldest of a queue of pending contract acceptances.
+BENCHMARK(reconcile)
+{
+    static const int one_way_ms = 10;
+    static StandInServer* server = new StandInServer;
+
+    LatencyProxy proxy(server->port(), one_way_ms);
+    GUIUpdater updater;
+    Connector connector(&updater);
+    connector.start("127.0.0.1", proxy.port(), "bench", "bench");
+    if (!wait_connected(connector) || connector.protocol_version() < 2) {
+        fprintf(stderr, "reconcile: connection failed\n");
+        return;
+    }
+
+    for (int optimistic = 1; optimistic >= 0; --optimistic) {
+        Reconciler<Commitments> commitments;
+        Ruling ruling;
+        bool ok = true;
+        uint64_t visible_ns = 0;
+        uint64_t actions = 0;
+        Bench::Result& r = bench.run(optimistic ? "reconcile_formed/optimistic" : "reconcile_formed/wait_for_server", [&] {
+            uint64_t begin = Bench::now_ns();
+            uint32_t seq = commitments.submit(&Commitments::form);
+            const Commitments& shown = optimistic ? commitments.predicted() : commitments.confirmed();
+            if (shown.formed)
+                visible_ns += Bench::now_ns() - begin;
+            connector.request(cmd_type_formed, cmd_type_formed_ok, NULL, 0,
+                              boost::bind(&Ruling::on_reply, &ruling, static_cast<uint8_t>(cmd_type_formed_ok),
+                                          boost::placeholders::_1, boost::placeholders::_2, boost::placeholders::_3));
+            int result = ruling.wait();
+            ok = result == 1 && ok;
+            commitments.confirm(seq);
+            if (!optimistic)
+                visible_ns += Bench::now_ns() - begin;
+            ++actions;
+            commitments.rebase(Commitments());
+        });
+        if (!ok)
+            fprintf(stderr, "reconcile: cmd_type_formed went unanswered\n");
+        r.counters["visible_after_us"] = double(visible_ns) / actions / 1e3;
+        r.counters["rtt_ms"] = 2.0 * one_way_ms;
+    }
+
+    // A rejected offer on the wire: the replay drops it and nothing else.
+    {
+        Reconciler<Commitments> commitments;
+        Ruling ruling;
+        std::string offer = "gone/1A5/1B7/A";
+        uint32_t seq = commitments.submit(boost::bind(&Commitments::accept, boost::placeholders::_1, 1u));
+        commitments.submit(boost::bind(&Commitments::accept, boost::placeholders::_1, 2u));
+        connector.request(cmd_type_accept_contract, cmd_type_accept_contract_ok,
+                          reinterpret_cast<const uint8_t*>(offer.data()), offer.size(),
+                          boost::bind(&Ruling::on_reply, &ruling, static_cast<uint8_t>(cmd_type_accept_contract_ok),
+                                      boost::placeholders::_1, boost::placeholders::_2, boost::placeholders::_3));
+        if (ruling.wait() != 0 || !commitments.reject(seq)
+                || commitments.predicted().offers != std::vector<uint32_t>(1, 2u))
+            fprintf(stderr, "reconcile: a turned down offer was not rolled back\n");
+    }
+    connector.stop();
+
+    static const std::size_t depths[] = { 4, 64 };
+    for (std::size_t d = 0; d < sizeof(depths) / sizeof(depths[0]); ++d) {
+        std::size_t depth = depths[d];
+        Reconciler<Commitments> commitments;
+        uint32_t oldest = 0;
+        bench.run("reconcile_reject/pending=" + std::to_string(depth), [&] {
+            commitments.reject_all();
+            oldest = commitments.submit(boost::bind(&Commitments::accept, boost::placeholders::_1, 0u));
+            for (std::size_t i = 1; i < depth; ++i)
+                commitments.submit(boost::bind(&Commitments::accept, boost::placeholders::_1, uint32_t(i)));
+        }, [&] {
+            commitments.reject(oldest);
+            do_not_optimize(commitments.predicted().offers.size());
+        });
+    }
+}
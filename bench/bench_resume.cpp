@@ -0,0 +1,337 @@
+#include "benchmark.h"
+#include "benchserver.h"
+
+namespace {
+
+// Stand-in server keeping one resumable session across connections, see
+// protocol.h. Replies go out rtt_ms after the frames they answer, as over a
+// slow link. disconnect() drops the connection and has users join while
+// the client is away; a resumed session gets those joins replayed.
+class ResumeServer
+{
+public:
+    ResumeServer(int _rtt_ms, std::size_t users) :
+        acceptor(io_service, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0)),
+        socket(io_service),
+        stopping(false),
+        rtt_ms(_rtt_ms),
+        roster_seq(1),
+        session(false),
+        generation(0),
+        received(0),
+        sent_base(0),
+        logins(0),
+        bytes(0)
+    {
+        for (std::size_t i = 0; i < users; ++i)
+            names.push_back("user" + std::to_string(i));
+        worker = boost::thread(boost::bind(&ResumeServer::serve, this));
+    }
+
+    ~ResumeServer()
+    {
+        stopping = true;
+        disconnect(0);
+        boost::system::error_code ignored;
+        tcp::socket wake(io_service);
+        wake.connect(acceptor.local_endpoint(), ignored);
+        worker.join();
+    }
+
+    unsigned short port() const { return acceptor.local_endpoint().port(); }
+
+    void disconnect(std::size_t joining)
+    {
+        boost::mutex::scoped_lock lock(mtx);
+        for (std::size_t i = 0; i < joining; ++i) {
+            RosterDelta delta = { RosterDelta::Join, true, ++roster_seq, "user" + std::to_string(names.size()), "" };
+            names.push_back(delta.name);
+            std::vector<uint8_t> payload;
+            RosterDelta::frame_payload(delta, payload);
+            boost::shared_ptr<std::vector<uint8_t> > frame(new std::vector<uint8_t>);
+            Connector::command_frame(cmd_type_roster_join, &payload[0], payload.size(), *frame);
+            if (session)
+                sent.push_back(frame);      // written to a connection that is gone
+        }
+        boost::system::error_code ignored;
+        socket.shutdown(tcp::socket::shutdown_both, ignored);
+    }
+
+    uint32_t sequence() { boost::mutex::scoped_lock lock(mtx); return roster_seq; }
+    std::size_t users() { boost::mutex::scoped_lock lock(mtx); return names.size(); }
+    std::size_t login_count() { boost::mutex::scoped_lock lock(mtx); return logins; }
+    uint64_t bytes_written() { boost::mutex::scoped_lock lock(mtx); return bytes; }
+
+private:
+    typedef boost::shared_ptr<const std::vector<uint8_t> > Frame;
+
+    void serve()
+    {
+        while (!stopping) {
+            boost::system::error_code error;
+            acceptor.accept(socket, error);
+            if (error || stopping)
+                return;
+            socket.set_option(tcp::no_delay(true));
+            std::vector<uint8_t> buffer;
+            uint8_t chunk[4096];
+            for (;;) {
+                std::size_t n = socket.read_some(boost::asio::buffer(chunk), error);
+                if (error)
+                    break;
+                buffer.insert(buffer.end(), chunk, chunk + n);
+                boost::this_thread::sleep(boost::posix_time::milliseconds(rtt_ms));
+                boost::mutex::scoped_lock lock(mtx);
+                answer_all(buffer);
+            }
+            boost::mutex::scoped_lock lock(mtx);
+            socket.close(error);
+        }
+    }
+
+    void answer_all(std::vector<uint8_t>& buffer)
+    {
+        std::vector<uint8_t> out;
+        std::size_t at = 0;
+        uint32_t received_before = received;
+        while (buffer.size() - at >= 7) {
+            const uint8_t* header = &buffer[at];
+            std::size_t header_size = header[1] == 38 ? 11 : 7;
+            uint32_t size;
+            memcpy(&size, &header[2], 4);
+            if (buffer.size() - at < header_size + size)
+                break;
+            answer(header, std::string(reinterpret_cast<const char*>(header) + header_size, size), out);
+            at += header_size + size;
+        }
+        buffer.erase(buffer.begin(), buffer.begin() + at);
+        if (session && received != received_before) {
+            std::vector<uint8_t> ack;
+            Connector::command_frame(cmd_type_ack, reinterpret_cast<const uint8_t*>(&received), 4, ack);
+            out.insert(out.end(), ack.begin(), ack.end());
+        }
+        boost::system::error_code ignored;
+        bytes += boost::asio::write(socket, boost::asio::buffer(out), ignored);
+    }
+
+    void answer(const uint8_t* header, const std::string& text, std::vector<uint8_t>& out)
+    {
+        std::vector<uint8_t> reply;
+        uint8_t cmd = header[6];
+        if (cmd == cmd_type_auth) {
+            ++logins;
+            session = text.find("\nresume") != std::string::npos;
+            std::string answer = text.find("proto=2") != std::string::npos ? "proto=2" : "";
+            if (session) {
+                token = "token" + std::to_string(++generation);
+                answer += "\nresume=" + token;
+                received = 0;
+                sent.clear();
+                sent_base = 0;
+            }
+            Connector::command_frame(cmd_type_auth_ok, reinterpret_cast<const uint8_t*>(answer.data()),
+                                     answer.size(), reply);
+            out.insert(out.end(), reply.begin(), reply.end());
+        } else if (cmd == cmd_type_resume) {
+            uint32_t client_received = 0;
+            if (text.size() >= 4)
+                memcpy(&client_received, text.data(), 4);
+            if (!session || text.size() < 4 || text.substr(4) != token || client_received < sent_base
+                    || client_received - sent_base > sent.size()) {
+                static const std::string refused = "resume";
+                Connector::command_frame(cmd_type_err, reinterpret_cast<const uint8_t*>(refused.data()),
+                                         refused.size(), reply);
+                out.insert(out.end(), reply.begin(), reply.end());
+                return;
+            }
+            trim(client_received);
+            Connector::command_frame(cmd_type_resume_ok, reinterpret_cast<const uint8_t*>(&received), 4, reply);
+            out.insert(out.end(), reply.begin(), reply.end());
+            for (std::size_t i = 0; i < sent.size(); ++i)
+                out.insert(out.end(), sent[i]->begin(), sent[i]->end());
+        } else if (cmd == cmd_type_ack) {
+            uint32_t client_received;
+            if (text.size() >= 4) {
+                memcpy(&client_received, text.data(), 4);
+                trim(client_received);
+            }
+        } else {
+            if (session)
+                ++received;
+            if (cmd == cmd_type_get_usr_list) {
+                RosterDelta delta = { RosterDelta::Snapshot, true, roster_seq, "", "" };
+                for (std::size_t i = 0; i < names.size(); ++i)
+                    delta.name += names[i] + "\n";
+                std::vector<uint8_t> payload;
+                RosterDelta::frame_payload(delta, payload);
+                uint32_t request_id = 0;
+                if (header[1] == 38)
+                    memcpy(&request_id, &header[7], 4);
+                Connector::command_frame(cmd_type_roster_snapshot, request_id, &payload[0], payload.size(), reply);
+            } else if (!stand_in_answer(header, text, reply)) {
+                return;
+            }
+            if (session)
+                sent.push_back(Frame(new std::vector<uint8_t>(reply)));
+            out.insert(out.end(), reply.begin(), reply.end());
+        }
+    }
+
+    // Forgets the frames the client has.
+    void trim(uint32_t client_received)
+    {
+        if (client_received < sent_base || client_received - sent_base > sent.size())
+            return;
+        sent.erase(sent.begin(), sent.begin() + (client_received - sent_base));
+        sent_base = client_received;
+    }
+
+    boost::asio::io_service io_service;
+    tcp::acceptor acceptor;
+    tcp::socket socket;
+    std::atomic<bool> stopping;
+    int rtt_ms;
+    boost::thread worker;
+
+    boost::mutex mtx;
+    std::vector<std::string> names;
+    uint32_t roster_seq;
+    bool session;
+    std::string token;
+    std::size_t generation;
+    uint32_t received;              // session frames from the client
+    std::deque<Frame> sent;         // session frames from sent_base on
+    uint32_t sent_base;
+    std::size_t logins;
+    uint64_t bytes;
+};
+
+// The client's view of what the server has: the roster and the contracts.
+class Mirror
+{
+public:
+    Mirror(GUIUpdater& _updater, Connector& _connector) :
+        updater(_updater),
+        connector(_connector),
+        contracts(0)
+    {
+    }
+
+    // What a player does by hand after logging in again.
+    void refetch(std::size_t markets)
+    {
+        {
+            boost::mutex::scoped_lock lock(mtx);
+            contracts = 0;
+        }
+        connector.request_roster();
+        static const std::string market = "A/";
+        for (std::size_t i = 0; i < markets; ++i)
+            connector.request(cmd_type_get_contract, cmd_type_get_contract_ok,
+                              reinterpret_cast<const uint8_t*>(market.data()), market.size(),
+                              boost::bind(&Mirror::on_contract, this, boost::placeholders::_1,
+                                          boost::placeholders::_2, boost::placeholders::_3));
+    }
+
+    // Until the roster matches the server's and markets contracts are in.
+    bool wait_consistent(ResumeServer& server, std::size_t markets)
+    {
+        uint32_t seq = server.sequence();
+        std::size_t users = server.users();
+        uint64_t deadline = Bench::now_ns() + 10000000000ULL;
+        std::vector<RosterDelta> deltas;
+        while (Bench::now_ns() < deadline) {
+            updater.take_roster_deltas(deltas);
+            for (std::size_t i = 0; i < deltas.size(); ++i)
+                roster.apply(deltas[i]);
+            deltas.clear();
+            bool fetched;
+            {
+                boost::mutex::scoped_lock lock(mtx);
+                fetched = contracts >= markets;
+            }
+            if (fetched && roster.sequence() == seq && roster.size() == users)
+                return true;
+            boost::this_thread::sleep(boost::posix_time::microseconds(50));
+        }
+        return false;
+    }
+
+private:
+    void on_contract(uint8_t cmd, const uint8_t*, uint32_t)
+    {
+        boost::mutex::scoped_lock lock(mtx);
+        if (cmd == cmd_type_get_contract_ok)
+            ++contracts;
+    }
+
+    GUIUpdater& updater;
+    Connector& connector;
+    Roster roster;
+    boost::mutex mtx;
+    std::size_t contracts;
+};
+
+bool wait_for(const boost::function<bool ()>& done)
+{
+    for (int i = 0; i < 200000 && !done(); ++i)
+        boost::this_thread::sleep(boost::posix_time::microseconds(50));
+    return done();
+}
+
+}
+
+// Time from a forced disconnect until the client again has the server's
+// roster and its contracts, with a 20 ms round trip and 2000 users of whom
+// 8 join during the outage. A full re-login has to log in and then fetch
+// the roster and the contracts again; a resumed session gets the 8 joins
+// replayed behind cmd_type_resume_ok and keeps what it had.
+BENCHMARK(resume)
+{
+    static const int rtt_ms = 20;
+    static const std::size_t users = 2000;
+    static const std::size_t joining = 8;
+    static const std::size_t markets = 4;
+
+    for (int resume = 1; resume >= 0; --resume) {
+        ResumeServer server(rtt_ms, users);
+        GUIUpdater updater;
+        Connector connector(&updater);
+        connector.set_resume(resume != 0);
+        connector.start("127.0.0.1", server.port(), "bench", "bench");
+        Mirror mirror(updater, connector);
+        if (!wait_connected(connector)) {
+            fprintf(stderr, "resume: connection failed\n");
+            return;
+        }
+        mirror.refetch(markets);
+        if (!mirror.wait_consistent(server, markets)) {
+            fprintf(stderr, "resume: initial fetch failed\n");
+            return;
+        }
+
+        bool ok = true;
+        uint64_t bytes = 0;
+        std::size_t drops = 0;
+        Bench::Result& r = bench.run(resume ? "resume_consistent/resumed" : "resume_consistent/relogin", [&] {
+            uint64_t bytes_before = server.bytes_written();
+            std::size_t logins = server.login_count();
+            server.disconnect(joining);
+            if (!resume) {
+                ok = wait_for([&] { return server.login_count() > logins && connector.is_connected(); }) && ok;
+                mirror.refetch(markets);
+            }
+            ok = mirror.wait_consistent(server, markets) && ok;
+            bytes += server.bytes_written() - bytes_before;
+            ++drops;
+        });
+        if (!ok)
+            fprintf(stderr, "resume: %s did not catch up\n", r.name.c_str());
+        if (resume && server.login_count() != 1)
+            fprintf(stderr, "resume: %zu logins, the session was not resumed\n", server.login_count());
+        r.counters["rtt_ms"] = rtt_ms;
+        r.counters["ms_to_consistent"] = r.ns_per_op / 1e6;
+        r.counters["bytes_per_recovery"] = double(bytes) / drops;
+        connector.stop();
+    }
+}
@@ -0,0 +1,105 @@
+#include "benchmark.h"
+#include "benchserver.h"
+#include "session.h"
+
+#ifdef BOOST_ASIO_HAS_CO_AWAIT
+
+namespace {
+
+// Flows of one round report here. The counters are only touched on the
+// connector thread; done is handed back to the benchmark thread.
+struct Round
+{
+    std::size_t flows_left;
+    std::size_t replies;
+    uint64_t cpu_begin;
+    uint64_t cpu_ns;
+    bool done;
+    boost::mutex mtx;
+    boost::condition_variable cv;
+
+    void reset(std::size_t flows)
+    {
+        flows_left = flows;
+        replies = 0;
+        cpu_begin = cpu_ns = 0;
+        done = false;
+    }
+
+    void finish()
+    {
+        cpu_ns = Bench::thread_cpu_ns() - cpu_begin;
+        boost::mutex::scoped_lock lock(mtx);
+        done = true;
+        cv.notify_all();
+    }
+
+    bool wait()
+    {
+        boost::mutex::scoped_lock lock(mtx);
+        while (!done) {
+            if (!cv.timed_wait(lock, boost::posix_time::seconds(10)))
+                return false;
+        }
+        return true;
+    }
+};
+
+static const char* const markets[] = { "A/", "B/", "C/", "D/" };
+static const std::size_t flow_requests = 1 + sizeof(markets) / sizeof(markets[0]);
+
+// A player going to market: the roster first, then an offer from every market.
+boost::asio::awaitable<void> market_flow(Session& session, Round& round)
+{
+    Reply roster = co_await session.request(cmd_type_get_usr_list);
+    round.replies += roster.cmd == cmd_type_roster_snapshot;
+    for (std::size_t i = 0; i < flow_requests - 1; ++i) {
+        Reply offer = co_await session.request(cmd_type_get_contract, markets[i]);
+        round.replies += offer.cmd == cmd_type_get_contract_ok;
+    }
+    if (--round.flows_left == 0)
+        round.finish();
+}
+
+}
+
+// Concurrent awaited flows over one connection, all resumed on the single
+// connector thread; cpu counters are that thread's time in the last round.
+BENCHMARK(session)
+{
+    static StandInServer* server = new StandInServer;
+    static const std::size_t concurrency[] = { 1, 16, 256, 4096 };
+
+    GUIUpdater updater;
+    Connector connector(&updater);
+    connector.start("127.0.0.1", server->port(), "bench", "bench");
+    if (!wait_connected(connector) || connector.protocol_version() < 2) {
+        fprintf(stderr, "session: connection failed\n");
+        return;
+    }
+    Session session(connector);
+    boost::shared_ptr<boost::asio::io_service> io_service = connector.get_io_service();
+
+    for (std::size_t c = 0; c < sizeof(concurrency) / sizeof(concurrency[0]); ++c) {
+        std::size_t flows = concurrency[c];
+        Round round;
+        bool complete = true;
+        Bench::Result& r = bench.run("session_flows/" + std::to_string(flows), [&] {
+            round.reset(flows);
+            io_service->post([&round] { round.cpu_begin = Bench::thread_cpu_ns(); });
+            for (std::size_t i = 0; i < flows; ++i)
+                session.spawn([&session, &round] { return market_flow(session, round); });
+            complete = round.wait() && complete;
+        });
+        if (!complete || round.replies != flows * flow_requests)
+            fprintf(stderr, "session: %zu flows lost replies\n", flows);
+        double requests = double(flows * flow_requests);
+        r.counters["requests_per_op"] = requests;
+        r.counters["requests_per_s"] = requests * 1e9 / r.ns_per_op;
+        if (round.cpu_ns)
+            r.counters["requests_per_cpu_s"] = requests * 1e9 / round.cpu_ns;
+    }
+    connector.stop();
+}
+
+#endif // BOOST_ASIO_HAS_CO_AWAIT
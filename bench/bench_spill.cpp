@@ -0,0 +1,255 @@
+#include "benchmark.h"
+#include "benchserver.h"
+
+#include <cstdio>
+#include <fstream>
+
+namespace {
+
+// Answers cmd_type_get_contract with a payload of the decimal size the
+// request names, generated and written in 64 KiB pieces so the server holds
+// no more of it than that. Logins are answered as by stand_in_answer().
+class BulkServer
+{
+public:
+    enum { ChunkSize = 64 * 1024 };
+
+    BulkServer() :
+        acceptor(io_service, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0)),
+        socket(io_service),
+        stopping(false),
+        worker(boost::bind(&BulkServer::serve, this))
+    {
+    }
+
+    ~BulkServer()
+    {
+        stopping = true;
+        boost::system::error_code ignored;
+        socket.shutdown(tcp::socket::shutdown_both, ignored);
+        tcp::socket wake(io_service);
+        wake.connect(acceptor.local_endpoint(), ignored);
+        worker.join();
+    }
+
+    Endpoint where() const { return Endpoint("127.0.0.1", acceptor.local_endpoint().port()); }
+
+private:
+    void serve()
+    {
+        boost::system::error_code error;
+        acceptor.accept(socket, error);
+        if (error || stopping)
+            return;
+        socket.set_option(tcp::no_delay(true));
+        std::vector<uint8_t> buffer, reply;
+        uint8_t chunk[4096];
+        for (;;) {
+            std::size_t n = socket.read_some(boost::asio::buffer(chunk), error);
+            if (error)
+                return;
+            buffer.insert(buffer.end(), chunk, chunk + n);
+            for (;;) {
+                std::size_t header_size = buffer.size() >= 2 && buffer[1] == 38 ? 11 : 7;
+                uint32_t size;
+                if (buffer.size() < header_size)
+                    break;
+                memcpy(&size, &buffer[2], 4);
+                if (buffer.size() < header_size + size)
+                    break;
+                std::string text(reinterpret_cast<const char*>(&buffer[header_size]), size);
+                if (buffer[6] == cmd_type_get_contract)
+                    send_bulk(&buffer[0], strtoul(text.c_str(), NULL, 10), error);
+                else if (stand_in_answer(&buffer[0], text, reply))
+                    boost::asio::write(socket, boost::asio::buffer(reply), error);
+                if (error)
+                    return;
+                buffer.erase(buffer.begin(), buffer.begin() + header_size + size);
+            }
+        }
+    }
+
+    void send_bulk(const uint8_t* request_header, uint32_t size, boost::system::error_code& error)
+    {
+        std::vector<uint8_t> header;
+        if (request_header[1] == 38) {
+            uint32_t request_id;
+            memcpy(&request_id, &request_header[7], 4);
+            Connector::command_frame(cmd_type_get_contract_ok, request_id, NULL, 0, header);
+        } else {
+            Connector::command_frame(cmd_type_get_contract_ok, NULL, 0, header);
+        }
+        memcpy(&header[2], &size, 4);
+        boost::asio::write(socket, boost::asio::buffer(header), error);
+        std::vector<uint8_t> piece(ChunkSize);
+        for (std::size_t i = 0; i < piece.size(); ++i)
+            piece[i] = uint8_t(i * 31);
+        while (size && !error) {
+            std::size_t n = std::min<std::size_t>(size, piece.size());
+            boost::asio::write(socket, boost::asio::buffer(&piece[0], n), error);
+            size -= n;
+        }
+    }
+
+    boost::asio::io_service io_service;
+    tcp::acceptor acceptor;
+    tcp::socket socket;
+    std::atomic<bool> stopping;
+    boost::thread worker;
+};
+
+class CountingSink : public FrameSink
+{
+public:
+    explicit CountingSink(uint64_t& _bytes) : bytes(_bytes) { }
+
+    void write(const uint8_t* data, std::size_t size)
+    {
+        do_not_optimize(data[size - 1]);
+        bytes += size;
+    }
+
+    void finish() { }
+
+private:
+    uint64_t& bytes;
+};
+
+// Fetches one payload of the given size per run() and waits for its reply.
+class BulkFetch
+{
+public:
+    enum Sink { Counting, TempFile, InMemory };
+
+    BulkFetch(Connector& _connector, Sink _sink) :
+        connector(_connector),
+        sink(_sink),
+        spilled(0)
+    {
+        if (sink == InMemory)
+            connector.set_max_frame_size(0xffffffff);
+        connector.set_spill_handler(boost::bind(&BulkFetch::make_sink, this, boost::placeholders::_1,
+                                                boost::placeholders::_2, boost::placeholders::_3));
+    }
+
+    bool run(uint32_t size)
+    {
+        spilled = 0;
+        received = 0;
+        done = false;
+        std::string payload = std::to_string(size);
+        connector.request(cmd_type_get_contract, cmd_type_get_contract_ok,
+                          reinterpret_cast<const uint8_t*>(payload.data()), payload.size(),
+                          boost::bind(&BulkFetch::on_reply, this, boost::placeholders::_1,
+                                      boost::placeholders::_2, boost::placeholders::_3));
+        boost::mutex::scoped_lock lock(mtx);
+        while (!done) {
+            if (!cv.timed_wait(lock, boost::posix_time::seconds(60)))
+                return false;
+        }
+        return received == size && (sink == InMemory || spilled == size);
+    }
+
+private:
+    boost::shared_ptr<FrameSink> make_sink(uint8_t cmd, uint32_t request_id, uint32_t size)
+    {
+        if (sink == TempFile)
+            return boost::shared_ptr<FrameSink>(new SpillFile(cmd, request_id, size,
+                boost::bind(&BulkFetch::on_file, this, boost::placeholders::_3, boost::placeholders::_4)));
+        return boost::shared_ptr<FrameSink>(new CountingSink(spilled));
+    }
+
+    // reads the file back the way a consumer of a spilled report would
+    void on_file(std::FILE* file, uint32_t)
+    {
+        uint8_t chunk[64 * 1024];
+        std::size_t n;
+        while ((n = std::fread(chunk, 1, sizeof(chunk), file)) > 0)
+            spilled += n;
+    }
+
+    void on_reply(uint8_t, const uint8_t*, uint32_t size)
+    {
+        boost::mutex::scoped_lock lock(mtx);
+        received = size;
+        done = true;
+        cv.notify_all();
+    }
+
+    Connector& connector;
+    Sink sink;
+    uint64_t spilled;       // connector thread only
+    uint32_t received;
+    bool done;
+    boost::mutex mtx;
+    boost::condition_variable cv;
+};
+
+// Resident set in kB from /proc/self/status, 0 where there is none.
+uint64_t status_kb(const char* field)
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    std::size_t length = strlen(field);
+    while (std::getline(status, line)) {
+        if (line.compare(0, length, field) == 0)
+            return strtoull(line.c_str() + length, NULL, 10);
+    }
+    return 0;
+}
+
+// Makes VmHWM start again from the current resident set.
+void reset_peak_rss()
+{
+    std::ofstream clear_refs("/proc/self/clear_refs");
+    clear_refs << "5";
+}
+
+}
+
+// Replies of 16 MiB to 256 MiB through one Connector. With the default
+// in-memory limit (Connector::DefaultMaxFrameSize) they stream to a
+// counting sink or a temporary file and the peak RSS growth stays flat
+// whatever the size; in_memory lifts the limit, as before, for contrast.
+BENCHMARK(spill)
+{
+    struct Case
+    {
+        const char* name;
+        BulkFetch::Sink sink;
+        uint32_t size;
+    };
+    static const Case cases[] = {
+        { "spill_stream/16MB", BulkFetch::Counting, 16u << 20 },
+        { "spill_stream/256MB", BulkFetch::Counting, 256u << 20 },
+        { "spill_file/64MB", BulkFetch::TempFile, 64u << 20 },
+        { "spill_in_memory/16MB", BulkFetch::InMemory, 16u << 20 },
+        { "spill_in_memory/64MB", BulkFetch::InMemory, 64u << 20 },
+    };
+
+    for (std::size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); ++c) {
+        BulkServer server;
+        GUIUpdater updater;
+        Connector connector(&updater);
+        BulkFetch fetch(connector, cases[c].sink);
+        connector.start(server.where(), "bench", "bench");
+        if (!wait_connected(connector)) {
+            fprintf(stderr, "spill: connection failed\n");
+            return;
+        }
+
+        reset_peak_rss();
+        uint64_t rss_before = status_kb("VmRSS:");
+        bool ok = true;
+        Bench::Result& r = bench.run(cases[c].name, [&] {
+            ok = fetch.run(cases[c].size) && ok;
+        });
+        uint64_t peak = status_kb("VmHWM:");
+        if (!ok)
+            fprintf(stderr, "spill: %s came back incomplete\n", cases[c].name);
+        r.counters["payload_mb_per_s"] = (cases[c].size >> 20) * 1e9 / r.ns_per_op;
+        if (peak)
+            r.counters["peak_rss_growth_mb"] = (peak > rss_before ? peak - rss_before : 0) / 1024.0;
+        connector.stop();
+    }
+}
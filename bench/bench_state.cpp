@@ -0,0 +1,153 @@
+#include "benchmark.h"
+#include "gamestate.h"
+#include "turnhistory.h"
+#include "timeseries.h"
+
+#include <string>
+
+namespace {
+
+GameState large_state(std::size_t products)
+{
+    GameState state;
+    state.turn = 4000;
+    state.money = 1234;
+    state.materials = 512;
+    state.credit_max_time = 42;
+    state.count_year = 3;
+    for (int i = 0; i < 4; ++i)
+        state.debit[i] = 10 * i;
+    for (std::size_t i = 0; i < products; ++i)
+        state.products.push_back(i % 3 ? GameState::ProductA : GameState::ProductB);
+    for (int i = 0; i < 20; ++i) {
+        GameState::CreditLine credit = { i, 100 + i };
+        state.credit_lines.push_back(credit);
+    }
+    for (int i = 0; i < 40; ++i) {
+        GameState::Line line;
+        line.product_type = i % 2;
+        line.line_type = i % 3 == 0;
+        line.loaded = i % 5 == 0;
+        line.have_materials.assign(line.line_type ? 2 : 4, 1);
+        state.lines.push_back(line);
+    }
+    for (int i = 0; i < 64; ++i) {
+        GameState::Market market = { "M" + std::to_string(i), 1, 2, i % 2 == 0 };
+        state.markets.push_back(market);
+    }
+    for (int i = 0; i < 100; ++i) {
+        GameState::Contract contract = { 3, 5, 2, 7, -1, 0 };
+        state.contracts.push_back(contract);
+    }
+    return state;
+}
+
+// What a typical turn changes: money, the credit countdown, a few products.
+void play_turn(GameState& state, std::size_t turn)
+{
+    ++state.turn;
+    state.money += 7;
+    for (std::size_t i = 0; i < state.credit_lines.size(); ++i)
+        --state.credit_lines[i].time;
+    for (std::size_t i = 0; i < 4; ++i)
+        state.products[(turn * 7919 + i * 104729) % state.products.size()] ^= 1;
+    state.products.push_back(GameState::ProductA);
+}
+
+std::string bench_name(const char* group, std::size_t products)
+{
+    return std::string(group) + "/products=" + std::to_string(products);
+}
+
+}
+
+BENCHMARK(snapshot)
+{
+    static const std::size_t sizes[] = { 100, 10000, 1000000 };
+    for (std::size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        GameState state = large_state(sizes[i]);
+        std::vector<uint8_t> encoded;
+        Bench::Result& e = bench.run(bench_name("snapshot_encode", sizes[i]), [&] {
+            snapshot::encode(state, encoded);
+            do_not_optimize(encoded);
+        });
+        e.counters["snapshot_bytes"] = double(encoded.size());
+
+        GameState decoded;
+        bench.run(bench_name("snapshot_decode", sizes[i]), [&] {
+            bool ok = snapshot::decode(&encoded[0], encoded.size(), decoded);
+            do_not_optimize(ok);
+        });
+    }
+}
+
+BENCHMARK(turn_history)
+{
+    static const std::size_t sizes[] = { 100, 10000, 1000000 };
+    for (std::size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        GameState state = large_state(sizes[i]);
+        TurnHistory history;
+        std::size_t turn = 0;
+        bench.run(bench_name("turn_history_record", sizes[i]), [&] {
+            play_turn(state, ++turn);
+            do_not_optimize(history.record(state));
+        });
+
+        bench.run(bench_name("turn_history_undo_redo", sizes[i]), [&] {
+            history.undo();
+            do_not_optimize(history.redo());
+        });
+
+        // memory for a thousand retained turns, against keeping full copies
+        static const std::size_t turns = 1000;
+        history.clear();
+        state = large_state(sizes[i]);
+        for (turn = 0; turn < turns; ++turn) {
+            play_turn(state, turn);
+            history.record(state);
+        }
+        Bench::Result& m = bench.run(bench_name("turn_history_checkout", sizes[i]), [&] {
+            do_not_optimize(history.checkout(++turn % turns));
+        });
+        TurnHistory::MemoryUsage usage = history.memory_usage();
+        m.counters["bytes_per_turn"] = double(usage.bytes) / usage.versions;
+        m.counters["flat_bytes_per_turn"] = double(usage.flat_bytes) / usage.versions;
+        m.counters["nodes"] = double(usage.nodes);
+    }
+}
+
+BENCHMARK(timeseries)
+{
+    GameState state = large_state(1000);
+    TimeSeries series;
+    std::size_t turn = 0;
+    bench.run("timeseries_append", [&] {
+        play_turn(state, ++turn);
+        series.append(state);
+    });
+
+    static const std::size_t rows[] = { 1000, 100000 };
+    for (std::size_t i = 0; i < sizeof(rows) / sizeof(rows[0]); ++i) {
+        TimeSeries session;
+        state = large_state(100);
+        for (turn = 0; turn < rows[i]; ++turn) {
+            play_turn(state, turn);
+            state.money += static_cast<int32_t>(turn * 2654435761u % 200) - 100;
+            session.append(state);
+        }
+        std::string suffix = "/rows=" + std::to_string(rows[i]);
+        std::vector<int64_t> x, y;
+        Bench::Result& d = bench.run("timeseries_decode" + suffix, [&] {
+            session.column(TimeSeries::Money).decode(y);
+            do_not_optimize(y);
+        });
+        d.counters["bytes_per_row"] = double(session.bytes()) / session.size();
+
+        session.turn_column().decode(x);
+        std::vector<std::size_t> picked;
+        bench.run("timeseries_lttb_800" + suffix, [&] {
+            lttb_downsample(x, y, 800, picked);
+            do_not_optimize(picked);
+        });
+    }
+}
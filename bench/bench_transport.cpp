@@ -0,0 +1,122 @@
+#include "benchmark.h"
+#include "benchserver.h"
+
+#include <atomic>
+
+namespace {
+
+// Keeps a window of requests in flight, issuing the next one from the
+// reply handler on the connector thread, until all replies are back. With
+// a window of one that is a chain of round trips.
+class Driver
+{
+public:
+    Driver(Connector& _connector, std::size_t payload_size) :
+        connector(_connector),
+        payload("A/" + std::string(payload_size > 2 ? payload_size - 2 : 0, 'x'))
+    {
+    }
+
+    bool run(std::size_t _total, std::size_t window)
+    {
+        total = _total;
+        sent = 0;
+        received = 0;
+        done = false;
+        for (std::size_t i = 0; i < window; ++i)
+            issue();
+        boost::mutex::scoped_lock lock(mtx);
+        while (!done) {
+            if (!cv.timed_wait(lock, boost::posix_time::seconds(10)))
+                return false;
+        }
+        return true;
+    }
+
+    std::size_t payload_size() const { return payload.size(); }
+
+private:
+    void issue()
+    {
+        if (sent.fetch_add(1) < total)
+            connector.request(cmd_type_get_contract, cmd_type_get_contract_ok,
+                              reinterpret_cast<const uint8_t*>(payload.data()), payload.size(),
+                              boost::bind(&Driver::on_reply, this, boost::placeholders::_1,
+                                          boost::placeholders::_2, boost::placeholders::_3));
+    }
+
+    void on_reply(uint8_t, const uint8_t*, uint32_t)
+    {
+        if (++received == total) {
+            boost::mutex::scoped_lock lock(mtx);
+            done = true;
+            cv.notify_all();
+            return;
+        }
+        issue();
+    }
+
+    Connector& connector;
+    std::string payload;
+    std::size_t total;
+    std::atomic<std::size_t> sent;
+    std::size_t received;       // connector thread only
+    bool done;
+    boost::mutex mtx;
+    boost::condition_variable cv;
+};
+
+}
+
+// The same Connector and framing over tcp://, unix:// and shm://, each to a
+// stand-in server in this process.
+BENCHMARK(transport)
+{
+    static const std::size_t round_trips = 1000;
+    static const std::size_t requests = 20000;
+    static const std::size_t window = 64;
+    static const std::size_t payload = 1024;
+
+    std::string suffix = std::to_string(Bench::now_ns());
+    std::vector<std::pair<std::string, Endpoint> > endpoints;
+    endpoints.push_back(std::make_pair("tcp", Endpoint()));
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    Endpoint unix_endpoint;
+    Endpoint::parse("unix:///tmp/yourcompany-bench-" + suffix + ".sock", 0, unix_endpoint);
+    endpoints.push_back(std::make_pair("unix", unix_endpoint));
+#endif
+    Endpoint shm_endpoint;
+    Endpoint::parse("shm://yourcompany-bench-" + suffix, 0, shm_endpoint);
+    endpoints.push_back(std::make_pair("shm", shm_endpoint));
+
+    for (std::size_t e = 0; e < endpoints.size(); ++e) {
+        const std::string& name = endpoints[e].first;
+        boost::scoped_ptr<StandInServer> server(name == "tcp" ? new StandInServer
+                                                               : new StandInServer(endpoints[e].second));
+        GUIUpdater updater;
+        Connector connector(&updater);
+        connector.start(server->where(), "bench", "bench");
+        if (!wait_connected(connector)) {
+            fprintf(stderr, "transport: %s connection failed\n", name.c_str());
+            continue;
+        }
+
+        Driver ping(connector, 16);
+        bool ok = true;
+        Bench::Result& rtt = bench.run("transport_round_trip/" + name, [&] {
+            ok = ping.run(round_trips, 1) && ok;
+        });
+        rtt.counters["round_trip_us"] = rtt.ns_per_op / round_trips / 1e3;
+
+        Driver flood(connector, payload);
+        Bench::Result& put = bench.run("transport_throughput/" + name, [&] {
+            ok = flood.run(requests, window) && ok;
+        });
+        put.counters["window"] = double(window);
+        put.counters["requests_per_s"] = requests * 1e9 / put.ns_per_op;
+        put.counters["request_mb_per_s"] = requests * (flood.payload_size() + 11) * 1e3 / put.ns_per_op;
+        if (!ok)
+            fprintf(stderr, "transport: %s lost replies\n", name.c_str());
+        connector.stop();
+    }
+}
@@ -0,0 +1,333 @@
+#include "benchmark.h"
+#include "benchserver.h"
+#include "uring.h"
+
+#ifdef __linux__
+#include <map>
+#include <signal.h>
+#include <sys/ptrace.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#endif
+
+namespace {
+
+// Many client sessions on one io_service thread, each driving its transport
+// the way Connector does: a read of up to 2048 bytes always outstanding and
+// one frame written at a time. A round is one cmd_type_get_contract request
+// and its reply on every session.
+class Fleet
+{
+public:
+    enum { ConnectWindow = 256, TimeoutSecs = 60 };
+
+    Fleet(const Endpoint& _endpoint, std::size_t count) :
+        endpoint(_endpoint),
+        work(new boost::asio::io_service::work(io_service)),
+        sessions(count),
+        next_connect(0),
+        pending(count),
+        failed(false),
+        cpu_begin(0),
+        cpu_ns(0)
+    {
+        std::string payload = "A/bench";
+        Connector::command_frame(cmd_type_get_contract, reinterpret_cast<const uint8_t*>(payload.data()),
+                                 payload.size(), request);
+        std::vector<uint8_t> reply;
+        stand_in_answer(&request[0], payload, reply);
+        reply_size = reply.size();
+
+        worker = boost::thread(boost::bind(&boost::asio::io_service::run, &io_service));
+        io_service.post([this] {
+            for (std::size_t i = 0; i < ConnectWindow; ++i)
+                connect_next();
+        });
+        wait();
+    }
+
+    ~Fleet()
+    {
+        boost::mutex::scoped_lock lock(mtx);
+        bool closed = false;
+        io_service.post([this, &closed] {
+            for (std::size_t i = 0; i < sessions.size(); ++i) {
+                if (sessions[i].transport)
+                    sessions[i].transport->close();
+            }
+            boost::mutex::scoped_lock lock(mtx);
+            closed = true;
+            cv.notify_all();
+        });
+        while (!closed)
+            cv.wait(lock);
+        lock.unlock();
+        io_service.stop();
+        worker.join();
+        sessions.clear();
+    }
+
+    bool ok() const { return !failed; }
+
+    // The io_service thread's CPU time for rounds rounds, 0 if a session
+    // failed or they took too long.
+    uint64_t run(std::size_t rounds)
+    {
+        {
+            boost::mutex::scoped_lock lock(mtx);
+            pending = sessions.size();
+        }
+        io_service.post([this, rounds] {
+            cpu_begin = Bench::thread_cpu_ns();
+            for (std::size_t i = 0; i < sessions.size(); ++i) {
+                sessions[i].rounds_left = rounds;
+                send(i);
+            }
+        });
+        return wait() ? cpu_ns : 0;
+    }
+
+private:
+    struct Session
+    {
+        boost::shared_ptr<Transport> transport;
+        uint8_t buffer[2048];
+        std::size_t received;
+        std::size_t rounds_left;
+    };
+
+    bool wait()
+    {
+        boost::mutex::scoped_lock lock(mtx);
+        while (pending && !failed) {
+            if (!cv.timed_wait(lock, boost::posix_time::seconds(int(TimeoutSecs))))
+                failed = true;
+        }
+        return !failed;
+    }
+
+    void done_one()
+    {
+        boost::mutex::scoped_lock lock(mtx);
+        if (--pending == 0) {
+            cpu_ns = Bench::thread_cpu_ns() - cpu_begin;
+            cv.notify_all();
+        }
+    }
+
+    void fail()
+    {
+        boost::mutex::scoped_lock lock(mtx);
+        failed = true;
+        cv.notify_all();
+    }
+
+    void connect_next()
+    {
+        if (next_connect == sessions.size())
+            return;
+        std::size_t i = next_connect++;
+        sessions[i].transport = Transport::create(io_service, endpoint);
+        sessions[i].received = 0;
+        sessions[i].transport->async_connect(boost::bind(&Fleet::on_connect, this, i,
+                                                         boost::placeholders::_1));
+    }
+
+    void on_connect(std::size_t i, const boost::system::error_code& error)
+    {
+        if (error) {
+            fail();
+            return;
+        }
+        read(i);
+        connect_next();
+        done_one();
+    }
+
+    void send(std::size_t i)
+    {
+        sessions[i].transport->async_write(&request[0], request.size(),
+                                           boost::bind(&Fleet::on_write, this, boost::placeholders::_1));
+    }
+
+    void on_write(const boost::system::error_code& error)
+    {
+        if (error && error != boost::asio::error::operation_aborted)
+            fail();
+    }
+
+    void read(std::size_t i)
+    {
+        sessions[i].transport->async_read_some(sessions[i].buffer, sizeof(sessions[i].buffer),
+                                               boost::bind(&Fleet::on_read, this, i,
+                                                           boost::placeholders::_1, boost::placeholders::_2));
+    }
+
+    void on_read(std::size_t i, const boost::system::error_code& error, std::size_t size)
+    {
+        if (error) {
+            if (error != boost::asio::error::operation_aborted)
+                fail();
+            return;
+        }
+        Session& session = sessions[i];
+        session.received += size;
+        for (; session.received >= reply_size; session.received -= reply_size) {
+            if (--session.rounds_left)
+                send(i);
+            else
+                done_one();
+        }
+        read(i);
+    }
+
+    Endpoint endpoint;
+    boost::asio::io_service io_service;
+    boost::scoped_ptr<boost::asio::io_service::work> work;
+    boost::thread worker;
+    std::vector<Session> sessions;
+    std::vector<uint8_t> request;
+    std::size_t reply_size;
+    std::size_t next_connect;
+
+    boost::mutex mtx;
+    boost::condition_variable cv;
+    std::size_t pending;
+    bool failed;
+    uint64_t cpu_begin;
+    uint64_t cpu_ns;
+};
+
+// Client and server sockets both count against the descriptor limit.
+std::size_t session_budget(std::size_t wanted)
+{
+#ifdef __linux__
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+        std::size_t room = limit.rlim_cur > 256 ? (limit.rlim_cur - 256) / 2 : 0;
+        return std::min(wanted, room);
+    }
+#endif
+    return wanted;
+}
+
+// System calls made by fn() and the threads it starts, counted by running
+// it in a child process under ptrace. -1 where that can't be done.
+long count_syscalls(const boost::function<void ()>& fn)
+{
+#ifdef __linux__
+    pid_t child = fork();
+    if (child < 0)
+        return -1;
+    if (child == 0) {
+        if (ptrace(PTRACE_TRACEME, 0, NULL, NULL) != 0)
+            _exit(1);
+        raise(SIGSTOP);
+        fn();
+        _exit(0);
+    }
+    int status;
+    if (waitpid(child, &status, 0) != child || !WIFSTOPPED(status))
+        return -1;
+    ptrace(PTRACE_SETOPTIONS, child, NULL,
+           reinterpret_cast<void*>(PTRACE_O_TRACESYSGOOD | PTRACE_O_TRACECLONE | PTRACE_O_EXITKILL));
+    ptrace(PTRACE_SYSCALL, child, NULL, NULL);
+
+    std::map<pid_t, bool> inside;     // entry and exit stops alternate per thread
+    long calls = 0;
+    for (;;) {
+        pid_t pid = waitpid(-1, &status, __WALL);
+        if (pid < 0)
+            return -1;
+        if (WIFEXITED(status) || WIFSIGNALED(status)) {
+            if (pid == child)
+                return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? calls : -1;
+            continue;
+        }
+        int signal = WSTOPSIG(status);
+        if (signal == (SIGTRAP | 0x80)) {
+            bool& in = inside[pid];
+            calls += !in;
+            in = !in;
+            signal = 0;
+        } else if (signal == SIGTRAP || signal == SIGSTOP) {
+            // thread creation events and new threads starting
+            signal = 0;
+        }
+        ptrace(PTRACE_SYSCALL, pid, NULL, reinterpret_cast<void*>(long(signal)));
+    }
+#else
+    (void)fn;
+    return -1;
+#endif
+}
+
+void count_run(const Endpoint& endpoint, std::size_t sessions, std::size_t rounds)
+{
+    Fleet fleet(endpoint, sessions);
+    if (!fleet.ok() || !fleet.run(rounds))
+        _exit(2);
+}
+
+}
+
+// One io_service thread carrying ~10k sessions against a stand-in server,
+// over the epoll reactor and over io_uring. cpu_ms_per_10k_sessions is
+// that thread's CPU time for one round trip on each of 10k sessions.
+// syscalls_per_message is the marginal count for one request and its reply:
+// two traced runs differing only in the number of rounds, subtracted, so
+// connecting and tearing down cancel out.
+BENCHMARK(uring)
+{
+    static const std::size_t rounds = 4;
+    static const std::size_t traced_sessions = 1000;
+    static const std::size_t traced_rounds[] = { 2, 6 };
+
+    std::size_t sessions = session_budget(10000);
+    AsyncStandInServer server;
+    std::vector<std::pair<std::string, Endpoint> > backends;
+    backends.push_back(std::make_pair("epoll", server.where()));
+    if (uring_available()) {
+        Endpoint uring_endpoint = server.where();
+        uring_endpoint.uring = true;
+        backends.push_back(std::make_pair("io_uring", uring_endpoint));
+    } else {
+        fprintf(stderr, "uring: io_uring not available, measuring epoll only\n");
+    }
+
+    for (std::size_t b = 0; b < backends.size(); ++b) {
+        const std::string& name = backends[b].first;
+        const Endpoint& endpoint = backends[b].second;
+        uint64_t cpu_ns = 0;
+        std::size_t runs = 0;
+        Bench::Result* r = NULL;
+        {
+            Fleet fleet(endpoint, sessions);
+            if (!fleet.ok()) {
+                fprintf(stderr, "uring: %s sessions failed to connect\n", name.c_str());
+                continue;
+            }
+            bool ok = true;
+            r = &bench.run("uring_sessions/" + name, [&] {
+                uint64_t cpu = fleet.run(rounds);
+                ok = cpu && ok;
+                cpu_ns += cpu;
+                ++runs;
+            });
+            if (!ok)
+                fprintf(stderr, "uring: %s lost replies\n", name.c_str());
+        }
+        r->counters["sessions"] = double(sessions);
+        r->counters["messages_per_s"] = sessions * rounds * 1e9 / r->ns_per_op;
+        r->counters["cpu_ms_per_10k_sessions"] = double(cpu_ns) / runs / rounds / 1e6 * 10000 / sessions;
+
+        // forked only now, so the child doesn't inherit the sessions' sockets
+        long few = count_syscalls(boost::bind(&count_run, endpoint, traced_sessions, traced_rounds[0]));
+        long many = count_syscalls(boost::bind(&count_run, endpoint, traced_sessions, traced_rounds[1]));
+        if (few >= 0 && many >= 0)
+            r->counters["syscalls_per_message"] = double(many - few)
+                    / (traced_sessions * (traced_rounds[1] - traced_rounds[0]));
+    }
+}
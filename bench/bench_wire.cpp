@@ -0,0 +1,234 @@
+#include "benchmark.h"
+#include "protocol.h"
+#include "roster.h"
+
+#include <QRegExp>
+#include <QString>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+// The protocol.h messages against the string handling they replaced, and
+// against binary layouts of the same fields (varints and length-prefixed
+// strings) for what a protocol revision would save on the wire. wire_bytes
+// includes the 7-byte frame header.
+
+namespace {
+
+typedef wire::Message<cmd_type_amount, wire::Varint<uint32_t>, wire::SVarint<int32_t> > BinaryAmount;
+typedef wire::Message<cmd_type_auction, wire::Varint<uint32_t>, wire::Str,
+                      wire::SVarint<int32_t>, wire::SVarint<int32_t> > BinaryAuction;
+typedef wire::Message<cmd_type_get_contract_ok, wire::SVarint<int32_t>, wire::SVarint<int32_t>,
+                      wire::SVarint<int32_t>, wire::SVarint<int32_t>, wire::Str> BinaryOffer;
+typedef wire::Message<cmd_type_roster_join, wire::Varint<uint32_t>, wire::Str, wire::Str> BinaryRosterJoin;
+
+// AuctionClient's field splitting before the schema.
+std::size_t split_fields(const uint8_t* data, uint32_t size, std::string* fields, std::size_t count)
+{
+    std::string payload(reinterpret_cast<const char*>(data), size);
+    std::size_t n = 0, begin = 0;
+    while (n < count && begin <= payload.size()) {
+        std::size_t end = payload.find('/', begin);
+        if (end == std::string::npos)
+            end = payload.size();
+        fields[n++] = payload.substr(begin, end - begin);
+        begin = end + 1;
+    }
+    return n;
+}
+
+// RosterDelta::parse before the schema.
+bool legacy_roster_parse(const uint8_t* data, uint32_t size, RosterDelta& delta)
+{
+    if (size < 4)
+        return false;
+    delta.has_seq = true;
+    memcpy(&delta.seq, data, 4);
+    std::string record(reinterpret_cast<const char*>(data + 4), size - 4);
+    delta.status.clear();
+    std::size_t tab = record.find('\t');
+    delta.name = record.substr(0, tab);
+    if (tab != std::string::npos)
+        delta.status = record.substr(tab + 1);
+    return !delta.name.empty();
+}
+
+struct Case
+{
+    const char* format;
+    std::size_t size;
+};
+
+template <class Body>
+void run_case(Bench& bench, const char* group, const Case& c, Body body)
+{
+    Bench::Result& r = bench.run(std::string(group) + "/" + c.format, body);
+    r.counters["wire_bytes"] = double(c.size + 7);
+}
+
+}
+
+BENCHMARK(wire)
+{
+    const uint32_t id = 40123;
+    const int32_t amount = 18750;
+
+    // a bid, as AuctionClient prepares three of them after every price change
+    {
+        char text[32];
+        Case c = { "text_snprintf", std::size_t(snprintf(text, sizeof(text), "%u/%d", id, amount)) };
+        run_case(bench, "wire_encode_amount", c, [&] {
+            char payload[32];
+            int length = snprintf(payload, sizeof(payload), "%u/%d", id, amount);
+            do_not_optimize(length);
+            do_not_optimize(payload);
+        });
+        wire::Buffer<msg::Amount::max_size> schema;
+        msg::Amount::encode(schema, id, amount);
+        c.format = "text_schema";
+        c.size = schema.size();
+        run_case(bench, "wire_encode_amount", c, [&] {
+            wire::Buffer<msg::Amount::max_size> payload;
+            msg::Amount::encode(payload, id, amount);
+            do_not_optimize(payload);
+        });
+        wire::Buffer<BinaryAmount::max_size> binary;
+        BinaryAmount::encode(binary, id, amount);
+        c.format = "binary_schema";
+        c.size = binary.size();
+        run_case(bench, "wire_encode_amount", c, [&] {
+            wire::Buffer<BinaryAmount::max_size> payload;
+            BinaryAmount::encode(payload, id, amount);
+            do_not_optimize(payload);
+        });
+    }
+
+    // an auction moving, decoded on the connector thread
+    {
+        const std::string lot = "Line B, two materials";
+        std::string text = std::to_string(id) + "/" + lot + "/" + std::to_string(amount) + "/250";
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(text.data());
+        Case c = { "text_split", text.size() };
+        run_case(bench, "wire_decode_auction", c, [&] {
+            std::string fields[4];
+            if (split_fields(data, text.size(), fields, 4) == 4) {
+                uint32_t parsed = static_cast<uint32_t>(strtoul(fields[0].c_str(), NULL, 10));
+                int32_t current = atoi(fields[2].c_str());
+                int32_t step = atoi(fields[3].c_str());
+                do_not_optimize(parsed);
+                do_not_optimize(fields[1]);
+                do_not_optimize(current);
+                do_not_optimize(step);
+            }
+        });
+        c.format = "text_schema";
+        run_case(bench, "wire_decode_auction", c, [&] {
+            uint32_t parsed;
+            wire::Text parsed_lot;
+            int32_t current, step;
+            bool ok = msg::Auction::decode(data, text.size(), parsed, parsed_lot, current, step);
+            do_not_optimize(ok);
+            do_not_optimize(parsed);
+            do_not_optimize(parsed_lot);
+            do_not_optimize(current);
+            do_not_optimize(step);
+        });
+        std::vector<uint8_t> binary;
+        BinaryAuction::encode(binary, id, lot, amount, 250);
+        c.format = "binary_schema";
+        c.size = binary.size();
+        run_case(bench, "wire_decode_auction", c, [&] {
+            uint32_t parsed;
+            wire::Text parsed_lot;
+            int32_t current, step;
+            bool ok = BinaryAuction::decode(&binary[0], binary.size(), parsed, parsed_lot, current, step);
+            do_not_optimize(ok);
+            do_not_optimize(parsed);
+            do_not_optimize(parsed_lot);
+            do_not_optimize(current);
+            do_not_optimize(step);
+        });
+    }
+
+    // a contract offer, as the bot host and the contract dialog read it
+    {
+        const std::string text = "12A35/8B47/Northern market";
+        Case c = { "text_sscanf", text.size() };
+        run_case(bench, "wire_decode_offer", c, [&] {
+            int32_t values[4];
+            char a_mark, b_mark;
+            int n = sscanf(text.c_str(), "%d%c%d/%d%c%d", &values[0], &a_mark, &values[1],
+                           &values[2], &b_mark, &values[3]);
+            do_not_optimize(n);
+            do_not_optimize(values);
+        });
+        const QString qtext = QString::fromStdString(text);
+        c.format = "text_qregexp";
+        run_case(bench, "wire_decode_offer", c, [&] {
+            QRegExp rx("(\\d+)[A|a](\\d+)/(\\d+)[B|b](\\d+)/(.*)");
+            if (rx.indexIn(qtext) != -1) {
+                int a = rx.cap(1).toInt();
+                std::string market = rx.cap(5).toStdString();
+                do_not_optimize(a);
+                do_not_optimize(market);
+            }
+        });
+        c.format = "text_schema";
+        run_case(bench, "wire_decode_offer", c, [&] {
+            int32_t a, price_a, b, price_b;
+            wire::Text market;
+            bool ok = msg::GetContractOk::decode(text.data(), text.size(), a, price_a, b, price_b, market);
+            do_not_optimize(ok);
+            do_not_optimize(a);
+            do_not_optimize(market);
+        });
+        std::vector<uint8_t> binary;
+        BinaryOffer::encode(binary, 12, 35, 8, 47, wire::Text("Northern market", 15));
+        c.format = "binary_schema";
+        c.size = binary.size();
+        run_case(bench, "wire_decode_offer", c, [&] {
+            int32_t a, price_a, b, price_b;
+            wire::Text market;
+            bool ok = BinaryOffer::decode(&binary[0], binary.size(), a, price_a, b, price_b, market);
+            do_not_optimize(ok);
+            do_not_optimize(a);
+            do_not_optimize(market);
+        });
+    }
+
+    // a roster join, into the RosterDelta the roster applies
+    {
+        RosterDelta join = { RosterDelta::Join, true, 1234567, "player4711", "ready" };
+        std::vector<uint8_t> text;
+        RosterDelta::frame_payload(join, text);
+        RosterDelta delta;
+        Case c = { "text_legacy", text.size() };
+        run_case(bench, "wire_decode_roster_join", c, [&] {
+            bool ok = legacy_roster_parse(&text[0], text.size(), delta);
+            do_not_optimize(ok);
+            do_not_optimize(delta);
+        });
+        c.format = "text_schema";
+        run_case(bench, "wire_decode_roster_join", c, [&] {
+            bool ok = RosterDelta::parse(RosterDelta::Join, &text[0], text.size(), delta);
+            do_not_optimize(ok);
+            do_not_optimize(delta);
+        });
+        std::vector<uint8_t> binary;
+        BinaryRosterJoin::encode(binary, join.seq, join.name, join.status);
+        c.format = "binary_schema";
+        c.size = binary.size();
+        run_case(bench, "wire_decode_roster_join", c, [&] {
+            uint32_t seq;
+            wire::Text name, status;
+            bool ok = BinaryRosterJoin::decode(&binary[0], binary.size(), seq, name, status);
+            if (ok) {
+                delta.seq = seq;
+                delta.name.assign(name.data, name.size);
+                delta.status.assign(status.data, status.size);
+            }
+            do_not_optimize(ok);
+            do_not_optimize(delta);
+        });
+    }
+}
@@ -0,0 +1,114 @@
+#ifndef BENCHACCESS_H
+#define BENCHACCESS_H
+
+#include "mainwindow.h"
+#include <QImage>
+#include <QPainter>
+
+// Reaches into MainWindow and ProductLine so the benchmarks can drive the
+// game logic and painting without going through dialogs.
+class BenchAccess
+{
+public:
+    static void set_main_state(MainWindow& w)
+    {
+        w.set_gui_state(MainWindow::MAIN_STATE);
+    }
+
+    static void set_market_state(MainWindow& w)
+    {
+        w.set_gui_state(MainWindow::MARKET_STATE);
+    }
+
+    static void set_money(MainWindow& w, int money)
+    {
+        w.money = money;
+    }
+
+    static void set_materials(MainWindow& w, int materials)
+    {
+        w.materials = materials;
+    }
+
+    static void set_debit(MainWindow& w, int slot, int value)
+    {
+        w.debit[slot] = value;
+    }
+
+    static std::vector<Product>& products(MainWindow& w)
+    {
+        return w.products;
+    }
+
+    static void clear_contracts(MainWindow& w)
+    {
+        w.contracts.clear();
+    }
+
+    static void add_contract(MainWindow& w, int a, int price_a, int b, int price_b)
+    {
+        MainWindow::Contract contract = { a, price_a, b, price_b, -1, 0 };
+        w.contracts.push_back(contract);
+    }
+
+    static void add_credit(MainWindow& w, int time, int money)
+    {
+        w.CreditLines.push_back(MainWindow::CreditLine(time, money));
+    }
+
+    static ProductLine* add_product_line(MainWindow& w, const QString& product_type, const QString& line_type)
+    {
+        ProductLine* line = new ProductLine(&w, product_type, line_type, &w.materials, w.products);
+        w.ProductLines.push_back(line);
+        w.create_product_line_widgets(line);
+        return line;
+    }
+
+    // One board frame from scratch: record every panel, rasterize them with
+    // the configured raster threads and composite into target.
+    static void render_board_frame(MainWindow& w, QImage& target, int raster_threads)
+    {
+        if (w.board.raster_threads() != raster_threads)
+            w.board.set_raster_threads(raster_threads);
+        w.board.invalidate();
+        w.update_board_scene();
+        w.board.rasterize(true);
+        QPainter p(&target);
+        w.board.paint(p);
+    }
+
+    static void clear_markets(MainWindow& w)
+    {
+        w.markets.clear();
+        w.rebuild_market_index();
+    }
+
+    static void add_market(MainWindow& w, const std::string& name, QRect rect, QColor color)
+    {
+        w.markets.push_back(MainWindow::Market(name, rect, color, &w.money));
+        w.rebuild_market_index();
+    }
+
+    static void select_market(MainWindow& w, std::size_t index, bool selected)
+    {
+        w.markets[index].selected = selected;
+    }
+
+    static void sale_products(MainWindow& w)
+    {
+        w.sale_products();
+    }
+
+    // The Step button.
+    static void play_turn(MainWindow& w)
+    {
+        w.on_Start_clicked();
+    }
+
+    static std::size_t turn_arena_capacity(const MainWindow& w)
+    {
+        return w.turn_arena.capacity();
+    }
+};
+
+#endif // BENCHACCESS_H
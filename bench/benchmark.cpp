@@ -0,0 +1,119 @@
+#include "benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+#include <time.h>
+
+namespace {
+
+void write_string(std::ostream& out, const std::string& text)
+{
+    out << '"';
+    for (std::size_t i = 0; i < text.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c == '"' || c == '\\') {
+            out << '\\' << text[i];
+        } else if (c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out << escaped;
+        } else {
+            out << text[i];
+        }
+    }
+    out << '"';
+}
+
+// JSON has no NaN or infinity
+void write_number(std::ostream& out, double value)
+{
+    if (std::isfinite(value))
+        out << value;
+    else
+        out << "null";
+}
+
+}
+
+Bench::Bench(double _min_time_ms, int _repetitions) :
+    min_time_ms(_min_time_ms),
+    repetitions(_repetitions < 1 ? 1 : _repetitions)
+{
+}
+
+uint64_t Bench::now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t Bench::thread_cpu_ns()
+{
+#ifdef CLOCK_THREAD_CPUTIME_ID
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+#else
+    return 0;
+#endif
+}
+
+uint64_t Bench::next_iterations(uint64_t iterations, uint64_t elapsed) const
+{
+    double scale = 1.4 * double(min_time_ns()) / double(elapsed);
+    if (scale > 10)
+        scale = 10;
+    uint64_t next = static_cast<uint64_t>(iterations * scale);
+    return next > iterations ? next : iterations + 1;
+}
+
+Bench::Result& Bench::add_result(const std::string& name, uint64_t iterations, std::vector<double>& samples)
+{
+    std::sort(samples.begin(), samples.end());
+    Result result;
+    result.name = name;
+    result.iterations = iterations;
+    result.ns_per_op = samples[samples.size() / 2];
+    result.min_ns_per_op = samples.front();
+    all_results.push_back(result);
+    return all_results.back();
+}
+
+std::string Bench::to_json() const
+{
+    std::ostringstream out;
+    out.precision(17);
+    out << "{\n  \"benchmarks\": [";
+    for (std::size_t i = 0; i < all_results.size(); ++i) {
+        const Result& r = all_results[i];
+        out << (i ? "," : "") << "\n    {\"name\": ";
+        write_string(out, r.name);
+        out << ", \"iterations\": " << r.iterations << ", \"ns_per_op\": ";
+        write_number(out, r.ns_per_op);
+        out << ", \"min_ns_per_op\": ";
+        write_number(out, r.min_ns_per_op);
+        out << ", \"counters\": {";
+        for (std::map<std::string, double>::const_iterator it = r.counters.begin(); it != r.counters.end(); ++it) {
+            out << (it == r.counters.begin() ? "" : ", ");
+            write_string(out, it->first);
+            out << ": ";
+            write_number(out, it->second);
+        }
+        out << "}}";
+    }
+    out << "\n  ]\n}\n";
+    return out.str();
+}
+
+BenchRegistry::Cases& BenchRegistry::cases()
+{
+    static Cases registered;
+    return registered;
+}
+
+BenchRegistry::BenchRegistry(const char* name, Bench::Function function)
+{
+    cases().push_back(std::make_pair(std::string(name), function));
+}
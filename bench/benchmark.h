@@ -0,0 +1,124 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <stdint.h>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+template <class T>
+inline void do_not_optimize(const T& value)
+{
+#if defined(__GNUC__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static const void* volatile sink;
+    sink = &value;
+#endif
+}
+
+class Bench
+{
+public:
+    typedef void (*Function)(Bench&);
+
+    struct Result
+    {
+        std::string name;
+        uint64_t iterations;
+        double ns_per_op;       // median of the repetitions
+        double min_ns_per_op;
+        std::map<std::string, double> counters;
+    };
+
+    Bench(double _min_time_ms, int _repetitions);
+
+    static uint64_t now_ns();
+    // CPU time of the calling thread, 0 where there is no such clock.
+    static uint64_t thread_cpu_ns();
+
+    // Times body() back to back. The iteration count is calibrated so that
+    // one repetition lasts at least min_time_ms.
+    template <class Body>
+    Result& run(const std::string& name, Body body)
+    {
+        uint64_t iterations = 1;
+        for (;;) {
+            uint64_t begin = now_ns();
+            for (uint64_t i = 0; i < iterations; ++i)
+                body();
+            uint64_t elapsed = now_ns() - begin;
+            if (elapsed >= min_time_ns() || iterations >= (1ULL << 30))
+                break;
+            iterations = elapsed ? next_iterations(iterations, elapsed) : iterations * 10;
+        }
+        std::vector<double> samples;
+        for (int r = 0; r < repetitions; ++r) {
+            uint64_t begin = now_ns();
+            for (uint64_t i = 0; i < iterations; ++i)
+                body();
+            samples.push_back(double(now_ns() - begin) / iterations);
+        }
+        return add_result(name, iterations, samples);
+    }
+
+    // Runs setup() before every body() and keeps it out of the timing.
+    template <class Setup, class Body>
+    Result& run(const std::string& name, Setup setup, Body body)
+    {
+        uint64_t iterations = 0;
+        uint64_t spent = 0;
+        while (spent < min_time_ns() && iterations < (1ULL << 24)) {
+            setup();
+            uint64_t begin = now_ns();
+            body();
+            spent += now_ns() - begin;
+            ++iterations;
+        }
+        std::vector<double> samples;
+        for (int r = 0; r < repetitions; ++r) {
+            uint64_t total = 0;
+            for (uint64_t i = 0; i < iterations; ++i) {
+                setup();
+                uint64_t begin = now_ns();
+                body();
+                total += now_ns() - begin;
+            }
+            samples.push_back(double(total) / iterations);
+        }
+        return add_result(name, iterations, samples);
+    }
+
+    const std::deque<Result>& results() const { return all_results; }
+
+    std::string to_json() const;
+
+private:
+    uint64_t min_time_ns() const { return static_cast<uint64_t>(min_time_ms * 1e6); }
+    uint64_t next_iterations(uint64_t iterations, uint64_t elapsed) const;
+    Result& add_result(const std::string& name, uint64_t iterations, std::vector<double>& samples);
+
+    double min_time_ms;
+    int repetitions;
+    std::deque<Result> all_results;     // run() hands out references that must stay valid
+};
+
+class BenchRegistry
+{
+public:
+    typedef std::vector<std::pair<std::string, Bench::Function> > Cases;
+
+    static Cases& cases();
+
+    BenchRegistry(const char* name, Bench::Function function);
+};
+
+#define BENCHMARK(name) \
+    static void bench_##name(Bench& bench); \
+    static BenchRegistry bench_##name##_registry(#name, &bench_##name); \
+    static void bench_##name(Bench& bench)
+
+#endif // BENCHMARK_H
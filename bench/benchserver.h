@@ -0,0 +1,498 @@
+#ifndef BENCHSERVER_H
+#define BENCHSERVER_H
+
+#include "connector.h"
+#include "shmring.h"
+
+#include <boost/asio.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+#include <atomic>
+#include <deque>
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+// Loopback peers for the benchmarks that drive the real Connector.
+
+using boost::asio::ip::tcp;
+
+// Answers one frame the way the game server would: accepts any login,
+// offers protocol 2 when the client does, answers cmd_type_get_contract,
+// cmd_type_get_usr_list and cmd_type_formed, accepts every contract offer
+// except those starting "gone" and echoes the request id of version 2
+// frames. Returns false for frames that get no answer.
+inline bool stand_in_answer(const uint8_t* header, const std::string& text, std::vector<uint8_t>& reply)
+{
+    std::string answer;
+    uint8_t answer_cmd;
+    if (header[6] == cmd_type_auth) {
+        answer_cmd = cmd_type_auth_ok;
+        answer = text.find("proto=2") != std::string::npos ? "proto=2" : "";
+    } else if (header[6] == cmd_type_get_contract) {
+        answer_cmd = cmd_type_get_contract_ok;
+        answer = "1A5/1B7/" + text.substr(0, text.find('/'));
+    } else if (header[6] == cmd_type_get_usr_list) {
+        answer_cmd = cmd_type_roster_snapshot;
+        answer = std::string(4, '\0') + "bench";
+    } else if (header[6] == cmd_type_formed) {
+        answer_cmd = cmd_type_formed_ok;
+    } else if (header[6] == cmd_type_accept_contract) {
+        answer_cmd = text.compare(0, 4, "gone") ? cmd_type_accept_contract_ok : cmd_type_err;
+    } else {
+        return false;
+    }
+    if (header[1] == 38) {
+        uint32_t request_id;
+        memcpy(&request_id, &header[7], 4);
+        Connector::command_frame(answer_cmd, request_id, reinterpret_cast<const uint8_t*>(answer.data()),
+                                 answer.size(), reply);
+    } else {
+        Connector::command_frame(answer_cmd, reinterpret_cast<const uint8_t*>(answer.data()),
+                                 answer.size(), reply);
+    }
+    return true;
+}
+
+// Answers the complete frames at the front of buffer, appending the
+// replies, and drops them from buffer.
+inline void stand_in_answer_all(std::vector<uint8_t>& buffer, std::vector<uint8_t>& replies)
+{
+    std::vector<uint8_t> reply;
+    std::size_t at = 0;
+    while (buffer.size() - at >= 7) {
+        const uint8_t* header = &buffer[at];
+        std::size_t header_size = header[1] == 38 ? 11 : 7;
+        uint32_t size;
+        memcpy(&size, &header[2], 4);
+        if (buffer.size() - at < header_size + size)
+            break;
+        std::string text(reinterpret_cast<const char*>(header) + header_size, size);
+        if (stand_in_answer(header, text, reply))
+            replies.insert(replies.end(), reply.begin(), reply.end());
+        at += header_size + size;
+    }
+    buffer.erase(buffer.begin(), buffer.begin() + at);
+}
+
+// Serves frames from a stream with blocking
+//   std::size_t read_some(uint8_t*, std::size_t)     0 once closed
+//   bool write(const uint8_t*, std::size_t)
+// until it closes. Replies to frames that arrived together go out in one write.
+template <class Stream>
+void stand_in_serve(Stream& stream)
+{
+    std::vector<uint8_t> buffer, replies;
+    uint8_t chunk[64 * 1024];
+    for (;;) {
+        std::size_t n = stream.read_some(chunk, sizeof(chunk));
+        if (!n)
+            return;
+        buffer.insert(buffer.end(), chunk, chunk + n);
+        replies.clear();
+        stand_in_answer_all(buffer, replies);
+        if (!replies.empty() && !stream.write(&replies[0], replies.size()))
+            return;
+    }
+}
+
+template <class Socket>
+struct SocketStream
+{
+    explicit SocketStream(boost::shared_ptr<Socket> _socket) : socket(_socket) { }
+
+    std::size_t read_some(uint8_t* data, std::size_t size)
+    {
+        boost::system::error_code error;
+        std::size_t n = socket->read_some(boost::asio::buffer(data, size), error);
+        return error ? 0 : n;
+    }
+
+    bool write(const uint8_t* data, std::size_t size)
+    {
+        boost::system::error_code error;
+        boost::asio::write(*socket, boost::asio::buffer(data, size), error);
+        return !error;
+    }
+
+    boost::shared_ptr<Socket> socket;
+};
+
+// Server side of a shm:// channel. The rings have no wakeup, so it spins,
+// which is what a co-located server polling its clients would do.
+struct ShmStream
+{
+    ShmStream(ShmChannel& _channel, const std::atomic<bool>& _stopping) :
+        channel(_channel), stopping(_stopping) { }
+
+    std::size_t read_some(uint8_t* data, std::size_t size)
+    {
+        for (;;) {
+            std::size_t n = channel.inbound().read(data, size);
+            if (n)
+                return n;
+            if (!channel.peer_alive() || stopping)
+                return 0;
+            boost::this_thread::yield();
+        }
+    }
+
+    bool write(const uint8_t* data, std::size_t size)
+    {
+        while (size) {
+            if (!channel.peer_alive())
+                return false;
+            std::size_t n = channel.outbound().write(data, size);
+            data += n;
+            size -= n;
+            if (!n)
+                boost::this_thread::yield();
+        }
+        return true;
+    }
+
+    ShmChannel& channel;
+    const std::atomic<bool>& stopping;
+};
+
+// Stand-in game server, see stand_in_answer(). Every socket connection
+// gets its own thread; a shm:// endpoint serves one client at a time.
+class StandInServer
+{
+public:
+    // TCP on an ephemeral loopback port
+    StandInServer() :
+        acceptor(io_service, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0)),
+        stopping(false),
+        worker(boost::bind(&StandInServer::accept_loop<tcp>, this, boost::ref(acceptor)))
+    {
+        endpoint = Endpoint("127.0.0.1", acceptor.local_endpoint().port());
+    }
+
+    // unix:// or shm:// at the given endpoint
+    explicit StandInServer(const Endpoint& _endpoint) :
+        endpoint(_endpoint),
+        acceptor(io_service),
+        stopping(false)
+    {
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+        if (endpoint.kind == Endpoint::Unix) {
+            ::unlink(endpoint.address.c_str());
+            local_acceptor.reset(new boost::asio::local::stream_protocol::acceptor(
+                io_service, boost::asio::local::stream_protocol::endpoint(endpoint.address)));
+            worker = boost::thread(boost::bind(&StandInServer::accept_loop<boost::asio::local::stream_protocol>,
+                                               this, boost::ref(*local_acceptor)));
+        }
+#endif
+        if (endpoint.kind == Endpoint::Shm) {
+            channel.reset(new ShmChannel(endpoint.address, ShmChannel::Server));
+            worker = boost::thread(boost::bind(&StandInServer::shm_loop, this));
+        }
+    }
+
+    ~StandInServer()
+    {
+        stopping = true;
+        // a blocked accept() only returns for a connection
+        boost::system::error_code ignored;
+        if (acceptor.is_open()) {
+            tcp::socket wake(io_service);
+            wake.connect(acceptor.local_endpoint(), ignored);
+        }
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+        if (local_acceptor) {
+            boost::asio::local::stream_protocol::socket wake(io_service);
+            wake.connect(local_acceptor->local_endpoint(), ignored);
+        }
+#endif
+        if (worker.joinable())
+            worker.join();
+        {
+            boost::mutex::scoped_lock lock(connections_mtx);
+            for (std::size_t i = 0; i < shutdowns.size(); ++i)
+                shutdowns[i]();
+        }
+        serving.join_all();
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+        if (local_acceptor)
+            ::unlink(endpoint.address.c_str());
+#endif
+    }
+
+    unsigned short port() const { return endpoint.port; }
+
+    const Endpoint& where() const { return endpoint; }
+
+private:
+    template <class Protocol>
+    void accept_loop(typename Protocol::acceptor& from)
+    {
+        for (;;) {
+            boost::shared_ptr<typename Protocol::socket> socket(new typename Protocol::socket(io_service));
+            boost::system::error_code error;
+            from.accept(*socket, error);
+            if (error || stopping)
+                return;
+            set_no_delay(*socket);
+            boost::mutex::scoped_lock lock(connections_mtx);
+            shutdowns.push_back(boost::bind(&StandInServer::shutdown<typename Protocol::socket>, socket));
+            serving.create_thread(boost::bind(&StandInServer::serve<typename Protocol::socket>, socket));
+        }
+    }
+
+    // wakes the connection's thread from its blocking read
+    template <class Socket>
+    static void shutdown(boost::shared_ptr<Socket> socket)
+    {
+        boost::system::error_code ignored;
+        socket->shutdown(Socket::shutdown_both, ignored);
+    }
+
+    template <class Socket>
+    static void serve(boost::shared_ptr<Socket> socket)
+    {
+        SocketStream<Socket> stream(socket);
+        stand_in_serve(stream);
+    }
+
+    void shm_loop()
+    {
+        ShmStream stream(*channel, stopping);
+        while (!stopping) {
+            if (channel->peer_alive())
+                stand_in_serve(stream);
+            else
+                boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+        }
+    }
+
+    static void set_no_delay(tcp::socket& socket) { socket.set_option(tcp::no_delay(true)); }
+    template <class Socket>
+    static void set_no_delay(Socket&) { }
+
+    Endpoint endpoint;
+    boost::asio::io_service io_service;
+    tcp::acceptor acceptor;
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    boost::scoped_ptr<boost::asio::local::stream_protocol::acceptor> local_acceptor;
+#endif
+    boost::scoped_ptr<ShmChannel> channel;
+    std::atomic<bool> stopping;
+    boost::thread worker;
+    boost::mutex connections_mtx;
+    std::vector<boost::function<void ()> > shutdowns;
+    boost::thread_group serving;
+};
+
+// The stand-in server for thousands of TCP connections: one thread serves
+// them all asynchronously.
+class AsyncStandInServer
+{
+public:
+    AsyncStandInServer() :
+        acceptor(io_service, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0))
+    {
+        accept();
+        worker = boost::thread(boost::bind(&boost::asio::io_service::run, &io_service));
+    }
+
+    ~AsyncStandInServer()
+    {
+        io_service.stop();
+        worker.join();
+    }
+
+    Endpoint where() const { return Endpoint("127.0.0.1", acceptor.local_endpoint().port()); }
+
+private:
+    class Connection : public boost::enable_shared_from_this<Connection>
+    {
+    public:
+        explicit Connection(boost::asio::io_service& io_service) : socket(io_service), writing(false) { }
+
+        void read()
+        {
+            socket.async_read_some(boost::asio::buffer(chunk),
+                                   boost::bind(&Connection::on_read, shared_from_this(),
+                                               boost::asio::placeholders::error,
+                                               boost::asio::placeholders::bytes_transferred));
+        }
+
+        tcp::socket socket;
+
+    private:
+        void on_read(const boost::system::error_code& error, std::size_t size)
+        {
+            if (error)
+                return;
+            buffer.insert(buffer.end(), chunk, chunk + size);
+            stand_in_answer_all(buffer, replies);
+            write();
+            read();
+        }
+
+        void write()
+        {
+            if (writing || replies.empty())
+                return;
+            writing = true;
+            sending.swap(replies);
+            replies.clear();
+            boost::asio::async_write(socket, boost::asio::buffer(sending),
+                                     boost::bind(&Connection::on_write, shared_from_this(),
+                                                 boost::asio::placeholders::error));
+        }
+
+        void on_write(const boost::system::error_code& error)
+        {
+            writing = false;
+            if (!error)
+                write();
+        }
+
+        std::vector<uint8_t> buffer, replies, sending;
+        uint8_t chunk[4096];
+        bool writing;
+    };
+
+    void accept()
+    {
+        boost::shared_ptr<Connection> connection(new Connection(io_service));
+        acceptor.async_accept(connection->socket, boost::bind(&AsyncStandInServer::on_accept, this, connection,
+                                                              boost::asio::placeholders::error));
+    }
+
+    void on_accept(boost::shared_ptr<Connection> connection, const boost::system::error_code& error)
+    {
+        if (error)
+            return;
+        connection->socket.set_option(tcp::no_delay(true));
+        connection->read();
+        accept();
+    }
+
+    boost::asio::io_service io_service;
+    tcp::acceptor acceptor;
+    boost::thread worker;
+};
+
+// Forwards bytes one way after a fixed delay, keeping their order.
+class DelayPipe
+{
+public:
+    DelayPipe(boost::asio::io_service& io_service, tcp::socket& _from, tcp::socket& _to,
+              boost::posix_time::time_duration _delay) :
+        from(_from), to(_to), delay(_delay), timer(io_service)
+    {
+    }
+
+    void start()
+    {
+        from.async_read_some(boost::asio::buffer(buffer),
+                             boost::bind(&DelayPipe::on_read, this,
+                                         boost::asio::placeholders::error,
+                                         boost::asio::placeholders::bytes_transferred));
+    }
+
+private:
+    struct Chunk
+    {
+        boost::posix_time::ptime due;
+        std::vector<uint8_t> data;
+    };
+
+    void on_read(const boost::system::error_code& error, std::size_t size)
+    {
+        if (error) {
+            boost::system::error_code ignored;
+            to.shutdown(tcp::socket::shutdown_both, ignored);
+            return;
+        }
+        Chunk chunk = { boost::posix_time::microsec_clock::universal_time() + delay,
+                        std::vector<uint8_t>(buffer, buffer + size) };
+        queue.push_back(chunk);
+        if (queue.size() == 1)
+            arm();
+        start();
+    }
+
+    void arm()
+    {
+        timer.expires_at(queue.front().due);
+        timer.async_wait(boost::bind(&DelayPipe::on_due, this, boost::asio::placeholders::error));
+    }
+
+    void on_due(const boost::system::error_code& error)
+    {
+        if (error)
+            return;
+        boost::system::error_code ignored;
+        boost::asio::write(to, boost::asio::buffer(queue.front().data), ignored);
+        queue.pop_front();
+        if (!queue.empty())
+            arm();
+    }
+
+    tcp::socket& from;
+    tcp::socket& to;
+    boost::posix_time::time_duration delay;
+    boost::asio::deadline_timer timer;
+    std::deque<Chunk> queue;
+    uint8_t buffer[4096];
+};
+
+// One client connection through a link with one_way_ms latency each way.
+class LatencyProxy
+{
+public:
+    LatencyProxy(unsigned short server_port, int one_way_ms) :
+        acceptor(io_service, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0)),
+        client(io_service),
+        server(io_service),
+        upstream(io_service, client, server, boost::posix_time::milliseconds(one_way_ms)),
+        downstream(io_service, server, client, boost::posix_time::milliseconds(one_way_ms)),
+        server_endpoint(boost::asio::ip::address_v4::loopback(), server_port)
+    {
+        acceptor.async_accept(client, boost::bind(&LatencyProxy::on_accept, this, boost::asio::placeholders::error));
+        worker = boost::thread(boost::bind(&boost::asio::io_service::run, &io_service));
+    }
+
+    ~LatencyProxy()
+    {
+        io_service.stop();
+        worker.join();
+    }
+
+    unsigned short port() const { return acceptor.local_endpoint().port(); }
+
+private:
+    void on_accept(const boost::system::error_code& error)
+    {
+        if (error)
+            return;
+        client.set_option(tcp::no_delay(true));
+        server.connect(server_endpoint);
+        server.set_option(tcp::no_delay(true));
+        upstream.start();
+        downstream.start();
+    }
+
+    boost::asio::io_service io_service;
+    tcp::acceptor acceptor;
+    tcp::socket client;
+    tcp::socket server;
+    DelayPipe upstream;
+    DelayPipe downstream;
+    tcp::endpoint server_endpoint;
+    boost::thread worker;
+};
+
+inline bool wait_connected(Connector& connector)
+{
+    for (int i = 0; i < 500 && !connector.is_connected(); ++i)
+        boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+    return connector.is_connected();
+}
+
+#endif // BENCHSERVER_H
@@ -0,0 +1,128 @@
+#include "benchmark.h"
+
+#include <QApplication>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+void usage()
+{
+    printf("usage: bench [--filter TEXT] [--min-time MS] [--repetitions N] [--json FILE]\n"
+           "       bench --compare BASELINE.json CURRENT.json [--threshold PERCENT]\n");
+}
+
+bool load_results(const char* path, QJsonObject& by_name)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return false;
+    }
+    QJsonArray benchmarks = QJsonDocument::fromJson(file.readAll()).object().value("benchmarks").toArray();
+    for (int i = 0; i < benchmarks.size(); ++i) {
+        QJsonObject result = benchmarks[i].toObject();
+        by_name.insert(result.value("name").toString(), result);
+    }
+    return true;
+}
+
+// Returns the number of benchmarks that got slower than the threshold allows.
+int compare(const char* baseline_path, const char* current_path, double threshold_percent)
+{
+    QJsonObject baseline, current;
+    if (!load_results(baseline_path, baseline) || !load_results(current_path, current))
+        return -1;
+
+    int regressions = 0;
+    printf("%-40s %14s %14s %9s\n", "benchmark", "baseline ns", "current ns", "change");
+    for (QJsonObject::const_iterator it = current.begin(); it != current.end(); ++it) {
+        double now = it.value().toObject().value("ns_per_op").toDouble();
+        if (!baseline.contains(it.key())) {
+            printf("%-40s %14s %14.1f %9s\n", qPrintable(it.key()), "-", now, "new");
+            continue;
+        }
+        double before = baseline.value(it.key()).toObject().value("ns_per_op").toDouble();
+        double change = before > 0 ? (now - before) * 100.0 / before : 0;
+        bool regressed = change > threshold_percent;
+        regressions += regressed;
+        printf("%-40s %14.1f %14.1f %+8.1f%%%s\n", qPrintable(it.key()), before, now, change,
+               regressed ? "  REGRESSION" : "");
+    }
+    return regressions;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    const char* filter = NULL;
+    const char* json_path = NULL;
+    const char* compare_paths[2] = { NULL, NULL };
+    double min_time_ms = 200;
+    double threshold_percent = 10;
+    int repetitions = 5;
+
+    for (int i = 1; i < argc; ++i) {
+        bool has_value = i + 1 < argc;
+        if (!strcmp(argv[i], "--filter") && has_value) {
+            filter = argv[++i];
+        } else if (!strcmp(argv[i], "--json") && has_value) {
+            json_path = argv[++i];
+        } else if (!strcmp(argv[i], "--min-time") && has_value) {
+            min_time_ms = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--repetitions") && has_value) {
+            repetitions = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--threshold") && has_value) {
+            threshold_percent = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--compare") && i + 2 < argc) {
+            compare_paths[0] = argv[++i];
+            compare_paths[1] = argv[++i];
+        } else {
+            usage();
+            return 2;
+        }
+    }
+
+    if (compare_paths[0]) {
+        int regressions = compare(compare_paths[0], compare_paths[1], threshold_percent);
+        if (regressions < 0)
+            return 2;
+        return regressions ? 1 : 0;
+    }
+
+    if (qgetenv("QT_QPA_PLATFORM").isEmpty())
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication app(argc, argv);
+
+    Bench bench(min_time_ms, repetitions);
+    const BenchRegistry::Cases& cases = BenchRegistry::cases();
+    for (std::size_t i = 0; i < cases.size(); ++i) {
+        if (filter && cases[i].first.find(filter) == std::string::npos)
+            continue;
+        std::size_t first = bench.results().size();
+        cases[i].second(bench);
+        for (std::size_t r = first; r < bench.results().size(); ++r)
+            fprintf(stderr, "%-40s %14.1f ns/op  (%llu iterations)\n",
+                    bench.results()[r].name.c_str(), bench.results()[r].ns_per_op,
+                    static_cast<unsigned long long>(bench.results()[r].iterations));
+    }
+
+    std::string json = bench.to_json();
+    if (json_path) {
+        FILE* file = fopen(json_path, "wb");
+        if (!file || fwrite(json.data(), 1, json.size(), file) != json.size()) {
+            fprintf(stderr, "cannot write %s\n", json_path);
+            return 1;
+        }
+        fclose(file);
+    } else {
+        fwrite(json.data(), 1, json.size(), stdout);
+    }
+    return 0;
+}
@@ -0,0 +1,136 @@
+#include "boardscene.h"
+
+#include <QMutexLocker>
+#include <QPainter>
+#include <QRunnable>
+
+class PanelRasterJob : public QRunnable
+{
+    BoardScene* scene;
+    int panel;
+    std::size_t signature;
+    QPicture picture;
+public:
+    PanelRasterJob(BoardScene* _scene, int _panel, std::size_t _signature, const QPicture& _picture) :
+        scene(_scene),
+        panel(_panel),
+        signature(_signature)
+    {
+        // deep copy, the GUI thread may record into the original meanwhile
+        picture.setData(_picture.data(), _picture.size());
+    }
+
+    void run()
+    {
+        QRect bounds = picture.boundingRect().adjusted(-2, -2, 2, 2);
+        QImage image(bounds.size().expandedTo(QSize(1, 1)), QImage::Format_ARGB32_Premultiplied);
+        image.fill(Qt::transparent);
+        {
+            QPainter p(&image);
+            p.translate(-bounds.topLeft());
+            p.drawPicture(0, 0, picture);
+        }
+        scene->raster_done(panel, signature, bounds.topLeft(), image);
+    }
+};
+
+BoardScene::BoardScene(QObject *parent) :
+    QObject(parent),
+    threads(0)
+{
+    invalidate();
+}
+
+BoardScene::~BoardScene()
+{
+    pool.waitForDone();
+}
+
+bool BoardScene::needs_update(Panel panel, std::size_t signature) const
+{
+    return !panels[panel].valid || panels[panel].signature != signature;
+}
+
+QPicture& BoardScene::record(Panel panel, std::size_t signature)
+{
+    QMutexLocker lock(&images_mtx);
+    panels[panel].picture = QPicture();
+    panels[panel].signature = signature;
+    panels[panel].valid = true;
+    return panels[panel].picture;
+}
+
+void BoardScene::paint(QPainter& p)
+{
+    for (int panel = 0; panel < PanelCount; ++panel)
+        paint_panel(p, static_cast<Panel>(panel));
+}
+
+void BoardScene::paint_panel(QPainter& p, Panel panel)
+{
+    if (!threads) {
+        if (panels[panel].valid)
+            p.drawPicture(0, 0, panels[panel].picture);
+        return;
+    }
+    QMutexLocker lock(&images_mtx);
+    if (panels[panel].image_valid)
+        p.drawImage(panels[panel].image_origin, panels[panel].image);
+}
+
+void BoardScene::invalidate()
+{
+    QMutexLocker lock(&images_mtx);
+    for (int panel = 0; panel < PanelCount; ++panel) {
+        panels[panel].signature = 0;
+        panels[panel].valid = false;
+        panels[panel].image_signature = 0;
+        panels[panel].image_valid = false;
+        panels[panel].in_flight = false;
+    }
+}
+
+void BoardScene::set_raster_threads(int _threads)
+{
+    pool.waitForDone();
+    threads = _threads > 0 ? _threads : 0;
+    if (threads)
+        pool.setMaxThreadCount(threads);
+}
+
+void BoardScene::rasterize(bool wait)
+{
+    if (!threads)
+        return;
+    {
+        QMutexLocker lock(&images_mtx);
+        for (int panel = 0; panel < PanelCount; ++panel) {
+            PanelState& state = panels[panel];
+            if (!state.valid || state.in_flight)
+                continue;
+            if (state.image_valid && state.image_signature == state.signature)
+                continue;
+            state.in_flight = true;
+            pool.start(new PanelRasterJob(this, panel, state.signature, state.picture));
+        }
+    }
+    if (wait)
+        pool.waitForDone();
+}
+
+void BoardScene::raster_done(int panel, std::size_t signature, QPoint origin, const QImage& image)
+{
+    {
+        QMutexLocker lock(&images_mtx);
+        PanelState& state = panels[panel];
+        state.in_flight = false;
+        // a stale image is dropped; the repaint below queues the new picture
+        if (state.valid && state.signature == signature) {
+            state.image = image;
+            state.image_origin = origin;
+            state.image_signature = signature;
+            state.image_valid = true;
+        }
+    }
+    QMetaObject::invokeMethod(this, "panelsReady", Qt::QueuedConnection);
+}
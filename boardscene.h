@@ -0,0 +1,94 @@
+#ifndef BOARDSCENE_H
+#define BOARDSCENE_H
+
+#include <QImage>
+#include <QMutex>
+#include <QObject>
+#include <QPicture>
+#include <QThreadPool>
+#include <cstddef>
+
+class QPainter;
+
+// Retained drawing of the production board. Every panel keeps the painter
+// commands it was last drawn with in a QPicture together with a signature
+// of the model values it was drawn from; a panel is only recorded again when
+// its signature changes, and paintEvent just replays the pictures.
+//
+// With raster threads set, out-of-date panels are instead rasterized into
+// their own QImage on a thread pool and paint() only composites the images.
+class BoardScene : public QObject
+{
+    Q_OBJECT
+public:
+    enum Panel
+    {
+        MoneyPanel,
+        CreditPanel,
+        DebitPanel1,
+        DebitPanel2,
+        DebitPanel3,
+        DebitPanel4,
+        MaterialsPanel,
+        ProductsPanel,
+        LinesPanel,
+        PanelCount
+    };
+
+    explicit BoardScene(QObject *parent = 0);
+    ~BoardScene();
+
+    bool needs_update(Panel panel, std::size_t signature) const;
+
+    // Clears the panel and returns its picture for recording.
+    QPicture& record(Panel panel, std::size_t signature);
+
+    void paint(QPainter& p);
+
+    void paint_panel(QPainter& p, Panel panel);
+
+    void invalidate();
+
+    // 0 replays the pictures on the GUI thread (the default).
+    void set_raster_threads(int threads);
+
+    int raster_threads() const { return threads; }
+
+    // Queues every panel whose image is behind its picture. panelsReady()
+    // is emitted when a queued image lands; with wait the call blocks
+    // until all of them are done.
+    void rasterize(bool wait);
+
+    static void signature_add(std::size_t& signature, std::size_t value)
+    {
+        signature ^= value + 0x9e3779b9 + (signature << 6) + (signature >> 2);
+    }
+
+signals:
+    void panelsReady();
+
+private:
+    friend class PanelRasterJob;
+
+    void raster_done(int panel, std::size_t signature, QPoint origin, const QImage& image);
+
+    struct PanelState
+    {
+        QPicture picture;
+        std::size_t signature;
+        bool valid;
+
+        QImage image;
+        QPoint image_origin;
+        std::size_t image_signature;
+        bool image_valid;
+        bool in_flight;
+    };
+
+    PanelState panels[PanelCount];
+    int threads;
+    QThreadPool pool;
+    QMutex images_mtx;
+};
+
+#endif // BOARDSCENE_H
@@ -0,0 +1,94 @@
+#ifndef BOTAPI_H
+#define BOTAPI_H
+
+#include <stdint.h>
+
+// What a bot plugin exports, as plain C so that plugins built with another
+// compiler or standard library load into the host. A plugin is a shared
+// library with a yourcompany_bot_plugin() function returning its BotPlugin;
+// the host refuses plugins whose abi_version differs from BOT_ABI_VERSION.
+// Anything new goes at the end of these structs with the version raised.
+//
+// The host calls observe() and decide() for one bot from one thread at a
+// time, but different bots of a plugin on several threads at once.
+#define BOT_ABI_VERSION 1
+#define BOT_PLUGIN_ENTRY "yourcompany_bot_plugin"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum BotEventKind
+{
+    BotEventContractOffer = 0,  // offer id in id, its "1A5/1B7" terms in values
+    BotEventRosterJoin,         // sequence number in id, name in text
+    BotEventRosterLeave,
+    BotEventYearClosed,         // year in id, money at its start and end in values[0..1]
+    BotEventRefused             // an action that could not be applied: its kind in id, argument in values[0]
+};
+
+typedef struct BotEvent
+{
+    uint32_t kind;
+    uint32_t id;
+    int32_t values[4];
+    const char* text;           // NUL terminated, valid during observe() only
+} BotEvent;
+
+// The bot's game as of the start of the turn to decide.
+typedef struct BotState
+{
+    uint32_t turn;
+    int32_t money;
+    int32_t materials;
+    uint32_t products_a;
+    uint32_t products_b;
+    uint32_t lines;
+    uint32_t lines_idle;        // not loaded yet this turn
+    int32_t materials_idle;     // what loading every idle line takes
+    uint32_t contracts;
+    uint32_t wanted_a;          // products the contracts ask for
+    uint32_t wanted_b;
+} BotState;
+
+enum BotActionKind
+{
+    BotBuyMaterials = 0,        // arg units
+    BotLoadLines,               // the first arg idle lines
+    BotSell,                    // fill the contracts the products cover
+    BotAcceptOffer              // the offer with id arg
+};
+
+typedef struct BotAction
+{
+    uint32_t kind;
+    int32_t arg;
+} BotAction;
+
+typedef struct BotPlugin
+{
+    uint32_t abi_version;
+    const char* name;
+
+    // config is the text after the plugin path on the host's command line.
+    void* (*create)(uint32_t bot, const char* config);
+    void (*destroy)(void* bot);
+
+    // Events since the bot's last turn, oldest first. May be NULL.
+    void (*observe)(void* bot, const BotEvent* events, uint32_t count);
+
+    // Decides a turn for count bots at once: bots[i] looks at states[i] and
+    // writes up to max_actions actions from actions + i * max_actions on,
+    // and how many it wrote to action_counts[i]. They are applied in order
+    // and the turn ends after the last one.
+    void (*decide)(void* const* bots, const BotState* states, uint32_t count,
+                   BotAction* actions, uint32_t max_actions, uint32_t* action_counts);
+} BotPlugin;
+
+typedef const BotPlugin* (*BotPluginEntry)(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BOTAPI_H
@@ -0,0 +1,455 @@
+#include "bothost.h"
+#include "autoplay.h"
+#include "connector.h"
+#include "varint.h"
+
+#include <algorithm>
+#include <chrono>
+
+#ifdef WIN32
+#include <windows.h>
+#define dlsym(handle, name) reinterpret_cast<void*>(GetProcAddress(static_cast<HMODULE>(handle), name))
+#define dlclose(handle) FreeLibrary(static_cast<HMODULE>(handle))
+#else
+#include <dlfcn.h>
+#endif
+
+boost::shared_ptr<BotLibrary> BotLibrary::open(const std::string& path, std::string& error)
+{
+#ifdef WIN32
+    void* handle = LoadLibraryA(path.c_str());
+    if (!handle) {
+        error = path + ": can't load";
+        return boost::shared_ptr<BotLibrary>();
+    }
+#else
+    void* handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!handle) {
+        const char* reason = dlerror();
+        error = reason ? reason : path + ": can't load";
+        return boost::shared_ptr<BotLibrary>();
+    }
+#endif
+    BotPluginEntry entry = reinterpret_cast<BotPluginEntry>(dlsym(handle, BOT_PLUGIN_ENTRY));
+    const BotPlugin* plugin = entry ? entry() : NULL;
+    if (!plugin || plugin->abi_version != BOT_ABI_VERSION || !plugin->create || !plugin->decide) {
+        if (!entry)
+            error = path + ": no " BOT_PLUGIN_ENTRY "()";
+        else if (!plugin)
+            error = path + ": " BOT_PLUGIN_ENTRY "() returned no plugin";
+        else
+            error = path + ": built for another bot ABI";
+        dlclose(handle);
+        return boost::shared_ptr<BotLibrary>();
+    }
+    boost::shared_ptr<BotLibrary> library(new BotLibrary(plugin));
+    library->handle = handle;
+    return library;
+}
+
+BotLibrary::BotLibrary(const BotPlugin* _plugin) :
+    handle(NULL),
+    api(_plugin)
+{
+}
+
+BotLibrary::~BotLibrary()
+{
+    if (handle)
+        dlclose(handle);
+}
+
+uint64_t BotHost::now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+BotHost::BotHost(std::size_t threads, const FrameSender& _send) :
+    send(_send),
+    batch_size(DefaultBatchSize),
+    max_frame_size(DefaultMaxFrameSize),
+    shards(std::max<std::size_t>(threads, 1)),
+    stopping(false),
+    round(0),
+    finished(0),
+    round_begin_ns(0),
+    next_offer(1),
+    totals(),
+    latencies_ns(LatencySamples),
+    latency_count(0)
+{
+    for (std::size_t i = 1; i < shards.size(); ++i)
+        workers.create_thread(boost::bind(&BotHost::work, this, i));
+}
+
+BotHost::~BotHost()
+{
+    {
+        boost::mutex::scoped_lock lock(mtx);
+        stopping = true;
+    }
+    start_cv.notify_all();
+    workers.join_all();
+    for (std::size_t i = 0; i < bots.size(); ++i) {
+        if (bots[i].library->plugin()->destroy)
+            bots[i].library->plugin()->destroy(bots[i].instance);
+    }
+}
+
+void BotHost::set_batch_size(std::size_t bots)
+{
+    batch_size = std::max<std::size_t>(bots, 1);
+}
+
+void BotHost::set_max_frame_size(std::size_t bytes)
+{
+    max_frame_size = bytes;
+}
+
+uint32_t BotHost::add_bot(const boost::shared_ptr<BotLibrary>& library, const GameState& state,
+                          const std::string& config)
+{
+    uint32_t id = static_cast<uint32_t>(bots.size());
+    bots.push_back(Bot());
+    Bot& bot = bots.back();
+    bot.library = library;
+    bot.instance = library->plugin()->create(id, config.c_str());
+    bot.state = state;
+    bot.report.begin_year(1, state.money);
+    bot.decisions = 0;
+    bot.latency_ns_total = 0;
+    bot.latency_ns_max = 0;
+    return id;
+}
+
+BotHost::BotStats BotHost::bot_stats(uint32_t bot) const
+{
+    const Bot& b = bots[bot];
+    BotStats result = { b.decisions, b.decisions ? b.latency_ns_total / 1e3 / b.decisions : 0,
+                        b.latency_ns_max / 1e3 };
+    return result;
+}
+
+void BotHost::post(const BotEvent& event)
+{
+    post(AllBots, event);
+}
+
+void BotHost::post(uint32_t bot, const BotEvent& event)
+{
+    Posted posted_event = { bot, event, event.text ? event.text : "" };
+    boost::mutex::scoped_lock lock(post_mtx);
+    posted.push_back(posted_event);
+}
+
+bool BotHost::offer_contract(const std::string& text)
+{
+    BotEvent event = BotEvent();
+    event.kind = BotEventContractOffer;
+    wire::Text market;
+    if (!msg::GetContractOk::decode(text.data(), text.size(), event.values[0], event.values[1],
+                                    event.values[2], event.values[3], market))
+        return false;
+    event.text = text.c_str();
+    {
+        boost::mutex::scoped_lock lock(post_mtx);
+        event.id = next_offer++;
+    }
+    post(event);
+    return true;
+}
+
+void BotHost::play_round()
+{
+    uint64_t begin = now_ns();
+    round_events.clear();
+    {
+        boost::mutex::scoped_lock lock(post_mtx);
+        round_events.swap(posted);
+    }
+    while (!offers.empty() && offers.front().round + OfferRounds <= round)
+        offers.pop_front();
+    for (std::size_t i = 0; i < round_events.size();) {
+        Posted& event = round_events[i];
+        if (event.event.kind == BotEventContractOffer) {
+            Offer offer = { event.event.id, round,
+                            { event.event.values[0], event.event.values[1],
+                              event.event.values[2], event.event.values[3], -1, 0 }, false };
+            offers.push_back(offer);
+        }
+        if (event.bot == AllBots) {
+            ++i;
+            continue;
+        }
+        if (event.bot < bots.size())
+            bots[event.bot].inbox.push_back(event);
+        round_events.erase(round_events.begin() + i);
+    }
+
+    {
+        boost::mutex::scoped_lock lock(mtx);
+        ++round;
+        finished = 0;
+        round_begin_ns = begin;
+    }
+    start_cv.notify_all();
+    play_shard(0);
+    {
+        boost::mutex::scoped_lock lock(mtx);
+        while (finished < shards.size() - 1)
+            done_cv.wait(lock);
+    }
+
+    boost::mutex::scoped_lock lock(stats_mtx);
+    ++totals.rounds;
+    for (std::size_t i = 0; i < shards.size(); ++i) {
+        Shard& shard = shards[i];
+        totals.decisions += shard.decisions;
+        totals.actions += shard.actions_applied;
+        totals.frames += shard.frames;
+        totals.bytes += shard.bytes;
+        for (std::size_t j = 0; j < shard.latencies_ns.size(); ++j)
+            latencies_ns[latency_count++ % LatencySamples] = shard.latencies_ns[j];
+    }
+    totals.seconds += (now_ns() - begin) / 1e9;
+}
+
+BotHost::Stats BotHost::stats() const
+{
+    std::vector<uint32_t> samples;
+    Stats result;
+    {
+        boost::mutex::scoped_lock lock(stats_mtx);
+        result = totals;
+        result.latency = Latency();
+        result.latency.count = latency_count;
+        if (!latency_count)
+            return result;
+        samples.assign(latencies_ns.begin(), latencies_ns.begin() + std::min<std::size_t>(latency_count, LatencySamples));
+    }
+    std::sort(samples.begin(), samples.end());
+    result.latency.median_us = samples[samples.size() / 2] / 1000.0;
+    result.latency.p99_us = samples[std::min(samples.size() - 1, samples.size() * 99 / 100)] / 1000.0;
+    result.latency.max_us = samples.back() / 1000.0;
+    return result;
+}
+
+void BotHost::work(std::size_t shard)
+{
+    uint64_t played = 0;
+    for (;;) {
+        {
+            boost::mutex::scoped_lock lock(mtx);
+            while (!stopping && round == played)
+                start_cv.wait(lock);
+            if (stopping)
+                return;
+            played = round;
+        }
+        play_shard(shard);
+        boost::mutex::scoped_lock lock(mtx);
+        if (++finished == shards.size() - 1)
+            done_cv.notify_all();
+    }
+}
+
+void BotHost::play_shard(std::size_t index)
+{
+    Shard& shard = shards[index];
+    shard.decisions = 0;
+    shard.actions_applied = 0;
+    shard.frames = 0;
+    shard.bytes = 0;
+    shard.latencies_ns.clear();
+    std::size_t begin = bots.size() * index / shards.size();
+    std::size_t end = bots.size() * (index + 1) / shards.size();
+    // a batch is a run of bots from the same plugin
+    while (begin < end) {
+        std::size_t batch_end = begin + 1;
+        while (batch_end < end && batch_end - begin < batch_size
+               && bots[batch_end].library == bots[begin].library)
+            ++batch_end;
+        play_batch(shard, begin, batch_end);
+        begin = batch_end;
+    }
+    flush(shard);
+}
+
+void BotHost::play_batch(Shard& shard, std::size_t begin, std::size_t end)
+{
+    const BotPlugin* plugin = bots[begin].library->plugin();
+    std::size_t count = end - begin;
+    shard.instances.resize(count);
+    shard.states.resize(count);
+    shard.actions.resize(count * MaxActions);
+    shard.counts.assign(count, 0);
+    for (std::size_t i = 0; i < count; ++i) {
+        Bot& bot = bots[begin + i];
+        if (plugin->observe && (!round_events.empty() || !bot.inbox.empty())) {
+            shard.events.clear();
+            for (std::size_t e = 0; e < round_events.size(); ++e) {
+                shard.events.push_back(round_events[e].event);
+                shard.events.back().text = round_events[e].text.c_str();
+            }
+            for (std::size_t e = 0; e < bot.inbox.size(); ++e) {
+                shard.events.push_back(bot.inbox[e].event);
+                shard.events.back().text = bot.inbox[e].text.c_str();
+            }
+            plugin->observe(bot.instance, &shard.events[0], static_cast<uint32_t>(shard.events.size()));
+        }
+        bot.inbox.clear();
+
+        const GameState& state = bot.state;
+        BotState& view = shard.states[i];
+        view = BotState();
+        view.turn = state.turn;
+        view.money = state.money;
+        view.materials = state.materials;
+        for (std::size_t p = 0; p < state.products.size(); ++p) {
+            if (state.products[p] == GameState::ProductA)
+                ++view.products_a;
+            else
+                ++view.products_b;
+        }
+        view.lines = static_cast<uint32_t>(state.lines.size());
+        for (std::size_t l = 0; l < state.lines.size(); ++l) {
+            if (state.lines[l].loaded)
+                continue;
+            ++view.lines_idle;
+            view.materials_idle += state.lines[l].product_type == GameState::ProductA ? 1 : 2;
+        }
+        view.contracts = static_cast<uint32_t>(state.contracts.size());
+        for (std::size_t c = 0; c < state.contracts.size(); ++c) {
+            view.wanted_a += state.contracts[c].a;
+            view.wanted_b += state.contracts[c].b;
+        }
+        shard.instances[i] = bot.instance;
+    }
+
+    plugin->decide(&shard.instances[0], &shard.states[0], static_cast<uint32_t>(count),
+                   &shard.actions[0], MaxActions, &shard.counts[0]);
+
+    for (std::size_t i = 0; i < count; ++i) {
+        uint32_t id = static_cast<uint32_t>(begin + i);
+        apply(bots[id], id, &shard.actions[i * MaxActions], std::min<uint32_t>(shard.counts[i], MaxActions), shard);
+    }
+}
+
+void BotHost::apply(Bot& bot, uint32_t id, const BotAction* actions, uint32_t count, Shard& shard)
+{
+    GameState& state = bot.state;
+    std::size_t record = shard.payload.size();
+    put_varint(shard.payload, id);
+    put_varint(shard.payload, state.turn);
+    std::size_t count_at = shard.payload.size();
+    put_varint(shard.payload, 0);
+    uint32_t applied = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        const BotAction& action = actions[i];
+        bool done = false;
+        switch (action.kind) {
+        case BotBuyMaterials:
+            done = rules::buy_materials(state, action.arg);
+            break;
+        case BotLoadLines: {
+            int32_t loaded = 0;
+            for (std::size_t l = 0; l < state.lines.size() && loaded < action.arg; ++l) {
+                if (rules::load_line(state, l))
+                    ++loaded;
+            }
+            done = loaded > 0;
+            break;
+        }
+        case BotSell:
+            done = !state.products.empty() && !state.contracts.empty();
+            if (done)
+                rules::sell(state, bot.report);
+            break;
+        case BotAcceptOffer: {
+            GameState::Contract contract;
+            done = take_offer(static_cast<uint32_t>(action.arg), contract);
+            if (done)
+                state.contracts.push_back(contract);
+            break;
+        }
+        }
+        if (!done) {
+            Posted refused = { id, BotEvent(), "" };
+            refused.event.kind = BotEventRefused;
+            refused.event.id = action.kind;
+            refused.event.values[0] = action.arg;
+            bot.inbox.push_back(refused);
+            continue;
+        }
+        put_varint(shard.payload, action.kind);
+        put_svarint(shard.payload, action.arg);
+        ++applied;
+    }
+    // one byte holds the count as long as MaxActions stays under 128
+    shard.payload[count_at] = static_cast<uint8_t>(applied);
+    shard.actions_applied += applied;
+
+    if (rules::end_turn(state, bot.report, shard.year)) {
+        Posted closed = { id, BotEvent(), "" };
+        closed.event.kind = BotEventYearClosed;
+        closed.event.id = shard.year.year;
+        closed.event.values[0] = static_cast<int32_t>(shard.year.money_start);
+        closed.event.values[1] = static_cast<int32_t>(shard.year.money_end);
+        bot.inbox.push_back(closed);
+    }
+    ++bot.decisions;
+    ++shard.decisions;
+
+    shard.waiting.push_back(id);
+    if (shard.payload.size() > max_frame_size) {
+        // this bot's turn starts the next frame unless it is the only one
+        if (shard.waiting.size() > 1) {
+            std::vector<uint8_t> turn(shard.payload.begin() + record, shard.payload.end());
+            shard.payload.resize(record);
+            shard.waiting.pop_back();
+            flush(shard);
+            shard.payload.swap(turn);
+            shard.waiting.push_back(id);
+        }
+        if (shard.payload.size() >= max_frame_size)
+            flush(shard);
+    }
+}
+
+void BotHost::flush(Shard& shard)
+{
+    if (shard.waiting.empty())
+        return;
+    boost::shared_ptr<std::vector<uint8_t> > frame(new std::vector<uint8_t>);
+    Connector::command_frame(cmd_type_bot_actions, &shard.payload[0], static_cast<uint32_t>(shard.payload.size()),
+                             *frame);
+    send(frame);
+    uint64_t now = now_ns();
+    for (std::size_t i = 0; i < shard.waiting.size(); ++i) {
+        Bot& bot = bots[shard.waiting[i]];
+        uint64_t latency = now - round_begin_ns;
+        bot.latency_ns_total += latency;
+        bot.latency_ns_max = std::max(bot.latency_ns_max, latency);
+        shard.latencies_ns.push_back(static_cast<uint32_t>(std::min<uint64_t>(latency, 0xffffffff)));
+    }
+    ++shard.frames;
+    shard.bytes += frame->size();
+    shard.payload.clear();
+    shard.waiting.clear();
+}
+
+bool BotHost::take_offer(uint32_t id, GameState::Contract& contract)
+{
+    boost::mutex::scoped_lock lock(offers_mtx);
+    for (std::size_t i = 0; i < offers.size(); ++i) {
+        if (offers[i].id != id)
+            continue;
+        if (offers[i].taken)
+            return false;
+        offers[i].taken = true;
+        contract = offers[i].contract;
+        return true;
+    }
+    return false;
+}
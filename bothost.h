@@ -0,0 +1,203 @@
+#ifndef BOTHOST_H
+#define BOTHOST_H
+
+#include "botapi.h"
+#include "gamestate.h"
+#include "report.h"
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include <deque>
+#include <string>
+#include <vector>
+
+// A bot plugin and the shared library it came from, which stays loaded as
+// long as bots made by it are around.
+class BotLibrary
+{
+public:
+    // NULL with error set when path doesn't load or wasn't built against
+    // this BOT_ABI_VERSION.
+    static boost::shared_ptr<BotLibrary> open(const std::string& path, std::string& error);
+
+    // A plugin linked into the executable.
+    explicit BotLibrary(const BotPlugin* _plugin);
+    ~BotLibrary();
+
+    const BotPlugin* plugin() const { return api; }
+
+private:
+    BotLibrary(const BotLibrary&);
+    BotLibrary& operator=(const BotLibrary&);
+
+    void* handle;
+    const BotPlugin* api;
+};
+
+// Plays many bots in one process without a window. Every round each bot is
+// shown the events posted since its last turn and decides one turn. The
+// bots are split into one shard per thread, and a shard asks a plugin for
+// up to batch_size of its bots' decisions in a single decide() call. Turns
+// are applied to the bots' own GameStates with the rules in autoplay.h, and
+// each shard sends what its bots decided as cmd_type_bot_actions frames of
+// up to max_frame_size bytes as soon as one fills up.
+class BotHost
+{
+public:
+    typedef boost::shared_ptr<const std::vector<uint8_t> > Frame;
+    // Called from the shard threads, e.g. Connector::frame_send.
+    typedef boost::function<void (const Frame& frame)> FrameSender;
+
+    enum
+    {
+        MaxActions = 16,                // a bot's actions per turn
+        DefaultBatchSize = 64,
+        DefaultMaxFrameSize = 16 * 1024,
+        OfferRounds = 4,                // how long a contract offer can be accepted
+        LatencySamples = 8192
+    };
+
+    struct Latency
+    {
+        std::size_t count;
+        double median_us;
+        double p99_us;
+        double max_us;
+    };
+
+    struct Stats
+    {
+        uint64_t rounds;
+        uint64_t decisions;         // bot turns
+        uint64_t actions;           // applied
+        uint64_t frames;
+        uint64_t bytes;
+        double seconds;             // spent in play_round()
+        Latency latency;            // round start until a bot's turn is handed to the sender
+    };
+
+    struct BotStats
+    {
+        uint64_t decisions;
+        double mean_us;
+        double max_us;
+    };
+
+    // threads - 1 workers are started, play_round() plays a shard itself.
+    BotHost(std::size_t threads, const FrameSender& _send);
+    ~BotHost();
+
+    // Between rounds only, like add_bot().
+    void set_batch_size(std::size_t bots);
+    // 0 sends every bot's turn in a frame of its own.
+    void set_max_frame_size(std::size_t bytes);
+
+    uint32_t add_bot(const boost::shared_ptr<BotLibrary>& library, const GameState& state,
+                     const std::string& config);
+    std::size_t size() const { return bots.size(); }
+    const GameState& state(uint32_t bot) const { return bots[bot].state; }
+    BotStats bot_stats(uint32_t bot) const;
+
+    // Any thread: queued for the bots' next turn. text is copied.
+    void post(const BotEvent& event);
+    void post(uint32_t bot, const BotEvent& event);
+    // A cmd_type_get_contract_ok payload, "1A5/1B7" and on; false if it
+    // doesn't follow msg::GetContractOk. The offer is open for OfferRounds and
+    // goes to the first bot to accept it, the others are refused.
+    bool offer_contract(const std::string& text);
+
+    // Plays one turn of every bot and returns once all their frames are
+    // with the sender.
+    void play_round();
+
+    Stats stats() const;
+
+    static uint64_t now_ns();
+
+private:
+    enum { AllBots = 0xffffffff };
+
+    struct Posted
+    {
+        uint32_t bot;
+        BotEvent event;
+        std::string text;
+    };
+
+    struct Offer
+    {
+        uint32_t id;
+        uint64_t round;
+        GameState::Contract contract;
+        bool taken;
+    };
+
+    struct Bot
+    {
+        boost::shared_ptr<BotLibrary> library;
+        void* instance;
+        GameState state;
+        ReportBuilder report;
+        std::vector<Posted> inbox;
+        uint64_t decisions;
+        uint64_t latency_ns_total;
+        uint64_t latency_ns_max;
+    };
+
+    // What a shard reuses from round to round.
+    struct Shard
+    {
+        std::vector<BotEvent> events;
+        std::vector<void*> instances;
+        std::vector<BotState> states;
+        std::vector<BotAction> actions;
+        std::vector<uint32_t> counts;
+        std::vector<uint8_t> payload;
+        std::vector<uint32_t> waiting;      // bots in payload
+        YearReport year;
+        uint64_t decisions;
+        uint64_t actions_applied;
+        uint64_t frames;
+        uint64_t bytes;
+        std::vector<uint32_t> latencies_ns;
+    };
+
+    void work(std::size_t shard);
+    void play_shard(std::size_t shard);
+    void play_batch(Shard& shard, std::size_t begin, std::size_t end);
+    void apply(Bot& bot, uint32_t id, const BotAction* actions, uint32_t count, Shard& shard);
+    void flush(Shard& shard);
+    bool take_offer(uint32_t id, GameState::Contract& contract);
+
+    FrameSender send;
+    std::size_t batch_size;
+    std::size_t max_frame_size;
+    std::vector<Bot> bots;
+    std::vector<Shard> shards;
+
+    // rounds
+    boost::mutex mtx;
+    boost::condition_variable start_cv;
+    boost::condition_variable done_cv;
+    bool stopping;
+    uint64_t round;
+    std::size_t finished;
+    uint64_t round_begin_ns;
+    boost::thread_group workers;
+
+    // set up by play_round() for the shards to read
+    std::vector<Posted> round_events;
+    std::deque<Offer> offers;
+    boost::mutex offers_mtx;        // the shards race for an offer's taken
+
+    boost::mutex post_mtx;
+    std::vector<Posted> posted;
+    uint32_t next_offer;
+
+    mutable boost::mutex stats_mtx;
+    Stats totals;
+    std::vector<uint32_t> latencies_ns;
+    std::size_t latency_count;
+};
+
+#endif // BOTHOST_H
@@ -0,0 +1,15 @@
+#-------------------------------------------------
+#
+# Headless bot host and the example plugin.
+#
+#   yourcompany-bots --server tcp://host:5000 --login bots \
+#       ./libgreedybot.so:1000:min_price=5
+#
+#-------------------------------------------------
+
+TEMPLATE = subdirs
+
+SUBDIRS = host greedybot
+
+host.file = host.pro
+greedybot.file = greedybot.pro
@@ -0,0 +1,96 @@
+// GreedyPolicy (see autoplay.h) as a bot plugin: keeps its lines loaded
+// while the stock is short of what the contracts ask for, and takes every
+// offer paying at least min_price a product. Config: "min_price=N".
+
+#include "botapi.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+struct GreedyBot
+{
+    int32_t min_price;
+    std::vector<uint32_t> offers;   // to accept in the next turn
+};
+
+void* greedy_create(uint32_t, const char* config)
+{
+    GreedyBot* bot = new GreedyBot;
+    bot->min_price = 0;
+    const char* setting = config ? strstr(config, "min_price=") : NULL;
+    if (setting)
+        bot->min_price = atoi(setting + strlen("min_price="));
+    return bot;
+}
+
+void greedy_destroy(void* bot)
+{
+    delete static_cast<GreedyBot*>(bot);
+}
+
+void greedy_observe(void* instance, const BotEvent* events, uint32_t count)
+{
+    GreedyBot* bot = static_cast<GreedyBot*>(instance);
+    for (uint32_t i = 0; i < count; ++i) {
+        const BotEvent& event = events[i];
+        if (event.kind == BotEventContractOffer && event.values[1] >= bot->min_price
+                && event.values[3] >= bot->min_price)
+            bot->offers.push_back(event.id);
+    }
+}
+
+void greedy_decide(void* const* bots, const BotState* states, uint32_t count,
+                   BotAction* actions, uint32_t max_actions, uint32_t* action_counts)
+{
+    for (uint32_t i = 0; i < count; ++i) {
+        GreedyBot* bot = static_cast<GreedyBot*>(bots[i]);
+        const BotState& state = states[i];
+        BotAction* out = actions + i * max_actions;
+        uint32_t n = 0;
+        while (!bot->offers.empty() && n + 3 < max_actions) {
+            BotAction accept = { BotAcceptOffer, static_cast<int32_t>(bot->offers.back()) };
+            out[n++] = accept;
+            bot->offers.pop_back();
+        }
+        bot->offers.clear();
+        if (state.products_a + state.products_b < state.wanted_a + state.wanted_b && state.lines_idle) {
+            int32_t missing = state.materials_idle - state.materials;
+            if (missing > 0 && state.money >= 2 * missing) {
+                BotAction buy = { BotBuyMaterials, missing };
+                out[n++] = buy;
+            }
+            BotAction load = { BotLoadLines, static_cast<int32_t>(state.lines_idle) };
+            out[n++] = load;
+        }
+        if (state.products_a + state.products_b && state.contracts) {
+            BotAction sell = { BotSell, 0 };
+            out[n++] = sell;
+        }
+        action_counts[i] = n;
+    }
+}
+
+const BotPlugin plugin = {
+    BOT_ABI_VERSION,
+    "greedy",
+    greedy_create,
+    greedy_destroy,
+    greedy_observe,
+    greedy_decide
+};
+
+}
+
+extern "C"
+#ifdef _WIN32
+__declspec(dllexport)
+#else
+__attribute__((visibility("default")))
+#endif
+const BotPlugin* yourcompany_bot_plugin(void)
+{
+    return &plugin;
+}
@@ -0,0 +1,13 @@
+# A bot plugin needs nothing but botapi.h.
+
+CONFIG   -= qt
+CONFIG   += plugin c++11
+
+TARGET = greedybot
+TEMPLATE = lib
+
+INCLUDEPATH += ..
+
+SOURCES += greedybot.cpp
+
+HEADERS += ../botapi.h
@@ -0,0 +1,14 @@
+# The host links the headless client core for Connector and GUIUpdater and
+# never opens a window.
+
+QT       = core
+
+CONFIG   += console c++11
+CONFIG   -= app_bundle
+
+TARGET = yourcompany-bots
+TEMPLATE = app
+
+include(../headless.pri)
+
+SOURCES += main.cpp
@@ -0,0 +1,213 @@
+#include "bothost.h"
+#include "connector.h"
+#include "marketcatalog.h"
+
+#include <QCoreApplication>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+volatile std::sig_atomic_t interrupted = 0;
+
+void on_interrupt(int)
+{
+    interrupted = 1;
+}
+
+void usage()
+{
+    printf("usage: yourcompany-bots [--server URI] [--login NAME] [--password TEXT] [--threads N]\n"
+           "                        [--batch N] [--frame BYTES] [--rate ROUNDS_PER_S] [--rounds N]\n"
+           "                        PLUGIN[:COUNT[:CONFIG]]...\n");
+}
+
+// A new game with one A line bought, as every bot starts.
+GameState starting_state()
+{
+    GameState state;
+    state.money = 50 - 15;
+    state.materials = 0;
+    state.credit_max_time = 42;
+    state.count_year = 4;
+    GameState::Line line = { GameState::ProductA, GameState::ProductA, false, std::vector<uint8_t>(4, 0) };
+    state.lines.push_back(line);
+    std::vector<MarketCatalog::MarketSpec> specs = MarketCatalog::load_scenario();
+    for (std::size_t i = 0; i < specs.size(); ++i) {
+        GameState::Market market = { specs[i].name, specs[i].price, specs[i].time, false };
+        state.markets.push_back(market);
+    }
+    return state;
+}
+
+// Runs on the connector thread.
+void contract_reply(BotHost* host, uint8_t cmd, const uint8_t* data, uint32_t size)
+{
+    if (cmd == cmd_type_get_contract_ok && data)
+        host->offer_contract(std::string(reinterpret_cast<const char*>(data), size));
+}
+
+void print_stats(const BotHost& host)
+{
+    BotHost::Stats stats = host.stats();
+    printf("%zu bots, %llu rounds: %.0f decisions/s, per-bot latency median %.0f us p99 %.0f us max %.0f us,"
+           " %llu frames %.1f KB\n",
+           host.size(), static_cast<unsigned long long>(stats.rounds),
+           stats.seconds > 0 ? stats.decisions / stats.seconds : 0, stats.latency.median_us,
+           stats.latency.p99_us, stats.latency.max_us, static_cast<unsigned long long>(stats.frames),
+           stats.bytes / 1024.0);
+    fflush(stdout);
+}
+
+}
+
+// Hosts bot plugins behind one login, without a window.
+int main(int argc, char *argv[])
+{
+    // GUIUpdater is a QObject and the scenario is found next to the
+    // executable; no event loop runs
+    QCoreApplication app(argc, argv);
+    std::string server = getenv("YOURCOMPANY_SERVER") ? getenv("YOURCOMPANY_SERVER") : "tcp://81.177.175.71:5000";
+    std::string login = "bots";
+    std::string password;
+    std::size_t threads = boost::thread::hardware_concurrency();
+    std::size_t batch = BotHost::DefaultBatchSize;
+    std::size_t frame = BotHost::DefaultMaxFrameSize;
+    double rate = 1;
+    uint64_t rounds = 0;
+    std::vector<std::string> plugins;
+
+    for (int i = 1; i < argc; ++i) {
+        bool has_value = i + 1 < argc;
+        if (!strcmp(argv[i], "--server") && has_value) {
+            server = argv[++i];
+        } else if (!strcmp(argv[i], "--login") && has_value) {
+            login = argv[++i];
+        } else if (!strcmp(argv[i], "--password") && has_value) {
+            password = argv[++i];
+        } else if (!strcmp(argv[i], "--threads") && has_value) {
+            threads = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--batch") && has_value) {
+            batch = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--frame") && has_value) {
+            frame = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--rate") && has_value) {
+            rate = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--rounds") && has_value) {
+            rounds = strtoull(argv[++i], NULL, 10);
+        } else if (argv[i][0] != '-') {
+            plugins.push_back(argv[i]);
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (plugins.empty()) {
+        usage();
+        return 2;
+    }
+
+    GUIUpdater updater;
+    Connector connector(&updater);
+    if (!connector.start(server, login, password)) {
+        fprintf(stderr, "can't use %s\n", server.c_str());
+        return 1;
+    }
+    BotHost host(threads, boost::bind(&Connector::frame_send, &connector, boost::placeholders::_1));
+    host.set_batch_size(batch);
+    host.set_max_frame_size(frame);
+
+    GameState start = starting_state();
+    for (std::size_t i = 0; i < plugins.size(); ++i) {
+        std::string spec = plugins[i];
+        std::string config;
+        std::size_t count = 1;
+        std::size_t colon = spec.find(':');
+        if (colon != std::string::npos) {
+            std::string rest = spec.substr(colon + 1);
+            spec.resize(colon);
+            colon = rest.find(':');
+            count = atoi(rest.c_str());
+            if (colon != std::string::npos)
+                config = rest.substr(colon + 1);
+        }
+        std::string error;
+        boost::shared_ptr<BotLibrary> library = BotLibrary::open(spec, error);
+        if (!library) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+        for (std::size_t b = 0; b < count; ++b)
+            host.add_bot(library, start, config);
+        printf("%zu x %s from %s\n", count, library->plugin()->name, spec.c_str());
+    }
+
+    for (int i = 0; i < 500 && !connector.is_connected(); ++i)
+        boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+    if (!connector.is_connected() || connector.protocol_version() < 2) {
+        fprintf(stderr, "%s: not connected or no protocol 2, cmd_type_bot_actions needs it\n", server.c_str());
+        return 1;
+    }
+
+    signal(SIGINT, on_interrupt);
+    signal(SIGTERM, on_interrupt);
+    uint64_t round_ns = rate > 0 ? static_cast<uint64_t>(1e9 / rate) : 0;
+    uint64_t next = BotHost::now_ns();
+    uint64_t report_at = next + 1000000000ULL;
+    std::vector<RosterDelta> deltas;
+    for (uint64_t round = 0; !interrupted && (!rounds || round < rounds); ++round) {
+        updater.take_roster_deltas(deltas);
+        for (std::size_t i = 0; i < deltas.size(); ++i) {
+            if (deltas[i].op != RosterDelta::Join && deltas[i].op != RosterDelta::Leave)
+                continue;
+            BotEvent event = BotEvent();
+            event.kind = deltas[i].op == RosterDelta::Join ? BotEventRosterJoin : BotEventRosterLeave;
+            event.id = deltas[i].seq;
+            event.text = deltas[i].name.c_str();
+            host.post(event);
+        }
+        deltas.clear();
+        // fresh offers for as long as they stay open
+        if (round % BotHost::OfferRounds == 0) {
+            for (std::size_t m = 0; m < start.markets.size(); ++m) {
+                std::vector<wire::Text> names(1, wire::Text(start.markets[m].name));
+                std::string payload;
+                msg::GetContract::encode(payload, names);
+                connector.request(msg::GetContract::cmd, cmd_type_get_contract_ok,
+                                  reinterpret_cast<const uint8_t*>(payload.data()), payload.size(),
+                                  boost::bind(&contract_reply, &host, boost::placeholders::_1,
+                                              boost::placeholders::_2, boost::placeholders::_3));
+            }
+        }
+
+        host.play_round();
+
+        uint64_t now = BotHost::now_ns();
+        if (now >= report_at) {
+            print_stats(host);
+            report_at = now + 1000000000ULL;
+        }
+        if (round_ns) {
+            next += round_ns;
+            if (next > now)
+                boost::this_thread::sleep(boost::posix_time::microseconds((next - now) / 1000));
+            else
+                next = now;
+        }
+    }
+    // replies still in flight point at host
+    connector.stop();
+    print_stats(host);
+
+    uint32_t slowest = 0;
+    for (uint32_t i = 1; i < host.size(); ++i) {
+        if (host.bot_stats(i).max_us > host.bot_stats(slowest).max_us)
+            slowest = i;
+    }
+    BotHost::BotStats bot = host.bot_stats(slowest);
+    printf("slowest bot %u: %.0f us mean, %.0f us max over %llu turns, money %d\n", slowest, bot.mean_us,
+           bot.max_us, static_cast<unsigned long long>(bot.decisions), host.state(slowest).money);
+    return 0;
+}
@@ -0,0 +1,25 @@
+#include "connector.h"
+#include <sstream>
+
+std::string base64_encode(const std::string &s)
+{
+    static const std::string base64_chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t i=0,ix=0,leng = s.length();
+    std::stringstream q;
+
+    for(i=0,ix=leng - leng%3; i<ix; i+=3)
+    {
+        q<< base64_chars[ (s[i] & 0xfc) >> 2 ];
+        q<< base64_chars[ ((s[i] & 0x03) << 4) + ((s[i+1] & 0xf0) >> 4)  ];
+        q<< base64_chars[ ((s[i+1] & 0x0f) << 2) + ((s[i+2] & 0xc0) >> 6)  ];
+        q<< base64_chars[ s[i+2] & 0x3f ];
+    }
+    if (ix<leng)
+    {
+        q<< base64_chars[ (s[ix] & 0xfc) >> 2 ];
+        q<< base64_chars[ ((s[ix] & 0x03) << 4) + (ix+1<leng ? (s[ix+1] & 0xf0) >> 4 : 0)];
+        q<< (ix+1<leng ? base64_chars[ ((s[ix+1] & 0x0f) << 2) ] : '=');
+        q<< '=';
+    }
+    return q.str();
+}
@@ -0,0 +1,997 @@
+#ifndef CONNECTOR_H
+#define CONNECTOR_H
+
+#include "guiupdater.h"
+#include "allocprof.h"
+#include "arena.h"
+#include "protocol.h"
+#include "roster.h"
+#include "auction.h"
+#include "spill.h"
+#include "tracer.h"
+#include "transport.h"
+#include <QDateTime>
+#include <QDebug>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/thread.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/asio.hpp>
+#include <boost/asio/deadline_timer.hpp>
+#include <boost/function.hpp>
+#include <atomic>
+#include <deque>
+#include <map>
+
+#ifdef WIN32
+#include <mstcpip.h>
+#undef min
+#undef errno
+#undef error
+#else
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+std::string base64_encode(const std::string &s);
+
+class Connector
+{
+    boost::mutex start_stop_mtx;
+     boost::shared_ptr<boost::asio::io_service> io_service;
+     boost::shared_ptr<boost::asio::io_service::work> ios_work;
+     boost::shared_ptr<boost::thread> worker_thread;
+    boost::shared_ptr<Transport> transport;
+
+    Endpoint endpoint;
+    std::string login;
+    std::string password;
+    uint64_t reconnect_if_no_response;
+    std::vector<uint8_t> read_buffer;
+    std::vector<uint8_t> parse_buffer;
+
+    GUIUpdater* data_receiver;
+    AuctionClient* auction;
+
+public:
+    typedef boost::shared_ptr<const std::vector<uint8_t> > Frame;
+    // data is NULL with a non-zero size for a reply that went to the spill
+    // handler, and NULL with cmd_type_err when the connection was lost.
+    typedef boost::function<void (uint8_t cmd, const uint8_t* data, uint32_t size)> ReplyHandler;
+    // Where a frame over the in-memory limit goes; NULL skips it.
+    typedef boost::function<boost::shared_ptr<FrameSink> (uint8_t cmd, uint32_t request_id, uint32_t size)> SpillHandler;
+
+    enum { DefaultMaxFrameSize = 1 << 20, AckEvery = 64, MaxUnacked = 4096,
+           PooledFrames = 256, PooledFrameCapacity = 64 * 1024 };
+
+private:
+    // Frames are written one at a time from the io_service thread, so
+    // pipelined requests never interleave on the transport. Written frames
+    // before write_head are dropped in batches; a vector keeps its memory
+    // where a deque would free and allocate blocks as it goes.
+    std::vector<Frame> write_queue;
+    std::size_t write_head;
+
+    // Completions of a transport older than connect() last made are
+    // stale. The generation rather than the transport itself goes into the
+    // handlers, which keeps them small enough for boost::function to hold
+    // without the heap.
+    uint32_t transport_generation;
+
+    struct ReadDone
+    {
+        Connector* connector;
+        uint32_t generation;
+
+        void operator()(const boost::system::error_code& error, std::size_t size) const
+        {
+            connector->handle_read(generation, error, size);
+        }
+    };
+
+    struct WriteDone
+    {
+        Connector* connector;
+        uint32_t generation;
+
+        void operator()(const boost::system::error_code& error, std::size_t) const
+        {
+            connector->on_send_over(generation, error);
+        }
+    };
+
+    // Buffers for command_send() and control_send(). One is free again
+    // once the pool holds its only reference, i.e. once it has been
+    // written and acknowledged.
+    boost::mutex pool_mtx;
+    std::vector<boost::shared_ptr<std::vector<uint8_t> > > frame_pool;
+    std::size_t pool_next;
+
+    // Frames from frame_send(), moved to the write queue by one posted
+    // drain_outbox() at a time. That post is the only one from outside
+    // the io_service thread, so it has a block of memory of its own.
+    boost::mutex outbox_mtx;
+    std::vector<Frame> outbox;
+    std::vector<Frame> outbox_drained;  // io_service thread
+    bool outbox_posted;
+    HandlerMemory outbox_memory;
+
+    struct DrainOutbox
+    {
+        typedef HandlerAllocator<void> allocator_type;
+
+        Connector* connector;
+
+        allocator_type get_allocator() const
+        {
+            return allocator_type(connector->outbox_memory);
+        }
+
+        void operator()() const
+        {
+            connector->drain_outbox();
+        }
+    };
+
+    // Temporaries of the frame being parsed or built on the io_service
+    // thread, e.g. the login reply's fields.
+    Arena frame_arena;
+
+    // Requests waiting for their reply. With protocol 2 the reply carries
+    // the request id; with protocol 1 it is matched to the oldest request
+    // expecting that reply command.
+    struct Pending {
+        uint8_t reply_cmd;
+        ReplyHandler handler;
+    };
+    boost::mutex requests_mtx;
+    uint32_t next_request_id;
+    std::map<uint32_t, ReplyHandler> in_flight;
+    std::deque<Pending> unnumbered;
+    uint8_t max_protocol;
+    std::atomic<int> protocol;
+
+    // A frame whose payload is over max_frame_size streams through spill
+    // instead of collecting in parse_buffer, see buffer_parse().
+    uint32_t max_frame_size;
+    SpillHandler spill_handler;
+    boost::shared_ptr<FrameSink> spill;
+    uint8_t spill_cmd;
+    uint32_t spill_request_id;
+    uint32_t spill_size;
+    uint32_t spill_left;
+
+    // Resumable sessions, see protocol.h. Frames after the login are counted
+    // both ways and what was sent stays in unacked until the server
+    // acknowledges it, so a reconnect repeats only what either side missed.
+    bool resume_enabled;
+    std::string resume_token;
+    bool counting;              // resumption offered or granted this session
+    bool established;           // logged in or resumed on this transport
+    uint32_t frames_in;         // session frames received
+    uint32_t frames_in_acked;   // frames_in as last sent in cmd_type_ack
+    uint32_t frames_out;        // session frames queued, unacked holds the last ones
+    std::vector<Frame> unacked;
+
+public:
+    Connector(GUIUpdater* data_receiver)
+        : reconnect_if_no_response(0)
+        , data_receiver(data_receiver)
+        , auction(NULL)
+        , write_head(0)
+        , transport_generation(0)
+        , pool_next(0)
+        , outbox_posted(false)
+        , next_request_id(0)
+        , max_protocol(PROTOCOL_VERSION)
+        , protocol(1)
+        , max_frame_size(DefaultMaxFrameSize)
+        , spill_cmd(0)
+        , spill_request_id(0)
+        , spill_size(0)
+        , spill_left(0)
+        , resume_enabled(true)
+        , counting(false)
+        , established(false)
+        , frames_in(0)
+        , frames_in_acked(0)
+        , frames_out(0)
+    {
+        read_buffer.resize(2048);
+    }
+
+    ~Connector()
+    {
+        stop();
+    }
+
+    void start(const std::string& host_, uint16_t port_, const std::string& login_, const std::string& password_)
+    {
+        start(Endpoint(host_, port_), login_, password_);
+    }
+
+    // uri as in Endpoint::parse, e.g. unix:///run/yourcompany.sock; false if it can't be parsed.
+    bool start(const std::string& uri, const std::string& login_, const std::string& password_)
+    {
+        Endpoint endpoint_;
+        if (!Endpoint::parse(uri, 5000, endpoint_))
+            return false;
+        start(endpoint_, login_, password_);
+        return true;
+    }
+
+    void start(const Endpoint& endpoint_, const std::string& login_, const std::string& password_)
+    {
+        boost::mutex::scoped_lock lock(start_stop_mtx);
+        assert(!io_service && !ios_work && !worker_thread);
+        endpoint = endpoint_;
+        login = login_;
+        password = password_;
+        forget_session();
+
+        reconnect_if_no_response = QDateTime::currentMSecsSinceEpoch();
+
+        io_service.reset(new boost::asio::io_service);
+        ios_work.reset(new boost::asio::io_service::work(*io_service));
+        io_service->post(&Connector::name_worker_thread);
+        worker_thread.reset(new boost::thread(boost::bind(&boost::asio::io_service::run, io_service)));
+        boost::shared_ptr<boost::asio::deadline_timer> keep_alive_timer(
+                    new boost::asio::deadline_timer(*io_service)
+                    );
+        keep_alive_timer->expires_from_now(boost::posix_time::seconds(1));
+        keep_alive_timer->async_wait(boost::bind(&Connector::keep_alive, this, keep_alive_timer));
+    }
+
+    void stop()
+    {
+        reconnect_if_no_response = 0;
+
+        {
+            boost::mutex::scoped_lock lock(start_stop_mtx);
+            ios_work.reset();
+            if (io_service)
+                io_service->stop();
+            if (worker_thread) {
+                worker_thread->join();
+                worker_thread.reset();
+            }
+            if (transport) {
+                transport->close();
+                transport.reset();
+            }
+            drop_requests();
+            forget_session();
+            io_service.reset();
+        }
+        // a drain_outbox() still posted went with the io_service
+        boost::mutex::scoped_lock lock(outbox_mtx);
+        outbox.clear();
+        outbox_posted = false;
+    }
+
+    // The io_service the transport runs on, between start() and stop().
+    boost::shared_ptr<boost::asio::io_service> get_io_service() const
+    {
+        return io_service;
+    }
+
+    static void name_worker_thread()
+    {
+        TRACE_THREAD_NAME("asio worker");
+    }
+
+    void send_command_new_state(int type, bool enabled, int id_paradox, int id)
+    {
+//        std::string data = stdprintf("%d:%d:%d:%d", type, enabled, id_paradox, id);
+//        command_send( cmd_type_set_new_state, reinterpret_cast<uint8_t*>(&data[0]), data.size());
+    }
+
+
+public:
+
+    static void command_frame(uint8_t cmd, const uint8_t* cmd_data, uint32_t size, std::vector<uint8_t>& frame)
+    {
+        frame.resize(size + 7);
+        size_t it = 0;
+        uint8_t* data = &frame[0];
+        data[it++] = 13;
+        data[it++] = 37;
+        memcpy(&data[it], &size, 4); it += 4;
+        data[it++] = cmd;
+
+        assert(it + size == frame.size());
+        if (size)
+            memcpy(&frame[it], cmd_data, size);
+    }
+
+    // Version 2 header: 13, 38, uint32 payload length, cmd, uint32 request id.
+    static void command_frame(uint8_t cmd, uint32_t request_id, const uint8_t* cmd_data, uint32_t size,
+                              std::vector<uint8_t>& frame)
+    {
+        frame.resize(size + 11);
+        uint8_t* data = &frame[0];
+        data[0] = 13;
+        data[1] = 38;
+        memcpy(&data[2], &size, 4);
+        data[6] = cmd;
+        memcpy(&data[7], &request_id, 4);
+        if (size)
+            memcpy(&frame[11], cmd_data, size);
+    }
+
+    // A buffer from the pool, or a new one when every pooled one is still
+    // queued or unacknowledged.
+    boost::shared_ptr<std::vector<uint8_t> > pooled_frame()
+    {
+        boost::mutex::scoped_lock lock(pool_mtx);
+        for (std::size_t n = 0; n < frame_pool.size(); ++n) {
+            if (++pool_next >= frame_pool.size())
+                pool_next = 0;
+            const boost::shared_ptr<std::vector<uint8_t> >& frame = frame_pool[pool_next];
+            if (frame.use_count() == 1) {
+                // one large payload shouldn't stay around for good
+                if (frame->capacity() > PooledFrameCapacity)
+                    std::vector<uint8_t>().swap(*frame);
+                return frame;
+            }
+        }
+        boost::shared_ptr<std::vector<uint8_t> > frame(new std::vector<uint8_t>);
+        if (frame_pool.size() < PooledFrames)
+            frame_pool.push_back(frame);
+        return frame;
+    }
+
+    void command_send(uint8_t cmd, const uint8_t* cmd_data, uint32_t size)
+    {
+        TRACE_SCOPE("Connector::command_send");
+        ALLOC_SCOPE("net.send");
+        boost::shared_ptr<std::vector<uint8_t> > frame = pooled_frame();
+        command_frame(cmd, cmd_data, size, *frame);
+        frame_send(frame);
+    }
+
+    // Sends cmd and calls handler with the reply, on the connector thread.
+    // Returns the request id, or 0 when the server only speaks protocol 1.
+    uint32_t request(uint8_t cmd, uint8_t reply_cmd, const uint8_t* cmd_data, uint32_t size,
+                     const ReplyHandler& handler)
+    {
+        TRACE_SCOPE("Connector::request");
+        // the reply handler's entry is allocated, the frame is pooled
+        ALLOC_SCOPE("net.request");
+        boost::shared_ptr<std::vector<uint8_t> > frame = pooled_frame();
+        uint32_t id = 0;
+        {
+            boost::mutex::scoped_lock lock(requests_mtx);
+            if (protocol >= 2) {
+                do {
+                    id = ++next_request_id;
+                } while (!id || in_flight.count(id));
+                in_flight[id] = handler;
+                command_frame(cmd, id, cmd_data, size, *frame);
+            } else {
+                Pending pending = { reply_cmd, handler };
+                unnumbered.push_back(pending);
+                command_frame(cmd, cmd_data, size, *frame);
+            }
+        }
+        frame_send(frame);
+        return id;
+    }
+
+    int protocol_version() const
+    {
+        return protocol;
+    }
+
+    // Caps the version offered in cmd_type_auth; takes effect on the next connect.
+    void set_max_protocol(uint8_t version)
+    {
+        max_protocol = version;
+    }
+
+    // Whether to offer a resumable session when logging in with protocol 2;
+    // takes effect on the next login.
+    void set_resume(bool enabled)
+    {
+        resume_enabled = enabled;
+    }
+
+    // Payloads larger than size are never held in memory; they go to the
+    // spill handler as they arrive. Both take effect on the next frame and
+    // belong before start().
+    void set_max_frame_size(uint32_t size)
+    {
+        max_frame_size = size;
+    }
+
+    void set_spill_handler(const SpillHandler& handler)
+    {
+        spill_handler = handler;
+    }
+
+    bool is_connected() const
+    {
+        return reconnect_if_no_response == 0 && transport.get() != NULL;
+    }
+
+    // Asks for the whole roster, e.g. after a lost delta.
+    void request_roster()
+    {
+        request(cmd_type_get_usr_list, cmd_type_roster_snapshot, NULL, 0,
+                boost::bind(&Connector::roster_reply, this, boost::placeholders::_1, boost::placeholders::_2, boost::placeholders::_3));
+    }
+
+    // Anything but a snapshot, including the cmd_type_err of a lost
+    // connection, is passed on as SnapshotFailed so the roster stops waiting.
+    void roster_reply(uint8_t cmd, const uint8_t* data, uint32_t size)
+    {
+        RosterDelta delta;
+        if (!(cmd == cmd_type_roster_snapshot && data && RosterDelta::parse(RosterDelta::Snapshot, data, size, delta))) {
+            delta = RosterDelta();
+            delta.op = RosterDelta::SnapshotFailed;
+        }
+        data_receiver->roster_delta(delta);
+    }
+
+    void set_auction(AuctionClient* _auction)
+    {
+        auction = _auction;
+    }
+
+    // Sends a frame built ahead of time; the buffer is shared, not copied.
+    // Callable from any thread. Frames sent in a burst are queued by a
+    // single handler.
+    void frame_send(const Frame& frame)
+    {
+        ALLOC_SCOPE("net.send");
+        if (!io_service)
+            return;
+        bool post;
+        {
+            boost::mutex::scoped_lock lock(outbox_mtx);
+            outbox.push_back(frame);
+            post = !outbox_posted;
+            outbox_posted = true;
+        }
+        if (post) {
+            DrainOutbox drain = { this };
+            io_service->post(drain);
+        }
+    }
+
+    void drain_outbox()
+    {
+        ALLOC_SCOPE("net.send");
+        {
+            boost::mutex::scoped_lock lock(outbox_mtx);
+            outbox_drained.swap(outbox);
+            outbox_posted = false;
+        }
+        for (std::size_t i = 0; i < outbox_drained.size(); ++i)
+            queue_frame(outbox_drained[i]);
+        outbox_drained.clear();
+    }
+
+    void queue_frame(const Frame& frame)
+    {
+        if (counting) {
+            unacked.push_back(frame);
+            ++frames_out;
+            // a server that stopped acknowledging can't be resumed with
+            if (unacked.size() > MaxUnacked)
+                forget_session();
+            // held until cmd_type_resume_ok says what the server has
+            else if (!established && !resume_token.empty())
+                return;
+        }
+        write_frame(frame);
+    }
+
+    void write_frame(const Frame& frame)
+    {
+        write_queue.push_back(frame);
+        if (write_queue.size() - write_head == 1)
+            write_next();
+    }
+
+    void clear_write_queue()
+    {
+        write_queue.clear();
+        write_head = 0;
+    }
+
+    // Login, resume and ack frames, which are not part of the session.
+    void control_send(uint8_t cmd, const uint8_t* cmd_data, uint32_t size)
+    {
+        boost::shared_ptr<std::vector<uint8_t> > frame = pooled_frame();
+        command_frame(cmd, cmd_data, size, *frame);
+        write_frame(frame);
+    }
+
+    void write_next()
+    {
+        TRACE_SCOPE("Connector::write_next");
+        ALLOC_SCOPE("net.write");
+        if (!transport) {
+            clear_write_queue();
+            return;
+        }
+        const Frame& frame = write_queue[write_head];
+        WriteDone done = { this, transport_generation };
+        transport->async_write(&(*frame)[0], frame->size(), done);
+    }
+
+    void on_send_over(uint32_t generation, const boost::system::error_code& error)
+    {
+        ALLOC_SCOPE("net.write");
+        // a write aborted by a reconnect belongs to the old transport's queue
+        if (generation != transport_generation)
+            return;
+        if (error) {
+//            qWarning("Paradox: error data sending to %s\n", endpoint.to_string().c_str());
+            clear_write_queue();
+            connection_lost(true);
+            return;
+        }
+        write_queue[write_head++].reset();
+        if (write_head == write_queue.size()) {
+            clear_write_queue();
+            return;
+        }
+        if (write_head >= write_queue.size() / 2) {
+            write_queue.erase(write_queue.begin(), write_queue.begin() + write_head);
+            write_head = 0;
+        }
+        write_next();
+    }
+
+    // Hands a reply to the request waiting for it; false for unsolicited frames.
+    bool dispatch_reply(uint8_t cmd, uint32_t request_id, const uint8_t* data, uint32_t size)
+    {
+        ReplyHandler handler;
+        {
+            boost::mutex::scoped_lock lock(requests_mtx);
+            if (request_id) {
+                std::map<uint32_t, ReplyHandler>::iterator it = in_flight.find(request_id);
+                if (it == in_flight.end())
+                    return false;
+                handler.swap(it->second);
+                in_flight.erase(it);
+            } else {
+                std::deque<Pending>::iterator it = unnumbered.begin();
+                while (it != unnumbered.end() && it->reply_cmd != cmd)
+                    ++it;
+                if (it == unnumbered.end())
+                    return false;
+                handler.swap(it->handler);
+                unnumbered.erase(it);
+            }
+        }
+        if (handler)
+            handler(cmd, data, size);
+        return true;
+    }
+
+    // Completes every waiting request with cmd_type_err and a NULL payload,
+    // which no reply from the server has.
+    void drop_requests()
+    {
+        std::map<uint32_t, ReplyHandler> numbered;
+        std::deque<Pending> waiting;
+        {
+            boost::mutex::scoped_lock lock(requests_mtx);
+            numbered.swap(in_flight);
+            waiting.swap(unnumbered);
+        }
+        for (std::map<uint32_t, ReplyHandler>::iterator it = numbered.begin(); it != numbered.end(); ++it)
+            if (it->second)
+                it->second(cmd_type_err, NULL, 0);
+        for (std::deque<Pending>::iterator it = waiting.begin(); it != waiting.end(); ++it)
+            if (it->handler)
+                it->handler(cmd_type_err, NULL, 0);
+    }
+
+    void read_data()
+    {
+        ReadDone done = { this, transport_generation };
+        transport->async_read_some(&read_buffer[0], read_buffer.size(), done);
+    }
+
+    // Starts streaming a frame over max_frame_size; its reply handler, if
+    // any, runs once the last byte is through.
+    void spill_begin(uint8_t cmd, uint32_t request_id, uint32_t size)
+    {
+        spill_cmd = cmd;
+        spill_request_id = request_id;
+        spill_size = size;
+        spill_left = size;
+        if (spill_handler)
+            spill = spill_handler(cmd, request_id, size);
+        if (!spill)
+            qWarning("Paradox: skipping a %u byte frame 0x%02x\n", size, cmd);
+    }
+
+    void spill_chunk(const uint8_t* data, size_t size)
+    {
+        spill_left -= size;
+        if (spill && size)
+            spill->write(data, size);
+        if (spill_left)
+            return;
+        boost::shared_ptr<FrameSink> sink;
+        sink.swap(spill);
+        if (sink)
+            sink->finish();
+        sink.reset();
+        dispatch_reply(spill_cmd, spill_request_id, NULL, spill_size);
+        frame_received(spill_cmd);
+    }
+
+    void forget_session()
+    {
+        resume_token.clear();
+        counting = false;
+        frames_in = 0;
+        frames_in_acked = 0;
+        frames_out = 0;
+        unacked.clear();
+    }
+
+    // Counts a session frame from the server, acknowledging them in batches.
+    void frame_received(uint8_t cmd)
+    {
+        if (!counting || !established || cmd == cmd_type_auth_ok || cmd == cmd_type_ack
+                || cmd == cmd_type_resume_ok)
+            return;
+        if (++frames_in - frames_in_acked >= AckEvery)
+            send_ack();
+    }
+
+    void send_ack()
+    {
+        frames_in_acked = frames_in;
+        wire::Buffer<msg::Ack::max_size> payload;
+        msg::Ack::encode(payload, frames_in);
+        control_send(msg::Ack::cmd, payload.data(), payload.size());
+    }
+
+    // Drops what the server says it has received from unacked; false if
+    // that is not a count the server could have.
+    bool acknowledged(uint32_t received)
+    {
+        uint32_t oldest = frames_out - static_cast<uint32_t>(unacked.size());
+        if (received - oldest > unacked.size())
+            return false;
+        unacked.erase(unacked.begin(), unacked.begin() + (received - oldest));
+        return true;
+    }
+
+    void send_login()
+    {
+        std::string credentials = base64_encode(login + "@" + password);
+        std::vector<wire::Text> options;
+        forget_session();
+        if (max_protocol >= 2) {
+            options.push_back("proto=2");
+            if (resume_enabled) {
+                options.push_back("resume");
+                counting = true;
+            }
+        }
+        ArenaBytes payload((ArenaAllocator<uint8_t>(frame_arena)));
+        msg::Auth::encode(payload, credentials, options);
+        control_send(msg::Auth::cmd, &payload[0], payload.size());
+    }
+
+    void send_resume()
+    {
+        ArenaBytes payload((ArenaAllocator<uint8_t>(frame_arena)));
+        msg::Resume::encode(payload, frames_in, resume_token);
+        frames_in_acked = frames_in;
+        control_send(msg::Resume::cmd, &payload[0], payload.size());
+    }
+
+    // The server no longer knows the session: log in afresh on the same
+    // connection. Requests waiting for a reply won't get one.
+    void restart_session()
+    {
+        protocol = 1;
+        drop_requests();
+        send_login();
+    }
+
+    // A session that was up reconnects at once, resuming if it can; after
+    // a failed attempt keep_alive takes over.
+    void connection_lost(bool force)
+    {
+        if (established) {
+            reconnect_if_no_response = QDateTime::currentMSecsSinceEpoch() + 10000000ULL;
+            connect();
+            return;
+        }
+        reconnect_if_no_response = QDateTime::currentMSecsSinceEpoch();
+        data_receiver->system_state_update(STATE_DISCONNECTED, force);
+    }
+
+    bool buffer_parse(uint8_t* packet, size_t len)
+    {
+        TRACE_SCOPE("Connector::buffer_parse");
+        ALLOC_SCOPE("net.parse");
+        if (spill_left) {
+            size_t n = std::min<size_t>(len, spill_left);
+            spill_chunk(packet, n);
+            packet += n;
+            len -= n;
+        }
+        parse_buffer.insert(parse_buffer.end(), packet, &packet[len]);
+        while (!parse_buffer.empty()) {
+            uint8_t* data = &parse_buffer[0];
+            size_t size = parse_buffer.size();
+            if (size < 7)
+                return true;
+            if (data[0] != 13 || (data[1] != 37 && data[1] != 38)) {
+//                qWarning("Paradox: wrong data format\n");
+                return false;
+            }
+            // version 2 frames carry a request id after the command
+            size_t header = data[1] == 38 ? 11 : 7;
+            if (size < header)
+                return true;
+
+            uint32_t data_len;
+            memcpy(&data_len, &data[2], 4);
+            uint8_t cmd = data[6];
+            uint32_t request_id = 0;
+            if (header == 11)
+                memcpy(&request_id, &data[7], 4);
+
+            // the length isn't trusted with memory: what would go over the
+            // limit is passed on as it arrives
+            if (data_len > max_frame_size) {
+                size_t n = std::min<size_t>(size - header, data_len);
+                spill_begin(cmd, request_id, data_len);
+                spill_chunk(&data[header], n);
+                parse_buffer.erase(parse_buffer.begin(), parse_buffer.begin() + header + n);
+                continue;
+            }
+            if (data_len + header > size)
+                return true;
+
+            const uint8_t* payload = &data[header];
+            frame_arena.reset();
+
+            if (dispatch_reply(cmd, request_id, payload, data_len)) {
+                parse_buffer.erase(parse_buffer.begin(), parse_buffer.begin() + header + data_len);
+                frame_received(cmd);
+                continue;
+            }
+
+            switch (cmd) {
+            case cmd_type_auth_ok: {
+//                std::string usr_list(reinterpret_cast<const char*>(payload), data_len);
+                ArenaString accepted(reinterpret_cast<const char*>(payload), data_len,
+                                     ArenaAllocator<char>(frame_arena));
+                protocol = max_protocol >= 2 && accepted.find("proto=2") != ArenaString::npos ? 2 : 1;
+                ArenaString::size_type token = accepted.find("resume=");
+                if (counting && token != ArenaString::npos) {
+                    token += 7;
+                    ArenaString::size_type end = accepted.find('\n', token);
+                    resume_token.assign(accepted.data() + token, (end == ArenaString::npos ? accepted.size() : end) - token);
+                } else {
+                    forget_session();
+                }
+                established = true;
+                data_receiver->system_state_update(STATE_CONNECTED, true);
+//                data_receiver->show_usr_list(usr_list);
+                reconnect_if_no_response = 0;
+////                command_send(cmd_type_get_tree, 0, 0);
+                break;
+////            case cmd_type_tree:
+////                tree_reply_parse(payload, data_len);
+////                break;
+////            case cmd_type_state_upd: {
+////                uint8_t level;
+////                int sz = 0;
+////                boost::shared_ptr<ParadoxElement> element = paradox_element_deserialize(
+////                    &data[7],
+////                    data_len,
+////                    level,
+////                    sz
+////                    );
+////                if (element)
+////                    data_receiver->object_changed(level, element);
+////                break; }
+            }
+            case cmd_type_get_usr_list:
+            {
+                 std::string usr_list(reinterpret_cast<const char*>(payload), data_len);
+                 data_receiver->show_usr_list(usr_list);
+                break;
+            }
+            case cmd_type_roster_join:
+            case cmd_type_roster_leave:
+            case cmd_type_roster_update:
+            case cmd_type_roster_snapshot:
+            {
+                static const uint8_t ops[] = { RosterDelta::Join, RosterDelta::Leave,
+                                               RosterDelta::Update, RosterDelta::Snapshot };
+                RosterDelta delta;
+                if (RosterDelta::parse(ops[cmd - cmd_type_roster_join], payload, data_len, delta))
+                    data_receiver->roster_delta(delta);
+                break;
+            }
+            case cmd_type_formed_ok:
+            {
+                 data_receiver->form_closed();
+                break;
+            }
+
+            case cmd_type_get_contract_ok:
+            {
+                data_receiver->update_contract_info(reinterpret_cast<const char*>(payload), data_len);
+                break;
+
+            }
+            case cmd_type_finish_market:
+            {
+                data_receiver->update_contract_info(reinterpret_cast<const char*>(payload), data_len);
+                break;
+            }
+            case cmd_type_auction:
+                if (auction)
+                    auction->on_auction(payload, data_len);
+                break;
+            case cmd_type_amount:
+                if (auction)
+                    auction->on_amount(payload, data_len);
+                break;
+            case cmd_type_auction_win:
+            case cmd_type_auction_lose:
+                if (auction)
+                    auction->on_result(cmd == cmd_type_auction_win, payload, data_len);
+                break;
+            case cmd_type_err: {
+                // an unknown or expired resume token
+                if (!established && !resume_token.empty()) {
+                    restart_session();
+                    break;
+                }
+                static const char unauthorized[] = "Unauthorized";
+                if (data_len == sizeof(unauthorized) - 1 && !memcmp(payload, unauthorized, data_len)) {
+                    data_receiver->system_state_update(
+                        STATE_INVALID_LOGIN,
+                        true
+                        );
+
+                    parse_buffer.erase(parse_buffer.begin(), parse_buffer.begin() + header + data_len);
+                    reconnect_if_no_response = 0;
+                    return false;
+                }
+                break;
+            }
+////            case cmd_type_send_troubles_info:
+////            {
+////                std::string event(reinterpret_cast<const char*>(payload), data_len);
+////                data_receiver->send_trouble_event(event);
+////                break;
+//            }
+            case cmd_type_resume_ok: {
+                uint32_t received;
+                if (!msg::ResumeOk::decode(payload, data_len, received) || !acknowledged(received)) {
+                    restart_session();
+                    break;
+                }
+                established = true;
+                for (std::size_t i = 0; i < unacked.size(); ++i)
+                    write_frame(unacked[i]);
+                data_receiver->system_state_update(STATE_CONNECTED, true);
+                reconnect_if_no_response = 0;
+                break;
+            }
+            case cmd_type_ack: {
+                uint32_t received;
+                if (msg::Ack::decode(payload, data_len, received))
+                    acknowledged(received);
+                break;
+            }
+            default:
+////                qWarning("Paradox: unsupported cmd 0x%02x received\n", cmd);
+                break;
+            }
+            parse_buffer.erase(parse_buffer.begin(), parse_buffer.begin() + header + data_len);
+            frame_received(cmd);
+        }
+        return true;
+    }
+
+    void handle_read(uint32_t generation, const boost::system::error_code &error, size_t bytes_transfered)
+    {
+        TRACE_SCOPE("Connector::handle_read");
+        ALLOC_SCOPE("net.read");
+        // a read aborted by a reconnect says nothing about the new transport
+        if (generation != transport_generation)
+            return;
+        if (error || !bytes_transfered || !buffer_parse(&read_buffer[0], bytes_transfered)) {
+//            qWarning("Paradox: error read data (size %lu) from %s\n", bytes_transfered, endpoint.to_string().c_str());
+            connection_lost(false);
+            return;
+        };
+        read_data();
+    }
+
+    void connect_cb(const boost::shared_ptr<Transport>& connected, const boost::system::error_code& error)
+    {
+        TRACE_SCOPE("Connector::connect_cb");
+        if (connected != transport)
+            return;
+        if (error) {
+//            qWarning("Paradox: can't connect to %s\n", endpoint.to_string().c_str());
+            reconnect_if_no_response = QDateTime::currentMSecsSinceEpoch();
+            data_receiver->system_state_update(STATE_DISCONNECTED, true);
+            return;
+        }
+        //data_receiver->system_state_update(STATE_CONNECTED);
+        frame_arena.reset();
+        if (resume_token.empty())
+            send_login();
+        else
+            send_resume();
+        read_data();
+    }
+
+    void connect()
+    {
+        assert(io_service);
+        parse_buffer.clear();
+        spill.reset();
+        spill_left = 0;
+        established = false;
+        // a session being resumed keeps its requests and protocol
+        if (resume_token.empty()) {
+            protocol = 1;
+            drop_requests();
+            data_receiver->system_state_update(STATE_DISCONNECTED, false);
+        }
+        if (transport)
+            transport->close();
+        clear_write_queue();
+        ++transport_generation;
+        transport = Transport::create(*io_service, endpoint);
+        if (!transport) {
+            qWarning("Paradox: %s is not supported here\n", endpoint.to_string().c_str());
+            reconnect_if_no_response = QDateTime::currentMSecsSinceEpoch();
+            data_receiver->system_state_update(STATE_DISCONNECTED, true);
+            return;
+        }
+        transport->async_connect(boost::bind(&Connector::connect_cb,
+            this,
+            transport,
+            boost::asio::placeholders::error));
+        reconnect_if_no_response = QDateTime::currentMSecsSinceEpoch() + 10000000ULL;
+
+    }
+
+    void keep_alive(boost::shared_ptr<boost::asio::deadline_timer>& keep_alive_timer)
+    {
+        keep_alive_timer->expires_from_now(boost::posix_time::seconds(reconnect_if_no_response ? 10 : 1));
+        if (reconnect_if_no_response && reconnect_if_no_response < QDateTime::currentMSecsSinceEpoch()) {
+//            qWarning(
+//                "Paradox: create new connection with %s %s\n",
+//                endpoint.to_string().c_str(),
+//                reconnect_if_no_response ? "" : "because of timeout"
+//                );
+            reconnect_if_no_response = QDateTime::currentMSecsSinceEpoch() + 10000000ULL;
+            connect();
+        } else if (established && counting && frames_in != frames_in_acked) {
+            send_ack();
+        }
+        keep_alive_timer->async_wait(boost::bind(&Connector::keep_alive, this, keep_alive_timer));
+    }
+};
+
+extern Connector *connector;
+
+#endif // CONNECTOR_H
@@ -0,0 +1,32 @@
+# Client sources shared by the application and the benchmark suite: the
+# headless core and the window on top of it.
+
+include($$PWD/headless.pri)
+
+SOURCES += $$PWD/mainwindow.cpp \
+    $$PWD/stallwatchdog.cpp \
+    $$PWD/boardscene.cpp \
+    $$PWD/marketview.cpp \
+    $$PWD/autosave.cpp \
+    $$PWD/turnhistory.cpp \
+    $$PWD/timeseries.cpp \
+    $$PWD/economychart.cpp \
+    $$PWD/rostermodel.cpp \
+    $$PWD/auctionpanel.cpp
+
+HEADERS  += $$PWD/mainwindow.h \
+    $$PWD/stallwatchdog.h \
+    $$PWD/boardscene.h \
+    $$PWD/marketview.h \
+    $$PWD/autosave.h \
+    $$PWD/persistent.h \
+    $$PWD/turnhistory.h \
+    $$PWD/timeseries.h \
+    $$PWD/economychart.h \
+    $$PWD/rostermodel.h \
+    $$PWD/auctionpanel.h \
+    $$PWD/reconcile.h
+
+FORMS    += $$PWD/mainwindow.ui \
+    $$PWD/dialog.ui \
+    $$PWD/formed.ui
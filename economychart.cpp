@@ -0,0 +1,124 @@
+#include "economychart.h"
+#include "tracer.h"
+
+#include <QPainter>
+#include <algorithm>
+
+namespace {
+
+const QColor colors[TimeSeries::ColumnCount] = {
+    QColor(0, 128, 0), QColor(128, 64, 0), QColor(0, 0, 200),
+    QColor(200, 0, 200), QColor(0, 160, 160), QColor(200, 0, 0)
+};
+
+}
+
+EconomyChart::EconomyChart(const TimeSeries *_series, QWidget *parent) :
+    QWidget(parent),
+    series(_series),
+    turns_offset(0),
+    cached_rows(0),
+    cached_truncations(0),
+    cached_threshold(0)
+{
+    setWindowTitle(tr("Economy"));
+    resize(640, 360);
+}
+
+void EconomyChart::refresh()
+{
+    if (isVisible())
+        update();
+}
+
+void EconomyChart::resizeEvent(QResizeEvent *)
+{
+    cached_plot = QRectF();
+}
+
+void EconomyChart::rebuild(const QRectF &plot)
+{
+    TRACE_SCOPE("EconomyChart::rebuild");
+    std::vector<std::size_t> picked;
+    std::size_t threshold = static_cast<std::size_t>(plot.width());
+    // a truncated series may have other rows where the decoded ones were
+    bool rewound = cached_truncations != series->truncations();
+    if (rewound) {
+        turns.clear();
+        turns_offset = 0;
+    }
+    series->turn_column().decode_tail(turns, turns_offset);
+    const std::vector<int64_t>& x = turns;
+    int64_t first = x.empty() ? 0 : x.front();
+    int64_t span = x.empty() ? 1 : std::max<int64_t>(x.back() - first, 1);
+
+    for (int c = 0; c < TimeSeries::ColumnCount; ++c) {
+        Line& line = lines[c];
+        if (rewound) {
+            line.values.clear();
+            line.offset = 0;
+        }
+        std::size_t decoded = line.values.size();
+        series->column(c).decode_tail(line.values, line.offset);
+        const std::vector<int64_t>& y = line.values;
+        if (!decoded)
+            line.min = line.max = y.empty() ? 0 : y.front();
+        for (std::size_t i = decoded; i < y.size(); ++i) {
+            line.min = std::min(line.min, y[i]);
+            line.max = std::max(line.max, y[i]);
+        }
+        line.points.clear();
+        line.last = series->column(c).last();
+        double range = double(std::max<int64_t>(line.max - line.min, 1));
+
+        if (rewound || threshold != cached_threshold)
+            line.sampler.reset(threshold);
+        line.sampler.update(x, y, picked);
+        line.points.reserve(static_cast<int>(picked.size()));
+        for (std::size_t i = 0; i < picked.size(); ++i) {
+            double px = plot.left() + plot.width() * double(x[picked[i]] - first) / span;
+            double py = plot.bottom() - plot.height() * double(y[picked[i]] - line.min) / range;
+            line.points.append(QPointF(px, py));
+        }
+    }
+    cached_rows = series->size();
+    cached_truncations = series->truncations();
+    cached_threshold = threshold;
+    cached_plot = plot;
+}
+
+void EconomyChart::paintEvent(QPaintEvent *)
+{
+    TRACE_SCOPE("EconomyChart::paintEvent");
+    QPainter p(this);
+    p.fillRect(rect(), Qt::white);
+    QFontMetrics metrics(font());
+    int legend_height = metrics.height() * ((TimeSeries::ColumnCount + 1) / 2) + 8;
+    QRectF plot = QRectF(rect()).adjusted(8, 8, -8, -8 - legend_height);
+    if (plot.width() < 4 || plot.height() < 4)
+        return;
+    if (cached_rows != series->size() || cached_truncations != series->truncations() || cached_plot != plot)
+        rebuild(plot);
+
+    p.setPen(Qt::gray);
+    p.drawRect(plot);
+    p.setRenderHint(QPainter::Antialiasing);
+    for (int c = 0; c < TimeSeries::ColumnCount; ++c) {
+        p.setPen(QPen(colors[c], 1.5));
+        p.drawPolyline(lines[c].points);
+    }
+
+    // each line is scaled to its own range, so the legend carries the numbers
+    p.setRenderHint(QPainter::Antialiasing, false);
+    qreal column_width = plot.width() / 2;
+    for (int c = 0; c < TimeSeries::ColumnCount; ++c) {
+        QPointF at(plot.left() + (c % 2) * column_width,
+                   plot.bottom() + 4 + (c / 2 + 1) * metrics.height());
+        p.setPen(colors[c]);
+        p.drawText(at, tr("%1: %2 (%3..%4)").arg(TimeSeries::column_name(c))
+                   .arg(lines[c].last).arg(lines[c].min).arg(lines[c].max));
+    }
+    p.setPen(Qt::black);
+    p.drawText(QPointF(plot.right() - metrics.width(tr("%1 turns").arg(series->size())), plot.top() + metrics.ascent()),
+               tr("%1 turns").arg(series->size()));
+}
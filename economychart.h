@@ -0,0 +1,53 @@
+#ifndef ECONOMYCHART_H
+#define ECONOMYCHART_H
+
+#include "timeseries.h"
+#include <QPolygonF>
+#include <QWidget>
+
+// Chart of the session economics. Every column is downsampled with LTTB to
+// about one point per horizontal pixel and the polylines are cached until
+// the series grows or the widget is resized, so painting costs the same
+// for ten turns and for a hundred thousand. When the series grows only the
+// new rows are decoded and only the last buckets are picked again.
+class EconomyChart : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit EconomyChart(const TimeSeries* _series, QWidget *parent = 0);
+
+public slots:
+    // Call after appending to the series.
+    void refresh();
+
+protected:
+    void paintEvent(QPaintEvent *);
+    void resizeEvent(QResizeEvent *);
+
+private:
+    struct Line
+    {
+        Line() : min(0), max(0), last(0), offset(0) { }
+
+        QPolygonF points;
+        int64_t min;
+        int64_t max;
+        int64_t last;
+        std::vector<int64_t> values;    // decoded so far
+        std::size_t offset;             // where values ends in the column
+        LttbSampler sampler;
+    };
+
+    void rebuild(const QRectF& plot);
+
+    const TimeSeries* series;
+    Line lines[TimeSeries::ColumnCount];
+    std::vector<int64_t> turns;
+    std::size_t turns_offset;
+    std::size_t cached_rows;
+    std::size_t cached_truncations;
+    std::size_t cached_threshold;
+    QRectF cached_plot;
+};
+
+#endif // ECONOMYCHART_H
@@ -0,0 +1,259 @@
+#include "gamestate.h"
+#include "varint.h"
+
+#include <cstring>
+#include <utility>
+
+GameState::GameState() :
+    turn(0),
+    money(0),
+    materials(0),
+    credit_max_time(0),
+    count_year(0)
+{
+    memset(debit, 0, sizeof(debit));
+}
+
+namespace snapshot {
+
+namespace {
+
+const uint8_t magic[4] = { 'Y', 'C', 'G', 'S' };
+
+uint32_t fnv1a(const uint8_t* data, std::size_t size)
+{
+    uint32_t hash = 2166136261u;
+    for (std::size_t i = 0; i < size; ++i) {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+class Writer
+{
+    std::vector<uint8_t>& out;
+public:
+    explicit Writer(std::vector<uint8_t>& _out) : out(_out) { }
+
+    void u(uint64_t value)
+    {
+        put_varint(out, value);
+    }
+
+    void s(int64_t value)
+    {
+        put_svarint(out, value);
+    }
+
+    void str(const std::string& value)
+    {
+        u(value.size());
+        out.insert(out.end(), value.begin(), value.end());
+    }
+
+    void bits(const std::vector<uint8_t>& flags)
+    {
+        u(flags.size());
+        std::size_t first = out.size();
+        out.resize(first + (flags.size() + 7) / 8, 0);
+        for (std::size_t i = 0; i < flags.size(); ++i) {
+            if (flags[i])
+                out[first + i / 8] |= static_cast<uint8_t>(1 << (i % 8));
+        }
+    }
+};
+
+class Reader
+{
+    const uint8_t* data;
+    const uint8_t* end;
+public:
+    bool ok;
+
+    Reader(const uint8_t* _data, std::size_t size) : data(_data), end(_data + size), ok(true) { }
+
+    uint64_t u()
+    {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (data == end)
+                break;
+            uint8_t byte = *data++;
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                return value;
+        }
+        ok = false;
+        return 0;
+    }
+
+    int64_t s()
+    {
+        return zigzag_decode(u());
+    }
+
+    // Element counts are bounded by the bytes left so that a corrupt
+    // count cannot make the decoder allocate gigabytes: every element takes
+    // at least min_bytes_each (1 or more) of them, a flag an eighth of one.
+    std::size_t count(std::size_t min_bytes_each)
+    {
+        uint64_t value = u();
+        if (value > static_cast<uint64_t>(end - data) / min_bytes_each) {
+            ok = false;
+            return 0;
+        }
+        return static_cast<std::size_t>(value);
+    }
+
+    std::size_t bit_count()
+    {
+        uint64_t value = u();
+        if (value > static_cast<uint64_t>(end - data) * 8) {
+            ok = false;
+            return 0;
+        }
+        return static_cast<std::size_t>(value);
+    }
+
+    std::string str()
+    {
+        std::size_t size = count(1);
+        if (!ok || size > static_cast<std::size_t>(end - data)) {
+            ok = false;
+            return std::string();
+        }
+        std::string value(reinterpret_cast<const char*>(data), size);
+        data += size;
+        return value;
+    }
+
+    void bits(std::vector<uint8_t>& flags)
+    {
+        std::size_t size = bit_count();
+        if (!ok)
+            return;
+        std::size_t packed = (size + 7) / 8;
+        flags.resize(size);
+        for (std::size_t i = 0; i < flags.size(); ++i)
+            flags[i] = (data[i / 8] >> (i % 8)) & 1;
+        data += packed;
+    }
+};
+
+}
+
+void encode(const GameState& state, std::vector<uint8_t>& out)
+{
+    out.assign(magic, magic + 4);
+    Writer w(out);
+    w.u(FormatVersion);
+    w.u(state.turn);
+    w.s(state.money);
+    w.s(state.materials);
+    w.s(state.credit_max_time);
+    w.s(state.count_year);
+    for (int i = 0; i < 4; ++i)
+        w.s(state.debit[i]);
+    w.bits(state.products);
+
+    w.u(state.credit_lines.size());
+    for (std::size_t i = 0; i < state.credit_lines.size(); ++i) {
+        w.s(state.credit_lines[i].time);
+        w.s(state.credit_lines[i].money);
+    }
+
+    w.u(state.lines.size());
+    for (std::size_t i = 0; i < state.lines.size(); ++i) {
+        const GameState::Line& line = state.lines[i];
+        w.u(line.product_type | (line.line_type << 1) | (line.loaded << 2));
+        w.bits(line.have_materials);
+    }
+
+    w.u(state.markets.size());
+    for (std::size_t i = 0; i < state.markets.size(); ++i) {
+        w.str(state.markets[i].name);
+        w.s(state.markets[i].price);
+        w.s(state.markets[i].time);
+        w.u(state.markets[i].selected);
+    }
+
+    w.u(state.contracts.size());
+    for (std::size_t i = 0; i < state.contracts.size(); ++i) {
+        w.s(state.contracts[i].a);
+        w.s(state.contracts[i].price_a);
+        w.s(state.contracts[i].b);
+        w.s(state.contracts[i].price_b);
+        w.s(state.contracts[i].market);
+    }
+
+    uint32_t checksum = fnv1a(&out[0], out.size());
+    for (int i = 0; i < 4; ++i)
+        out.push_back(static_cast<uint8_t>(checksum >> (8 * i)));
+}
+
+bool decode(const uint8_t* data, std::size_t size, GameState& state)
+{
+    if (size < 9 || memcmp(data, magic, 4))
+        return false;
+    uint32_t checksum = 0;
+    for (int i = 0; i < 4; ++i)
+        checksum |= static_cast<uint32_t>(data[size - 4 + i]) << (8 * i);
+    if (checksum != fnv1a(data, size - 4))
+        return false;
+
+    Reader r(data + 4, size - 8);
+    uint64_t version = r.u();
+    if (version < 1 || version > FormatVersion)
+        return false;
+
+    GameState decoded;
+    decoded.turn = static_cast<uint32_t>(r.u());
+    decoded.money = static_cast<int32_t>(r.s());
+    decoded.materials = static_cast<int32_t>(r.s());
+    decoded.credit_max_time = static_cast<int32_t>(r.s());
+    decoded.count_year = static_cast<int32_t>(r.s());
+    for (int i = 0; i < 4; ++i)
+        decoded.debit[i] = static_cast<int32_t>(r.s());
+    r.bits(decoded.products);
+
+    decoded.credit_lines.resize(r.count(2));
+    for (std::size_t i = 0; r.ok && i < decoded.credit_lines.size(); ++i) {
+        decoded.credit_lines[i].time = static_cast<int32_t>(r.s());
+        decoded.credit_lines[i].money = static_cast<int32_t>(r.s());
+    }
+
+    decoded.lines.resize(r.count(2));
+    for (std::size_t i = 0; r.ok && i < decoded.lines.size(); ++i) {
+        uint64_t flags = r.u();
+        decoded.lines[i].product_type = flags & 1;
+        decoded.lines[i].line_type = (flags >> 1) & 1;
+        decoded.lines[i].loaded = (flags >> 2) & 1;
+        r.bits(decoded.lines[i].have_materials);
+    }
+
+    decoded.markets.resize(r.count(4));
+    for (std::size_t i = 0; r.ok && i < decoded.markets.size(); ++i) {
+        decoded.markets[i].name = r.str();
+        decoded.markets[i].price = static_cast<int32_t>(r.s());
+        decoded.markets[i].time = static_cast<int32_t>(r.s());
+        decoded.markets[i].selected = r.u() != 0;
+    }
+
+    decoded.contracts.resize(r.count(version < 2 ? 4 : 5));
+    for (std::size_t i = 0; r.ok && i < decoded.contracts.size(); ++i) {
+        decoded.contracts[i].a = static_cast<int32_t>(r.s());
+        decoded.contracts[i].price_a = static_cast<int32_t>(r.s());
+        decoded.contracts[i].b = static_cast<int32_t>(r.s());
+        decoded.contracts[i].price_b = static_cast<int32_t>(r.s());
+        decoded.contracts[i].market = version < 2 ? -1 : static_cast<int32_t>(r.s());
+        decoded.contracts[i].offer = 0;
+    }
+
+    if (!r.ok)
+        return false;
+    std::swap(state, decoded);
+    return true;
+}
+
+}
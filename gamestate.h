@@ -0,0 +1,100 @@
+#ifndef GAMESTATE_H
+#define GAMESTATE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Plain copy of everything a game session consists of. MainWindow captures
+// one after every turn; it is immutable once captured, so it can be shared
+// with other threads (autosave) without locking.
+struct GameState
+{
+    enum { ProductA = 0, ProductB = 1 };
+
+    struct CreditLine
+    {
+        int32_t time;
+        int32_t money;
+    };
+
+    struct Line
+    {
+        uint8_t product_type;
+        uint8_t line_type;
+        bool loaded;                        // materials loaded this turn
+        std::vector<uint8_t> have_materials;
+    };
+
+    struct Market
+    {
+        std::string name;
+        int32_t price;
+        int32_t time;
+        bool selected;
+    };
+
+    struct Contract
+    {
+        int32_t a;
+        int32_t price_a;
+        int32_t b;
+        int32_t price_b;
+        int32_t market;     // index into MainWindow's markets, -1 when unknown
+        uint32_t offer;     // accepted offer the server rules on, 0 if none
+    };
+
+    uint32_t turn;
+    int32_t money;
+    int32_t materials;
+    int32_t credit_max_time;
+    int32_t count_year;
+    int32_t debit[4];
+    std::vector<uint8_t> products;
+    std::vector<CreditLine> credit_lines;
+    std::vector<Line> lines;
+    std::vector<Market> markets;
+    std::vector<Contract> contracts;
+
+    GameState();
+};
+
+inline bool operator==(const GameState::CreditLine& a, const GameState::CreditLine& b)
+{
+    return a.time == b.time && a.money == b.money;
+}
+
+inline bool operator==(const GameState::Line& a, const GameState::Line& b)
+{
+    return a.product_type == b.product_type && a.line_type == b.line_type
+            && a.loaded == b.loaded && a.have_materials == b.have_materials;
+}
+
+inline bool operator==(const GameState::Market& a, const GameState::Market& b)
+{
+    return a.name == b.name && a.price == b.price && a.time == b.time && a.selected == b.selected;
+}
+
+inline bool operator==(const GameState::Contract& a, const GameState::Contract& b)
+{
+    return a.a == b.a && a.price_a == b.price_a && a.b == b.b && a.price_b == b.price_b
+            && a.market == b.market && a.offer == b.offer;
+}
+
+// Versioned binary snapshot: "YCGS", format version, then every field as
+// LEB128 varints (zigzag for signed values) with product and material
+// flags bit-packed, closed by an FNV-1a checksum of the preceding bytes.
+// Offer numbers only mean something to the session that made them and are
+// not saved. Version 2 added the contracts' markets; version 1 snapshots
+// still decode, with markets of -1.
+namespace snapshot {
+
+enum { FormatVersion = 2 };
+
+void encode(const GameState& state, std::vector<uint8_t>& out);
+
+bool decode(const uint8_t* data, std::size_t size, GameState& state);
+
+}
+
+#endif // GAMESTATE_H
@@ -0,0 +1,78 @@
+#include "guiupdater.h"
+#include "tracer.h"
+
+#include <QThread>
+
+void GUIUpdater::system_state_update(StateType new_state, bool force)
+{
+    if (state == new_state)
+        return;
+    if (!force && state == STATE_INVALID_LOGIN && new_state == STATE_DISCONNECTED)
+        return;
+    state = new_state;
+}
+
+void GUIUpdater::update_contract_info(const char* data, std::size_t size)
+{
+    contract_info.assign(data, size);
+}
+
+void GUIUpdater::show_usr_list(const std::string &_usr_list)
+{
+    RosterDelta delta;
+    delta.op = RosterDelta::Snapshot;
+    delta.has_seq = false;
+    delta.seq = 0;
+    delta.name = _usr_list;
+    roster_delta(delta);
+}
+
+void GUIUpdater::roster_delta(const RosterDelta &delta)
+{
+    boost::mutex::scoped_lock lock(roster_mtx);
+    // a snapshot supersedes everything queued before it
+    if (delta.op == RosterDelta::Snapshot)
+        roster_deltas.clear();
+    roster_deltas.push_back(delta);
+}
+
+void GUIUpdater::take_roster_deltas(std::vector<RosterDelta> &deltas)
+{
+    boost::mutex::scoped_lock lock(roster_mtx);
+    deltas.swap(roster_deltas);
+}
+
+void GUIUpdater::form_closed()
+{
+    emit requestFormClosed();
+}
+
+void GUIUpdater::newLabel() {
+    TRACE_THREAD_NAME("GUIUpdater");
+    while(1)
+    {
+        StateType current = state;
+        state = STATE_IDLE;
+        bool label = current == STATE_DISCONNECTED ||
+                current == STATE_CONNECTED ||
+                current == STATE_INVALID_LOGIN;
+        bool roster_changed;
+        {
+            boost::mutex::scoped_lock lock(roster_mtx);
+            roster_changed = !roster_deltas.empty();
+        }
+        // passes with nothing to hand over would be most of the trace
+        if (label || !contract_info.empty() || roster_changed) {
+            TRACE_SCOPE("GUIUpdater::newLabel");
+            if (label)
+                emit requestNewLabel(current);
+            if (!contract_info.empty()) {
+                emit requestNewUpdateInfo(QString(contract_info.c_str()));
+                contract_info = "";
+            }
+            if (roster_changed)
+                emit requestChangeUsers();
+        }
+        QThread::msleep(100);
+    }
+}
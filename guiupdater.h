@@ -0,0 +1,47 @@
+#ifndef GUIUPDATER_H
+#define GUIUPDATER_H
+
+#include "roster.h"
+#include <QObject>
+#include <QString>
+#include <boost/thread/mutex.hpp>
+#include <string>
+#include <vector>
+
+enum StateType {
+    STATE_IDLE = -1,
+    STATE_DISCONNECTED = 0,
+    STATE_CONNECTED,
+    STATE_INVALID_LOGIN
+};
+
+// What the connector thread hands to the window: the connection state, the
+// last contract offer and the roster deltas. newLabel() polls them on a
+// thread of its own and signals the window. Needs only QtCore, so the bot
+// host links it without any window code.
+class GUIUpdater : public QObject {
+    Q_OBJECT
+    StateType state;
+    std::string contract_info;
+    boost::mutex roster_mtx;
+    std::vector<RosterDelta> roster_deltas;
+public:
+    explicit GUIUpdater(QObject *parent = 0) : QObject(parent), state(STATE_IDLE) { }
+    void system_state_update(StateType new_state, bool force);
+    void update_contract_info(const char* data, std::size_t size);
+    void show_usr_list(const std::string& _usr_list);
+    void roster_delta(const RosterDelta& delta);
+    // Hands the deltas queued since the last call over to the GUI thread.
+    void take_roster_deltas(std::vector<RosterDelta>& deltas);
+    void form_closed();
+public slots:
+    void newLabel();
+
+signals:
+    void requestNewLabel(int);
+    void requestNewUpdateInfo(QString);
+    void requestChangeUsers();
+    void requestFormClosed();
+};
+
+#endif // GUIUPDATER_H
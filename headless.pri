@@ -0,0 +1,64 @@
+# Client sources that need no window: networking, the game rules and the bot
+# host. The bot host links only these, and only QtCore.
+
+INCLUDEPATH += $$PWD
+
+# qmake CONFIG+=trace compiles the timeline spans in (see tracer.h)
+trace {
+    DEFINES += YOURCOMPANY_TRACE
+}
+
+# qmake CONFIG+=allocprof counts heap allocations by site (see allocprof.h)
+allocprof {
+    DEFINES += YOURCOMPANY_ALLOCPROF
+}
+
+win32 {
+    INCLUDEPATH += C:/boost/boost_msvc2017/include/boost-1_66
+    LIBS += "-LC:/boost/boost_msvc2017/lib" \
+                -llibboost_system-vc141-mt-gd-x32-1_66
+}
+unix {
+    # -lrt: shm_open for the shared-memory transport on older glibc
+    # -lboost_chrono: the auto-player's steady clock
+    # -ldl: dlopen for bot plugins
+    LIBS += -lboost_thread -lboost_system -lboost_chrono -lpthread -lrt -ldl
+}
+
+SOURCES += $$PWD/connector.cpp \
+    $$PWD/guiupdater.cpp \
+    $$PWD/transport.cpp \
+    $$PWD/shmring.cpp \
+    $$PWD/uring.cpp \
+    $$PWD/spill.cpp \
+    $$PWD/autoplay.cpp \
+    $$PWD/bothost.cpp \
+    $$PWD/tracer.cpp \
+    $$PWD/allocprof.cpp \
+    $$PWD/marketcatalog.cpp \
+    $$PWD/gamestate.cpp \
+    $$PWD/roster.cpp \
+    $$PWD/auction.cpp \
+    $$PWD/report.cpp
+
+HEADERS  += $$PWD/connector.h \
+    $$PWD/guiupdater.h \
+    $$PWD/protocol.h \
+    $$PWD/wire.h \
+    $$PWD/tracer.h \
+    $$PWD/allocprof.h \
+    $$PWD/arena.h \
+    $$PWD/marketcatalog.h \
+    $$PWD/gamestate.h \
+    $$PWD/roster.h \
+    $$PWD/auction.h \
+    $$PWD/report.h \
+    $$PWD/varint.h \
+    $$PWD/session.h \
+    $$PWD/transport.h \
+    $$PWD/shmring.h \
+    $$PWD/uring.h \
+    $$PWD/spill.h \
+    $$PWD/autoplay.h \
+    $$PWD/botapi.h \
+    $$PWD/bothost.h
@@ -2,6 +2,13 @@
 #include "ui_mainwindow.h"
 #include "ui_dialog.h"
 #include "ui_formed.h"
+#include "connector.h"
+#include "tracer.h"
+#include "allocprof.h"
+#include "stallwatchdog.h"
+#include "autosave.h"
+#include "economychart.h"
+#include "auctionpanel.h"
 #include <QPainter>
 #include <QInputDialog>
 #include <QDebug>
@@ -9,427 +16,12 @@
 #include <QDateTime>
 #include <QThread>
 #include <QMouseEvent>
-
-#include <boost/asio/io_service.hpp>
-#include <boost/asio/ip/tcp.hpp>
-#include <boost/thread.hpp>
-#include <boost/date_time/posix_time/posix_time.hpp>
-#include <boost/asio.hpp>
-#include <boost/asio/deadline_timer.hpp>
-
-#ifdef WIN32
-#include <mstcpip.h>
-#undef min
-#undef errno
-#undef error
-#endif
-#define TCP_KEEPALIVE_SECS 5
-
-enum  {
-    cmd_type_auth = 0,
-    cmd_type_auth_ok,
-    cmd_type_formed,
-    cmd_type_get_usr_list,
-    cmd_type_formed_ok,
-    cmd_type_get_contract,
-    cmd_type_get_contract_ok,
-    cmd_type_finish_market,
-    cmd_type_auction,
-    cmd_type_amount,
-    cmd_type_auction_win,
-    cmd_type_auction_lose,
-    cmd_type_report,
-    cmd_type_err,
-};
-
-std::string base64_encode(const std::string &s)
-{
-    static const std::string base64_chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-    size_t i=0,ix=0,leng = s.length();
-    std::stringstream q;
-
-    for(i=0,ix=leng - leng%3; i<ix; i+=3)
-    {
-        q<< base64_chars[ (s[i] & 0xfc) >> 2 ];
-        q<< base64_chars[ ((s[i] & 0x03) << 4) + ((s[i+1] & 0xf0) >> 4)  ];
-        q<< base64_chars[ ((s[i+1] & 0x0f) << 2) + ((s[i+2] & 0xc0) >> 6)  ];
-        q<< base64_chars[ s[i+2] & 0x3f ];
-    }
-    if (ix<leng)
-    {
-        q<< base64_chars[ (s[ix] & 0xfc) >> 2 ];
-        q<< base64_chars[ ((s[ix] & 0x03) << 4) + (ix+1<leng ? (s[ix+1] & 0xf0) >> 4 : 0)];
-        q<< (ix+1<leng ? base64_chars[ ((s[ix+1] & 0x0f) << 2) ] : '=');
-        q<< '=';
-    }
-    return q.str();
-}
-
-class Connector
-{
-    boost::mutex start_stop_mtx;
-     boost::shared_ptr<boost::asio::io_service> io_service;
-     boost::shared_ptr<boost::asio::io_service::work> ios_work;
-     boost::shared_ptr<boost::thread> worker_thread;
-    boost::shared_ptr<boost::asio::ip::tcp::resolver> resolver;
-    boost::shared_ptr<boost::asio::ip::tcp::socket> socket;
-
-    std::string host;
-    uint16_t port;
-    std::string login;
-    std::string password;
-    uint64_t reconnect_if_no_response;
-    std::vector<uint8_t> read_buffer;
-    std::vector<uint8_t> parse_buffer;
-
-    GUIUpdater* data_receiver;
-
-    struct ToSend {
-        std::vector<uint8_t> data;
-    };
-
-public:
-    Connector(GUIUpdater* data_receiver)
-        : reconnect_if_no_response(0)
-        , data_receiver(data_receiver)
-    {
-        read_buffer.resize(2048);
-    }
-
-    ~Connector()
-    {
-        stop();
-    }
-
-    void start(const std::string& host_, uint16_t port_, const std::string& login_, const std::string& password_)
-    {
-        boost::mutex::scoped_lock lock(start_stop_mtx);
-        assert(!io_service && !ios_work && !worker_thread && !resolver);
-        host = host_;
-        port = port_;
-        login = login_;
-        password = password_;
-
-        reconnect_if_no_response = QDateTime::currentMSecsSinceEpoch();
-
-        io_service.reset(new boost::asio::io_service);
-        ios_work.reset(new boost::asio::io_service::work(*io_service));
-        resolver.reset(new boost::asio::ip::tcp::resolver(*io_service));
-        worker_thread.reset(new boost::thread(boost::bind(&boost::asio::io_service::run, io_service)));
-        boost::shared_ptr<boost::asio::deadline_timer> keep_alive_timer(
-                    new boost::asio::deadline_timer(*io_service)
-                    );
-        keep_alive_timer->expires_from_now(boost::posix_time::seconds(1));
-        keep_alive_timer->async_wait(boost::bind(&Connector::keep_alive, this, keep_alive_timer));
-    }
-
-    void stop()
-    {
-        reconnect_if_no_response = 0;
-
-        {
-            boost::mutex::scoped_lock lock(start_stop_mtx);
-            ios_work.reset();
-            if (io_service)
-                io_service->stop();
-            if (worker_thread) {
-                worker_thread->join();
-                worker_thread.reset();
-            }
-            if (socket) {
-                socket->close();
-                socket.reset();
-            }
-            resolver.reset();
-            io_service.reset();
-        }
-    }
-
-    void send_command_new_state(int type, bool enabled, int id_paradox, int id)
-    {
-//        std::string data = stdprintf("%d:%d:%d:%d", type, enabled, id_paradox, id);
-//        command_send( cmd_type_set_new_state, reinterpret_cast<uint8_t*>(&data[0]), data.size());
-    }
-
-
-public:
-
-    void command_send(uint8_t cmd, uint8_t* cmd_data, uint32_t size)
-    {
-        boost::shared_ptr<ToSend> to_send(new ToSend);
-        to_send->data.resize(size + 7);
-        size_t it = 0;
-        uint8_t* data = &to_send->data[0];
-        data[it++] = 13;
-        data[it++] = 37;
-        memcpy(&data[it], &size, 4); it += 4;
-        data[it++] = cmd;
-
-        assert(it + size == to_send->data.size());
-        if (size)
-            memcpy(&to_send->data[it], cmd_data, size);
-
-        boost::asio::async_write(*socket,
-            boost::asio::buffer(reinterpret_cast<const char*>(&to_send->data[0]), to_send->data.size()),
-            boost::asio::transfer_all(),
-            boost::bind(
-                &Connector::on_send_over,
-                this,
-                to_send,
-                boost::asio::placeholders::error
-                )
-            );
-    }
-
-    void on_send_over(
-        boost::shared_ptr<ToSend>& /*to_send*/,
-        const boost::system::error_code& error
-        )
-    {
-        if (error) {
-//            log_timestamp("Paradox: error data sending to %s\n", host.c_str());
-            reconnect_if_no_response = QDateTime::currentMSecsSinceEpoch();
-            data_receiver->system_state_update(STATE_DISCONNECTED, true);
-        }
-    }
-
-    void read_data()
-    {
-        boost::asio::async_read(
-                *socket,
-                boost::asio::buffer(&read_buffer[0], read_buffer.size()),
-                boost::asio::transfer_at_least(1),
-                boost::bind(
-                    &Connector::handle_read,
-                    this,
-                    boost::asio::placeholders::error,
-                    boost::asio::placeholders::bytes_transferred
-                    )
-        );
-    }
-
-    bool buffer_parse(uint8_t* packet, size_t len)
-    {
-        parse_buffer.insert(parse_buffer.end(), packet, &packet[len]);
-        while (!parse_buffer.empty()) {
-            uint8_t* data = &parse_buffer[0];
-            size_t size = parse_buffer.size();
-            if (size < 7)
-                return true;
-            if (data[0] != 13 || data[1] != 37) {
-//                log_warning("Paradox: wrong data format\n");
-                return false;
-            }
-
-            uint32_t data_len;
-            memcpy(&data_len, &data[2], 4);
-            if (data_len + 7 > size)
-                return true;
-
-            uint8_t cmd = data[6];
-
-            switch (cmd) {
-            case cmd_type_auth_ok: {
-//                std::string usr_list(reinterpret_cast<const char*>(&data[7]), data_len);
-                data_receiver->system_state_update(STATE_CONNECTED, true);
-//                data_receiver->show_usr_list(usr_list);
-                reconnect_if_no_response = 0;
-////                command_send(cmd_type_get_tree, 0, 0);
-                break;
-////            case cmd_type_tree:
-////                tree_reply_parse(&data[7], data_len);
-////                break;
-////            case cmd_type_state_upd: {
-////                uint8_t level;
-////                int sz = 0;
-////                boost::shared_ptr<ParadoxElement> element = paradox_element_deserialize(
-////                    &data[7],
-////                    data_len,
-////                    level,
-////                    sz
-////                    );
-////                if (element)
-////                    data_receiver->object_changed(level, element);
-////                break; }
-            }
-            case cmd_type_get_usr_list:
-            {
-                 std::string usr_list(reinterpret_cast<const char*>(&data[7]), data_len);
-                 data_receiver->show_usr_list(usr_list);
-                break;
-            }
-            case cmd_type_formed_ok:
-            {
-                 data_receiver->form_closed();
-                break;
-            }
-
-            case cmd_type_get_contract_ok:
-            {
-                std::string contract_info(reinterpret_cast<const char*>(&data[7]), data_len);
-                data_receiver->update_contract_info(contract_info);
-                break;
-
-            }
-            case cmd_type_finish_market:
-            {
-                std::string contract_info(reinterpret_cast<const char*>(&data[7]), data_len);
-                data_receiver->update_contract_info(contract_info);
-                break;
-            }
-            case cmd_type_err: {
-                std::string err_msg(reinterpret_cast<const char*>(&data[7]), data_len);
-                if (err_msg == "Unauthorized") {
-                    data_receiver->system_state_update(
-                        STATE_INVALID_LOGIN,
-                        true
-                        );
-
-                    parse_buffer.erase(parse_buffer.begin(), parse_buffer.begin() + 7 + static_cast<int>(data_len));
-                    reconnect_if_no_response = 0;
-                    return false;
-                }
-                break;
-            }
-////            case cmd_type_send_troubles_info:
-////            {
-////                std::string event(reinterpret_cast<const char*>(&data[7]), data_len);
-////                data_receiver->send_trouble_event(event);
-////                break;
-//            }
-            default:
-////                log_warning("Paradox: unsupported cmd 0x%02x received\n", cmd);
-                break;
-            }
-            parse_buffer.erase(parse_buffer.begin(), parse_buffer.begin() + 7 + static_cast<int>(data_len));
-        }
-        return true;
-    }
-
-    void handle_read(const boost::system::error_code &error, size_t bytes_transfered)
-    {
-        if (error || !bytes_transfered || !buffer_parse(&read_buffer[0], bytes_transfered)) {
-//            log_timestamp("Paradox: error read data (size %lu) from %s\n", bytes_transfered, host.c_str());
-            reconnect_if_no_response = QDateTime::currentMSecsSinceEpoch();
-            data_receiver->system_state_update(STATE_DISCONNECTED, false);
-            return;
-        };
-        read_data();
-    }
-
-    void connect_cb(const boost::system::error_code& error)
-    {
-        if (error) {
-//            log_timestamp("Paradox: can't connect to %s\n", host.c_str());
-            reconnect_if_no_response = QDateTime::currentMSecsSinceEpoch();
-            data_receiver->system_state_update(STATE_DISCONNECTED, true);
-            return;
-        }
-        //data_receiver->system_state_update(STATE_CONNECTED);
-        std::string auth_data = base64_encode(login + "@" + password);
-        command_send(cmd_type_auth, reinterpret_cast<uint8_t*>(&auth_data[0]), auth_data.size());
-        read_data();
-
-#ifdef WIN32
-        DWORD ret_bytes = 0;
-        struct tcp_keepalive keepalive_opts;
-        keepalive_opts.onoff = TRUE;
-        keepalive_opts.keepalivetime = TCP_KEEPALIVE_SECS * 1000;
-        keepalive_opts.keepaliveinterval = TCP_KEEPALIVE_SECS * 1000;
-        int res = WSAIoctl(
-                    socket->native_handle(),
-                    SIO_KEEPALIVE_VALS,
-                    &keepalive_opts,
-                    sizeof(keepalive_opts),
-                    NULL,
-                    0,
-                    &ret_bytes,
-                    NULL,
-                    NULL);
-        if (res == SOCKET_ERROR) {
-//            log_warning("ASIO: WSAIotcl(SIO_KEEPALIVE_VALS) failed (%d)\n", WSAGetLastError());
-        }
-#else
-        int optval = 1;
-        if (setsockopt(socket->native_handle(), SOL_SOCKET, SO_KEEPALIVE, &optval, sizeof(optval)) == -1) {
-            log_warning("ASIO: setsockopt(SO_KEEPALIVE) failed (%s)\n", strerror(errno));
-            return;
-        }
-        optval = 3;
-        if (setsockopt(socket->native_handle(), SOL_TCP, TCP_KEEPCNT, &optval, sizeof(optval)) == -1) {
-            log_warning("ASIO: setsockopt(TCP_KEEPCNT) failed (%s)\n", strerror(errno));
-            return;
-        }
-        optval = TCP_KEEPALIVE_SECS;
-        if (setsockopt(socket->native_handle(), SOL_TCP, TCP_KEEPIDLE, &optval, sizeof(optval)) == -1) {
-            log_warning("ASIO: setsockopt(TCP_KEEPIDLE) failed (%s)\n", strerror(errno));
-            return;
-        }
-        optval = TCP_KEEPALIVE_SECS;
-        if (setsockopt(socket->native_handle(), SOL_TCP, TCP_KEEPINTVL, &optval, sizeof(optval)) == -1) {
-            log_warning("ASIO: setsockopt(TCP_KEEPINTVL) failed (%s)\n", strerror(errno));
-            return;
-        }
-#endif
-    }
-
-    void resolve_cb(const boost::system::error_code& error, boost::asio::ip::tcp::resolver::iterator i)
-    {
-        if (error) {
-//            log_timestamp("Paradox: unable to resolve %s\n", host.c_str());
-            reconnect_if_no_response = QDateTime::currentMSecsSinceEpoch();
-            data_receiver->system_state_update(STATE_DISCONNECTED, true);
-            return;
-        }
-        if (socket)
-            socket->close();
-        socket.reset(new boost::asio::ip::tcp::socket(*io_service));
-        socket->async_connect(*i, boost::bind(&Connector::connect_cb, this, boost::asio::placeholders::error));
-
-#ifndef WIN32
-        try {
-            boost::asio::ip::tcp::no_delay delay_option(true);
-            socket->set_option(delay_option);
-
-            boost::asio::socket_base::keep_alive keep_alive_option(true);
-            socket->set_option(keep_alive_option);
-        } catch (const std::exception& e) {
-            log_timestamp("Paradox: connection to %s setup error: %s\n", host.c_str(), e.what());
-        }
-#endif
-    }
-
-    void connect()
-    {
-        assert(resolver);
-        parse_buffer.clear();
-
-        data_receiver->system_state_update(STATE_DISCONNECTED, false);
-        boost::asio::ip::tcp::resolver::query query(host, /*stdprintf("%hu", port)*/ "5000");
-        resolver->async_resolve(query, boost::bind(&Connector::resolve_cb,
-            this,
-            boost::asio::placeholders::error,
-            boost::asio::placeholders::iterator));
-        reconnect_if_no_response = QDateTime::currentMSecsSinceEpoch() + 10000000ULL;
-
-    }
-
-    void keep_alive(boost::shared_ptr<boost::asio::deadline_timer>& keep_alive_timer)
-    {
-        keep_alive_timer->expires_from_now(boost::posix_time::seconds(reconnect_if_no_response ? 10 : 1));
-        if (reconnect_if_no_response && reconnect_if_no_response < QDateTime::currentMSecsSinceEpoch()) {
-//            log_timestamp(
-//                "Paradox: create new connection with %s:%hu %s\n",
-//                host.c_str(),
-//                port,
-//                reconnect_if_no_response ? "" : "because of timeout"
-//                );
-            reconnect_if_no_response = QDateTime::currentMSecsSinceEpoch() + 10000000ULL;
-            connect();
-        }
-        keep_alive_timer->async_wait(boost::bind(&Connector::keep_alive, this, keep_alive_timer));
-    }
-};
+#include <QShortcut>
+#include <QFile>
+#include <QTimer>
+#include <QScreen>
+#include <QGuiApplication>
+#include <algorithm>
 
 Connector *connector = NULL;
 
@@ -449,33 +41,89 @@ MainWindow::MainWindow(QWidget *parent) :
     connect_status(false),
     form(parent, this),
     dialog(parent, this),
-    count_year(4)
+    count_year(4),
+    index_current_market(-1),
+    turn_number(0),
+    resume_checked(false),
+    roster_model(&roster),
+    auction_panel(NULL),
+    auction_shown(0),
+    economy_chart(NULL),
+    next_offer(1),
+    offer_dialog_open(false)
 {
+    TRACE_THREAD_NAME("GUI");
     ui->setupUi(this);
+#ifdef YOURCOMPANY_TRACE
+    QShortcut* trace_flush = new QShortcut(QKeySequence(tr("Ctrl+Shift+T")), this);
+    connect(trace_flush, SIGNAL(activated()), this, SLOT(flush_trace()));
+#endif
+    connect(new QShortcut(QKeySequence::Undo, this), SIGNAL(activated()), this, SLOT(undo_turn()));
+    connect(new QShortcut(QKeySequence::Redo, this), SIGNAL(activated()), this, SLOT(redo_turn()));
+    connect(new QShortcut(QKeySequence(tr("Ctrl+B")), this), SIGNAL(activated()), this, SLOT(branch_from_turn()));
+    connect(new QShortcut(QKeySequence(tr("Ctrl+E")), this), SIGNAL(activated()), this, SLOT(show_economy()));
+    connect(new QShortcut(QKeySequence(tr("Ctrl+P")), this), SIGNAL(activated()), this, SLOT(toggle_autoplay()));
+    autoplay_timer = new QTimer(this);
+    connect(autoplay_timer, SIGNAL(timeout()), this, SLOT(show_autoplay()));
     //ui->BuyMaterials->hide();
     ui->NewCredit->hide();
     ui->BuyNewProductLine->hide();
     ui->Market->hide();
     memset(debit, 0, 4 * sizeof(int));
+    form.form_ui->users->setModel(&roster_model);
+    connect(form.form_ui->search, SIGNAL(textChanged(QString)), &roster_model, SLOT(set_filter(QString)));
+    board.set_raster_threads(qgetenv("YOURCOMPANY_RASTER_THREADS").toInt());
+    connect(&board, SIGNAL(panelsReady()), this, SLOT(update()));
+    watchdog = new StallWatchdog(this);
+    connect(watchdog, SIGNAL(stallDetected(QString,int)), this, SLOT(report_stall(QString,int)), Qt::QueuedConnection);
+    watchdog->start();
     updater = new GUIUpdater();
     connector = new Connector(updater);
+    // e.g. unix:///run/yourcompany.sock or shm://yourcompany next to a local server
+    server = qgetenv("YOURCOMPANY_SERVER").toStdString();
+    Endpoint endpoint;
+    if (!Endpoint::parse(server, 5000, endpoint)) {
+        if (!server.empty())
+            qWarning("YOURCOMPANY_SERVER: can't use %s\n", server.c_str());
+        server = "tcp://81.177.175.71:5000";
+    }
+    if (!qgetenv("YOURCOMPANY_PROTOCOL").isEmpty())
+        connector->set_max_protocol(static_cast<uint8_t>(qgetenv("YOURCOMPANY_PROTOCOL").toInt()));
+    connector->set_auction(&auction);
+    connect(&auction, SIGNAL(changed()), this, SLOT(show_auction()), Qt::QueuedConnection);
     QThread *thread = new QThread;
 
     connect(thread, SIGNAL(started()), updater, SLOT(newLabel()));
     connect(updater, SIGNAL(requestNewLabel(int)), this, SLOT(process(int)));
     connect(updater, SIGNAL(requestNewUpdateInfo(QString)), this, SLOT(update_contract_info(QString)));
-    connect(updater, SIGNAL(requestChangeUsers(QString)), this, SLOT(show_change_users(QString)));
+    connect(updater, SIGNAL(requestChangeUsers()), this, SLOT(show_change_users()));
     connect(updater, SIGNAL(requestFormClosed()), this, SLOT(form_closed()));
     updater->moveToThread(thread);
     thread->start();
-    markets.push_back(Market("A", QRect(270, 50, 250, 250), Qt::red, &money));
-    markets.push_back(Market("B", QRect(530, 50, 250, 250), Qt::blue, &money));
-    markets.push_back(Market("C", QRect(790, 50, 250, 250), Qt::yellow, &money, 2, 2));
-    markets.push_back(Market("CENTRAL", QRect(10, 50, 250, 250), Qt::gray, &money, 0, 0));
+    std::vector<MarketCatalog::MarketSpec> specs = MarketCatalog::load_scenario();
+    for (std::size_t i = 0; i < specs.size(); ++i) {
+        QColor color(specs[i].color);
+        if (!color.isValid())
+            color = Qt::gray;
+        markets.push_back(Market(specs[i].name, specs[i].rect, color, &money, specs[i].price, specs[i].time));
+    }
+    rebuild_market_index();
+    std::vector<std::string> market_names;
+    for (std::size_t i = 0; i < markets.size(); ++i)
+        market_names.push_back(markets[i].name);
+    report.set_markets(market_names);
+    report.begin_year(1, money);
+    // set again after every money change, keeps the prepared bids affordable
+    auction.set_budget(money);
+    reports_file.setFileName("yourcompany_reports.csv");
+    autosave = new Autosave("yourcompany_autosave.bin");
 }
 
 MainWindow::~MainWindow()
 {
+    // the io thread calls into auction and the reply handlers bound to this
+    connector->stop();
+    connector->set_auction(NULL);
     delete Office;
     delete BuyMaterials;
     delete SaleProducts;
@@ -489,6 +137,29 @@ MainWindow::~MainWindow()
     }
     //thread->stop();
     //delete updater;
+    (void) TRACE_FLUSH("yourcompany_trace.json");
+    (void) ALLOC_REPORT("yourcompany_allocs.txt");
+    watchdog->stop();
+    watchdog->write_report("yourcompany_stalls.txt");
+    autoplay.stop();
+    delete autosave;
+    delete economy_chart;
+    delete auction_panel;
+}
+
+void MainWindow::report_stall(QString handler, int duration_ms)
+{
+    qWarning() << "GUI stalled for" << duration_ms << "ms in" << handler;
+}
+
+void MainWindow::flush_trace()
+{
+    QString path = QString("yourcompany_trace_%1.json")
+            .arg(QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss"));
+    if (TRACE_FLUSH(path.toStdString()))
+        statusBar()->showMessage(tr("Trace written to %1").arg(path));
+    else
+        statusBar()->showMessage(tr("Trace is not available"));
 }
 
 void MainWindow::create_circles(QWidget *group_box, QPainter& p, int finish_count, bool have_credit = false)
@@ -514,33 +185,12 @@ void MainWindow::create_circles(QWidget *group_box, QPainter& p, int finish_coun
 
 void MainWindow::create_circles_with_name()
 {
+    TRACE_SCOPE("MainWindow::create_circles_with_name");
     QPainter p(this);
+    market_view.resize(markets.size());
     for (std::size_t i = 0; i < markets.size(); ++i) {
-        p.setPen(QPen(markets[i].selected ? Qt::green : markets[i].color, markets[i].selected ? 5 : 1,Qt::SolidLine));
-        p.setBrush(QBrush(markets[i].color));
-        p.drawEllipse(markets[i].rect);
-
-        QPoint point;
-        point.setX(markets[i].rect.x() + markets[i].rect.width() /2 - (markets[i].name.size() == 1 ? 10 : 30 * (int) (markets[i].name.size() / 2)));
-        point.setY(markets[i].rect.y()  + markets[i].rect.height() /2);
-        p.setPen(QPen(Qt::black,1,Qt::SolidLine));
-        p.setBrush(QBrush(Qt::black));
-        p.setFont(QFont("Arial", 30));
-        p.drawText(point, tr(markets[i].name.c_str()));
-        point.setX(markets[i].rect.x() + markets[i].rect.width() /2 - 30);
-        point.setY(markets[i].rect.y() + 40 + markets[i].rect.height() /2);
-        p.setFont(QFont("Arial", 15));
-        p.drawText(point, markets[i].is_opened() ? tr("Opened") : tr("Closed"));
-        p.setPen(QPen(Qt::blue, 3,Qt::SolidLine));
-        p.setBrush(Qt::NoBrush);
-        if (i == index_current_market) {
-            QRect rect = markets[i].rect;
-            rect.setX(rect.x() - 3);
-            rect.setY(rect.y() - 3);
-            rect.setWidth(rect.width() + 4);
-            rect.setHeight(rect.height() + 4);
-            p.drawRect(rect);
-        }
+        market_view.paint(p, i, markets[i].name, markets[i].rect, markets[i].color,
+                          markets[i].is_opened(), markets[i].selected, i == index_current_market);
     }
 }
 
@@ -623,163 +273,562 @@ void MainWindow::set_new_button(QWidget *&widget, QWidget *&parent, QRect rect,
 
 }
 
+void MainWindow::create_board_widgets()
+{
+    if (Office)
+        return;
+    set_new_group_box(Office, ui->centralWidget, "Office", QRect(270, 10, 441, 51));
+    set_new_group_box(WarehouseMaterials, ui->centralWidget, "WarehouseMaterials", QRect(20, 10, 241, 271));
+    BuyMaterials = new QPushButton(WarehouseMaterials);
+    BuyMaterials->setObjectName("BuyMaterials");
+    BuyMaterials->setGeometry(QRect(150, 240, 80, 21));
+    ((QPushButton*) BuyMaterials)->setText("BuyMaterials");
+    connect(BuyMaterials, SIGNAL(clicked(bool)), this, SLOT(BuyMaterials_clicked()));
+    set_new_group_box(WarehouseProduct, ui->centralWidget, "WarehouseProduct", QRect(730, 10, 291, 191));
+    SaleProducts = new QPushButton(WarehouseProduct);
+    SaleProducts->setObjectName("SaleProducts");
+    SaleProducts->setGeometry(QRect(170, 140, 80, 21));
+    ((QPushButton*) SaleProducts)->setText("SaleProducts");
+    connect(SaleProducts, SIGNAL(clicked(bool)), this, SLOT(SaleProducts_clicked()));
+}
+
+void MainWindow::create_product_line_widgets(ProductLine *product_line)
+{
+    QRect rect = new_location_product_line();
+    set_new_group_box(product_line->widget, ui->centralWidget, std::string("Line")
+                      + std::to_string(ProductLines.size() - 1) + product_line->product_type.toStdString(), rect);
+    rect.setX(rect.x() - 25);
+    rect.setWidth(20);
+    set_new_button(product_line->button, ui->centralWidget, rect, product_line);
+    product_line->widget->setVisible(gui_state == MAIN_STATE);
+    product_line->button->setVisible(gui_state == MAIN_STATE);
+}
+
+void MainWindow::set_gui_state(GuiState state)
+{
+    gui_state = state;
+    bool board_visible = gui_state == MAIN_STATE;
+    setMouseTracking(gui_state == MARKET_STATE);
+    ui->centralWidget->setMouseTracking(gui_state == MARKET_STATE);
+    if (gui_state != MARKET_STATE)
+        unsetCursor();
+    if (board_visible)
+        create_board_widgets();
+    if (Office) {
+        Office->setVisible(board_visible);
+        WarehouseMaterials->setVisible(board_visible);
+        WarehouseProduct->setVisible(board_visible);
+    }
+    ui->CreditPayment->setVisible(board_visible);
+    ui->Debit1->setVisible(board_visible);
+    ui->Debit2->setVisible(board_visible);
+    ui->Debit3->setVisible(board_visible);
+    ui->Debit4->setVisible(board_visible);
+    ui->NewCredit->setVisible(board_visible);
+    for (std::list<ProductLine*>::iterator it = ProductLines.begin(); it != ProductLines.end(); ++it) {
+        (*it)->widget->setVisible(board_visible);
+        (*it)->button->setVisible(board_visible);
+    }
+    update();
+}
+
+void MainWindow::update_board_scene()
+{
+    std::size_t signature = money;
+    BoardScene::signature_add(signature, ui->Money->width());
+    if (board.needs_update(BoardScene::MoneyPanel, signature)) {
+        QPainter p(&board.record(BoardScene::MoneyPanel, signature));
+        p.setPen(QPen(Qt::red,1,Qt::SolidLine));
+        p.setBrush(QBrush(Qt::red));
+        create_circles(ui->Money, p, money);
+    }
+
+    signature = credit_max_time;
+    for (std::size_t index = 0; index < CreditLines.size(); ++index)
+        BoardScene::signature_add(signature, CreditLines[index].time);
+    if (board.needs_update(BoardScene::CreditPanel, signature)) {
+        QPainter p(&board.record(BoardScene::CreditPanel, signature));
+        p.setBrush(Qt::NoBrush);
+        p.setPen(QPen(Qt::blue,1,Qt::SolidLine));
+        create_circles(ui->CreditPayment, p, credit_max_time, true);
+    }
+
+    QWidget* debit_boxes[4] = { ui->Debit1, ui->Debit2, ui->Debit3, ui->Debit4 };
+    for (int i = 0; i < 4; ++i) {
+        BoardScene::Panel panel = static_cast<BoardScene::Panel>(BoardScene::DebitPanel1 + i);
+        if (board.needs_update(panel, debit[i])) {
+            QPainter p(&board.record(panel, debit[i]));
+            p.setPen(QPen(Qt::red,1,Qt::SolidLine));
+            p.setBrush(QBrush(Qt::red));
+            create_square(debit_boxes[i], p, debit[i]);
+        }
+    }
+
+    if (board.needs_update(BoardScene::MaterialsPanel, materials)) {
+        QPainter p(&board.record(BoardScene::MaterialsPanel, materials));
+        p.setPen(QPen(Qt::yellow,1,Qt::SolidLine));
+        p.setBrush(QBrush(Qt::yellow));
+        create_triangles(WarehouseMaterials, p, (void*) &materials);
+    }
+
+    signature = products.size();
+    for (std::size_t i = 0; i < products.size(); ++i)
+        BoardScene::signature_add(signature, products[i].type);
+    if (board.needs_update(BoardScene::ProductsPanel, signature)) {
+        QPainter p(&board.record(BoardScene::ProductsPanel, signature));
+        p.setPen(QPen(Qt::blue,1,Qt::SolidLine));
+        p.setBrush(QBrush(Qt::blue));
+        create_triangles(WarehouseProduct, p, (void*) &products);
+    }
+
+    signature = ProductLines.size();
+    for (std::list<ProductLine*>::iterator it = ProductLines.begin(); it != ProductLines.end(); ++it) {
+        std::deque<bool>& have_materials = (*it)->MatPerTime.have_materials;
+        BoardScene::signature_add(signature, (*it)->widget->x());
+        BoardScene::signature_add(signature, (*it)->widget->y());
+        for (std::size_t i = 0; i < have_materials.size(); ++i)
+            BoardScene::signature_add(signature, have_materials[i]);
+    }
+    if (board.needs_update(BoardScene::LinesPanel, signature)) {
+        QPainter p(&board.record(BoardScene::LinesPanel, signature));
+        for (std::list<ProductLine*>::iterator it = ProductLines.begin(); it != ProductLines.end(); ++it) {
+            p.setPen(QPen(Qt::blue,1,Qt::SolidLine));
+            (*it)->create_empty_triangles_in_product_line(p);
+        }
+    }
+}
+
 void MainWindow::paintEvent(QPaintEvent *)
 {
+    TRACE_SCOPE("MainWindow::paintEvent");
+    STALL_SCOPE("MainWindow::paintEvent");
     switch (gui_state) {
     case MAIN_STATE:
     {
-       QPainter p(this);
-       p.setPen(QPen(Qt::red,1,Qt::SolidLine));
-       p.setBrush(QBrush(Qt::red));
-       create_circles(ui->Money, p, money);
-       p.setBrush(Qt::NoBrush);
-       p.setPen(QPen(Qt::blue,1,Qt::SolidLine));
-       create_circles(ui->CreditPayment, p, credit_max_time, true);
-       if (!Office)
-          set_new_group_box(Office, ui->centralWidget, "Office", QRect(270, 10, 441, 51));
-       else
-           (reinterpret_cast<QGroupBox*> (Office))->show();
-       if (!WarehouseMaterials) {
-          set_new_group_box(WarehouseMaterials, ui->centralWidget, "WarehouseMaterials", QRect(20, 10, 241, 271));
-          if (!BuyMaterials) {
-              BuyMaterials = new QPushButton(WarehouseMaterials);
-              BuyMaterials->setObjectName("BuyMaterials");
-              BuyMaterials->setGeometry(QRect(150, 240, 80, 21));
-              ((QPushButton*) BuyMaterials)->setText("BuyMaterials");
-              connect(BuyMaterials, SIGNAL(clicked(bool)), this, SLOT(BuyMaterials_clicked()));
-              BuyMaterials->show();
-          }
-       } else {
-           (reinterpret_cast<QGroupBox*> (WarehouseMaterials))->show();
-       }
-       if (!WarehouseProduct) {
-           set_new_group_box(WarehouseProduct, ui->centralWidget, "WarehouseProduct", QRect(730, 10, 291, 191));
-           if (!SaleProducts) {
-               SaleProducts = new QPushButton(WarehouseProduct);
-               SaleProducts->setObjectName("SaleProducts");
-               SaleProducts->setGeometry(QRect(170, 140, 80, 21));
-               ((QPushButton*) SaleProducts)->setText("SaleProducts");
-               connect(SaleProducts, SIGNAL(clicked(bool)), this, SLOT(SaleProducts_clicked()));
-               SaleProducts->show();
-           }
-       } else {
-            (reinterpret_cast<QGroupBox*> (WarehouseProduct))->show();
-       }
-        if (!ProductLines.empty()) {
-           std::string pr_line_str = ProductLines.back()->product_type.toStdString();
-            if (!(ProductLines.back()->widget)) {
-                QRect rect = new_location_product_line();
-                set_new_group_box(ProductLines.back()->widget, ui->centralWidget,  std::string("Line")
-                                  + std::to_string(ProductLines.size() - 1) + pr_line_str, rect);
-                rect.setX(rect.x() - 25);
-                rect.setWidth(20);
-                set_new_button(ProductLines.back()->button, ui->centralWidget, rect, ProductLines.back());
-            }
-            for (std::list<ProductLine*>::iterator it = ProductLines.begin(); it != ProductLines.end(); ++it) {
-                p.setPen(QPen(Qt::blue,1,Qt::SolidLine));
-                (reinterpret_cast<QGroupBox*> ((*it)->widget))->show();
-                (reinterpret_cast<QPushButton*> ((*it)->button))->show();
-                (*it)->create_empty_triangles_in_product_line(p);
-            }
-        }
-        if (materials) {
-            p.setPen(QPen(Qt::yellow,1,Qt::SolidLine));
-            p.setBrush(QBrush(Qt::yellow));
-            create_triangles(WarehouseMaterials, p, (void*) &materials);
-        }
-        if (!products.empty()) {
-            p.setPen(QPen(Qt::blue,1,Qt::SolidLine));
-            p.setBrush(QBrush(Qt::blue));
-            create_triangles(WarehouseProduct, p, (void*) &products);
-        }
-        p.setPen(QPen(Qt::red,1,Qt::SolidLine));
-        p.setBrush(QBrush(Qt::red));
-        create_square(ui->Debit1, p, debit[0]);
-        create_square(ui->Debit2, p, debit[1]);
-        create_square(ui->Debit3, p, debit[2]);
-        create_square(ui->Debit4, p, debit[3]);
-        ui->CreditPayment->show();
-        ui->Debit1->show();
-        ui->Debit2->show();
-        ui->Debit3->show();
-        ui->Debit4->show();
-        ui->NewCredit->show();
+        update_board_scene();
+        board.rasterize(false);
+        QPainter p(this);
+        board.paint(p);
         break;
     }
     case MARKET_STATE:
     {
-        (reinterpret_cast<QGroupBox*> (WarehouseProduct))->hide();
-        (reinterpret_cast<QGroupBox*> (WarehouseMaterials))->hide();
-        (reinterpret_cast<QGroupBox*> (Office))->hide();
-        ui->CreditPayment->hide();
-        ui->Debit1->hide();
-        ui->Debit2->hide();
-        ui->Debit3->hide();
-        ui->Debit4->hide();
-        ui->NewCredit->hide();
-        QPainter p(this);
-        p.setPen(QPen(Qt::red,1,Qt::SolidLine));
-        p.setBrush(QBrush(Qt::red));
-        for (std::list<ProductLine*>::iterator it = ProductLines.begin(); it != ProductLines.end(); ++it) {
-            (reinterpret_cast<QGroupBox*> ((*it)->widget))->hide();
-            (reinterpret_cast<QPushButton*> ((*it)->button))->hide();
+        update_board_scene();
+        board.rasterize(false);
+        {
+            QPainter p(this);
+            board.paint_panel(p, BoardScene::MoneyPanel);
         }
-        create_circles(ui->Money, p, money);
         create_circles_with_name();
+        break;
     }
+    default:
+        break;
     };
 }
 
+void MainWindow::changeEvent(QEvent *event)
+{
+    if (event->type() == QEvent::LanguageChange)
+        market_view.invalidate();
+    QMainWindow::changeEvent(event);
+}
+
+void MainWindow::rebuild_market_index()
+{
+    std::vector<QRect> circles;
+    circles.reserve(markets.size());
+    for (std::size_t i = 0; i < markets.size(); ++i)
+        circles.push_back(markets[i].rect);
+    market_grid.build(circles);
+}
+
 void MainWindow::mousePressEvent(QMouseEvent *event)
 {
-    for (std::size_t i = 0; i < markets.size(); ++i) {
-        int xc, yc, r, x, y;
-        xc = markets[i].rect.x() + markets[i].rect.width() / 2;
-        yc = markets[i].rect.y() + markets[i].rect.height() / 2;
-        r = markets[i].rect.width() / 2;
-        x = event->x();
-        y = event->y();
-        if (((x - xc) * (x - xc) + (y - yc) * (y - yc) <= r * r)
-                && !markets[i].selected
-                && money > 0) {
-               markets[i].selected = true;
-               markets[i].recount_before();
-        }
+    STALL_SCOPE("MainWindow::mousePressEvent");
+    if (gui_state != MARKET_STATE)
+        return;
+    int i = market_grid.hit(event->pos());
+    if (i >= 0 && !markets[i].selected && money > 0) {
+        markets[i].selected = true;
+        markets[i].recount_before();
+        auction.set_budget(money);
+        update();
     }
-    repaint();
+}
+
+void MainWindow::mouseMoveEvent(QMouseEvent *event)
+{
+    if (gui_state != MARKET_STATE)
+        return;
+    int i = market_grid.hit(event->pos());
+    setCursor(i >= 0 && !markets[i].selected ? Qt::PointingHandCursor : Qt::ArrowCursor);
 }
 
 void MainWindow::on_Start_clicked()
 {
+    TRACE_SCOPE("MainWindow::on_Start_clicked");
+    STALL_SCOPE("MainWindow::on_Start_clicked");
     // Code for connect to server
     if (gui_state == IDLE_STATE) {
         createStausBar();
         dialog.show();
     } else {
-        for (std::size_t index = 0; index < CreditLines.size(); ++index) {
-            CreditLines[index].time--;
+        bool year_closed = false;
+        {
+            ALLOC_SCOPE("turn");
+            turn_arena.reset();
+            for (std::size_t index = 0; index < CreditLines.size(); ++index) {
+                CreditLines[index].time--;
+            }
+            for (std::list<ProductLine*>::iterator it = ProductLines.begin(); it != ProductLines.end(); ++it) {
+                report.line_turn(!(*it)->button->isEnabled());
+                std::size_t before = products.size();
+                (*it)->MatPerTime.recount();
+                report.produced((*it)->MatPerTime.type == Product::TypeA ? GameState::ProductA : GameState::ProductB,
+                                products.size() - before);
+            }
+            if (debit[3] > 0)
+                money += debit[3];
+            for (int i = 3; i > 0; --i) {
+                debit[i] = debit[i - 1];
+                debit[i - 1] = 0;
+            }
+            int credit_outstanding = 0;
+            for (std::size_t index = 0; index < CreditLines.size(); ++index)
+                credit_outstanding += CreditLines[index].money;
+            report.end_turn(credit_outstanding);
+            --count_year;
+            if (!count_year) {
+                for (std::size_t i = 0; i < markets.size(); ++i) {
+                    int before = money;
+                    markets[i].recount_after();
+                    markets[i].recount_before();
+                    report.market_fee(static_cast<int>(i), before - money);
+                }
+                count_year = 4;
+                report.finish_year(money, closed_year);
+                year_closed = true;
+            }
+            ++turn_number;
         }
-        for (std::list<ProductLine*>::iterator it = ProductLines.begin(); it != ProductLines.end(); ++it) {
-            (*it)->MatPerTime.recount();
+        for (std::list<ProductLine*>::iterator it = ProductLines.begin(); it != ProductLines.end(); ++it)
             (*it)->button->setEnabled(true);
+        if (year_closed)
+            publish_year(closed_year);
+        {
+            // kept by the history, the autosave and the economy series
+            ALLOC_SCOPE("turn.snapshot");
+            boost::shared_ptr<const GameState> state(new GameState(capture_state()));
+            record_turn(*state, boost::shared_ptr<const ReportBuilder>(new ReportBuilder(report)));
+            autosave->submit(state);
+        }
+        if (economy_chart)
+            economy_chart->refresh();
+        auction.set_budget(money);
+    }
+    update();
+
+}
+
+// Sends the year's report and appends it to yourcompany_reports.csv.
+void MainWindow::publish_year(const YearReport& year)
+{
+    TRACE_SCOPE("MainWindow::publish_year");
+    {
+        ALLOC_SCOPE("turn.publish");
+        ArenaBytes frame((ArenaAllocator<uint8_t>(turn_arena)));
+        year.encode(frame);
+        connector->command_send(cmd_type_report, &frame[0], frame.size());
+
+        ArenaString csv((ArenaAllocator<char>(turn_arena)));
+        year.to_csv(csv);
+        if (!reports_file.isOpen() && reports_file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Unbuffered)
+                && !reports_file.size())
+            reports_file.write(YearReport::csv_header());
+        if (reports_file.isOpen())
+            reports_file.write(csv.data(), csv.size());
+    }
+    statusBar()->showMessage(tr("Year %1 closed: %2 -> %3").arg(year.year).arg(year.money_start).arg(year.money_end));
+}
+
+// Plays turns with GreedyPolicy at YOURCOMPANY_AUTOPLAY_RATE turns a
+// second, as fast as possible when unset, until toggled again. The board
+// only takes input back then.
+void MainWindow::toggle_autoplay()
+{
+    if (autoplay.running()) {
+        autoplay.stop();
+        autoplay_timer->stop();
+        show_autoplay();
+        report = autoplay.report();
+        ui->centralWidget->setEnabled(true);
+        statusBar()->showMessage(tr("Auto-play stopped at turn %1").arg(turn_number));
+        return;
+    }
+    if (gui_state != MAIN_STATE)
+        return;
+    autoplay.start(capture_state(), report, boost::shared_ptr<TurnPolicy>(new GreedyPolicy),
+                   qgetenv("YOURCOMPANY_AUTOPLAY_RATE").toDouble());
+    ui->centralWidget->setEnabled(false);
+    // one refresh of the board per displayed frame, however many turns went by
+    qreal refresh = QGuiApplication::primaryScreen() ? QGuiApplication::primaryScreen()->refreshRate() : 60;
+    autoplay_timer->start(qMax(1, qRound(1000 / (refresh > 0 ? refresh : 60))));
+}
+
+void MainWindow::show_autoplay()
+{
+    TRACE_SCOPE("MainWindow::show_autoplay");
+    STALL_SCOPE("MainWindow::show_autoplay");
+    AutoPlayer::Progress progress;
+    autoplay.take(progress);
+    for (std::size_t i = 0; i < progress.turns.size(); ++i)
+        record_turn(*progress.turns[i], progress.reports[i]);
+    turn_arena.reset();
+    for (std::size_t i = 0; i < progress.years.size(); ++i)
+        publish_year(progress.years[i]);
+    if (progress.turns.empty())
+        return;
+    const boost::shared_ptr<const GameState>& state = progress.turns.back();
+    restore_state(*state);
+    autosave->submit(state);
+    if (economy_chart)
+        economy_chart->refresh();
+    statusBar()->showMessage(tr("Auto-play: turn %1").arg(state->turn));
+}
+
+GameState MainWindow::capture_state() const
+{
+    GameState state;
+    state.turn = turn_number;
+    state.money = money;
+    state.materials = materials;
+    state.credit_max_time = credit_max_time;
+    state.count_year = count_year;
+    memcpy(state.debit, debit, sizeof(state.debit));
+
+    state.products.reserve(products.size());
+    for (std::size_t i = 0; i < products.size(); ++i)
+        state.products.push_back(products[i].type == Product::TypeA ? GameState::ProductA : GameState::ProductB);
+
+    for (std::size_t i = 0; i < CreditLines.size(); ++i) {
+        GameState::CreditLine credit = { CreditLines[i].time, CreditLines[i].money };
+        state.credit_lines.push_back(credit);
+    }
+
+    for (std::list<ProductLine*>::const_iterator it = ProductLines.begin(); it != ProductLines.end(); ++it) {
+        GameState::Line line;
+        line.product_type = (*it)->product_type == "A" ? GameState::ProductA : GameState::ProductB;
+        line.line_type = (*it)->product_line_type == "A" ? GameState::ProductA : GameState::ProductB;
+        line.loaded = (*it)->button && !(*it)->button->isEnabled();
+        line.have_materials.assign((*it)->MatPerTime.have_materials.begin(), (*it)->MatPerTime.have_materials.end());
+        state.lines.push_back(line);
+    }
+
+    for (std::size_t i = 0; i < markets.size(); ++i) {
+        GameState::Market market = { markets[i].name, markets[i].price, markets[i].time, markets[i].selected };
+        state.markets.push_back(market);
+    }
+
+    for (std::size_t i = 0; i < contracts.size(); ++i) {
+        GameState::Contract contract = { contracts[i].a, contracts[i].priceA, contracts[i].b, contracts[i].priceB,
+                                         contracts[i].market, contracts[i].offer };
+        state.contracts.push_back(contract);
+    }
+    return state;
+}
+
+void MainWindow::restore_state(const GameState &state)
+{
+    turn_number = state.turn;
+    money = state.money;
+    materials = state.materials;
+    credit_max_time = state.credit_max_time;
+    count_year = state.count_year;
+    memcpy(debit, state.debit, sizeof(debit));
+
+    products.resize(state.products.size());
+    for (std::size_t i = 0; i < state.products.size(); ++i)
+        products[i].type = state.products[i] == GameState::ProductA ? Product::TypeA : Product::TypeB;
+
+    CreditLines.clear();
+    for (std::size_t i = 0; i < state.credit_lines.size(); ++i)
+        CreditLines.push_back(CreditLine(state.credit_lines[i].time, state.credit_lines[i].money));
+
+    // lines of the same kind as before keep their widgets, the auto-player
+    // restores a state every frame
+    std::list<ProductLine*>::iterator kept = ProductLines.begin();
+    for (std::size_t i = 0; i < state.lines.size(); ++i) {
+        const GameState::Line& saved = state.lines[i];
+        QString product_type = saved.product_type == GameState::ProductA ? "A" : "B";
+        QString line_type = saved.line_type == GameState::ProductA ? "A" : "B";
+        if (kept != ProductLines.end()
+                && ((*kept)->product_type != product_type || (*kept)->product_line_type != line_type)) {
+            for (std::list<ProductLine*>::iterator it = kept; it != ProductLines.end(); ++it)
+                delete *it;
+            ProductLines.erase(kept, ProductLines.end());
+            kept = ProductLines.end();
         }
-        if (debit[3] > 0)
-            money += debit[3];
-        for (int i = 3; i > 0; --i) {
-            debit[i] = debit[i - 1];
-            debit[i - 1] = 0;
+        ProductLine* product_line;
+        if (kept != ProductLines.end()) {
+            product_line = *kept++;
+        } else {
+            product_line = new ProductLine(this, product_type, line_type, &materials, products);
+            ProductLines.push_back(product_line);
+            create_product_line_widgets(product_line);
         }
-        --count_year;
-        if (!count_year) {
-            for (std::size_t i = 0; i < markets.size(); ++i) {
-                markets[i].recount_after();
-                markets[i].recount_before();
+        std::deque<bool>& have_materials = product_line->MatPerTime.have_materials;
+        for (std::size_t slot = 0; slot < have_materials.size(); ++slot)
+            have_materials[slot] = slot < saved.have_materials.size() && saved.have_materials[slot];
+        product_line->button->setEnabled(!saved.loaded);
+    }
+    for (std::list<ProductLine*>::iterator it = kept; it != ProductLines.end(); ++it)
+        delete *it;
+    ProductLines.erase(kept, ProductLines.end());
+    ui->BuyNewProductLine->setEnabled(ProductLines.size() <= 3);
+
+    for (std::size_t i = 0; i < state.markets.size(); ++i) {
+        for (std::size_t m = 0; m < markets.size(); ++m) {
+            if (markets[m].name == state.markets[i].name) {
+                markets[m].price = state.markets[i].price;
+                markets[m].time = state.markets[i].time;
+                markets[m].selected = state.markets[i].selected;
             }
-            count_year = 4;
         }
     }
-    repaint();
 
+    contracts.clear();
+    for (std::size_t i = 0; i < state.contracts.size(); ++i) {
+        Contract contract = { state.contracts[i].a, state.contracts[i].price_a,
+                              state.contracts[i].b, state.contracts[i].price_b,
+                              state.contracts[i].market, state.contracts[i].offer };
+        contracts.push_back(contract);
+    }
+    auction.set_budget(money);
+    update();
+}
+
+void MainWindow::resume_autosave()
+{
+    if (resume_checked)
+        return;
+    resume_checked = true;
+    GameState saved;
+    if (Autosave::load(autosave->file_path(), saved)) {
+        restore_state(saved);
+        statusBar()->showMessage(tr("Resumed saved game at turn %1").arg(saved.turn));
+    }
+    history.clear();
+    turn_reports.clear();
+    economy.truncate(0);
+    economy_versions.clear();
+    GameState state = capture_state();
+    record_turn(state, boost::shared_ptr<const ReportBuilder>(new ReportBuilder(report)));
+}
+
+// Adds a played turn to the history and the economy series together with the
+// running year as the turn left it, which undo and redo put back.
+void MainWindow::record_turn(const GameState& state, const boost::shared_ptr<const ReportBuilder>& year)
+{
+    std::size_t id = history.record(state);
+    turn_reports.resize(id + 1);
+    turn_reports[id] = year;
+    economy.append(state);
+    economy_versions.push_back(id);
+}
+
+// Makes the economy series follow the versions from the first one to the
+// head: rows of undone turns or of another branch are dropped and the
+// head's turns the series doesn't have yet are added.
+void MainWindow::rewind_economy()
+{
+    std::vector<TurnHistory::VersionPtr> path;
+    for (TurnHistory::VersionPtr version = history.head(); version; version = version->parent)
+        path.push_back(version);
+    std::reverse(path.begin(), path.end());
+
+    std::size_t kept = 0;
+    while (kept < path.size() && kept < economy_versions.size() && economy_versions[kept] == path[kept]->id)
+        ++kept;
+    economy.truncate(kept);
+    economy_versions.resize(kept);
+    for (std::size_t i = kept; i < path.size(); ++i) {
+        GameState state;
+        path[i]->to_state(state);
+        economy.append(state);
+        economy_versions.push_back(path[i]->id);
+    }
+    if (economy_chart)
+        economy_chart->refresh();
+}
+
+void MainWindow::show_history_head()
+{
+    boost::shared_ptr<GameState> state(new GameState);
+    history.head()->to_state(*state);
+    restore_state(*state);
+    report = *turn_reports[history.head()->id];
+    rewind_economy();
+    autosave->submit(state);
+    statusBar()->showMessage(tr("Turn %1 (version %2 of %3)")
+                             .arg(state->turn).arg(history.head()->id).arg(history.size()));
+}
+
+void MainWindow::show_economy()
+{
+    if (!economy_chart)
+        economy_chart = new EconomyChart(&economy);
+    economy_chart->show();
+    economy_chart->raise();
+}
+
+void MainWindow::show_auction()
+{
+    // pops up once per auction, a panel closed during it stays closed
+    AuctionClient::State state = auction.state();
+    if (state.outcome != AuctionClient::Open || (auction_panel && state.id == auction_shown))
+        return;
+    auction_shown = state.id;
+    if (!auction_panel) {
+        auction_panel = new AuctionPanel(&auction);
+        connect(auction_panel, SIGNAL(bidRequested(int)), this, SLOT(place_bid(int)));
+    }
+    auction_panel->show();
+    auction_panel->raise();
+}
+
+void MainWindow::place_bid(int level)
+{
+    TRACE_SCOPE("MainWindow::place_bid");
+    AuctionClient::Frame frame;
+    if (auction.take_bid(level, frame))
+        connector->frame_send(frame);
+}
+
+// The history only moves while the player has the board, not during
+// auto-play, whose turns are recorded on top of the head.
+void MainWindow::undo_turn()
+{
+    if (gui_state == MAIN_STATE && !autoplay.running() && history.undo())
+        show_history_head();
+}
+
+void MainWindow::redo_turn()
+{
+    if (gui_state == MAIN_STATE && !autoplay.running() && history.redo())
+        show_history_head();
+}
+
+void MainWindow::branch_from_turn()
+{
+    if (gui_state != MAIN_STATE || autoplay.running() || !history.size())
+        return;
+    bool ok = false;
+    int id = QInputDialog::getInt(this, tr("Branch from turn"), tr("Version:"),
+                                  static_cast<int>(history.head()->id), 0,
+                                  static_cast<int>(history.size()) - 1, 1, &ok);
+    if (ok && history.checkout(id))
+        show_history_head();
 }
 
 QRect MainWindow::new_location_product_line()
@@ -801,34 +850,40 @@ QRect MainWindow::new_location_product_line()
 
 void MainWindow::add_materials()
 {
+    TRACE_SCOPE("MainWindow::add_materials");
+    STALL_SCOPE("MainWindow::add_materials");
     bool ok = false;
-    int count_materials = QInputDialog::getInt(this, tr("Type Product Materials"),
-                                         tr("Type Product Materials (input A or B):"), 0, 0, 1000, 1, &ok);
+    int count_materials;
+    {
+        STALL_MODAL_SCOPE();
+        count_materials = QInputDialog::getInt(this, tr("Type Product Materials"),
+                                               tr("Type Product Materials (input A or B):"), 0, 0, 1000, 1, &ok);
+    }
     if (ok && (count_materials)) {
         if (money > 0) {
             money -= 2 * count_materials;
             materials += count_materials;
-            repaint();
+            auction.set_budget(money);
+            update();
         } else {
             QMessageBox msgBox;
             msgBox.setText("No money");
             msgBox.setStandardButtons(QMessageBox::Ok);
+            STALL_MODAL_SCOPE();
             msgBox.exec();
         }
     }
 
 }
 
+// Fills every contract the stock covered when the sale started, compacting
+// products and contracts in place.
 void MainWindow::sale_products()
 {
-//    bool ok = false;
-//    QString materials = QInputDialog::getText(this, tr("Sale Product"),
-//                                         tr("What products do you want to sale (FOR EXAMPLE 10A2B) ?"), QLineEdit::Normal,
-//                                                "", &ok);
-//    QRegExp rx("(\\d+)[A|a](\\d+)[B|b]");
-//    if (rx.indexIn(materials) != -1) {
-//        int a = rx.cap(1).toInt();
-//        int b = rx.cap(2).toInt();
+    TRACE_SCOPE("MainWindow::sale_products");
+    STALL_SCOPE("MainWindow::sale_products");
+    {
+        ALLOC_SCOPE("turn.sale");
         int count_a = 0, count_b = 0;
         for (std::size_t i = 0; i < products.size() ; ++i) {
             if (products[i].type == Product::TypeA)
@@ -836,61 +891,62 @@ void MainWindow::sale_products()
             else
                 ++count_b;
         }
-//        if (count_a < a || count_b < b) {
-//            QMessageBox msgBox;
-//            msgBox.setText("No products");
-//            msgBox.setStandardButtons(QMessageBox::Ok);
-//            msgBox.exec();
-//        } else {
-            for (std::size_t j = 0; j < contracts.size();) {
-                if (contracts[j].a <= count_a && contracts[j].b <= count_b) {
-                    for (std::size_t i = 0; i < products.size() ;) {
-                        if (products[i].type == Product::TypeA && contracts[j].a > 0) {
-                            products.erase(products.begin() + i);
-                            std::vector<Product>(products).swap(products);
-                            --contracts[j].a;
-                            debit[0] += contracts[j].priceA;
-                        } else if (products[i].type == Product::TypeB && contracts[j].b > 0) {
-                            products.erase(products.begin() + i);
-                            std::vector<Product>(products).swap(products);
-                            --contracts[j].b;
-                            debit[0] += contracts[j].priceB;
-                        } else {
-                            ++i;
-                        }
-                    }
-                    contracts.erase(contracts.begin() + j);
-                    std::vector<Contract>(contracts).swap(contracts);
+        std::size_t open = 0;
+        for (std::size_t j = 0; j < contracts.size(); ++j) {
+            Contract& contract = contracts[j];
+            if (contract.a > count_a || contract.b > count_b) {
+                contracts[open++] = contract;
+                continue;
+            }
+            std::size_t kept = 0;
+            for (std::size_t i = 0; i < products.size(); ++i) {
+                if (products[i].type == Product::TypeA && contract.a > 0) {
+                    --contract.a;
+                    debit[0] += contract.priceA;
+                    report.sale(contract.market, GameState::ProductA, contract.priceA);
+                } else if (products[i].type == Product::TypeB && contract.b > 0) {
+                    --contract.b;
+                    debit[0] += contract.priceB;
+                    report.sale(contract.market, GameState::ProductB, contract.priceB);
                 } else {
-                    ++j;
+                    products[kept++] = products[i];
                 }
             }
-            repaint();
-//        }
-//    } else {
-//        QMessageBox msgBox;
-//        msgBox.setText("Bad Info");
-//        msgBox.setStandardButtons(QMessageBox::Ok);
-//        msgBox.exec();
-//    }
+            products.resize(kept);
+        }
+        contracts.resize(open);
+    }
+    update();
 }
 
 void MainWindow::on_BuyNewProductLine_clicked()
 {
+    TRACE_SCOPE("MainWindow::on_BuyNewProductLine_clicked");
+    STALL_SCOPE("MainWindow::on_BuyNewProductLine_clicked");
     bool ok;
-    QString type_product = QInputDialog::getText(this, tr("Type Product"),
-                                         tr("Type Product (input A or B):"), QLineEdit::Normal,
-                                         "", &ok);
-    if (ok && (type_product == "A" || type_product == "B")) {
-        QString type_product_line = QInputDialog::getText(this, tr("Type Product Line"),
-                                             tr("Type Product Line (input A or B):"), QLineEdit::Normal,
+    QString type_product;
+    {
+        STALL_MODAL_SCOPE();
+        type_product = QInputDialog::getText(this, tr("Type Product"),
+                                             tr("Type Product (input A or B):"), QLineEdit::Normal,
                                              "", &ok);
+    }
+    if (ok && (type_product == "A" || type_product == "B")) {
+        QString type_product_line;
+        {
+            STALL_MODAL_SCOPE();
+            type_product_line = QInputDialog::getText(this, tr("Type Product Line"),
+                                                      tr("Type Product Line (input A or B):"), QLineEdit::Normal,
+                                                      "", &ok);
+        }
         if (ok && (type_product_line == "A" || type_product_line == "B")) {
             ProductLine* product_line = new ProductLine(this, type_product, type_product_line, &materials, products);
             if (money >= product_line->price) {
                 money -= product_line->price;
                 ProductLines.push_back(product_line);
-                repaint();
+                create_product_line_widgets(product_line);
+                auction.set_budget(money);
+                update();
             }
         }
     }
@@ -901,18 +957,30 @@ void MainWindow::on_BuyNewProductLine_clicked()
 
 void MainWindow::on_NewCredit_clicked()
 {
+    TRACE_SCOPE("MainWindow::on_NewCredit_clicked");
+    STALL_SCOPE("MainWindow::on_NewCredit_clicked");
     bool ok;
-    int credit_time = QInputDialog::getInt(this, tr("Credit time"),
-                                         tr("Credit time (input number):"), 0, 0, 1000, 0,
-                                         &ok);
+    int credit_time;
+    {
+        STALL_MODAL_SCOPE();
+        credit_time = QInputDialog::getInt(this, tr("Credit time"),
+                                           tr("Credit time (input number):"), 0, 0, 1000, 0,
+                                           &ok);
+    }
     if (ok && credit_time) {
-        int credit_money = QInputDialog::getInt(this, tr("Credit money"),
-                                             tr("Credit money (input number):"), 0, 0, 1000, 0,
-                                             &ok);
+        int credit_money;
+        {
+            STALL_MODAL_SCOPE();
+            credit_money = QInputDialog::getInt(this, tr("Credit money"),
+                                                tr("Credit money (input number):"), 0, 0, 1000, 0,
+                                                &ok);
+        }
         if (ok && credit_money) {
             CreditLines.push_back(CreditLine(credit_time, credit_money));
             money += credit_money;
-            repaint();
+            report.credit_drawn(credit_money);
+            auction.set_budget(money);
+            update();
         }
     }
 }
@@ -940,12 +1008,11 @@ void MainWindow::process(int status)
     case STATE_CONNECTED:
     {
          statusBar()->showMessage(tr("Connected"));
-         gui_state = MAIN_STATE;
-         ui->NewCredit->show();
+         set_gui_state(MAIN_STATE);
          ui->BuyNewProductLine->show();
          ui->Market->show();
          ui->Start->setText("Step");
-         repaint();
+         resume_autosave();
         break;
     }
     case STATE_INVALID_LOGIN:
@@ -960,36 +1027,188 @@ void MainWindow::process(int status)
 void MainWindow::update_contract_info(QString contract_info)
 {
 //     updater->update_contract_info(contract_info);
-    QMessageBox msgBox;
-    QRegExp rx("(\\d+)[A|a](\\d+)/(\\d+)[B|b](\\d+)/(.*)");
-    if (rx.indexIn(contract_info) != -1)
+    TRACE_SCOPE("MainWindow::update_contract_info");
+    STALL_SCOPE("MainWindow::update_contract_info");
+    // protocol 1 replies do not say which request they answer; the market
+    // is recognized by name
+    std::string text = contract_info.toStdString();
+    int32_t a, price_a, b, price_b;
+    wire::Text market;
+    PendingOffer offer = { -1, contract_info, true };
+    if (msg::GetContractOk::decode(text.data(), text.size(), a, price_a, b, price_b, market))
     {
         for (std::size_t i = 0; i < markets.size(); ++i) {
-            if (markets[i].name == rx.cap(5).toStdString()) {
-                index_current_market = i;
+            if (wire::Text(markets[i].name) == market) {
+                offer.market = static_cast<int>(i);
             }
         }
     }
+    pending_offers.push_back(offer);
+    show_pending_offers();
+//    connector->
+
+}
+
+// market is where the offer came from, -1 if it isn't known.
+void MainWindow::offer_contract(const QString &contract_info, int market)
+{
+    QMessageBox msgBox;
     msgBox.setText(contract_info);
     msgBox.setStandardButtons(QMessageBox::Yes | QMessageBox::No);
-    int info = msgBox.exec();
+    int info;
+    {
+        TRACE_SCOPE("QMessageBox::exec");
+        STALL_MODAL_SCOPE();
+        info = msgBox.exec();
+    }
     if (info == QMessageBox::Yes) {
-        if (rx.indexIn(contract_info) != -1) {
-            contracts.push_back({rx.cap(1).toInt(),
-                                rx.cap(2).toInt(),
-                                rx.cap(3).toInt(),
-                                rx.cap(4).toInt() });
+        std::string text = contract_info.toStdString();
+        int32_t a, price_a, b, price_b;
+        wire::Text market_name;
+        if (msg::GetContractOk::decode(text.data(), text.size(), a, price_a, b, price_b, market_name)) {
+            Contract contract = { a, price_a, b, price_b, market, 0 };
+            // protocol 1 servers don't know cmd_type_accept_contract, the
+            // contract is only taken locally as before
+            if (connector->protocol_version() >= 2) {
+                contract.offer = next_offer++;
+                uint32_t seq = commitments.submit(boost::bind(&Commitments::accept, boost::placeholders::_1,
+                                                              contract.offer));
+                connector->request(cmd_type_accept_contract, cmd_type_accept_contract_ok,
+                                   reinterpret_cast<const uint8_t*>(text.data()), text.size(),
+                                   boost::bind(&MainWindow::action_reply, this, seq,
+                                               static_cast<uint8_t>(cmd_type_accept_contract_ok),
+                                               boost::placeholders::_1, boost::placeholders::_2,
+                                               boost::placeholders::_3));
+            }
+            // the auto-player owns the game state while it runs
+            if (autoplay.running()) {
+                GameState::Contract played = { contract.a, contract.priceA, contract.b, contract.priceB,
+                                               contract.market, contract.offer };
+                autoplay.add_contract(played);
+            } else {
+                contracts.push_back(contract);
+            }
         }
     }
-    connector->command_send(cmd_type_get_contract, reinterpret_cast<uint8_t*>(&opened_markets[0]), opened_markets.size());
-//    connector->
+}
+
+void MainWindow::request_contracts(std::size_t market)
+{
+    std::vector<wire::Text> names(1, wire::Text(markets[market].name));
+    std::string payload;
+    msg::GetContract::encode(payload, names);
+    connector->request(msg::GetContract::cmd, cmd_type_get_contract_ok,
+                       reinterpret_cast<const uint8_t*>(payload.data()), payload.size(),
+                       boost::bind(&MainWindow::contract_reply, this, static_cast<int>(market),
+                                   boost::placeholders::_1, boost::placeholders::_2, boost::placeholders::_3));
+}
+
+// Runs on the connector thread.
+void MainWindow::contract_reply(int market, uint8_t cmd, const uint8_t *data, uint32_t size)
+{
+    if (cmd != cmd_type_get_contract_ok || !data)
+        return;
+    QMetaObject::invokeMethod(this, "contract_offer_received", Qt::QueuedConnection, Q_ARG(int, market),
+                              Q_ARG(QString, QString::fromUtf8(reinterpret_cast<const char*>(data), size)));
+}
+
+void MainWindow::submit_formed()
+{
+    uint32_t seq = commitments.submit(&Commitments::form);
+    form_closed();
+    std::string payload;
+    msg::Formed::encode(payload, login);
+    connector->request(msg::Formed::cmd, cmd_type_formed_ok,
+                       reinterpret_cast<const uint8_t*>(payload.data()), payload.size(),
+                       boost::bind(&MainWindow::action_reply, this, seq, static_cast<uint8_t>(cmd_type_formed_ok),
+                                   boost::placeholders::_1, boost::placeholders::_2, boost::placeholders::_3));
+}
+
+// Runs on the connector thread. Anything but the expected reply, including
+// the cmd_type_err of a lost connection, turns the action down.
+void MainWindow::action_reply(uint32_t seq, uint8_t reply_cmd, uint8_t cmd, const uint8_t*, uint32_t)
+{
+    QMetaObject::invokeMethod(this, "action_ruled", Qt::QueuedConnection, Q_ARG(uint, seq),
+                              Q_ARG(bool, cmd == reply_cmd));
+}
 
+void MainWindow::action_ruled(uint seq, bool accepted)
+{
+    TRACE_SCOPE("MainWindow::action_ruled");
+    if (accepted) {
+        commitments.confirm(seq);
+        return;
+    }
+    std::vector<uint32_t> offers = commitments.predicted().offers;
+    if (!commitments.reject(seq))
+        return;
+    // undo whatever of the prediction the replay no longer produces
+    const Commitments& predicted = commitments.predicted();
+    if (!predicted.formed)
+        form.show();
+    // the auto-player owns the contracts while it runs
+    for (std::size_t i = 0; autoplay.running() && i < offers.size(); ++i) {
+        if (std::find(predicted.offers.begin(), predicted.offers.end(), offers[i]) == predicted.offers.end())
+            autoplay.withdraw_offer(offers[i]);
+    }
+    for (std::size_t j = 0; j < contracts.size();) {
+        if (contracts[j].offer && std::find(predicted.offers.begin(), predicted.offers.end(),
+                                            contracts[j].offer) == predicted.offers.end())
+            contracts.erase(contracts.begin() + j);
+        else
+            ++j;
+    }
+    statusBar()->showMessage(tr("The server turned down an action, it has been undone"));
+    update();
+}
+
+void MainWindow::contract_offer_received(int market, QString contract_info)
+{
+    TRACE_SCOPE("MainWindow::contract_offer_received");
+    STALL_SCOPE("MainWindow::contract_offer_received");
+    PendingOffer offer = { market, contract_info, false };
+    pending_offers.push_back(offer);
+    show_pending_offers();
 }
 
-void MainWindow::show_change_users(QString list_users)
+// One dialog at a time: offers arriving while it is open wait in
+// pending_offers, and the server is asked for the next offer once the
+// last one has been answered.
+void MainWindow::show_pending_offers()
 {
+    if (offer_dialog_open)
+        return;
+    offer_dialog_open = true;
+    while (!pending_offers.empty()) {
+        PendingOffer offer = pending_offers.front();
+        pending_offers.pop_front();
+        index_current_market = offer.market;
+        offer_contract(offer.contract_info, offer.market);
+        if (offer.all_markets)
+            connector->command_send(msg::GetContract::cmd, reinterpret_cast<uint8_t*>(&opened_markets[0]), opened_markets.size());
+        else if (gui_state == MARKET_STATE)
+            request_contracts(offer.market);
+    }
+    offer_dialog_open = false;
+}
+
+void MainWindow::show_change_users()
+{
+    TRACE_SCOPE("MainWindow::show_change_users");
+    STALL_SCOPE("MainWindow::show_change_users");
+    std::vector<RosterDelta> deltas;
+    updater->take_roster_deltas(deltas);
+    bool changed = false;
+    for (std::size_t i = 0; i < deltas.size(); ++i) {
+        Roster::Result result = roster.apply(deltas[i]);
+        if (result == Roster::Gap)
+            connector->request_roster();
+        changed = changed || result == Roster::Applied;
+    }
+    if (!changed)
+        return;
     form.show();
-    form.form_ui->label->setText(QString("User List:\n") + list_users);
+    form.form_ui->label->setText(tr("User List: %1").arg(roster.size()));
 }
 
 void MainWindow::form_closed()
@@ -1060,6 +1279,8 @@ void ProductLine::create_empty_triangles_in_product_line(QPainter& p)
 
 void ProductLine::DownloadMaterials_clicked()
 {
+    TRACE_SCOPE("ProductLine::DownloadMaterials_clicked");
+    STALL_SCOPE("ProductLine::DownloadMaterials_clicked");
     int count = product_type == "A" ? 1 : 2;
     if (MatPerTime.materials_in_line) {
         if (*MatPerTime.materials_in_line - count >= 0) {
@@ -1068,7 +1289,7 @@ void ProductLine::DownloadMaterials_clicked()
             button->setEnabled(false);
         }
     }
-    parent->repaint();
+    parent->update();
 }
 
 ProductLine::_MatPerTime::_MatPerTime(int *_materials, std::vector<Product> &_products)
@@ -1112,7 +1333,7 @@ void Dialog::on_buttonBox_clicked(QAbstractButton *button)
 {
     if (!dialog_ui->LoginEdit->text().isEmpty() && !dialog_ui->PasswordEdit->text().isEmpty()) {
         connector->stop();
-        connector->start("81.177.175.71", 5000,
+        connector->start(parent_window->server,
              dialog_ui->LoginEdit->text().toStdString(), dialog_ui->PasswordEdit->text().toStdString());
         parent_window->login = dialog_ui->LoginEdit->text().toStdString();
     } else {
@@ -1124,7 +1345,7 @@ void Dialog::on_pushButton_clicked()
 {
      if (!dialog_ui->LoginEdit->text().isEmpty() && !dialog_ui->PasswordEdit->text().isEmpty()) {
          connector->stop();
-         connector->start("81.177.175.71", 5000,
+         connector->start(parent_window->server,
               dialog_ui->LoginEdit->text().toStdString(), dialog_ui->PasswordEdit->text().toStdString());
         parent_window->login = dialog_ui->LoginEdit->text().toStdString();
          this->close();
@@ -1136,82 +1357,48 @@ void Dialog::on_pushButton_clicked()
      }
 }
 
-void GUIUpdater::system_state_update(StateType new_state, bool force)
-{
-    if (state == new_state)
-        return;
-    if (!force && state == STATE_INVALID_LOGIN && new_state == STATE_DISCONNECTED)
-        return;
-    state = new_state;
-}
-
-void GUIUpdater::update_contract_info(const std::string &_contract_info)
-{
-    contract_info = _contract_info;
-}
-
-void GUIUpdater::show_usr_list(const std::string &_usr_list)
-{
-    usr_list = _usr_list;
-}
-
-void GUIUpdater::form_closed()
-{
-    emit requestFormClosed();
-}
-
-void GUIUpdater::newLabel() {
-    while(1)
-    {
-        if (state == STATE_DISCONNECTED ||
-                state == STATE_CONNECTED ||
-                state == STATE_INVALID_LOGIN)
-            emit requestNewLabel(state);
-        state = STATE_IDLE;
-        if (!contract_info.empty()) {
-            emit requestNewUpdateInfo(QString(contract_info.c_str()));
-            contract_info = "";
-        }
-        if (!usr_list.empty()) {
-             emit requestChangeUsers(QString(usr_list.c_str()));
-             usr_list = "";
-        }
-        Sleep(100);
-    }
-}
-
 void MainWindow::on_Market_clicked()
 {
     if (gui_state == MAIN_STATE) {
-        gui_state = MARKET_STATE;
+        set_gui_state(MARKET_STATE);
         ui->Market->setText("Go to Production");
+        std::vector<wire::Text> names;
         for (std::size_t i = 0; i < markets.size(); ++i) {
             if (markets[i].is_opened())
-                opened_markets += markets[i].name + "/";
+                names.push_back(wire::Text(markets[i].name));
+        }
+        opened_markets.clear();
+        msg::GetContract::encode(opened_markets, names);
+        if (connector->protocol_version() >= 2) {
+            // one request per market, all in flight at once
+            for (std::size_t i = 0; i < markets.size(); ++i) {
+                if (markets[i].is_opened())
+                    request_contracts(i);
+            }
+        } else {
+            connector->command_send(msg::GetContract::cmd, reinterpret_cast<uint8_t*>(&opened_markets[0]), opened_markets.size());
         }
-        connector->command_send(cmd_type_get_contract, reinterpret_cast<uint8_t*>(&opened_markets[0]), opened_markets.size());
     } else {
-        gui_state = MAIN_STATE;
+        set_gui_state(MAIN_STATE);
         ui->Market->setText("Go to Market");
     }
-    repaint();
 }
 
-MainWindow::Market::Market(const std::string &_name, QRect _rect, Qt::GlobalColor _color, int *_money) :
+MainWindow::Market::Market(const std::string &_name, QRect _rect, QColor _color, int *_money) :
     price(1),
     time(1)
 {
     init(_name, _rect, _color, _money);
 }
 
-MainWindow::Market::Market(const std::string &_name, QRect _rect, Qt::GlobalColor _color, int *_money, int _price, int _time) :
+MainWindow::Market::Market(const std::string &_name, QRect _rect, QColor _color, int *_money, int _price, int _time) :
     price(_price),
     time(_time)
 {
     init(_name, _rect, _color, _money);
 }
 
-void MainWindow::Market::init(const std::string &_name, QRect _rect, Qt::GlobalColor _color, int *_money)
+void MainWindow::Market::init(const std::string &_name, QRect _rect, QColor _color, int *_money)
 {
     name = _name;
     rect = _rect;
@@ -1242,5 +1429,5 @@ Form::Form(QWidget *parent, MainWindow *_parent_window) :
 
 void Form::on_pushButton_clicked()
 {
-    connector->command_send(cmd_type_formed, reinterpret_cast<uint8_t*>(&parent_window->login[0]), parent_window->login.size());
+    parent_window->submit_formed();
 }
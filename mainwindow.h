@@ -4,7 +4,23 @@
 #include <QMainWindow>
 #include <QAbstractButton>
 #include <QDialog>
+#include <QFile>
 #include <deque>
+#include "boardscene.h"
+#include "marketview.h"
+#include "marketcatalog.h"
+#include "gamestate.h"
+#include "turnhistory.h"
+#include "timeseries.h"
+#include "roster.h"
+#include "rostermodel.h"
+#include "auction.h"
+#include "report.h"
+#include "reconcile.h"
+#include "autoplay.h"
+#include "arena.h"
+#include "guiupdater.h"
+#include <boost/thread/mutex.hpp>
 
 namespace Ui {
 class MainWindow;
@@ -17,19 +33,18 @@ struct Product
     enum _type { TypeA, TypeB } type;
 };
 
-enum StateType {
-    STATE_IDLE = -1,
-    STATE_DISCONNECTED = 0,
-    STATE_CONNECTED,
-    STATE_INVALID_LOGIN
-};
-
-
 class MainWindow;
+class StallWatchdog;
+class Autosave;
+class BenchAccess;
+class EconomyChart;
+class AuctionPanel;
+class QTimer;
 
 class ProductLine : public QWidget
 {
     Q_OBJECT
+    friend class BenchAccess;
     MainWindow* parent;
 public:
     int price;
@@ -98,32 +113,11 @@ private:
     Ui::Dialog *dialog_ui;
 };
 
-class GUIUpdater : public QObject {
-    Q_OBJECT
-    StateType state;
-    std::string contract_info;
-    std::string usr_list;
-public:
-    explicit GUIUpdater(QObject *parent = 0) : QObject(parent), state(STATE_IDLE) { }
-    void system_state_update(StateType new_state, bool force);
-    void update_contract_info(const std::string& _contract_info);
-    void show_usr_list(const std::string& _usr_list);
-    void form_closed();
-public slots:
-    void newLabel();
-
-signals:
-    void requestNewLabel(int);
-    void requestNewUpdateInfo(QString);
-    void requestChangeUsers(QString);
-    void requestFormClosed();
-};
-
-
 class MainWindow : public QMainWindow
 {
     Q_OBJECT
-    enum
+    friend class BenchAccess;
+    enum GuiState
     {
         IDLE_STATE,
         MARKET_STATE,
@@ -161,15 +155,15 @@ class MainWindow : public QMainWindow
         int price;
         int time;
         QRect rect;
-        Qt::GlobalColor color;
+        QColor color;
         int *money;
         bool selected;
 
-        Market(const std::string& _name, QRect _rect, Qt::GlobalColor _color, int *_money);
+        Market(const std::string& _name, QRect _rect, QColor _color, int *_money);
 
-        Market(const std::string& _name, QRect _rect, Qt::GlobalColor _color, int *_money, int _price, int _time);
+        Market(const std::string& _name, QRect _rect, QColor _color, int *_money, int _price, int _time);
 
-        void init(const std::string& _name, QRect _rect, Qt::GlobalColor _color, int *_money);
+        void init(const std::string& _name, QRect _rect, QColor _color, int *_money);
 
         bool is_opened() { return !time; }
 
@@ -184,37 +178,109 @@ class MainWindow : public QMainWindow
         int priceA;
         int b;
         int priceB;
+        int market;     // index into markets, -1 when unknown
+        uint32_t offer; // accepted offer the server rules on, 0 if none
+    };
+
+    // What the player committed to that the server has to accept. Actions
+    // are applied to it at once and undone if the server turns them down.
+    struct Commitments
+    {
+        bool formed;
+        std::vector<uint32_t> offers;   // accepted contract offers
+
+        Commitments() : formed(false) { }
+
+        static void form(Commitments& commitments) { commitments.formed = true; }
+        static void accept(Commitments& commitments, uint32_t offer) { commitments.offers.push_back(offer); }
     };
 
     std::vector<Contract> contracts;
 
+    // A cmd_type_get_contract_ok waiting for its dialog.
+    struct PendingOffer
+    {
+        int market;             // -1 if no market has its name
+        QString contract_info;
+        bool all_markets;       // protocol 1: answers opened_markets, not one market
+    };
+
     std::vector<Market> markets;
     std::vector<CreditLine> CreditLines;
     bool connect_status;
     int count_year;
-    std::string opened_markets;
+    std::string opened_markets;     // msg::GetContract of the markets open on entering them
     std::size_t index_current_market;
+    BoardScene board;
+    MarketView market_view;
+    MarketGrid market_grid;
+    int turn_number;
+    bool resume_checked;
+    Autosave *autosave;
+    TurnHistory history;
+    std::vector<boost::shared_ptr<const ReportBuilder> > turn_reports;     // by history version id
+    TimeSeries economy;
+    std::vector<std::size_t> economy_versions;      // the history version of each economy row
+    Roster roster;
+    RosterModel roster_model;
+    AuctionClient auction;
+    AuctionPanel *auction_panel;
+    uint32_t auction_shown;         // the auction the panel last popped up for
+    ReportBuilder report;
+    YearReport closed_year;
+    QFile reports_file;
+    // Temporaries of the turn being played, see on_Start_clicked().
+    Arena turn_arena;
+    EconomyChart *economy_chart;
+    Reconciler<Commitments> commitments;
+    uint32_t next_offer;
+    std::deque<PendingOffer> pending_offers;
+    bool offer_dialog_open;
+    AutoPlayer autoplay;
+    QTimer *autoplay_timer;
 
 public:
     GUIUpdater *updater;
+    StallWatchdog *watchdog;
 public:
     explicit MainWindow(QWidget *parent = 0);
     ~MainWindow();
+    // Closes the form before the server has answered cmd_type_formed.
+    void submit_formed();
 private:
     void create_circles(QWidget* group_box, QPainter &p, int finish_count, bool have_credit);
     void create_circles_with_name();
     void set_new_group_box(QWidget*& widget, QWidget*& parent, const std::string& name, QRect rect);
     void set_new_button(QWidget*& widget, QWidget*& parent, QRect rect, ProductLine *product_line);
+    void create_board_widgets();
+    void create_product_line_widgets(ProductLine *product_line);
+    void set_gui_state(GuiState state);
+    void update_board_scene();
     QRect new_location_product_line();
     void add_materials();
     void sale_products();
     void create_triangles(QWidget *group_box, QPainter& p, void *finish_count);
     void create_square(QWidget *group_box, QPainter& p, int finish_count);
     void createStausBar();
+    void rebuild_market_index();
+    GameState capture_state() const;
+    void restore_state(const GameState& state);
+    void resume_autosave();
+    void record_turn(const GameState& state, const boost::shared_ptr<const ReportBuilder>& year);
+    void rewind_economy();
+    void show_history_head();
+    void publish_year(const YearReport& year);
+    void offer_contract(const QString& contract_info, int market);
+    void show_pending_offers();
+    void request_contracts(std::size_t market);
+    void contract_reply(int market, uint8_t cmd, const uint8_t* data, uint32_t size);
+    void action_reply(uint32_t seq, uint8_t reply_cmd, uint8_t cmd, const uint8_t* data, uint32_t size);
 
 protected:
     void paintEvent(QPaintEvent *);
+    void changeEvent(QEvent *event);
     void mousePressEvent(QMouseEvent *event);
+    void mouseMoveEvent(QMouseEvent *event);
 
 private slots:
     void on_Start_clicked();
@@ -229,11 +295,33 @@ private slots:
 
     void on_Market_clicked();
 
+    void flush_trace();
+
+    void undo_turn();
+
+    void redo_turn();
+
+    void branch_from_turn();
+
+    void show_economy();
+
+    void show_auction();
+
+    void place_bid(int level);
+
+    void toggle_autoplay();
+
+    void show_autoplay();
+
+    void report_stall(QString handler, int duration_ms);
+
 public slots:
     void process(int status);
     void update_contract_info(QString contract_info);
-    void show_change_users(QString list_users);
+    void contract_offer_received(int market, QString contract_info);
+    void show_change_users();
     void form_closed();
+    void action_ruled(uint seq, bool accepted);
 
 private:
     Ui::MainWindow *ui;
@@ -242,6 +330,7 @@ public:
     Form form;
     std::string login;
     std::string password;
+    std::string server;         // endpoint URI, see Endpoint::parse
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,140 @@
+#include "marketcatalog.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+
+bool MarketCatalog::load(const QString& path, std::vector<MarketSpec>& specs, QString* error)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (error)
+            *error = file.errorString();
+        return false;
+    }
+    QJsonParseError parse_error;
+    QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &parse_error);
+    if (document.isNull()) {
+        if (error)
+            *error = parse_error.errorString();
+        return false;
+    }
+
+    QJsonArray markets = document.object().value("markets").toArray();
+    std::vector<MarketSpec> loaded;
+    for (int i = 0; i < markets.size(); ++i) {
+        QJsonObject market = markets[i].toObject();
+        MarketSpec spec;
+        spec.name = market.value("name").toString().toStdString();
+        int size = market.value("size").toInt(0);
+        spec.rect = QRect(market.value("x").toInt(), market.value("y").toInt(),
+                          market.value("width").toInt(size), market.value("height").toInt(size));
+        spec.color = market.value("color").toString("gray");
+        spec.price = market.value("price").toInt(1);
+        spec.time = market.value("time").toInt(1);
+        if (spec.name.empty() || spec.rect.width() <= 0 || spec.rect.height() <= 0 || spec.color.isEmpty()) {
+            if (error)
+                *error = QString("market %1 is incomplete").arg(i);
+            return false;
+        }
+        loaded.push_back(spec);
+    }
+    if (loaded.empty()) {
+        if (error)
+            *error = "no markets";
+        return false;
+    }
+    specs.swap(loaded);
+    return true;
+}
+
+std::vector<MarketCatalog::MarketSpec> MarketCatalog::load_scenario()
+{
+    QString path = QString::fromLocal8Bit(qgetenv("YOURCOMPANY_SCENARIO"));
+    if (path.isEmpty())
+        path = QDir(QCoreApplication::applicationDirPath()).filePath("scenario.json");
+
+    std::vector<MarketSpec> specs;
+    QString error;
+    if (QFile::exists(path) && !load(path, specs, &error))
+        qWarning() << "Scenario" << path << "ignored:" << error;
+    if (specs.empty())
+        specs = default_markets();
+    return specs;
+}
+
+std::vector<MarketCatalog::MarketSpec> MarketCatalog::default_markets()
+{
+    MarketSpec markets[] = {
+        { "A", QRect(270, 50, 250, 250), "red", 1, 1 },
+        { "B", QRect(530, 50, 250, 250), "blue", 1, 1 },
+        { "C", QRect(790, 50, 250, 250), "yellow", 2, 2 },
+        { "CENTRAL", QRect(10, 50, 250, 250), "gray", 0, 0 },
+    };
+    return std::vector<MarketSpec>(markets, markets + sizeof(markets) / sizeof(markets[0]));
+}
+
+MarketGrid::MarketGrid() :
+    cell_size(1),
+    columns(0),
+    rows(0)
+{
+}
+
+void MarketGrid::build(const std::vector<QRect>& _circles)
+{
+    circles = _circles;
+    cells.clear();
+    columns = rows = 0;
+    if (circles.empty())
+        return;
+
+    bounds = circles[0];
+    long long diameters = 0;
+    for (std::size_t i = 0; i < circles.size(); ++i) {
+        bounds |= circles[i];
+        diameters += std::max(circles[i].width(), circles[i].height());
+    }
+    // cells about one average circle across keep every list short
+    cell_size = std::max(1, static_cast<int>(diameters / circles.size()));
+    columns = bounds.width() / cell_size + 1;
+    rows = bounds.height() / cell_size + 1;
+    cells.resize(columns * rows);
+
+    for (std::size_t i = 0; i < circles.size(); ++i) {
+        QRect r = circles[i].translated(-bounds.topLeft());
+        for (int row = r.top() / cell_size; row <= r.bottom() / cell_size; ++row)
+            for (int column = r.left() / cell_size; column <= r.right() / cell_size; ++column)
+                cells[cell_index(column, row)].push_back(static_cast<int>(i));
+    }
+}
+
+int MarketGrid::hit(QPoint point) const
+{
+    if (cells.empty() || !bounds.contains(point))
+        return -1;
+    QPoint local = point - bounds.topLeft();
+    const std::vector<int>& cell = cells[cell_index(local.x() / cell_size, local.y() / cell_size)];
+    for (std::vector<int>::const_reverse_iterator it = cell.rbegin(); it != cell.rend(); ++it) {
+        if (contains(circles[*it], point))
+            return *it;
+    }
+    return -1;
+}
+
+bool MarketGrid::contains(const QRect& circle, QPoint point)
+{
+    // ellipse test in 64 bits: (dx * ry)^2 + (dy * rx)^2 <= (rx * ry)^2, doubled
+    // so that centres of even-sized rectangles stay integral
+    long long rx = circle.width();
+    long long ry = circle.height();
+    long long dx = 2LL * point.x() - (2LL * circle.x() + circle.width());
+    long long dy = 2LL * point.y() - (2LL * circle.y() + circle.height());
+    return (dx * ry) * (dx * ry) + (dy * rx) * (dy * rx) <= (rx * ry) * (rx * ry);
+}
@@ -0,0 +1,65 @@
+#ifndef MARKETCATALOG_H
+#define MARKETCATALOG_H
+
+#include <QPoint>
+#include <QRect>
+#include <QString>
+#include <string>
+#include <vector>
+
+// Markets of a scenario file:
+//
+//   { "markets": [ { "name": "A", "x": 270, "y": 50, "size": 250,
+//                    "color": "red", "price": 1, "time": 1 }, ... ] }
+//
+// "width"/"height" may replace "size"; price and time default to 1. Only
+// QtCore is needed, so the bot host reads the same scenario; the color is
+// kept as the name the window gives QColor.
+class MarketCatalog
+{
+public:
+    struct MarketSpec
+    {
+        std::string name;
+        QRect rect;
+        QString color;
+        int price;
+        int time;
+    };
+
+    static bool load(const QString& path, std::vector<MarketSpec>& specs, QString* error = 0);
+
+    // YOURCOMPANY_SCENARIO, else scenario.json next to the executable,
+    // else the four built-in markets.
+    static std::vector<MarketSpec> load_scenario();
+
+    static std::vector<MarketSpec> default_markets();
+};
+
+// Uniform grid over the market circles. Each cell lists the markets whose
+// bounding rectangle overlaps it, so a hit test only checks the few
+// circles in the cell under the cursor.
+class MarketGrid
+{
+public:
+    MarketGrid();
+
+    void build(const std::vector<QRect>& _circles);
+
+    // Topmost (last drawn) market whose circle contains point, or -1.
+    int hit(QPoint point) const;
+
+    static bool contains(const QRect& circle, QPoint point);
+
+private:
+    int cell_index(int column, int row) const { return row * columns + column; }
+
+    QRect bounds;
+    int cell_size;
+    int columns;
+    int rows;
+    std::vector<QRect> circles;
+    std::vector<std::vector<int> > cells;
+};
+
+#endif // MARKETCATALOG_H
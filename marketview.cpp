@@ -0,0 +1,119 @@
+#include "marketview.h"
+
+#include <QCoreApplication>
+#include <QFontMetricsF>
+#include <QPainter>
+
+MarketView::MarketView() :
+    title_font("Arial", 30),
+    state_font("Arial", 15),
+    labels_valid(false)
+{
+}
+
+void MarketView::resize(std::size_t count)
+{
+    entries.resize(count);
+}
+
+void MarketView::invalidate()
+{
+    labels_valid = false;
+    for (std::size_t i = 0; i < entries.size(); ++i) {
+        entries[i].layout_valid = false;
+        entries[i].pixmap_valid = false;
+    }
+}
+
+void MarketView::prepare_labels()
+{
+    opened_text.setText(QCoreApplication::translate("MainWindow", "Opened"));
+    closed_text.setText(QCoreApplication::translate("MainWindow", "Closed"));
+    opened_text.prepare(QTransform(), state_font);
+    closed_text.prepare(QTransform(), state_font);
+    labels_valid = true;
+}
+
+void MarketView::layout(Entry& entry)
+{
+    // text positions are the baselines the board always used, moved to
+    // the top-left corner QStaticText is drawn from
+    qreal title_ascent = QFontMetricsF(title_font).ascent();
+    qreal state_ascent = QFontMetricsF(state_font).ascent();
+
+    entry.title.setText(QCoreApplication::translate("MainWindow", entry.name.c_str()));
+    entry.title.prepare(QTransform(), title_font);
+    QPoint title(entry.rect.x() + entry.rect.width() / 2
+                 - (entry.name.size() == 1 ? 10 : 30 * (int) (entry.name.size() / 2)),
+                 entry.rect.y() + entry.rect.height() / 2);
+    entry.title_pos = QPointF(title) - QPointF(0, title_ascent);
+
+    QPoint state(entry.rect.x() + entry.rect.width() / 2 - 30,
+                 entry.rect.y() + 40 + entry.rect.height() / 2);
+    entry.state_pos = QPointF(state) - QPointF(0, state_ascent);
+
+    entry.layout_valid = true;
+    entry.pixmap_valid = false;
+}
+
+void MarketView::render(Entry& entry, int state, qreal device_pixel_ratio)
+{
+    QSize size = entry.rect.size() + QSize(2 * Margin, 2 * Margin);
+    entry.pixmap = QPixmap(size * device_pixel_ratio);
+    entry.pixmap.setDevicePixelRatio(device_pixel_ratio);
+    entry.pixmap.fill(Qt::transparent);
+
+    QPainter p(&entry.pixmap);
+    p.translate(-(entry.rect.topLeft() - QPoint(Margin, Margin)));
+    bool selected = state & StateSelected;
+    p.setPen(QPen(selected ? QColor(Qt::green) : entry.color, selected ? 5 : 1, Qt::SolidLine));
+    p.setBrush(QBrush(entry.color));
+    p.drawEllipse(entry.rect);
+
+    p.setPen(QPen(Qt::black, 1, Qt::SolidLine));
+    p.setFont(title_font);
+    p.drawStaticText(entry.title_pos, entry.title);
+    p.setFont(state_font);
+    p.drawStaticText(entry.state_pos, state & StateOpened ? opened_text : closed_text);
+
+    if (state & StateCurrent) {
+        p.setPen(QPen(Qt::blue, 3, Qt::SolidLine));
+        p.setBrush(Qt::NoBrush);
+        QRect rect = entry.rect;
+        rect.setX(rect.x() - 3);
+        rect.setY(rect.y() - 3);
+        rect.setWidth(rect.width() + 4);
+        rect.setHeight(rect.height() + 4);
+        p.drawRect(rect);
+    }
+
+    entry.pixmap_state = state;
+    entry.pixmap_valid = true;
+}
+
+void MarketView::paint(QPainter& p, std::size_t index, const std::string& name, const QRect& rect,
+                       const QColor& color, bool opened, bool selected, bool current)
+{
+    if (index >= entries.size())
+        resize(index + 1);
+    if (!labels_valid)
+        prepare_labels();
+
+    Entry& entry = entries[index];
+    if (entry.name != name || entry.rect != rect || entry.color != color) {
+        entry.name = name;
+        entry.rect = rect;
+        entry.color = color;
+        entry.layout_valid = false;
+    }
+    if (!entry.layout_valid)
+        layout(entry);
+
+    qreal device_pixel_ratio = p.device()->devicePixelRatioF();
+    int state = (opened ? StateOpened : 0) | (selected ? StateSelected : 0) | (current ? StateCurrent : 0);
+    if (!entry.pixmap_valid || entry.pixmap_state != state
+            || entry.pixmap.devicePixelRatio() != device_pixel_ratio)
+        render(entry, state, device_pixel_ratio);
+
+    p.drawPixmap(rect.topLeft() - QPoint(Margin, Margin), entry.pixmap);
+}
@@ -0,0 +1,69 @@
+#ifndef MARKETVIEW_H
+#define MARKETVIEW_H
+
+#include <QColor>
+#include <QFont>
+#include <QPixmap>
+#include <QRect>
+#include <QStaticText>
+#include <string>
+#include <vector>
+
+class QPainter;
+
+// Renderer for the market circles. Fonts, translated labels and their
+// positions are laid out once per market and language; each market is
+// drawn into a cached pixmap that is only redrawn when its open/closed,
+// selected or current state changes.
+class MarketView
+{
+public:
+    MarketView();
+
+    void resize(std::size_t count);
+
+    void paint(QPainter& p, std::size_t index, const std::string& name, const QRect& rect,
+               const QColor& color, bool opened, bool selected, bool current);
+
+    // Drops the text layout, e.g. after a language change.
+    void invalidate();
+
+private:
+    enum
+    {
+        StateOpened = 1,
+        StateSelected = 2,
+        StateCurrent = 4,
+        Margin = 6
+    };
+
+    struct Entry
+    {
+        std::string name;
+        QRect rect;
+        QColor color;
+        QStaticText title;
+        QPointF title_pos;
+        QPointF state_pos;
+        bool layout_valid;
+
+        QPixmap pixmap;
+        int pixmap_state;
+        bool pixmap_valid;
+
+        Entry() : layout_valid(false), pixmap_state(0), pixmap_valid(false) { }
+    };
+
+    void prepare_labels();
+    void layout(Entry& entry);
+    void render(Entry& entry, int state, qreal device_pixel_ratio);
+
+    QFont title_font;
+    QFont state_font;
+    QStaticText opened_text;
+    QStaticText closed_text;
+    bool labels_valid;
+    std::vector<Entry> entries;
+};
+
+#endif // MARKETVIEW_H
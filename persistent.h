@@ -0,0 +1,129 @@
+#ifndef PERSISTENT_H
+#define PERSISTENT_H
+
+#include <boost/shared_ptr.hpp>
+#include <algorithm>
+#include <vector>
+
+// Immutable vector stored as a 32-way trie. updated() builds the next
+// version from a plain std::vector and reuses every leaf and branch whose
+// contents did not change, so consecutive versions share all but the
+// changed paths and keeping many versions alive costs little memory.
+template <class T>
+class PersistentVector
+{
+public:
+    enum { Bits = 5, Width = 1 << Bits, Mask = Width - 1 };
+
+    struct Node
+    {
+        std::vector<boost::shared_ptr<const Node> > children;
+        std::vector<T> values;
+    };
+
+    typedef boost::shared_ptr<const Node> NodePtr;
+
+    PersistentVector() : count(0), shift(0) { }
+
+    std::size_t size() const { return count; }
+
+    bool empty() const { return !count; }
+
+    const T& operator[](std::size_t i) const
+    {
+        const Node* node = root.get();
+        for (unsigned level = shift; level > 0; level -= Bits)
+            node = node->children[(i >> level) & Mask].get();
+        return node->values[i & Mask];
+    }
+
+    void to_vector(std::vector<T>& out) const
+    {
+        out.clear();
+        out.reserve(count);
+        append_leaves(root.get(), out);
+    }
+
+    PersistentVector updated(const std::vector<T>& values) const
+    {
+        PersistentVector next;
+        next.count = values.size();
+        if (values.empty())
+            return next;
+        while ((static_cast<std::size_t>(Width) << next.shift) < values.size())
+            next.shift += Bits;
+
+        NodePtr old = root;
+        // the vector shrank by a level or more: compare against the leftmost subtree
+        for (unsigned level = shift; old && level > next.shift; level -= Bits)
+            old = old->children.empty() ? NodePtr() : old->children[0];
+        // it grew: the old root lines up with the leftmost subtree at its own depth
+        NodePtr grown = shift < next.shift ? root : NodePtr();
+
+        next.root = build(values, 0, next.shift, shift < next.shift ? NodePtr() : old, grown);
+        return next;
+    }
+
+    // Calls visit(node) for every node reachable from this version.
+    template <class Visitor>
+    void visit_nodes(Visitor& visit) const
+    {
+        visit_node(root.get(), visit);
+    }
+
+private:
+    NodePtr build(const std::vector<T>& values, std::size_t offset, unsigned level,
+                  NodePtr old, const NodePtr& grown) const
+    {
+        if (!old && grown && level == shift && offset == 0)
+            old = grown;
+
+        if (!level) {
+            std::size_t end = std::min(values.size(), offset + static_cast<std::size_t>(Width));
+            if (old && old->values.size() == end - offset
+                    && std::equal(old->values.begin(), old->values.end(), values.begin() + offset))
+                return old;
+            boost::shared_ptr<Node> leaf(new Node);
+            leaf->values.assign(values.begin() + offset, values.begin() + end);
+            return leaf;
+        }
+
+        boost::shared_ptr<Node> branch(new Node);
+        std::size_t span = static_cast<std::size_t>(1) << level;
+        bool same = old.get() != NULL;
+        for (std::size_t child = 0; child < Width && offset + child * span < values.size(); ++child) {
+            NodePtr old_child = old && child < old->children.size() ? old->children[child] : NodePtr();
+            branch->children.push_back(build(values, offset + child * span, level - Bits,
+                                             old_child, child ? NodePtr() : grown));
+            same = same && old_child == branch->children.back();
+        }
+        if (same && old->children.size() == branch->children.size())
+            return old;
+        return branch;
+    }
+
+    static void append_leaves(const Node* node, std::vector<T>& out)
+    {
+        if (!node)
+            return;
+        out.insert(out.end(), node->values.begin(), node->values.end());
+        for (std::size_t i = 0; i < node->children.size(); ++i)
+            append_leaves(node->children[i].get(), out);
+    }
+
+    template <class Visitor>
+    static void visit_node(const Node* node, Visitor& visit)
+    {
+        if (!node)
+            return;
+        visit(node);
+        for (std::size_t i = 0; i < node->children.size(); ++i)
+            visit_node(node->children[i].get(), visit);
+    }
+
+    std::size_t count;
+    unsigned shift;
+    NodePtr root;
+};
+
+#endif // PERSISTENT_H
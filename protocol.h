@@ -0,0 +1,111 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include "wire.h"
+
+// Frames are 13, 37, uint32 payload length, cmd, payload. Protocol 2 adds
+// frames starting 13, 38 with a uint32 request id after cmd; the client
+// offers it by appending "\nproto=2" to the cmd_type_auth payload and uses
+// it once cmd_type_auth_ok contains "proto=2". Replies echo the request id,
+// unsolicited frames carry 0.
+#define PROTOCOL_VERSION 2
+
+enum  {
+    cmd_type_auth = 0,
+    cmd_type_auth_ok,
+    cmd_type_formed,
+    cmd_type_get_usr_list,
+    cmd_type_formed_ok,
+    cmd_type_get_contract,
+    cmd_type_get_contract_ok,
+    cmd_type_finish_market,
+    cmd_type_auction,
+    cmd_type_amount,
+    cmd_type_auction_win,
+    cmd_type_auction_lose,
+    cmd_type_report,            // year-end totals, see YearReport::encode
+    cmd_type_err,
+    // roster deltas: uint32 sequence number, then "name[\tstatus]"; a gap in
+    // the sequence is repaired by sending cmd_type_get_usr_list, which is
+    // answered with cmd_type_roster_snapshot (sequence, then one user per line)
+    cmd_type_roster_join,
+    cmd_type_roster_leave,
+    cmd_type_roster_update,
+    cmd_type_roster_snapshot,
+    // taking a contract offer (protocol 2 only): the offer text as received
+    // in cmd_type_get_contract_ok, answered with cmd_type_accept_contract_ok
+    // or, if the offer is gone, cmd_type_err
+    cmd_type_accept_contract,
+    cmd_type_accept_contract_ok,
+    // resumable sessions: the client offers one with "\nresume" in
+    // cmd_type_auth, the server grants it with "resume=<token>" in
+    // cmd_type_auth_ok. Each side then counts the frames it sends after the
+    // login, these three aside, and keeps them until they are acknowledged.
+    //   cmd_type_ack        uint32 frames received so far
+    //   cmd_type_resume     uint32 frames received so far, then the token;
+    //                       sent instead of cmd_type_auth after a drop
+    //   cmd_type_resume_ok  uint32 frames the server received; the frames
+    //                       the client missed follow it, and the client
+    //                       sends again the ones the server missed
+    // A token the server no longer knows gets cmd_type_err.
+    cmd_type_ack,
+    cmd_type_resume,
+    cmd_type_resume_ok,
+    // bots hosted behind one login (protocol 2 only): what a round of them
+    // decided, for each bot varint bot id, varint turn and varint action
+    // count, then per action varint kind and svarint argument as in
+    // botapi.h. Frames hold whole bots and are not answered.
+    cmd_type_bot_actions,
+};
+
+// The payload of every command as a wire::Message. The text layouts are the
+// server's; Rest stands for payloads the client passes through whole or
+// that have a codec of their own.
+namespace msg {
+
+// base64 "login@password", then options such as "\nproto=2"
+typedef wire::Message<cmd_type_auth, wire::Until<'\n'>, wire::Prefixed<'\n'> > Auth;
+typedef wire::Message<cmd_type_auth_ok, wire::Rest> AuthOk;            // "\n"-separated options
+typedef wire::Message<cmd_type_formed, wire::Rest> Formed;             // the login
+typedef wire::Message<cmd_type_get_usr_list> GetUsrList;
+typedef wire::Message<cmd_type_formed_ok, wire::Rest> FormedOk;
+typedef wire::Message<cmd_type_get_contract, wire::Tokens<'/'> > GetContract;  // market names, each followed by '/'
+
+// "1A5/1B7/market": A count and price, B count and price, the market
+typedef wire::Message<cmd_type_get_contract_ok,
+                      wire::UDec<int32_t, 'A', 'a'>, wire::UDec<int32_t, '/'>,
+                      wire::UDec<int32_t, 'B', 'b'>, wire::UDec<int32_t, '/'>, wire::Rest> GetContractOk;
+typedef wire::Message<cmd_type_finish_market,
+                      wire::UDec<int32_t, 'A', 'a'>, wire::UDec<int32_t, '/'>,
+                      wire::UDec<int32_t, 'B', 'b'>, wire::UDec<int32_t, '/'>, wire::Rest> FinishMarket;
+
+// "id/lot/current/step" and "id/amount"
+typedef wire::Message<cmd_type_auction, wire::Dec<uint32_t, '/'>, wire::Token<'/'>,
+                      wire::Dec<int32_t, '/'>, wire::Dec<int32_t> > Auction;
+typedef wire::Message<cmd_type_amount, wire::Dec<uint32_t, '/'>, wire::Dec<int32_t> > Amount;
+typedef wire::Message<cmd_type_auction_win, wire::Dec<uint32_t, '/'>, wire::Dec<int32_t> > AuctionWin;
+typedef wire::Message<cmd_type_auction_lose, wire::Dec<uint32_t, '/'>, wire::Dec<int32_t> > AuctionLose;
+
+typedef wire::Message<cmd_type_report, wire::Rest> Report;             // YearReport::encode
+typedef wire::Message<cmd_type_err, wire::Rest> Err;
+
+// sequence number, name, status
+typedef wire::Message<cmd_type_roster_join, wire::U32, wire::Token<'\t'>, wire::Rest> RosterJoin;
+typedef wire::Message<cmd_type_roster_leave, wire::U32, wire::Token<'\t'>, wire::Rest> RosterLeave;
+typedef wire::Message<cmd_type_roster_update, wire::U32, wire::Token<'\t'>, wire::Rest> RosterUpdate;
+// sequence number, one "name[\tstatus]" per line
+typedef wire::Message<cmd_type_roster_snapshot, wire::U32, wire::Rest> RosterSnapshot;
+
+typedef wire::Message<cmd_type_accept_contract, wire::Rest> AcceptContract;   // the offer text
+typedef wire::Message<cmd_type_accept_contract_ok, wire::Rest> AcceptContractOk;
+
+// frame counts; Resume adds the token
+typedef wire::Message<cmd_type_ack, wire::U32> Ack;
+typedef wire::Message<cmd_type_resume, wire::U32, wire::Rest> Resume;
+typedef wire::Message<cmd_type_resume_ok, wire::U32> ResumeOk;
+
+typedef wire::Message<cmd_type_bot_actions, wire::Rest> BotActions;   // see above
+
+}
+
+#endif // PROTOCOL_H
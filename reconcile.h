@@ -0,0 +1,141 @@
+#ifndef RECONCILE_H
+#define RECONCILE_H
+
+#include <boost/function.hpp>
+#include <deque>
+#include <stdint.h>
+
+// Client-side prediction for actions the server rules on. submit() applies
+// an action to the predicted state straight away and tags it with a
+// sequence number; the server's answer either confirms it, folding it into
+// the authoritative state, or rejects it, in which case the prediction is
+// rebuilt from the authoritative state by replaying the actions still
+// pending. Actions are applied in submission order, the order the server
+// sees them in, so they must only depend on the state they are given.
+template <class State>
+class Reconciler
+{
+public:
+    typedef boost::function<void (State&)> Action;
+
+    explicit Reconciler(const State& initial = State()) :
+        authoritative(initial),
+        prediction(initial),
+        next_seq(1)
+    {
+    }
+
+    uint32_t submit(const Action& action)
+    {
+        Pending pending = { next_seq++, action, false };
+        if (!next_seq)
+            next_seq = 1;
+        action(prediction);
+        actions.push_back(pending);
+        return pending.seq;
+    }
+
+    // A confirmation arriving ahead of an earlier action's answer waits for
+    // it, so the authoritative state never skips an action.
+    bool confirm(uint32_t seq)
+    {
+        typename std::deque<Pending>::iterator it = find(seq);
+        if (it == actions.end())
+            return false;
+        it->confirmed = true;
+        fold_confirmed();
+        return true;
+    }
+
+    // Rejecting the action confirmations were waiting for lets them through.
+    bool reject(uint32_t seq)
+    {
+        typename std::deque<Pending>::iterator it = find(seq);
+        if (it == actions.end())
+            return false;
+        actions.erase(it);
+        fold_confirmed();
+        replay();
+        return true;
+    }
+
+    // A change the server doesn't rule on, made to both states.
+    void apply_local(const Action& action)
+    {
+        action(authoritative);
+        action(prediction);
+    }
+
+    // Takes state as authoritative (a server snapshot, a restored game) and
+    // replays the pending actions on top of it.
+    void rebase(const State& state)
+    {
+        authoritative = state;
+        replay();
+    }
+
+    // Rejects everything still unanswered, e.g. when the connection was
+    // lost and no answer will come. Confirmed actions are kept.
+    void reject_all()
+    {
+        for (std::size_t i = 0; i < actions.size(); ++i) {
+            if (actions[i].confirmed)
+                actions[i].action(authoritative);
+        }
+        actions.clear();
+        prediction = authoritative;
+    }
+
+    const State& predicted() const { return prediction; }
+
+    const State& confirmed() const { return authoritative; }
+
+    std::size_t pending() const { return actions.size(); }
+
+    bool is_pending(uint32_t seq) const
+    {
+        for (std::size_t i = 0; i < actions.size(); ++i) {
+            if (actions[i].seq == seq)
+                return true;
+        }
+        return false;
+    }
+
+private:
+    struct Pending
+    {
+        uint32_t seq;
+        Action action;
+        bool confirmed;         // waiting for an earlier action's answer
+    };
+
+    typename std::deque<Pending>::iterator find(uint32_t seq)
+    {
+        typename std::deque<Pending>::iterator it = actions.begin();
+        while (it != actions.end() && it->seq != seq)
+            ++it;
+        return it;
+    }
+
+    void fold_confirmed()
+    {
+        while (!actions.empty() && actions.front().confirmed) {
+            actions.front().action(authoritative);
+            actions.pop_front();
+        }
+    }
+
+    void replay()
+    {
+        prediction = authoritative;
+        for (std::size_t i = 0; i < actions.size(); ++i)
+            actions[i].action(prediction);
+    }
+
+    State authoritative;
+    State prediction;
+    std::deque<Pending> actions;
+    uint32_t next_seq;
+};
+
+#endif // RECONCILE_H
@@ -0,0 +1,165 @@
+#include "report.h"
+#include "arena.h"
+#include "varint.h"
+
+#include <cinttypes>
+#include <cstdio>
+
+namespace {
+
+YearReport::MarketRow market_row(const std::string& name)
+{
+    YearReport::MarketRow row = { name, { 0, 0 }, { 0, 0 }, 0 };
+    return row;
+}
+
+// Keeps the name, which would otherwise be copied every year.
+void clear_row(YearReport::MarketRow& row)
+{
+    row.revenue[0] = row.revenue[1] = 0;
+    row.sold[0] = row.sold[1] = 0;
+    row.fees = 0;
+}
+
+}
+
+template <class Bytes>
+void YearReport::encode(Bytes &out) const
+{
+    out.clear();
+    put_varint(out, FormatVersion);
+    put_varint(out, year);
+    put_varint(out, turns);
+    put_svarint(out, money_start);
+    put_svarint(out, money_end);
+    put_varint(out, markets.size());
+    for (std::size_t i = 0; i < markets.size(); ++i) {
+        const MarketRow& row = markets[i];
+        put_varint(out, row.name.size());
+        out.insert(out.end(), row.name.begin(), row.name.end());
+        for (int type = 0; type < 2; ++type) {
+            put_svarint(out, row.revenue[type]);
+            put_svarint(out, row.sold[type]);
+        }
+        put_svarint(out, row.fees);
+    }
+    put_svarint(out, credit_drawn);
+    put_svarint(out, credit_outstanding);
+    put_svarint(out, credit_turns);
+    put_varint(out, line_turns);
+    put_varint(out, loaded_line_turns);
+    put_svarint(out, produced[0]);
+    put_svarint(out, produced[1]);
+}
+
+template <class String>
+void YearReport::to_csv(String &out) const
+{
+    char line[256];
+    for (std::size_t i = 0; i < markets.size(); ++i) {
+        const MarketRow& row = markets[i];
+        if (!row.sold[0] && !row.sold[1] && !row.fees)
+            continue;
+        int n = snprintf(line, sizeof(line), "%" PRIu32 ",market,", year);
+        out.append(line, n);
+        out.append(row.name.data(), row.name.size());
+        n = snprintf(line, sizeof(line), ",%" PRId64 ",%" PRId64 ",%" PRId64 ",%" PRId64 ",%" PRId64 "\n",
+                     row.revenue[0], row.revenue[1], row.sold[0], row.sold[1], row.fees);
+        out.append(line, n);
+    }
+    int n = snprintf(line, sizeof(line),
+                     "%" PRIu32 ",totals,%" PRIu32 ",%" PRId64 ",%" PRId64 ",%" PRId64 ",%" PRId64 ",%" PRId64
+                     ",%" PRIu32 ",%" PRIu32 ",%" PRId64 ",%" PRId64 "\n",
+                     year, turns, money_start, money_end, credit_drawn, credit_outstanding, credit_turns,
+                     loaded_line_turns, line_turns, produced[0], produced[1]);
+    out.append(line, n);
+}
+
+template void YearReport::encode(std::vector<uint8_t>&) const;
+template void YearReport::encode(ArenaBytes&) const;
+template void YearReport::to_csv(std::string&) const;
+template void YearReport::to_csv(ArenaString&) const;
+
+const char* YearReport::csv_header()
+{
+    return "# year,market,name,revenue_a,revenue_b,sold_a,sold_b,fees\n"
+           "# year,totals,turns,money_start,money_end,credit_drawn,credit_outstanding,credit_turns,"
+           "loaded_line_turns,line_turns,produced_a,produced_b\n";
+}
+
+ReportBuilder::ReportBuilder()
+{
+    begin_year(1, 0);
+}
+
+void ReportBuilder::set_markets(const std::vector<std::string> &names)
+{
+    current.markets.clear();
+    for (std::size_t i = 0; i < names.size(); ++i)
+        current.markets.push_back(market_row(names[i]));
+    current.markets.push_back(market_row("-"));
+}
+
+void ReportBuilder::begin_year(uint32_t year, int64_t money)
+{
+    std::vector<YearReport::MarketRow> markets;
+    markets.swap(current.markets);
+    for (std::size_t i = 0; i < markets.size(); ++i)
+        clear_row(markets[i]);
+    if (markets.empty())
+        markets.push_back(market_row("-"));
+
+    current = YearReport();
+    current.year = year;
+    current.money_start = money;
+    current.markets.swap(markets);
+}
+
+YearReport::MarketRow& ReportBuilder::row(int market)
+{
+    if (market < 0 || market + 1 >= static_cast<int>(current.markets.size()))
+        return current.markets.back();
+    return current.markets[market];
+}
+
+void ReportBuilder::sale(int market, int product_type, int64_t price)
+{
+    YearReport::MarketRow& r = row(market);
+    r.revenue[product_type & 1] += price;
+    ++r.sold[product_type & 1];
+}
+
+void ReportBuilder::market_fee(int market, int64_t amount)
+{
+    row(market).fees += amount;
+}
+
+void ReportBuilder::credit_drawn(int64_t amount)
+{
+    current.credit_drawn += amount;
+}
+
+void ReportBuilder::line_turn(bool loaded)
+{
+    ++current.line_turns;
+    current.loaded_line_turns += loaded;
+}
+
+void ReportBuilder::produced(int product_type, int64_t count)
+{
+    current.produced[product_type & 1] += count;
+}
+
+void ReportBuilder::end_turn(int64_t credit_outstanding)
+{
+    ++current.turns;
+    current.credit_outstanding = credit_outstanding;
+    current.credit_turns += credit_outstanding;
+}
+
+void ReportBuilder::finish_year(int64_t money, YearReport &report)
+{
+    current.money_end = money;
+    report = current;
+    begin_year(current.year + 1, money);
+}
@@ -0,0 +1,79 @@
+#ifndef REPORT_H
+#define REPORT_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Totals of one game year, four turns long.
+struct YearReport
+{
+    enum { FormatVersion = 1 };
+
+    struct MarketRow
+    {
+        std::string name;
+        int64_t revenue[2];     // by product type, GameState::ProductA / ProductB
+        int64_t sold[2];
+        int64_t fees;           // paid for staying in the market
+    };
+
+    uint32_t year;
+    uint32_t turns;
+    int64_t money_start;
+    int64_t money_end;
+    std::vector<MarketRow> markets;     // the last row collects sales with no known market
+    int64_t credit_drawn;
+    int64_t credit_outstanding;         // at year end
+    int64_t credit_turns;               // sum of outstanding credit over the year's turns
+    uint32_t line_turns;
+    uint32_t loaded_line_turns;
+    int64_t produced[2];
+
+    // Compact payload for cmd_type_report: format version, then every field
+    // as a varint (zigzag for amounts), markets by name. Bytes is
+    // std::vector<uint8_t> or ArenaBytes.
+    template <class Bytes>
+    void encode(Bytes& out) const;
+
+    // One CSV line per market with activity plus a totals line, appended to
+    // out (std::string or ArenaString); the column layout of both kinds is
+    // described by csv_header().
+    template <class String>
+    void to_csv(String& out) const;
+
+    static const char* csv_header();
+};
+
+// Accumulates the running year as turns are played. Every event adds to a
+// fixed set of counters, so closing a year costs the same however long the
+// session has been and never walks the turn history.
+class ReportBuilder
+{
+public:
+    ReportBuilder();
+
+    void set_markets(const std::vector<std::string>& names);
+
+    void begin_year(uint32_t year, int64_t money);
+
+    // market is an index into set_markets(), or -1 when unknown
+    void sale(int market, int product_type, int64_t price);
+    void market_fee(int market, int64_t amount);
+    void credit_drawn(int64_t amount);
+    void line_turn(bool loaded);
+    void produced(int product_type, int64_t count);
+    void end_turn(int64_t credit_outstanding);
+
+    // Closes the running year into report and starts the next one.
+    void finish_year(int64_t money, YearReport& report);
+
+    const YearReport& running() const { return current; }
+
+private:
+    YearReport::MarketRow& row(int market);
+
+    YearReport current;
+};
+
+#endif // REPORT_H
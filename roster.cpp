@@ -0,0 +1,197 @@
+#include "roster.h"
+#include "protocol.h"
+
+bool RosterDelta::parse(uint8_t op, const uint8_t *data, uint32_t size, RosterDelta &delta)
+{
+    wire::Text name, status;
+    bool ok = false;
+    switch (op) {
+    case Snapshot:
+        ok = msg::RosterSnapshot::decode(data, size, delta.seq, name);
+        break;
+    case Join:
+        ok = msg::RosterJoin::decode(data, size, delta.seq, name, status);
+        break;
+    case Leave:
+        ok = msg::RosterLeave::decode(data, size, delta.seq, name, status);
+        break;
+    case Update:
+        ok = msg::RosterUpdate::decode(data, size, delta.seq, name, status);
+        break;
+    }
+    if (!ok || (op != Snapshot && name.empty()))
+        return false;
+    delta.op = op;
+    delta.has_seq = true;
+    delta.name.assign(name.data, name.size);
+    delta.status.assign(status.data, status.size);
+    return true;
+}
+
+void RosterDelta::frame_payload(const RosterDelta &delta, std::vector<uint8_t> &payload)
+{
+    payload.clear();
+    if (delta.op == Snapshot)
+        msg::RosterSnapshot::encode(payload, delta.seq, delta.name);
+    else
+        msg::RosterJoin::encode(payload, delta.seq, delta.name, delta.status);    // the deltas share a layout
+}
+
+Roster::Roster() :
+    listener(NULL),
+    seq(0),
+    synced(false),
+    resyncing(false)
+{
+}
+
+Roster::Result Roster::apply(const RosterDelta &delta)
+{
+    if (delta.op == RosterDelta::Snapshot) {
+        reset(delta.name);
+        seq = delta.seq;
+        synced = delta.has_seq;
+        resyncing = false;
+        return Applied;
+    }
+    if (delta.op == RosterDelta::SnapshotFailed) {
+        // the next delta finds the gap again and asks anew
+        resyncing = false;
+        return Stale;
+    }
+
+    if (resyncing)
+        return Resyncing;
+    if (synced) {
+        if (static_cast<int32_t>(delta.seq - seq) <= 0)
+            return Stale;
+        if (delta.seq != seq + 1) {
+            resyncing = true;
+            return Gap;
+        }
+    }
+
+    switch (delta.op) {
+    case RosterDelta::Join:
+    case RosterDelta::Update:
+        join(delta.name, delta.status);
+        break;
+    case RosterDelta::Leave:
+        leave(delta.name);
+        break;
+    }
+    seq = delta.seq;
+    synced = true;
+    return Applied;
+}
+
+void Roster::clear()
+{
+    if (listener)
+        listener->roster_about_to_reset();
+    users.clear();
+    index.clear();
+    sorted.clear();
+    if (listener)
+        listener->roster_reset();
+    seq = 0;
+    synced = false;
+    resyncing = false;
+}
+
+const Roster::User* Roster::find(const std::string &name) const
+{
+    boost::unordered_map<std::string, std::size_t>::const_iterator it = index.find(name);
+    return it == index.end() ? NULL : &users[it->second];
+}
+
+std::string Roster::to_text() const
+{
+    std::string text;
+    for (std::size_t i = 0; i < users.size(); ++i) {
+        text += users[i].name;
+        if (!users[i].status.empty())
+            text += " (" + users[i].status + ")";
+        text += '\n';
+    }
+    return text;
+}
+
+void Roster::find_prefix(const std::string &prefix, std::vector<std::size_t> &slots) const
+{
+    slots.clear();
+    for (std::set<std::string>::const_iterator it = sorted.lower_bound(prefix);
+         it != sorted.end() && !it->compare(0, prefix.size(), prefix); ++it)
+        slots.push_back(index.find(*it)->second);
+}
+
+void Roster::reset(const std::string &list)
+{
+    if (listener)
+        listener->roster_about_to_reset();
+    // join() would report every user one by one
+    Listener* saved = listener;
+    listener = NULL;
+    users.clear();
+    index.clear();
+    sorted.clear();
+    std::size_t begin = 0;
+    while (begin < list.size()) {
+        std::size_t end = list.find('\n', begin);
+        if (end == std::string::npos)
+            end = list.size();
+        std::string line = list.substr(begin, end - begin);
+        if (!line.empty() && line[line.size() - 1] == '\r')
+            line.erase(line.size() - 1);
+        std::size_t tab = line.find('\t');
+        if (!line.empty() && tab != 0)
+            join(line.substr(0, tab), tab == std::string::npos ? std::string() : line.substr(tab + 1));
+        begin = end + 1;
+    }
+    listener = saved;
+    if (listener)
+        listener->roster_reset();
+}
+
+void Roster::join(const std::string &name, const std::string &status)
+{
+    std::pair<boost::unordered_map<std::string, std::size_t>::iterator, bool> inserted =
+            index.insert(std::make_pair(name, users.size()));
+    if (!inserted.second) {
+        users[inserted.first->second].status = status;
+        if (listener)
+            listener->roster_changed(inserted.first->second);
+        return;
+    }
+    if (listener)
+        listener->roster_about_to_insert(users.size());
+    User user = { name, status };
+    users.push_back(user);
+    sorted.insert(name);
+    if (listener)
+        listener->roster_inserted();
+}
+
+void Roster::leave(const std::string &name)
+{
+    boost::unordered_map<std::string, std::size_t>::iterator it = index.find(name);
+    if (it == index.end())
+        return;
+    std::size_t slot = it->second;
+    std::size_t last = users.size() - 1;
+    if (listener)
+        listener->roster_about_to_remove(last, slot);
+    index.erase(it);
+    sorted.erase(name);
+    if (slot != last) {
+        users[slot].name.swap(users.back().name);
+        users[slot].status.swap(users.back().status);
+        index[users[slot].name] = slot;
+    }
+    users.pop_back();
+    if (listener) {
+        listener->roster_removed();
+        if (slot != last)
+            listener->roster_changed(slot);
+    }
+}
@@ -0,0 +1,106 @@
+#ifndef ROSTER_H
+#define ROSTER_H
+
+#include <boost/unordered_map.hpp>
+#include <set>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// One roster change as received from the server. Snapshot carries the whole
+// list ("name[\tstatus]" per line); the other ops carry one user.
+// SnapshotFailed carries nothing: a request for the list went unanswered.
+struct RosterDelta
+{
+    enum Op { Snapshot, Join, Leave, Update, SnapshotFailed };
+
+    uint8_t op;
+    bool has_seq;           // false for the legacy cmd_type_get_usr_list reply
+    uint32_t seq;
+    std::string name;       // the list for Snapshot
+    std::string status;
+
+    // Decodes a roster frame payload, msg::RosterJoin and its siblings in
+    // protocol.h: uint32 sequence number, then the user record or, for
+    // snapshots, the list.
+    static bool parse(uint8_t op, const uint8_t* data, uint32_t size, RosterDelta& delta);
+
+    // Encodes the payload parse() reads.
+    static void frame_payload(const RosterDelta& delta, std::vector<uint8_t>& payload);
+};
+
+// Users currently in the game, applied delta by delta. Lookups go through a
+// hash index and leaves swap the last user into the freed slot, so each
+// delta costs O(1) (plus O(log n) for the sorted name index) whatever the
+// number of players.
+class Roster
+{
+public:
+    struct User
+    {
+        std::string name;
+        std::string status;
+    };
+
+    // Told about every slot change, before and after it happens, so a view
+    // can follow the roster without re-reading it.
+    class Listener
+    {
+    public:
+        virtual ~Listener() { }
+        virtual void roster_about_to_reset() = 0;
+        virtual void roster_reset() = 0;
+        virtual void roster_about_to_insert(std::size_t slot) = 0;
+        virtual void roster_inserted() = 0;
+        // A leave removes the last slot, slot, after moving its user into
+        // leaving, the slot that was freed; roster_changed() follows for
+        // that slot.
+        virtual void roster_about_to_remove(std::size_t slot, std::size_t leaving) = 0;
+        virtual void roster_removed() = 0;
+        virtual void roster_changed(std::size_t slot) = 0;
+    };
+
+    enum Result
+    {
+        Applied,
+        Stale,          // already seen or a SnapshotFailed, ignored
+        Gap,            // a delta was lost: fetch the full list
+        Resyncing       // waiting for the full list, ignored
+    };
+
+    Roster();
+
+    Result apply(const RosterDelta& delta);
+
+    void clear();
+
+    std::size_t size() const { return users.size(); }
+
+    const User& user(std::size_t slot) const { return users[slot]; }
+
+    const User* find(const std::string& name) const;
+
+    uint32_t sequence() const { return seq; }
+
+    std::string to_text() const;
+
+    // Slots of the users whose name starts with prefix, in name order.
+    void find_prefix(const std::string& prefix, std::vector<std::size_t>& slots) const;
+
+    void set_listener(Listener* _listener) { listener = _listener; }
+
+private:
+    void reset(const std::string& list);
+    void join(const std::string& name, const std::string& status);
+    void leave(const std::string& name);
+
+    std::vector<User> users;
+    boost::unordered_map<std::string, std::size_t> index;
+    std::set<std::string> sorted;
+    Listener* listener;
+    uint32_t seq;
+    bool synced;
+    bool resyncing;
+};
+
+#endif // ROSTER_H
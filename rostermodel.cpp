@@ -0,0 +1,163 @@
+#include "rostermodel.h"
+#include "tracer.h"
+
+RosterModel::RosterModel(Roster *_roster, QObject *parent) :
+    QAbstractListModel(parent),
+    roster(_roster),
+    leaving_row(-1),
+    moved_row(-1),
+    moved_to(0)
+{
+    roster->set_listener(this);
+}
+
+RosterModel::~RosterModel()
+{
+    roster->set_listener(NULL);
+}
+
+int RosterModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+    return static_cast<int>(prefix.isEmpty() ? roster->size() : matches.size());
+}
+
+QVariant RosterModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= rowCount())
+        return QVariant();
+    const Roster::User& user = roster->user(slot(index.row()));
+    switch (role) {
+    case Qt::DisplayRole:
+        if (user.status.empty())
+            return QString::fromStdString(user.name);
+        return QString("%1 (%2)").arg(QString::fromStdString(user.name), QString::fromStdString(user.status));
+    case Qt::ToolTipRole:
+        return QString::fromStdString(user.status);
+    }
+    return QVariant();
+}
+
+void RosterModel::set_filter(const QString &_prefix)
+{
+    TRACE_SCOPE("RosterModel::set_filter");
+    beginResetModel();
+    prefix = _prefix;
+    prefix_name = prefix.toStdString();
+    refilter();
+    endResetModel();
+}
+
+std::size_t RosterModel::slot(int row) const
+{
+    return prefix.isEmpty() ? static_cast<std::size_t>(row) : matches[row];
+}
+
+void RosterModel::refilter()
+{
+    if (prefix.isEmpty())
+        matches.clear();
+    else
+        roster->find_prefix(prefix_name, matches);
+}
+
+// While a filter is set the rows are positions in the sorted match list, not
+// slots. A joining or leaving user's row is found by binary search on the
+// names and only that row is inserted or removed.
+
+std::size_t RosterModel::match_row(const std::string &name) const
+{
+    std::size_t low = 0, high = matches.size();
+    while (low < high) {
+        std::size_t middle = low + (high - low) / 2;
+        if (roster->user(matches[middle]).name < name)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+bool RosterModel::matched(std::size_t row, std::size_t slot) const
+{
+    return row < matches.size() && matches[row] == slot;
+}
+
+void RosterModel::roster_about_to_reset()
+{
+    beginResetModel();
+}
+
+void RosterModel::roster_reset()
+{
+    refilter();
+    endResetModel();
+}
+
+void RosterModel::roster_about_to_insert(std::size_t slot)
+{
+    if (prefix.isEmpty())
+        beginInsertRows(QModelIndex(), static_cast<int>(slot), static_cast<int>(slot));
+}
+
+void RosterModel::roster_inserted()
+{
+    if (prefix.isEmpty()) {
+        endInsertRows();
+        return;
+    }
+    // the views read matches, which still holds the rows they know about
+    std::size_t slot = roster->size() - 1;
+    const std::string& name = roster->user(slot).name;
+    if (name.compare(0, prefix_name.size(), prefix_name))
+        return;
+    int row = static_cast<int>(match_row(name));
+    beginInsertRows(QModelIndex(), row, row);
+    matches.insert(matches.begin() + row, slot);
+    endInsertRows();
+}
+
+void RosterModel::roster_about_to_remove(std::size_t slot, std::size_t leaving)
+{
+    if (prefix.isEmpty()) {
+        beginRemoveRows(QModelIndex(), static_cast<int>(slot), static_cast<int>(slot));
+        return;
+    }
+    std::size_t row = match_row(roster->user(leaving).name);
+    leaving_row = matched(row, leaving) ? static_cast<int>(row) : -1;
+    row = match_row(roster->user(slot).name);
+    moved_row = slot != leaving && matched(row, slot) ? static_cast<int>(row) : -1;
+    moved_to = leaving;
+    if (leaving_row >= 0)
+        beginRemoveRows(QModelIndex(), leaving_row, leaving_row);
+}
+
+void RosterModel::roster_removed()
+{
+    if (prefix.isEmpty()) {
+        endRemoveRows();
+        return;
+    }
+    if (moved_row >= 0)
+        matches[moved_row] = moved_to;
+    if (leaving_row >= 0) {
+        matches.erase(matches.begin() + leaving_row);
+        endRemoveRows();
+    }
+    leaving_row = moved_row = -1;
+}
+
+void RosterModel::roster_changed(std::size_t slot)
+{
+    if (prefix.isEmpty()) {
+        QModelIndex changed = index(static_cast<int>(slot));
+        emit dataChanged(changed, changed);
+        return;
+    }
+    std::size_t row = match_row(roster->user(slot).name);
+    if (matched(row, slot)) {
+        QModelIndex changed = index(static_cast<int>(row));
+        emit dataChanged(changed, changed);
+    }
+}
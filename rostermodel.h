@@ -0,0 +1,52 @@
+#ifndef ROSTERMODEL_H
+#define ROSTERMODEL_H
+
+#include "roster.h"
+#include <QAbstractListModel>
+
+// List model over a Roster. Rows follow roster slots and are inserted,
+// removed and changed one at a time, so a QListView with uniform item sizes
+// only lays out the rows it shows. A prefix filter lists the matching users
+// in name order from the roster's sorted index.
+class RosterModel : public QAbstractListModel, public Roster::Listener
+{
+    Q_OBJECT
+public:
+    explicit RosterModel(Roster* _roster, QObject *parent = 0);
+    ~RosterModel();
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+
+    const QString& filter() const { return prefix; }
+
+public slots:
+    void set_filter(const QString& _prefix);
+
+protected:
+    void roster_about_to_reset();
+    void roster_reset();
+    void roster_about_to_insert(std::size_t slot);
+    void roster_inserted();
+    void roster_about_to_remove(std::size_t slot, std::size_t leaving);
+    void roster_removed();
+    void roster_changed(std::size_t slot);
+
+private:
+    std::size_t slot(int row) const;
+    void refilter();
+    std::size_t match_row(const std::string& name) const;
+    bool matched(std::size_t row, std::size_t slot) const;
+
+    Roster* roster;
+    QString prefix;
+    std::string prefix_name;            // prefix as the roster stores names
+    std::vector<std::size_t> matches;   // slots when filtered
+
+    // a leave in progress while filtered, rows in matches or -1
+    int leaving_row;
+    int moved_row;
+    std::size_t moved_to;
+};
+
+#endif // ROSTERMODEL_H
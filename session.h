@@ -0,0 +1,134 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include "connector.h"
+
+// Awaitable requests on top of Connector::request(), so a flow that needs
+// several replies reads top to bottom:
+//
+//     Reply roster = co_await session.request(cmd_type_get_usr_list);
+//     Reply offer = co_await session.request(cmd_type_get_contract, "A/");
+//
+// Coroutines are spawned on the connector's io_service and resume on its
+// thread, so any number of them share that one thread and the socket. Needs
+// C++20 coroutines; without them this header declares nothing.
+#ifdef BOOST_ASIO_HAS_CO_AWAIT
+
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <memory>
+
+struct Reply
+{
+    uint8_t cmd;
+    std::vector<uint8_t> data;
+
+    std::string text() const { return std::string(data.begin(), data.end()); }
+};
+
+class Session
+{
+public:
+    explicit Session(Connector& _connector) :
+        connector(_connector)
+    {
+    }
+
+    // The command the server answers cmd with.
+    static uint8_t reply_command(uint8_t cmd)
+    {
+        switch (cmd) {
+        case cmd_type_auth:
+            return cmd_type_auth_ok;
+        case cmd_type_formed:
+            return cmd_type_formed_ok;
+        case cmd_type_get_usr_list:
+            return cmd_type_roster_snapshot;
+        case cmd_type_get_contract:
+            return cmd_type_get_contract_ok;
+        case cmd_type_accept_contract:
+            return cmd_type_accept_contract_ok;
+        default:
+            return cmd_type_err;
+        }
+    }
+
+    // Completes with (error_code, Reply). The error is connection_aborted
+    // when the connection was lost before the reply came, message_size when
+    // the reply was over the connector's frame limit and went to its spill
+    // handler.
+    template <class CompletionToken>
+    auto async_request(uint8_t cmd, uint8_t reply_cmd, const uint8_t* data, uint32_t size,
+                       CompletionToken&& token)
+    {
+        return boost::asio::async_initiate<CompletionToken, void (boost::system::error_code, Reply)>(
+            Initiate(connector), token, cmd, reply_cmd, data, size);
+    }
+
+    boost::asio::awaitable<Reply> request(uint8_t cmd, std::string payload = std::string())
+    {
+        co_return co_await async_request(cmd, reply_command(cmd),
+                                         reinterpret_cast<const uint8_t*>(payload.data()), payload.size(),
+                                         boost::asio::use_awaitable);
+    }
+
+    // Waits for the login to finish; false on timeout.
+    boost::asio::awaitable<bool> connected(boost::posix_time::time_duration timeout)
+    {
+        boost::asio::deadline_timer timer(co_await boost::asio::this_coro::executor);
+        boost::posix_time::ptime deadline = boost::posix_time::microsec_clock::universal_time() + timeout;
+        while (!connector.is_connected() && boost::posix_time::microsec_clock::universal_time() < deadline) {
+            timer.expires_from_now(boost::posix_time::milliseconds(10));
+            co_await timer.async_wait(boost::asio::use_awaitable);
+        }
+        co_return connector.is_connected();
+    }
+
+    // Runs flow(), which returns an awaitable, on the connector thread.
+    template <class Flow>
+    void spawn(Flow flow)
+    {
+        boost::shared_ptr<boost::asio::io_service> io_service = connector.get_io_service();
+        if (io_service)
+            boost::asio::co_spawn(*io_service, std::move(flow), boost::asio::detached);
+    }
+
+private:
+    struct Initiate
+    {
+        explicit Initiate(Connector& _connector) : connector(_connector) { }
+
+        template <class Handler>
+        void operator()(Handler&& handler, uint8_t cmd, uint8_t reply_cmd, const uint8_t* data, uint32_t size)
+        {
+            // Connector keeps reply handlers in boost::function, which copies;
+            // the completion handler is move-only, so it is shared instead.
+            std::shared_ptr<typename std::decay<Handler>::type> shared(
+                new typename std::decay<Handler>::type(std::forward<Handler>(handler)));
+            connector.request(cmd, reply_cmd, data, size,
+                              [shared](uint8_t cmd, const uint8_t* data, uint32_t size) {
+                boost::system::error_code error;
+                if (cmd == cmd_type_err && !data)
+                    error = boost::asio::error::connection_aborted;
+                else if (!data)
+                    error = boost::asio::error::message_size;
+                Reply reply = { cmd, data ? std::vector<uint8_t>(data, data + size) : std::vector<uint8_t>() };
+                // resume outside buffer_parse, on the coroutine's executor
+                boost::asio::post(boost::asio::get_associated_executor(*shared),
+                                  [shared, error, reply]() mutable {
+                    (*shared)(error, std::move(reply));
+                });
+            });
+        }
+
+        Connector& connector;
+    };
+
+    Connector& connector;
+};
+
+#endif // BOOST_ASIO_HAS_CO_AWAIT
+
+#endif // SESSION_H
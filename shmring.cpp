@@ -0,0 +1,201 @@
+#include "shmring.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#ifdef WIN32
+#include <windows.h>
+#undef min
+#undef max
+#else
+#include <cerrno>
+#include <signal.h>
+#include <unistd.h>
+#endif
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+              "the rings are shared between processes and need lock-free atomics");
+
+std::size_t ShmRing::write(const uint8_t *src, std::size_t size)
+{
+    uint64_t w = header->write_pos.load(std::memory_order_relaxed);
+    uint64_t r = header->read_pos.load(std::memory_order_acquire);
+    std::size_t n = std::min<std::size_t>(size, capacity - (w - r));
+    if (!n)
+        return 0;
+    std::size_t at = w & (capacity - 1);
+    std::size_t first = std::min<std::size_t>(n, capacity - at);
+    memcpy(data + at, src, first);
+    memcpy(data, src + first, n - first);
+    header->write_pos.store(w + n, std::memory_order_release);
+    return n;
+}
+
+std::size_t ShmRing::read(uint8_t *dst, std::size_t size)
+{
+    uint64_t r = header->read_pos.load(std::memory_order_relaxed);
+    uint64_t w = header->write_pos.load(std::memory_order_acquire);
+    std::size_t n = std::min<std::size_t>(size, w - r);
+    if (!n)
+        return 0;
+    std::size_t at = r & (capacity - 1);
+    std::size_t first = std::min<std::size_t>(n, capacity - at);
+    memcpy(dst, data + at, first);
+    memcpy(dst + first, data, n - first);
+    header->read_pos.store(r + n, std::memory_order_release);
+    return n;
+}
+
+bool ShmRing::empty() const
+{
+    return header->read_pos.load(std::memory_order_relaxed) == header->write_pos.load(std::memory_order_acquire);
+}
+
+void ShmRing::reset()
+{
+    header->write_pos.store(0, std::memory_order_relaxed);
+    header->read_pos.store(0, std::memory_order_relaxed);
+}
+
+namespace {
+
+uint32_t current_pid()
+{
+#ifdef WIN32
+    return GetCurrentProcessId();
+#else
+    return static_cast<uint32_t>(getpid());
+#endif
+}
+
+// A process that exits or crashes leaves its flags in the segment as they
+// were, so the other side also asks the system whether it's still there.
+bool process_alive(uint32_t pid)
+{
+#ifdef WIN32
+    HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, pid);
+    if (!process)
+        return GetLastError() == ERROR_ACCESS_DENIED;
+    bool alive = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+    CloseHandle(process);
+    return alive;
+#else
+    return kill(static_cast<pid_t>(pid), 0) == 0 || errno == EPERM;
+#endif
+}
+
+uint64_t now_ms()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
+
+// Followed by the client-to-server and the server-to-client ring data.
+struct ShmChannel::Segment
+{
+    enum { Magic = 0x59435348 };
+    enum { Free = 0, Claiming = 1, Attached = 2 };
+
+    uint32_t magic;
+    uint32_t capacity;
+    std::atomic<uint32_t> server_alive;
+    std::atomic<uint32_t> client_state;
+    std::atomic<uint32_t> server_pid;
+    std::atomic<uint32_t> client_pid;   // of the Claiming or Attached client
+    char pad[64 - 6 * sizeof(uint32_t)];
+    ShmRing::Header to_server;
+    ShmRing::Header to_client;
+};
+
+ShmChannel::ShmChannel(const std::string &_name, Side _side, uint32_t capacity) :
+    name(_name),
+    side(_side),
+    segment(NULL),
+    peer_checked_ms(0),
+    peer_running(true)
+{
+    using namespace boost::interprocess;
+    if (side == Server) {
+        uint32_t rounded = 4096;
+        while (rounded < capacity)
+            rounded <<= 1;
+        shared_memory_object::remove(name.c_str());
+        shared_memory_object shm(create_only, name.c_str(), read_write);
+        shm.truncate(sizeof(Segment) + 2 * std::size_t(rounded));
+        region.reset(new mapped_region(shm, read_write));
+        segment = static_cast<Segment*>(region->get_address());
+        segment->capacity = rounded;
+        segment->client_state.store(Segment::Free);
+        segment->client_pid.store(0);
+        segment->server_pid.store(current_pid());
+        segment->server_alive.store(1);
+        segment->magic = Segment::Magic;
+    } else {
+        shared_memory_object shm(open_only, name.c_str(), read_write);
+        region.reset(new mapped_region(shm, read_write));
+        segment = static_cast<Segment*>(region->get_address());
+        if (region->get_size() < sizeof(Segment) || segment->magic != Segment::Magic
+                || !segment->server_alive.load() || !process_alive(segment->server_pid.load()))
+            throw interprocess_exception("shared memory channel is not available");
+        // the slot of a client that died without detaching can be taken over
+        uint32_t expected = Segment::Free;
+        if (!segment->client_state.compare_exchange_strong(expected, Segment::Claiming)
+                && (process_alive(segment->client_pid.load())
+                    || !segment->client_state.compare_exchange_strong(expected, Segment::Claiming)))
+            throw interprocess_exception("shared memory channel is not available");
+        segment->client_pid.store(current_pid());
+    }
+
+    uint8_t* rings = reinterpret_cast<uint8_t*>(segment + 1);
+    ShmRing to_server(&segment->to_server, rings, segment->capacity);
+    ShmRing to_client(&segment->to_client, rings + segment->capacity, segment->capacity);
+    in = side == Server ? to_server : to_client;
+    out = side == Server ? to_client : to_server;
+
+    if (side == Client) {
+        // the server only touches the rings while a client is attached
+        in.reset();
+        out.reset();
+        segment->client_state.store(Segment::Attached, std::memory_order_release);
+    }
+}
+
+ShmChannel::~ShmChannel()
+{
+    detach();
+}
+
+bool ShmChannel::peer_alive() const
+{
+    if (!segment)
+        return false;
+    bool attached = side == Server ? segment->client_state.load(std::memory_order_acquire) == Segment::Attached
+                                   : segment->server_alive.load(std::memory_order_acquire) != 0;
+    if (!attached)
+        return false;
+    // the transports ask on every idle poll, the process table is consulted
+    // every PeerCheckMs
+    uint64_t now = now_ms();
+    if (now - peer_checked_ms >= PeerCheckMs) {
+        peer_checked_ms = now;
+        peer_running = process_alive(side == Server ? segment->client_pid.load() : segment->server_pid.load());
+    }
+    return peer_running;
+}
+
+void ShmChannel::detach()
+{
+    if (!segment)
+        return;
+    if (side == Server) {
+        segment->server_alive.store(0);
+        boost::interprocess::shared_memory_object::remove(name.c_str());
+    } else {
+        segment->client_state.store(Segment::Free);
+    }
+    segment = NULL;
+    region.reset();
+}
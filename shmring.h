@@ -0,0 +1,78 @@
+#ifndef SHMRING_H
+#define SHMRING_H
+
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <boost/shared_ptr.hpp>
+#include <atomic>
+#include <stdint.h>
+#include <string>
+
+// Single-producer, single-consumer byte ring living in shared memory. The
+// positions only grow; each side writes one of them and reads the other.
+class ShmRing
+{
+public:
+    struct Header
+    {
+        std::atomic<uint64_t> write_pos;
+        char pad0[64 - sizeof(std::atomic<uint64_t>)];
+        std::atomic<uint64_t> read_pos;
+        char pad1[64 - sizeof(std::atomic<uint64_t>)];
+    };
+
+    ShmRing() : header(NULL), data(NULL), capacity(0) { }
+    ShmRing(Header* _header, uint8_t* _data, uint32_t _capacity) :
+        header(_header), data(_data), capacity(_capacity) { }
+
+    // Both copy as much as fits or is available and return the byte count.
+    std::size_t write(const uint8_t* src, std::size_t size);
+    std::size_t read(uint8_t* dst, std::size_t size);
+
+    bool empty() const;
+    void reset();
+
+private:
+    Header* header;
+    uint8_t* data;
+    uint32_t capacity;      // power of two
+};
+
+// A ring pair shared by one server and one client, named shm://<name> in
+// endpoint URIs. The server creates the segment and removes it when done.
+class ShmChannel
+{
+public:
+    enum Side { Server, Client };
+
+    // Throws boost::interprocess::interprocess_exception when the segment
+    // can't be created or opened, or another client is attached.
+    ShmChannel(const std::string& name, Side side, uint32_t capacity = 1 << 20);
+    ~ShmChannel();
+
+    ShmRing& inbound() { return in; }
+    ShmRing& outbound() { return out; }
+
+    // Whether a client is attached (for the server) or the server is still
+    // there (for the client). A peer whose process is gone, e.g. crashed
+    // without detaching, isn't alive either.
+    bool peer_alive() const;
+
+    void detach();
+
+private:
+    struct Segment;
+
+    enum { PeerCheckMs = 100 };
+
+    std::string name;
+    Side side;
+    boost::shared_ptr<boost::interprocess::mapped_region> region;
+    Segment* segment;
+    ShmRing in;
+    ShmRing out;
+    mutable uint64_t peer_checked_ms;
+    mutable bool peer_running;
+};
+
+#endif // SHMRING_H
@@ -0,0 +1,44 @@
+#include "spill.h"
+
+#include <QDebug>
+#include <cerrno>
+#include <cstring>
+
+SpillFile::SpillFile(uint8_t _cmd, uint32_t _request_id, uint32_t _size, const Done& _done) :
+    cmd(_cmd),
+    request_id(_request_id),
+    size(_size),
+    done(_done),
+    file(std::tmpfile()),
+    failed(false)
+{
+    if (!file) {
+        qWarning("Paradox: no temporary file for a %u byte frame (%s)\n", size, strerror(errno));
+        failed = true;
+    }
+}
+
+SpillFile::~SpillFile()
+{
+    if (file)
+        std::fclose(file);
+}
+
+void SpillFile::write(const uint8_t* data, std::size_t chunk)
+{
+    if (failed)
+        return;
+    if (std::fwrite(data, 1, chunk, file) != chunk) {
+        qWarning("Paradox: spilling a %u byte frame failed (%s)\n", size, strerror(errno));
+        failed = true;
+    }
+}
+
+void SpillFile::finish()
+{
+    if (failed || std::fflush(file) != 0)
+        return;
+    std::rewind(file);
+    if (done)
+        done(cmd, request_id, file, size);
+}
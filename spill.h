@@ -0,0 +1,43 @@
+#ifndef SPILL_H
+#define SPILL_H
+
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <cstdio>
+#include <stdint.h>
+
+// Takes the payload of a frame over Connector's in-memory limit a chunk at
+// a time, in order, on the connector thread. finish() follows the last
+// chunk; a sink released without it lost its connection mid-frame.
+class FrameSink
+{
+public:
+    virtual ~FrameSink() { }
+
+    virtual void write(const uint8_t* data, std::size_t size) = 0;
+    virtual void finish() = 0;
+};
+
+// Spills to an anonymous temporary file, handed to done rewound once the
+// frame is complete. The file goes away with the sink.
+class SpillFile : public FrameSink
+{
+public:
+    typedef boost::function<void (uint8_t cmd, uint32_t request_id, std::FILE* file, uint32_t size)> Done;
+
+    SpillFile(uint8_t cmd, uint32_t request_id, uint32_t size, const Done& done);
+    ~SpillFile();
+
+    void write(const uint8_t* data, std::size_t size);
+    void finish();
+
+private:
+    uint8_t cmd;
+    uint32_t request_id;
+    uint32_t size;
+    Done done;
+    std::FILE* file;
+    bool failed;
+};
+
+#endif // SPILL_H
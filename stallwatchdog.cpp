@@ -0,0 +1,205 @@
+#include "stallwatchdog.h"
+
+#include <QCoreApplication>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+namespace {
+
+bool stall_before(const StallWatchdog::Stall& a, const StallWatchdog::Stall& b)
+{
+    return a.at_ms < b.at_ms;
+}
+
+}
+
+std::atomic<const char*> StallWatchdog::current_handler(NULL);
+StallWatchdog* StallWatchdog::active = NULL;
+uint64_t StallWatchdog::modal_ms = 0;
+
+StallWatchdog::HandlerScope::HandlerScope(const char* name) :
+    previous(current_handler.exchange(name)),
+    begin_ms(now_ms()),
+    modal_begin_ms(modal_ms)
+{
+}
+
+StallWatchdog::HandlerScope::~HandlerScope()
+{
+    const char* name = current_handler.exchange(previous);
+    uint64_t duration = now_ms() - begin_ms - (modal_ms - modal_begin_ms);
+    if (active && duration >= static_cast<uint64_t>(active->threshold_ms))
+        active->add_stall(name, begin_ms, duration, true);
+}
+
+StallWatchdog::ModalScope::ModalScope() :
+    begin_ms(now_ms()),
+    modal_begin_ms(modal_ms)
+{
+}
+
+StallWatchdog::ModalScope::~ModalScope()
+{
+    // modal scopes nested in this one have added their time already
+    modal_ms += now_ms() - begin_ms - (modal_ms - modal_begin_ms);
+}
+
+StallWatchdog::StallWatchdog(QObject *parent, int _threshold_ms, int _probe_interval_ms) :
+    QObject(parent),
+    threshold_ms(_threshold_ms),
+    probe_interval_ms(_probe_interval_ms),
+    heartbeat_type(static_cast<QEvent::Type>(QEvent::registerEventType())),
+    running(false),
+    probe_posted_ms(0),
+    handler_at_threshold(NULL),
+    next_stall(0),
+    stall_count(0),
+    probes(0),
+    max_lag_ms(0),
+    total_lag_ms(0)
+{
+    memset(histogram, 0, sizeof(histogram));
+}
+
+StallWatchdog::~StallWatchdog()
+{
+    stop();
+    if (active == this)
+        active = NULL;
+}
+
+StallWatchdog* StallWatchdog::instance()
+{
+    return active;
+}
+
+uint64_t StallWatchdog::now_ms()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void StallWatchdog::start()
+{
+    if (running.exchange(true))
+        return;
+    active = this;
+    probe_posted_ms = 0;
+    probe_thread.reset(new boost::thread(boost::bind(&StallWatchdog::run, this)));
+}
+
+void StallWatchdog::stop()
+{
+    if (!running.exchange(false))
+        return;
+    probe_thread->join();
+    probe_thread.reset();
+}
+
+void StallWatchdog::run()
+{
+    while (running) {
+        uint64_t now = now_ms();
+        uint64_t posted = probe_posted_ms;
+        if (!posted) {
+            handler_at_threshold = NULL;
+            probe_posted_ms = now;
+            QCoreApplication::postEvent(this, new QEvent(heartbeat_type), Qt::HighEventPriority);
+        } else if (now - posted >= static_cast<uint64_t>(threshold_ms) && !handler_at_threshold) {
+            const char* handler = current_handler;
+            handler_at_threshold = handler ? handler : "(event loop)";
+        }
+        boost::this_thread::sleep(boost::posix_time::milliseconds(probe_interval_ms));
+    }
+}
+
+bool StallWatchdog::event(QEvent *e)
+{
+    if (e->type() != heartbeat_type)
+        return QObject::event(e);
+
+    uint64_t posted = probe_posted_ms;
+    uint64_t lag = now_ms() - posted;
+    const char* handler = handler_at_threshold;
+    probe_posted_ms = 0;
+
+    std::size_t bucket = 0;
+    while (bucket + 1 < HistogramBuckets && (1ULL << bucket) <= lag)
+        ++bucket;
+    {
+        boost::mutex::scoped_lock lock(stats_mtx);
+        ++histogram[bucket];
+        ++probes;
+        total_lag_ms += lag;
+        if (lag > max_lag_ms)
+            max_lag_ms = lag;
+    }
+    if (lag >= static_cast<uint64_t>(threshold_ms))
+        add_stall(handler ? handler : "(event loop)", posted, lag, false);
+    return true;
+}
+
+void StallWatchdog::add_stall(const char* handler, uint64_t at_ms, uint64_t duration_ms, bool long_frame)
+{
+    Stall stall = { handler ? handler : "(unknown)", at_ms, duration_ms, long_frame };
+    {
+        boost::mutex::scoped_lock lock(stats_mtx);
+        if (stalls.size() < MaxStalls)
+            stalls.push_back(stall);
+        else
+            stalls[next_stall] = stall;
+        next_stall = (next_stall + 1) % MaxStalls;
+        ++stall_count;
+    }
+    emit stallDetected(QString::fromStdString(stall.handler), static_cast<int>(duration_ms));
+}
+
+std::string StallWatchdog::report()
+{
+    boost::mutex::scoped_lock lock(stats_mtx);
+    std::ostringstream out;
+    out << "Event-loop stall report (threshold " << threshold_ms << " ms)\n";
+    out << "probes: " << probes
+        << ", average lag: " << (probes ? total_lag_ms / probes : 0) << " ms"
+        << ", max lag: " << max_lag_ms << " ms\n\n";
+
+    out << "latency histogram:\n";
+    for (std::size_t i = 0; i < HistogramBuckets; ++i) {
+        if (!i)
+            out << "       < 1 ms";
+        else if (i + 1 == HistogramBuckets)
+            out << "  >= " << (1ULL << (i - 1)) << " ms";
+        else
+            out << "  " << (1ULL << (i - 1)) << ".." << (1ULL << i) << " ms";
+        out << ": " << histogram[i] << "\n";
+    }
+
+    // a long handler is added when it ends but stamped with its start, so
+    // the ring isn't in time order
+    std::vector<Stall> kept(stalls);
+    std::stable_sort(kept.begin(), kept.end(), stall_before);
+    out << "\nstalls: " << stall_count;
+    if (stall_count > kept.size())
+        out << " (the last " << kept.size() << " listed)";
+    out << "\n";
+    for (std::size_t i = 0; i < kept.size(); ++i) {
+        out << "  +" << kept[i].at_ms - kept[0].at_ms << " ms  "
+            << (kept[i].long_frame ? "long handler " : "loop lag     ")
+            << kept[i].duration_ms << " ms  in " << kept[i].handler << "\n";
+    }
+    return out.str();
+}
+
+bool StallWatchdog::write_report(const std::string& path)
+{
+    std::string text = report();
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file)
+        return false;
+    bool ok = fwrite(text.data(), 1, text.size(), file) == text.size();
+    return fclose(file) == 0 && ok;
+}
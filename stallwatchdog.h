@@ -0,0 +1,105 @@
+#ifndef STALLWATCHDOG_H
+#define STALLWATCHDOG_H
+
+#include <QObject>
+#include <QEvent>
+#include <boost/thread.hpp>
+#include <atomic>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Measures GUI event-loop lag from a helper thread. The helper posts a
+// heartbeat event to the GUI thread and times how long it waits in the
+// queue; handlers wrapped in STALL_SCOPE name the code that was running
+// when the lag passed the threshold. Modal dialogs run a nested event loop,
+// so time spent in a STALL_MODAL_SCOPE isn't counted against the handler
+// that opened them.
+class StallWatchdog : public QObject
+{
+    Q_OBJECT
+public:
+    struct Stall
+    {
+        std::string handler;
+        uint64_t at_ms;
+        uint64_t duration_ms;
+        bool long_frame;
+    };
+
+    enum
+    {
+        HistogramBuckets = 12,
+        MaxStalls = 256         // the most recent are kept
+    };
+
+    class HandlerScope
+    {
+        const char* previous;
+        uint64_t begin_ms;
+        uint64_t modal_begin_ms;
+    public:
+        explicit HandlerScope(const char* name);
+        ~HandlerScope();
+    };
+
+    // Around a modal exec(), GUI thread only.
+    class ModalScope
+    {
+        uint64_t begin_ms;
+        uint64_t modal_begin_ms;
+    public:
+        ModalScope();
+        ~ModalScope();
+    };
+
+    explicit StallWatchdog(QObject *parent = 0, int _threshold_ms = 100, int _probe_interval_ms = 20);
+    ~StallWatchdog();
+
+    static StallWatchdog* instance();
+    static uint64_t now_ms();
+
+    void start();
+    void stop();
+
+    std::string report();
+    bool write_report(const std::string& path);
+
+signals:
+    void stallDetected(QString handler, int duration_ms);
+
+protected:
+    bool event(QEvent *e);
+
+private:
+    void run();
+    void add_stall(const char* handler, uint64_t at_ms, uint64_t duration_ms, bool long_frame);
+
+    static std::atomic<const char*> current_handler;
+    static StallWatchdog* active;
+    static uint64_t modal_ms;           // spent in modal scopes so far
+
+    int threshold_ms;
+    int probe_interval_ms;
+    QEvent::Type heartbeat_type;
+    std::atomic<bool> running;
+    std::atomic<uint64_t> probe_posted_ms;
+    std::atomic<const char*> handler_at_threshold;
+    boost::shared_ptr<boost::thread> probe_thread;
+
+    boost::mutex stats_mtx;
+    std::vector<Stall> stalls;          // a ring of MaxStalls
+    std::size_t next_stall;
+    uint64_t stall_count;
+    uint64_t histogram[HistogramBuckets];
+    uint64_t probes;
+    uint64_t max_lag_ms;
+    uint64_t total_lag_ms;
+};
+
+#define STALL_CONCAT_IMPL(a, b) a##b
+#define STALL_CONCAT(a, b) STALL_CONCAT_IMPL(a, b)
+#define STALL_SCOPE(name) StallWatchdog::HandlerScope STALL_CONCAT(stall_scope_, __LINE__)(name)
+#define STALL_MODAL_SCOPE() StallWatchdog::ModalScope STALL_CONCAT(stall_modal_, __LINE__)
+
+#endif // STALLWATCHDOG_H
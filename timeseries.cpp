@@ -0,0 +1,221 @@
+#include "timeseries.h"
+#include "varint.h"
+
+#include <algorithm>
+#include <cmath>
+
+void DeltaColumn::append(int64_t value)
+{
+    put_svarint(data, static_cast<int64_t>(static_cast<uint64_t>(value) - static_cast<uint64_t>(previous)));
+    previous = value;
+    ++count;
+}
+
+void DeltaColumn::decode(std::vector<int64_t> &out) const
+{
+    std::size_t offset = 0;
+    out.clear();
+    decode_tail(out, offset);
+}
+
+void DeltaColumn::decode_tail(std::vector<int64_t> &out, std::size_t &offset) const
+{
+    std::size_t i = out.size();
+    if (i >= count)
+        return;
+    out.resize(count);
+    const uint8_t* p = &data[offset];
+    int64_t value = i ? out[i - 1] : 0;
+    for (; i < count; ++i) {
+        uint64_t zigzag = 0;
+        for (int shift = 0;; shift += 7) {
+            uint8_t byte = *p++;
+            zigzag |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                break;
+        }
+        value += zigzag_decode(zigzag);
+        out[i] = value;
+    }
+    offset = static_cast<std::size_t>(p - &data[0]);
+}
+
+void DeltaColumn::truncate(std::size_t rows)
+{
+    if (rows >= count)
+        return;
+    std::size_t offset = 0;
+    int64_t value = 0;
+    for (std::size_t i = 0; i < rows; ++i) {
+        uint64_t zigzag = 0;
+        for (int shift = 0;; shift += 7) {
+            uint8_t byte = data[offset++];
+            zigzag |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                break;
+        }
+        value += zigzag_decode(zigzag);
+    }
+    data.resize(offset);
+    previous = value;
+    count = rows;
+}
+
+const char* TimeSeries::column_name(int column)
+{
+    static const char* names[ColumnCount] = {
+        "Money", "Materials", "Products A", "Products B", "Debit", "Credit"
+    };
+    return column >= 0 && column < ColumnCount ? names[column] : "";
+}
+
+void TimeSeries::append(const GameState &state)
+{
+    int64_t products_a = 0;
+    for (std::size_t i = 0; i < state.products.size(); ++i)
+        products_a += state.products[i] == GameState::ProductA;
+    int64_t debit = 0;
+    for (int i = 0; i < 4; ++i)
+        debit += state.debit[i];
+    int64_t credit = 0;
+    for (std::size_t i = 0; i < state.credit_lines.size(); ++i)
+        credit += state.credit_lines[i].money;
+
+    turns.append(state.turn);
+    columns[Money].append(state.money);
+    columns[Materials].append(state.materials);
+    columns[ProductsA].append(products_a);
+    columns[ProductsB].append(static_cast<int64_t>(state.products.size()) - products_a);
+    columns[Debit].append(debit);
+    columns[Credit].append(credit);
+}
+
+void TimeSeries::truncate(std::size_t rows)
+{
+    turns.truncate(rows);
+    for (int i = 0; i < ColumnCount; ++i)
+        columns[i].truncate(rows);
+    ++truncated;
+}
+
+std::size_t TimeSeries::bytes() const
+{
+    std::size_t total = turns.bytes();
+    for (int i = 0; i < ColumnCount; ++i)
+        total += columns[i].bytes();
+    return total;
+}
+
+void lttb_downsample(const std::vector<int64_t> &x, const std::vector<int64_t> &y,
+                     std::size_t threshold, std::vector<std::size_t> &indices)
+{
+    indices.clear();
+    std::size_t n = std::min(x.size(), y.size());
+    if (threshold >= n || threshold < 3) {
+        for (std::size_t i = 0; i < n; ++i)
+            indices.push_back(i);
+        return;
+    }
+
+    // first and last points are kept; the rest is split into threshold - 2
+    // buckets and each bucket keeps the point forming the largest triangle
+    // with the previous pick and the average of the next bucket
+    double every = double(n - 2) / (threshold - 2);
+    std::size_t a = 0;
+    indices.push_back(a);
+    for (std::size_t bucket = 0; bucket < threshold - 2; ++bucket) {
+        std::size_t begin = static_cast<std::size_t>(bucket * every) + 1;
+        std::size_t end = static_cast<std::size_t>((bucket + 1) * every) + 1;
+        std::size_t next_begin = end;
+        std::size_t next_end = std::min(static_cast<std::size_t>((bucket + 2) * every) + 1, n);
+
+        double avg_x = 0, avg_y = 0;
+        for (std::size_t i = next_begin; i < next_end; ++i) {
+            avg_x += x[i];
+            avg_y += y[i];
+        }
+        std::size_t next_count = next_end - next_begin;
+        avg_x /= next_count;
+        avg_y /= next_count;
+
+        double ax = double(x[a]), ay = double(y[a]);
+        double best_area = -1;
+        std::size_t best = begin;
+        for (std::size_t i = begin; i < end; ++i) {
+            double area = std::fabs((ax - avg_x) * (double(y[i]) - ay) - (ax - double(x[i])) * (avg_y - ay));
+            if (area > best_area) {
+                best_area = area;
+                best = i;
+            }
+        }
+        indices.push_back(best);
+        a = best;
+    }
+    indices.push_back(n - 1);
+}
+
+void LttbSampler::reset(std::size_t _threshold)
+{
+    threshold = _threshold;
+    width = 1;
+    fixed.clear();
+}
+
+void LttbSampler::update(const std::vector<int64_t> &x, const std::vector<int64_t> &y,
+                         std::vector<std::size_t> &indices)
+{
+    indices.clear();
+    std::size_t n = std::min(x.size(), y.size());
+    if (n <= 2 || threshold < 3) {
+        for (std::size_t i = 0; i < n; ++i)
+            indices.push_back(i);
+        return;
+    }
+
+    // the first and last rows are kept, the ones between go into buckets
+    // of width rows of which the last may still be filling up
+    while ((n - 2 + width - 1) / width + 2 > threshold) {
+        width *= 2;
+        fixed.clear();
+    }
+    std::size_t buckets = (n - 2 + width - 1) / width;
+    if (fixed.empty())
+        fixed.push_back(0);
+    indices = fixed;
+
+    std::size_t a = fixed.back();
+    for (std::size_t bucket = fixed.size() - 1; bucket < buckets; ++bucket) {
+        std::size_t begin = 1 + bucket * width;
+        std::size_t end = std::min(begin + width, n - 1);
+        std::size_t next_begin = end;
+        std::size_t next_end = std::min(end + width, n - 1);
+        bool next_full = next_end - next_begin == width;
+        if (next_begin == next_end)
+            next_end = n;       // the last bucket aims at the last row
+
+        double avg_x = 0, avg_y = 0;
+        for (std::size_t i = next_begin; i < next_end; ++i) {
+            avg_x += x[i];
+            avg_y += y[i];
+        }
+        std::size_t next_count = next_end - next_begin;
+        avg_x /= next_count;
+        avg_y /= next_count;
+
+        double ax = double(x[a]), ay = double(y[a]);
+        double best_area = -1;
+        std::size_t best = begin;
+        for (std::size_t i = begin; i < end; ++i) {
+            double area = std::fabs((ax - avg_x) * (double(y[i]) - ay) - (ax - double(x[i])) * (avg_y - ay));
+            if (area > best_area) {
+                best_area = area;
+                best = i;
+            }
+        }
+        indices.push_back(best);
+        if (next_full && fixed.size() == bucket + 1)
+            fixed.push_back(best);
+        a = best;
+    }
+    indices.push_back(n - 1);
+}
@@ -0,0 +1,98 @@
+#ifndef TIMESERIES_H
+#define TIMESERIES_H
+
+#include "gamestate.h"
+#include <stdint.h>
+#include <vector>
+
+// Append-only integer column. Each value is stored as the zigzag varint of
+// its difference to the previous one, so slowly moving counters such as
+// money or the turn number take one or two bytes per row.
+class DeltaColumn
+{
+public:
+    DeltaColumn() : previous(0), count(0) { }
+
+    void append(int64_t value);
+
+    std::size_t size() const { return count; }
+
+    int64_t last() const { return previous; }
+
+    void decode(std::vector<int64_t>& out) const;
+
+    // Appends the rows after the out.size() already decoded ones; offset is
+    // where they ended in the data, 0 for an empty out.
+    void decode_tail(std::vector<int64_t>& out, std::size_t& offset) const;
+
+    // Drops the rows from rows on, appending carries on from the one before.
+    void truncate(std::size_t rows);
+
+    std::size_t bytes() const { return data.capacity(); }
+
+private:
+    std::vector<uint8_t> data;
+    int64_t previous;
+    std::size_t count;
+};
+
+// Per-turn economics of the session, one column per charted quantity.
+class TimeSeries
+{
+public:
+    enum Column { Money, Materials, ProductsA, ProductsB, Debit, Credit, ColumnCount };
+
+    TimeSeries() : truncated(0) { }
+
+    static const char* column_name(int column);
+
+    void append(const GameState& state);
+
+    // Keeps the first rows turns, e.g. when the game goes back to one.
+    void truncate(std::size_t rows);
+
+    std::size_t size() const { return turns.size(); }
+
+    const DeltaColumn& turn_column() const { return turns; }
+
+    const DeltaColumn& column(int column) const { return columns[column]; }
+
+    std::size_t bytes() const;
+
+    // Counts truncate() calls, rows decoded before a change of it are stale.
+    std::size_t truncations() const { return truncated; }
+
+private:
+    DeltaColumn turns;
+    DeltaColumn columns[ColumnCount];
+    std::size_t truncated;
+};
+
+// Largest-Triangle-Three-Buckets: picks at most threshold points of (x, y)
+// that keep the visual shape of the line. Writes the chosen indices.
+void lttb_downsample(const std::vector<int64_t>& x, const std::vector<int64_t>& y,
+                     std::size_t threshold, std::vector<std::size_t>& indices);
+
+// LTTB for a series that only grows. The buckets are a fixed number of rows
+// wide, so a bucket's pick is final once the bucket after it is full and an
+// update only picks the last buckets again. The width doubles whenever the
+// picks would pass threshold, which picks everything anew once per doubling.
+class LttbSampler
+{
+public:
+    LttbSampler() : threshold(0), width(1) { }
+
+    // Starts over, e.g. for another width of the chart or rewound rows.
+    void reset(std::size_t _threshold);
+
+    // x and y hold the rows of the previous update and maybe more.
+    void update(const std::vector<int64_t>& x, const std::vector<int64_t>& y,
+                std::vector<std::size_t>& indices);
+
+private:
+    std::size_t threshold;
+    std::size_t width;                  // rows per bucket
+    std::vector<std::size_t> fixed;     // the first row, then the final picks
+};
+
+#endif // TIMESERIES_H
@@ -0,0 +1,135 @@
+#include "tracer.h"
+
+#ifdef YOURCOMPANY_TRACE
+
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+
+namespace {
+
+thread_local Tracer::ThreadBuffer* tls_buffer = NULL;
+
+void json_escape(std::ostringstream& out, const std::string& s)
+{
+    for (std::size_t i = 0; i < s.size(); ++i) {
+        char c = s[i];
+        if (c == '"' || c == '\\')
+            out << '\\' << c;
+        else if (static_cast<unsigned char>(c) < 0x20)
+            out << ' ';
+        else
+            out << c;
+    }
+}
+
+}
+
+Tracer::ThreadBuffer::ThreadBuffer(uint32_t _tid, std::size_t capacity) :
+    tid(_tid),
+    head(0),
+    wrapped(false)
+{
+    events.resize(capacity);
+}
+
+void Tracer::ThreadBuffer::push(const Event& event)
+{
+    boost::mutex::scoped_lock lock(mtx);
+    events[head] = event;
+    if (++head == events.size()) {
+        head = 0;
+        wrapped = true;
+    }
+}
+
+Tracer::Tracer() :
+    next_tid(1),
+    capacity(1 << 16)
+{
+}
+
+Tracer& Tracer::instance()
+{
+    static Tracer tracer;
+    return tracer;
+}
+
+uint64_t Tracer::now_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Tracer::ThreadBuffer* Tracer::current_buffer()
+{
+    if (!tls_buffer) {
+        boost::mutex::scoped_lock lock(buffers_mtx);
+        tls_buffer = new ThreadBuffer(next_tid++, capacity);
+        buffers.push_back(tls_buffer);
+    }
+    return tls_buffer;
+}
+
+void Tracer::set_thread_name(const char* name)
+{
+    ThreadBuffer* buffer = current_buffer();
+    boost::mutex::scoped_lock lock(buffer->mtx);
+    buffer->thread_name = name;
+}
+
+void Tracer::record(const char* name, uint64_t begin_us, uint64_t end_us)
+{
+    Event event = { name, begin_us, end_us - begin_us };
+    current_buffer()->push(event);
+}
+
+std::string Tracer::to_json()
+{
+    std::vector<ThreadBuffer*> snapshot;
+    {
+        boost::mutex::scoped_lock lock(buffers_mtx);
+        snapshot = buffers;
+    }
+
+    std::ostringstream out;
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    for (std::size_t b = 0; b < snapshot.size(); ++b) {
+        ThreadBuffer* buffer = snapshot[b];
+        boost::mutex::scoped_lock lock(buffer->mtx);
+        if (!buffer->thread_name.empty()) {
+            out << (first ? "" : ",")
+                << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid
+                << ",\"args\":{\"name\":\"";
+            json_escape(out, buffer->thread_name);
+            out << "\"}}";
+            first = false;
+        }
+        std::size_t count = buffer->wrapped ? buffer->events.size() : buffer->head;
+        std::size_t start = buffer->wrapped ? buffer->head : 0;
+        for (std::size_t i = 0; i < count; ++i) {
+            const Event& event = buffer->events[(start + i) % buffer->events.size()];
+            out << (first ? "" : ",") << "{\"name\":\"";
+            json_escape(out, event.name);
+            out << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid
+                << ",\"ts\":" << event.begin_us
+                << ",\"dur\":" << event.duration_us << "}";
+            first = false;
+        }
+    }
+    out << "]}";
+    return out.str();
+}
+
+bool Tracer::flush(const std::string& path)
+{
+    std::string json = to_json();
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file)
+        return false;
+    bool ok = fwrite(json.data(), 1, json.size(), file) == json.size();
+    return fclose(file) == 0 && ok;
+}
+
+#endif // YOURCOMPANY_TRACE
@@ -0,0 +1,94 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+// Timeline spans for the network, updater and paint paths.
+// Build with CONFIG += trace to compile them in; without it every macro
+// below expands to nothing. Spans land in a per-thread ring buffer and are
+// written as Chrome/Perfetto trace-event JSON by TRACE_FLUSH(path).
+
+#ifdef YOURCOMPANY_TRACE
+
+#include <boost/thread/mutex.hpp>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class Tracer
+{
+public:
+    struct Event
+    {
+        const char* name;
+        uint64_t begin_us;
+        uint64_t duration_us;
+    };
+
+    struct ThreadBuffer
+    {
+        boost::mutex mtx;
+        uint32_t tid;
+        std::string thread_name;
+        std::vector<Event> events;
+        std::size_t head;
+        bool wrapped;
+
+        ThreadBuffer(uint32_t _tid, std::size_t capacity);
+
+        void push(const Event& event);
+    };
+
+    static Tracer& instance();
+
+    static uint64_t now_us();
+
+    void set_thread_name(const char* name);
+
+    void record(const char* name, uint64_t begin_us, uint64_t end_us);
+
+    std::string to_json();
+
+    bool flush(const std::string& path);
+
+private:
+    Tracer();
+
+    ThreadBuffer* current_buffer();
+
+    boost::mutex buffers_mtx;
+    // Buffers are never freed: a thread may still write after it was flushed.
+    std::vector<ThreadBuffer*> buffers;
+    uint32_t next_tid;
+    std::size_t capacity;
+};
+
+class TraceScope
+{
+    const char* name;
+    uint64_t begin_us;
+public:
+    explicit TraceScope(const char* _name) :
+        name(_name),
+        begin_us(Tracer::now_us())
+    { }
+
+    ~TraceScope()
+    {
+        Tracer::instance().record(name, begin_us, Tracer::now_us());
+    }
+};
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#define TRACE_THREAD_NAME(name) Tracer::instance().set_thread_name(name)
+#define TRACE_FLUSH(path) Tracer::instance().flush(path)
+
+#else
+
+#define TRACE_SCOPE(name) ((void) 0)
+#define TRACE_THREAD_NAME(name) ((void) 0)
+#define TRACE_FLUSH(path) false
+
+#endif // YOURCOMPANY_TRACE
+
+#endif // TRACER_H
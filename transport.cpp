@@ -0,0 +1,474 @@
+#include "transport.h"
+#include "shmring.h"
+#include "uring.h"
+
+#include <QDebug>
+#include <boost/asio.hpp>
+#include <boost/bind/bind.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <chrono>
+
+#ifdef WIN32
+#include <mstcpip.h>
+#undef min
+#undef errno
+#undef error
+#else
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <cerrno>
+#include <cstring>
+#endif
+#define TCP_KEEPALIVE_SECS 5
+
+bool Endpoint::parse(const std::string &uri, uint16_t default_port, Endpoint &endpoint)
+{
+    std::size_t scheme_end = uri.find("://");
+    std::string scheme = scheme_end == std::string::npos ? "tcp" : uri.substr(0, scheme_end);
+    std::string rest = scheme_end == std::string::npos ? uri : uri.substr(scheme_end + 3);
+    if (rest.empty())
+        return false;
+
+    if (scheme == "unix") {
+        endpoint.kind = Unix;
+        endpoint.address = rest;
+        endpoint.port = 0;
+        endpoint.uring = false;
+        return true;
+    }
+    if (scheme == "shm") {
+        endpoint.kind = Shm;
+        endpoint.address = rest;
+        endpoint.port = 0;
+        endpoint.uring = false;
+        return true;
+    }
+    if (scheme != "tcp" && scheme != "tcp+uring")
+        return false;
+
+    endpoint.kind = Tcp;
+    endpoint.uring = scheme == "tcp+uring";
+    endpoint.port = default_port;
+    std::size_t colon = rest.rfind(':');
+    if (colon == std::string::npos) {
+        endpoint.address = rest;
+    } else {
+        char* end = NULL;
+        unsigned long port = strtoul(rest.c_str() + colon + 1, &end, 10);
+        if (*end || !port || port > 65535)
+            return false;
+        endpoint.address = rest.substr(0, colon);
+        endpoint.port = static_cast<uint16_t>(port);
+    }
+    return !endpoint.address.empty();
+}
+
+std::string Endpoint::to_string() const
+{
+    switch (kind) {
+    case Unix:
+        return "unix://" + address;
+    case Shm:
+        return "shm://" + address;
+    default:
+        return (uring ? "tcp+uring://" : "tcp://") + address + ":" + std::to_string(port);
+    }
+}
+
+namespace {
+
+// An IoHandler whose asio operation lives in the transport's memory for
+// that direction, which it keeps alive until the operation is freed.
+class OpHandler
+{
+public:
+    typedef HandlerAllocator<void> allocator_type;
+
+    OpHandler(const boost::shared_ptr<Transport>& _transport, HandlerMemory& _memory,
+              const Transport::IoHandler& _handler) :
+        transport(_transport),
+        memory(&_memory),
+        handler(_handler)
+    {
+    }
+
+    allocator_type get_allocator() const
+    {
+        return allocator_type(*memory);
+    }
+
+    void operator()(const boost::system::error_code& error, std::size_t size)
+    {
+        handler(error, size);
+    }
+
+private:
+    boost::shared_ptr<Transport> transport;
+    HandlerMemory* memory;
+    Transport::IoHandler handler;
+};
+
+template <class Socket>
+class SocketTransport : public Transport
+{
+public:
+    explicit SocketTransport(boost::asio::io_service& io_service) :
+        socket(io_service)
+    {
+    }
+
+    void async_read_some(uint8_t* data, std::size_t size, const IoHandler& handler)
+    {
+        socket.async_read_some(boost::asio::buffer(data, size), OpHandler(shared_from_this(), read_memory, handler));
+    }
+
+    void async_write(const uint8_t* data, std::size_t size, const IoHandler& handler)
+    {
+        boost::asio::async_write(socket, boost::asio::buffer(data, size), boost::asio::transfer_all(),
+                                 OpHandler(shared_from_this(), write_memory, handler));
+    }
+
+    void close()
+    {
+        boost::system::error_code ignored;
+        socket.close(ignored);
+    }
+
+protected:
+    Socket socket;
+    HandlerMemory read_memory;
+    HandlerMemory write_memory;
+};
+
+class TcpTransport : public SocketTransport<boost::asio::ip::tcp::socket>
+{
+public:
+    TcpTransport(boost::asio::io_service& io_service, const Endpoint& _endpoint) :
+        SocketTransport<boost::asio::ip::tcp::socket>(io_service),
+        resolver(io_service),
+        endpoint(_endpoint)
+    {
+    }
+
+    void async_connect(const ConnectHandler& handler)
+    {
+        boost::asio::ip::tcp::resolver::query query(endpoint.address, std::to_string(endpoint.port));
+        resolver.async_resolve(query, boost::bind(&TcpTransport::resolve_cb,
+            boost::static_pointer_cast<TcpTransport>(shared_from_this()),
+            handler,
+            boost::asio::placeholders::error,
+            boost::asio::placeholders::iterator));
+    }
+
+    void close()
+    {
+        resolver.cancel();
+        SocketTransport<boost::asio::ip::tcp::socket>::close();
+    }
+
+private:
+    void resolve_cb(const ConnectHandler& handler, const boost::system::error_code& error,
+                    boost::asio::ip::tcp::resolver::iterator i)
+    {
+        if (error) {
+//            qWarning("Paradox: unable to resolve %s\n", endpoint.address.c_str());
+            handler(error);
+            return;
+        }
+        boost::asio::async_connect(socket, i, boost::bind(&TcpTransport::connect_cb,
+            boost::static_pointer_cast<TcpTransport>(shared_from_this()),
+            handler,
+            boost::asio::placeholders::error));
+    }
+
+    void connect_cb(const ConnectHandler& handler, const boost::system::error_code& error)
+    {
+        if (!error)
+            set_options();
+        handler(error);
+    }
+
+    void set_options()
+    {
+#ifdef WIN32
+        DWORD ret_bytes = 0;
+        struct tcp_keepalive keepalive_opts;
+        keepalive_opts.onoff = TRUE;
+        keepalive_opts.keepalivetime = TCP_KEEPALIVE_SECS * 1000;
+        keepalive_opts.keepaliveinterval = TCP_KEEPALIVE_SECS * 1000;
+        int res = WSAIoctl(
+                    socket.native_handle(),
+                    SIO_KEEPALIVE_VALS,
+                    &keepalive_opts,
+                    sizeof(keepalive_opts),
+                    NULL,
+                    0,
+                    &ret_bytes,
+                    NULL,
+                    NULL);
+        if (res == SOCKET_ERROR) {
+//            qWarning("ASIO: WSAIotcl(SIO_KEEPALIVE_VALS) failed (%d)\n", WSAGetLastError());
+        }
+#else
+        set_tcp_options(socket.native_handle(), endpoint.address);
+#endif
+    }
+
+    boost::asio::ip::tcp::resolver resolver;
+    Endpoint endpoint;
+};
+
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+// Same host, no TCP stack: no Nagle, no keepalive to tune.
+class UnixTransport : public SocketTransport<boost::asio::local::stream_protocol::socket>
+{
+public:
+    UnixTransport(boost::asio::io_service& io_service, const Endpoint& endpoint) :
+        SocketTransport<boost::asio::local::stream_protocol::socket>(io_service),
+        path(endpoint.address)
+    {
+    }
+
+    void async_connect(const ConnectHandler& handler)
+    {
+        socket.async_connect(boost::asio::local::stream_protocol::endpoint(path), handler);
+    }
+
+private:
+    std::string path;
+};
+#endif
+
+// The rings have no wakeup, so a waiting read or write polls: first by
+// reposting itself for SpinUs, which keeps the round trip in the
+// microseconds while traffic flows, then on a timer backing off to
+// MaxSleepUs so an idle connection costs little CPU.
+class ShmTransport : public Transport
+{
+public:
+    enum { SpinUs = 50, MinSleepUs = 20, MaxSleepUs = 1000 };
+
+    ShmTransport(boost::asio::io_service& _io_service, const Endpoint& endpoint) :
+        io_service(_io_service),
+        name(endpoint.address),
+        read_timer(_io_service),
+        write_timer(_io_service),
+        read_data(NULL),
+        write_data(NULL),
+        closed(false)
+    {
+    }
+
+    void async_connect(const ConnectHandler& handler)
+    {
+        boost::system::error_code error;
+        try {
+            channel.reset(new ShmChannel(name, ShmChannel::Client));
+        } catch (const std::exception& e) {
+            qWarning("Paradox: shared memory channel %s: %s\n", name.c_str(), e.what());
+            error = boost::asio::error::connection_refused;
+        }
+        io_service.post(boost::bind(handler, error));
+    }
+
+    void async_read_some(uint8_t* data, std::size_t size, const IoHandler& handler)
+    {
+        read_data = data;
+        read_op.start(size, handler);
+        if (closed || !channel)
+            read_op.abort(io_service);
+        else
+            io_service.post(boost::bind(&ShmTransport::poll_read, shared_this()));
+    }
+
+    void async_write(const uint8_t* data, std::size_t size, const IoHandler& handler)
+    {
+        write_data = data;
+        write_op.start(size, handler);
+        if (closed || !channel)
+            write_op.abort(io_service);
+        else
+            io_service.post(boost::bind(&ShmTransport::poll_write, shared_this()));
+    }
+
+    // Pending handlers move to the io_service instead of staying here: they
+    // usually hold the transport, which would otherwise never be freed.
+    void close()
+    {
+        closed = true;
+        read_timer.cancel();
+        write_timer.cancel();
+        read_op.abort(io_service);
+        write_op.abort(io_service);
+        if (channel)
+            channel->detach();
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+    typedef void (ShmTransport::*Poll)();
+
+    struct Op
+    {
+        std::size_t size;
+        std::size_t done;
+        IoHandler handler;
+        Clock::time_point idle_since;
+        int sleep_us;
+
+        void start(std::size_t _size, const IoHandler& _handler)
+        {
+            size = _size;
+            done = 0;
+            handler = _handler;
+            progressed();
+        }
+
+        void progressed()
+        {
+            idle_since = Clock::now();
+            sleep_us = MinSleepUs;
+        }
+
+        void complete(const boost::system::error_code& error)
+        {
+            IoHandler h;
+            h.swap(handler);
+            h(error, done);
+        }
+
+        void abort(boost::asio::io_service& io_service)
+        {
+            if (!handler)
+                return;
+            io_service.post(boost::bind(handler, boost::asio::error::operation_aborted, 0));
+            handler.clear();
+        }
+    };
+
+    boost::shared_ptr<ShmTransport> shared_this()
+    {
+        return boost::static_pointer_cast<ShmTransport>(shared_from_this());
+    }
+
+    void poll_read()
+    {
+        if (!read_op.handler)
+            return;
+        read_op.done = channel->inbound().read(read_data, read_op.size);
+        if (read_op.done) {
+            read_op.complete(boost::system::error_code());
+            return;
+        }
+        if (!channel->peer_alive()) {
+            read_op.complete(boost::asio::error::eof);
+            return;
+        }
+        wait(read_op, read_timer, &ShmTransport::poll_read);
+    }
+
+    void poll_write()
+    {
+        if (!write_op.handler)
+            return;
+        if (!channel->peer_alive()) {
+            write_op.complete(boost::asio::error::broken_pipe);
+            return;
+        }
+        std::size_t n = channel->outbound().write(write_data + write_op.done, write_op.size - write_op.done);
+        write_op.done += n;
+        if (write_op.done == write_op.size) {
+            write_op.complete(boost::system::error_code());
+            return;
+        }
+        if (n)
+            write_op.progressed();
+        wait(write_op, write_timer, &ShmTransport::poll_write);
+    }
+
+    void wait(Op& op, boost::asio::deadline_timer& timer, Poll poll)
+    {
+        if (Clock::now() - op.idle_since < std::chrono::microseconds(SpinUs)) {
+            io_service.post(boost::bind(poll, shared_this()));
+            return;
+        }
+        timer.expires_from_now(boost::posix_time::microseconds(op.sleep_us));
+        timer.async_wait(boost::bind(&ShmTransport::on_timer, shared_this(), poll));
+        op.sleep_us = std::min<int>(op.sleep_us * 2, MaxSleepUs);
+    }
+
+    // also reached when close() cancels the timer, with nothing left to poll
+    void on_timer(Poll poll)
+    {
+        (this->*poll)();
+    }
+
+    boost::asio::io_service& io_service;
+    std::string name;
+    boost::scoped_ptr<ShmChannel> channel;
+    boost::asio::deadline_timer read_timer;
+    boost::asio::deadline_timer write_timer;
+    uint8_t* read_data;
+    const uint8_t* write_data;
+    Op read_op;
+    Op write_op;
+    bool closed;
+};
+
+}
+
+#ifndef WIN32
+void set_tcp_options(int fd, const std::string &address)
+{
+    int optval = 1;
+    if (setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &optval, sizeof(optval)) == -1)
+        qWarning("Paradox: connection to %s setup error: %s\n", address.c_str(), strerror(errno));
+
+    if (setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &optval, sizeof(optval)) == -1) {
+        qWarning("ASIO: setsockopt(SO_KEEPALIVE) failed (%s)\n", strerror(errno));
+        return;
+    }
+    optval = 3;
+    if (setsockopt(fd, SOL_TCP, TCP_KEEPCNT, &optval, sizeof(optval)) == -1) {
+        qWarning("ASIO: setsockopt(TCP_KEEPCNT) failed (%s)\n", strerror(errno));
+        return;
+    }
+    optval = TCP_KEEPALIVE_SECS;
+    if (setsockopt(fd, SOL_TCP, TCP_KEEPIDLE, &optval, sizeof(optval)) == -1) {
+        qWarning("ASIO: setsockopt(TCP_KEEPIDLE) failed (%s)\n", strerror(errno));
+        return;
+    }
+    optval = TCP_KEEPALIVE_SECS;
+    if (setsockopt(fd, SOL_TCP, TCP_KEEPINTVL, &optval, sizeof(optval)) == -1) {
+        qWarning("ASIO: setsockopt(TCP_KEEPINTVL) failed (%s)\n", strerror(errno));
+        return;
+    }
+}
+#endif
+
+boost::shared_ptr<Transport> Transport::create(boost::asio::io_service &io_service, const Endpoint &endpoint)
+{
+    switch (endpoint.kind) {
+    case Endpoint::Tcp:
+        if (endpoint.uring) {
+            boost::shared_ptr<Transport> transport = create_uring_transport(io_service, endpoint);
+            if (transport)
+                return transport;
+            static bool warned = false;
+            if (!warned) {
+                warned = true;
+                qWarning("Paradox: io_uring unavailable, %s uses epoll\n", endpoint.to_string().c_str());
+            }
+        }
+        return boost::shared_ptr<Transport>(new TcpTransport(io_service, endpoint));
+    case Endpoint::Unix:
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+        return boost::shared_ptr<Transport>(new UnixTransport(io_service, endpoint));
+#else
+        return boost::shared_ptr<Transport>();
+#endif
+    case Endpoint::Shm:
+        return boost::shared_ptr<Transport>(new ShmTransport(io_service, endpoint));
+    }
+    return boost::shared_ptr<Transport>();
+}
@@ -0,0 +1,130 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <boost/asio/io_service.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/system/error_code.hpp>
+#include <stdint.h>
+#include <string>
+#include <type_traits>
+
+// Where the server is, parsed from an endpoint URI:
+//   tcp://host:port, host:port or just host (default port)
+//   tcp+uring://host:port  the same over io_uring where the kernel has it,
+//                          see uring.h; the epoll reactor otherwise
+//   unix:///path/to/socket
+//   shm://name             shared-memory rings, see ShmChannel
+struct Endpoint
+{
+    enum Kind { Tcp, Unix, Shm };
+
+    Kind kind;
+    std::string address;    // host, socket path or segment name
+    uint16_t port;
+    bool uring;
+
+    Endpoint() : kind(Tcp), port(0), uring(false) { }
+    Endpoint(const std::string& host, uint16_t _port) : kind(Tcp), address(host), port(_port), uring(false) { }
+
+    static bool parse(const std::string& uri, uint16_t default_port, Endpoint& endpoint);
+    std::string to_string() const;
+};
+
+// Memory for an asio handler that is never pending twice, such as the one
+// read a transport has outstanding: its operation reuses one block instead
+// of the heap. Falls back to the heap when the block is taken or small.
+class HandlerMemory
+{
+public:
+    HandlerMemory() : in_use(false) { }
+
+    void* allocate(std::size_t size)
+    {
+        if (!in_use && size <= sizeof(storage)) {
+            in_use = true;
+            return &storage;
+        }
+        return ::operator new(size);
+    }
+
+    void deallocate(void* p)
+    {
+        if (p == &storage)
+            in_use = false;
+        else
+            ::operator delete(p);
+    }
+
+private:
+    HandlerMemory(const HandlerMemory&);
+    HandlerMemory& operator=(const HandlerMemory&);
+
+    std::aligned_storage<256>::type storage;
+    bool in_use;
+};
+
+// The associated allocator of a handler using HandlerMemory.
+template <class T>
+class HandlerAllocator
+{
+public:
+    typedef T value_type;
+
+    explicit HandlerAllocator(HandlerMemory& _memory) : memory(&_memory) { }
+
+    template <class U>
+    HandlerAllocator(const HandlerAllocator<U>& other) : memory(other.memory) { }
+
+    T* allocate(std::size_t n) const
+    {
+        return static_cast<T*>(memory->allocate(sizeof(T) * n));
+    }
+
+    void deallocate(T* p, std::size_t) const
+    {
+        memory->deallocate(p);
+    }
+
+    template <class U>
+    bool operator==(const HandlerAllocator<U>& other) const { return memory == other.memory; }
+
+    template <class U>
+    bool operator!=(const HandlerAllocator<U>& other) const { return memory != other.memory; }
+
+private:
+    template <class U> friend class HandlerAllocator;
+
+    HandlerMemory* memory;
+};
+
+// The byte stream the framed protocol runs over. Only one read and one
+// write are outstanding at a time; handlers run on the io_service thread
+// and are never called from inside the initiating call. An IoHandler small
+// enough for boost::function to hold in place is never copied to the heap.
+class Transport : public boost::enable_shared_from_this<Transport>
+{
+public:
+    typedef boost::function<void (const boost::system::error_code&)> ConnectHandler;
+    typedef boost::function<void (const boost::system::error_code&, std::size_t)> IoHandler;
+
+    virtual ~Transport() { }
+
+    virtual void async_connect(const ConnectHandler& handler) = 0;
+    virtual void async_read_some(uint8_t* data, std::size_t size, const IoHandler& handler) = 0;
+    // Completes once all of data is written.
+    virtual void async_write(const uint8_t* data, std::size_t size, const IoHandler& handler) = 0;
+    // Pending operations complete with operation_aborted.
+    virtual void close() = 0;
+
+    // NULL when the kind isn't available on this platform.
+    static boost::shared_ptr<Transport> create(boost::asio::io_service& io_service, const Endpoint& endpoint);
+};
+
+#ifndef WIN32
+// TCP_NODELAY and the keepalive probing every server connection gets.
+void set_tcp_options(int fd, const std::string& address);
+#endif
+
+#endif // TRANSPORT_H
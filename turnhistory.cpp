@@ -0,0 +1,152 @@
+#include "turnhistory.h"
+
+#include <cstring>
+#include <set>
+
+namespace {
+
+std::size_t heap_bytes(const uint8_t&) { return 0; }
+std::size_t heap_bytes(const GameState::CreditLine&) { return 0; }
+std::size_t heap_bytes(const GameState::Contract&) { return 0; }
+std::size_t heap_bytes(const GameState::Line& line) { return line.have_materials.capacity(); }
+std::size_t heap_bytes(const GameState::Market& market) { return market.name.capacity(); }
+
+// Sums node sizes, counting each node once when seen is given.
+template <class T>
+struct NodeCounter
+{
+    std::set<const void*>* seen;
+    std::size_t nodes;
+    std::size_t bytes;
+
+    explicit NodeCounter(std::set<const void*>* _seen) : seen(_seen), nodes(0), bytes(0) { }
+
+    void operator()(const typename PersistentVector<T>::Node* node)
+    {
+        if (seen && !seen->insert(node).second)
+            return;
+        ++nodes;
+        // shared_ptr control block plus the node and its arrays
+        bytes += sizeof(*node) + 2 * sizeof(void*)
+                + node->children.capacity() * sizeof(node->children[0])
+                + node->values.capacity() * sizeof(T);
+        for (std::size_t i = 0; i < node->values.size(); ++i)
+            bytes += heap_bytes(node->values[i]);
+    }
+};
+
+template <class T>
+void count_nodes(const PersistentVector<T>& vector, std::set<const void*>* seen,
+                 std::size_t& nodes, std::size_t& bytes)
+{
+    NodeCounter<T> counter(seen);
+    vector.visit_nodes(counter);
+    nodes += counter.nodes;
+    bytes += counter.bytes;
+}
+
+void count_version(const TurnHistory::Version& version, std::set<const void*>* seen,
+                   std::size_t& nodes, std::size_t& bytes)
+{
+    bytes += sizeof(version) + 2 * sizeof(void*);
+    count_nodes(version.products, seen, nodes, bytes);
+    count_nodes(version.credit_lines, seen, nodes, bytes);
+    count_nodes(version.lines, seen, nodes, bytes);
+    count_nodes(version.markets, seen, nodes, bytes);
+    count_nodes(version.contracts, seen, nodes, bytes);
+}
+
+}
+
+void TurnHistory::Version::to_state(GameState &state) const
+{
+    state.turn = turn;
+    state.money = money;
+    state.materials = materials;
+    state.credit_max_time = credit_max_time;
+    state.count_year = count_year;
+    memcpy(state.debit, debit, sizeof(state.debit));
+    products.to_vector(state.products);
+    credit_lines.to_vector(state.credit_lines);
+    lines.to_vector(state.lines);
+    markets.to_vector(state.markets);
+    contracts.to_vector(state.contracts);
+}
+
+TurnHistory::TurnHistory()
+{
+}
+
+std::size_t TurnHistory::record(const GameState &state)
+{
+    static const Version empty = Version();
+    const Version& base = current ? *current : empty;
+
+    boost::shared_ptr<Version> version(new Version);
+    version->id = versions.size();
+    version->turn = state.turn;
+    version->money = state.money;
+    version->materials = state.materials;
+    version->credit_max_time = state.credit_max_time;
+    version->count_year = state.count_year;
+    memcpy(version->debit, state.debit, sizeof(version->debit));
+    version->products = base.products.updated(state.products);
+    version->credit_lines = base.credit_lines.updated(state.credit_lines);
+    version->lines = base.lines.updated(state.lines);
+    version->markets = base.markets.updated(state.markets);
+    version->contracts = base.contracts.updated(state.contracts);
+    version->parent = current;
+
+    versions.push_back(version);
+    current = version;
+    redo_stack.clear();
+    return version->id;
+}
+
+bool TurnHistory::undo()
+{
+    if (!current || !current->parent)
+        return false;
+    redo_stack.push_back(current);
+    current = current->parent;
+    return true;
+}
+
+bool TurnHistory::redo()
+{
+    if (redo_stack.empty())
+        return false;
+    current = redo_stack.back();
+    redo_stack.pop_back();
+    return true;
+}
+
+bool TurnHistory::checkout(std::size_t id)
+{
+    if (id >= versions.size())
+        return false;
+    current = versions[id];
+    redo_stack.clear();
+    return true;
+}
+
+void TurnHistory::clear()
+{
+    redo_stack.clear();
+    current.reset();
+    versions.clear();
+}
+
+TurnHistory::MemoryUsage TurnHistory::memory_usage() const
+{
+    MemoryUsage usage = MemoryUsage();
+    usage.versions = versions.size();
+    usage.bytes = versions.capacity() * sizeof(VersionPtr);
+    std::set<const void*> seen;
+    std::size_t flat_nodes = 0;
+    for (std::size_t i = 0; i < versions.size(); ++i) {
+        count_version(*versions[i], &seen, usage.nodes, usage.bytes);
+        count_version(*versions[i], NULL, flat_nodes, usage.flat_bytes);
+    }
+    return usage;
+}
@@ -0,0 +1,70 @@
+#ifndef TURNHISTORY_H
+#define TURNHISTORY_H
+
+#include "gamestate.h"
+#include "persistent.h"
+#include <boost/shared_ptr.hpp>
+#include <vector>
+
+// Every recorded turn as a tree of versions. A version keeps its collections
+// in persistent vectors built from its parent's, so it only owns the leaves
+// that changed during the turn. Undo, redo and checkout just move the head
+// pointer; to_state() materializes the head when the window needs it.
+class TurnHistory
+{
+public:
+    struct Version
+    {
+        std::size_t id;
+        uint32_t turn;
+        int32_t money;
+        int32_t materials;
+        int32_t credit_max_time;
+        int32_t count_year;
+        int32_t debit[4];
+        PersistentVector<uint8_t> products;
+        PersistentVector<GameState::CreditLine> credit_lines;
+        PersistentVector<GameState::Line> lines;
+        PersistentVector<GameState::Market> markets;
+        PersistentVector<GameState::Contract> contracts;
+        boost::shared_ptr<const Version> parent;
+
+        void to_state(GameState& state) const;
+    };
+
+    typedef boost::shared_ptr<const Version> VersionPtr;
+
+    struct MemoryUsage
+    {
+        std::size_t versions;
+        std::size_t nodes;          // distinct trie nodes across all versions
+        std::size_t bytes;          // approximate heap retained by the history
+        std::size_t flat_bytes;     // the same versions stored as full copies
+    };
+
+    TurnHistory();
+
+    // Adds state as a child of the head and makes it the head. Recording
+    // after an undo starts a new branch; the old one stays reachable
+    // through checkout().
+    std::size_t record(const GameState& state);
+
+    bool undo();
+    bool redo();
+    bool checkout(std::size_t id);
+
+    const VersionPtr& head() const { return current; }
+
+    std::size_t size() const { return versions.size(); }
+
+    void clear();
+
+    MemoryUsage memory_usage() const;
+
+private:
+    std::vector<VersionPtr> versions;       // indexed by id
+    VersionPtr current;
+    std::vector<VersionPtr> redo_stack;
+};
+
+#endif // TURNHISTORY_H
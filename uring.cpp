@@ -0,0 +1,757 @@
+#include "uring.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+#endif
+
+#ifndef IORING_RECV_MULTISHOT
+
+bool uring_available()
+{
+    return false;
+}
+
+boost::shared_ptr<Transport> create_uring_transport(boost::asio::io_service&, const Endpoint&)
+{
+    return boost::shared_ptr<Transport>();
+}
+
+#else
+
+#include <QDebug>
+#include <boost/asio.hpp>
+#include <boost/bind/bind.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <unordered_map>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+
+namespace {
+
+// No liburing: the three system calls are all the ring needs.
+int io_uring_setup(unsigned entries, io_uring_params* params)
+{
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0));
+}
+
+int io_uring_register(int fd, unsigned opcode, const void* arg, unsigned nr_args)
+{
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+// The submission and completion queues shared with the kernel.
+class Ring
+{
+public:
+    Ring() :
+        fd(-1),
+        rings(MAP_FAILED),
+        rings_size(0),
+        sqes_map(MAP_FAILED),
+        sqes_size(0),
+        sqe_tail(0)
+    {
+    }
+
+    ~Ring()
+    {
+        close();
+    }
+
+    bool setup(unsigned entries)
+    {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        params.flags = IORING_SETUP_CQSIZE;
+        params.cq_entries = entries * 4;
+        fd = io_uring_setup(entries, &params);
+        if (fd < 0)
+            return false;
+        if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_NODROP))
+            return false;
+
+        rings_size = std::max<std::size_t>(params.sq_off.array + params.sq_entries * sizeof(unsigned),
+                                           params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+        rings = mmap(NULL, rings_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+        sqes_map = mmap(NULL, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if (rings == MAP_FAILED || sqes_map == MAP_FAILED)
+            return false;
+
+        uint8_t* base = static_cast<uint8_t*>(rings);
+        sq_head = reinterpret_cast<unsigned*>(base + params.sq_off.head);
+        sq_tail = reinterpret_cast<unsigned*>(base + params.sq_off.tail);
+        sq_flags = reinterpret_cast<unsigned*>(base + params.sq_off.flags);
+        sq_mask = *reinterpret_cast<unsigned*>(base + params.sq_off.ring_mask);
+        sq_entries = params.sq_entries;
+        unsigned* array = reinterpret_cast<unsigned*>(base + params.sq_off.array);
+        for (unsigned i = 0; i < sq_entries; ++i)
+            array[i] = i;
+        sqes = static_cast<io_uring_sqe*>(sqes_map);
+        sqe_tail = *sq_tail;
+
+        cq_head = reinterpret_cast<unsigned*>(base + params.cq_off.head);
+        cq_tail = reinterpret_cast<unsigned*>(base + params.cq_off.tail);
+        cq_mask = *reinterpret_cast<unsigned*>(base + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(base + params.cq_off.cqes);
+        return true;
+    }
+
+    void close()
+    {
+        if (sqes_map != MAP_FAILED)
+            munmap(sqes_map, sqes_size);
+        if (rings != MAP_FAILED)
+            munmap(rings, rings_size);
+        if (fd >= 0)
+            ::close(fd);
+        sqes_map = rings = MAP_FAILED;
+        fd = -1;
+    }
+
+    int register_op(unsigned opcode, const void* arg, unsigned nr_args)
+    {
+        return io_uring_register(fd, opcode, arg, nr_args);
+    }
+
+    // NULL when the submission queue is full.
+    io_uring_sqe* get_sqe()
+    {
+        if (sqe_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) == sq_entries)
+            return NULL;
+        io_uring_sqe* sqe = &sqes[sqe_tail & sq_mask];
+        ++sqe_tail;
+        memset(sqe, 0, sizeof(*sqe));
+        return sqe;
+    }
+
+    // Everything queued since the last call in one system call, none when
+    // nothing is queued.
+    int submit(unsigned flags = 0)
+    {
+        unsigned pending = sqe_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+        if (!pending && !flags)
+            return 0;
+        __atomic_store_n(sq_tail, sqe_tail, __ATOMIC_RELEASE);
+        int ret;
+        do {
+            ret = io_uring_enter(fd, pending, 0, flags);
+        } while (ret < 0 && errno == EINTR);
+        return ret;
+    }
+
+    // Calls handler for every completion there is, including those the
+    // kernel kept back while the completion queue was full.
+    template <class Handler>
+    void reap(Handler handler)
+    {
+        for (;;) {
+            unsigned head = *cq_head;
+            if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+                if (!(__atomic_load_n(sq_flags, __ATOMIC_RELAXED) & IORING_SQ_CQ_OVERFLOW)
+                        || submit(IORING_ENTER_GETEVENTS) < 0)
+                    return;
+                continue;
+            }
+            io_uring_cqe cqe = cqes[head & cq_mask];
+            __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+            handler(cqe);
+        }
+    }
+
+private:
+    int fd;
+    void* rings;
+    std::size_t rings_size;
+    void* sqes_map;
+    std::size_t sqes_size;
+
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_flags;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    io_uring_sqe* sqes;
+    unsigned sqe_tail;      // queued, published to sq_tail on submit
+
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned cq_mask;
+    io_uring_cqe* cqes;
+};
+
+bool kernel_at_least(int major, int minor)
+{
+    utsname name;
+    int running_major = 0, running_minor = 0;
+    if (uname(&name) != 0 || sscanf(name.release, "%d.%d", &running_major, &running_minor) != 2)
+        return false;
+    return running_major > major || (running_major == major && running_minor >= minor);
+}
+
+// Multishot receive came with 6.0; everything else used here is older.
+bool probe()
+{
+    if (!kernel_at_least(6, 0))
+        return false;
+    Ring ring;
+    if (!ring.setup(8))
+        return false;
+    std::vector<uint8_t> storage(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op));
+    io_uring_probe* ops = reinterpret_cast<io_uring_probe*>(&storage[0]);
+    if (ring.register_op(IORING_REGISTER_PROBE, ops, 256) < 0)
+        return false;
+    static const int needed[] = { IORING_OP_CONNECT, IORING_OP_RECV, IORING_OP_SEND, IORING_OP_ASYNC_CANCEL };
+    for (std::size_t i = 0; i < sizeof(needed) / sizeof(needed[0]); ++i) {
+        if (needed[i] > ops->last_op || !(ops->ops[needed[i]].flags & IO_URING_OP_SUPPORTED))
+            return false;
+    }
+    return true;
+}
+
+class UringTransport;
+
+// The ring of one io_service and the receive buffers all of its
+// connections share.
+class UringService : public boost::asio::io_service::service
+{
+public:
+    static boost::asio::io_service::id id;
+
+    enum { Entries = 4096, BufferCount = 4096, BufferSize = 2048, BufferGroup = 0 };
+    // user_data is the transport with the operation in the low bits
+    enum { OpMask = 7 };
+
+    explicit UringService(boost::asio::io_service& _io_service);
+    ~UringService();
+
+    bool ready() const { return ok; }
+
+    // Queued, submitted with everything else queued before the io_service
+    // runs the next handler. NULL when the ring has no room.
+    io_uring_sqe* get_sqe();
+    void flush();
+
+    // Keeps a transport alive while the kernel has operations of it.
+    void hold(const boost::shared_ptr<UringTransport>& transport) { held[transport.get()] = transport; }
+    void release(UringTransport* transport) { held.erase(transport); }
+
+    const uint8_t* buffer(unsigned bid) const { return buffers + std::size_t(bid) * BufferSize; }
+    void recycle(unsigned bid);
+    // Receive stopped for want of buffers, rearm it once one is recycled.
+    void starving(const boost::shared_ptr<UringTransport>& transport) { starved.push_back(transport); }
+
+private:
+    void shutdown();
+    void wait();
+    void on_ready(const boost::system::error_code& error);
+    void complete(const io_uring_cqe& cqe);
+
+    boost::asio::io_service& io_service;
+    Ring ring;
+    boost::asio::posix::stream_descriptor notifier;
+    // io_uring_buf_ring as an array: the header's flexible array member
+    // lands at offset 8 when compiled as C++. The tail overlays bufs[0].resv.
+    io_uring_buf* buf_ring;
+    uint8_t* buffers;
+    uint16_t buf_tail;
+    bool flush_pending;
+    bool ok;
+    std::unordered_map<UringTransport*, boost::shared_ptr<UringTransport> > held;
+    std::vector<boost::shared_ptr<UringTransport> > starved;
+};
+
+boost::asio::io_service::id UringService::id;
+
+class UringTransport : public Transport
+{
+public:
+    enum Op { Connect = 1, Recv = 2, Send = 3 };
+
+    UringTransport(boost::asio::io_service& _io_service, UringService& _service, const Endpoint& _endpoint) :
+        io_service(_io_service),
+        service(_service),
+        resolver(_io_service),
+        endpoint(_endpoint),
+        fd(-1),
+        in_flight(0),
+        closed(false),
+        read_data(NULL),
+        read_size(0),
+        write_data(NULL),
+        write_size(0),
+        write_done(0)
+    {
+    }
+
+    ~UringTransport()
+    {
+        if (fd >= 0)
+            ::close(fd);
+    }
+
+    void async_connect(const ConnectHandler& handler)
+    {
+        connect_handler = handler;
+        boost::asio::ip::tcp::resolver::query query(endpoint.address, std::to_string(endpoint.port));
+        resolver.async_resolve(query, boost::bind(&UringTransport::resolve_cb, shared_this(),
+                                                  boost::asio::placeholders::error,
+                                                  boost::asio::placeholders::iterator));
+    }
+
+    void async_read_some(uint8_t* data, std::size_t size, const IoHandler& handler)
+    {
+        read_data = data;
+        read_size = size;
+        read_handler = handler;
+        if (closed)
+            abort(read_handler);
+        else if (!chunks.empty() || read_error)
+            io_service.post(boost::bind(&UringTransport::deliver, shared_this()));
+    }
+
+    void async_write(const uint8_t* data, std::size_t size, const IoHandler& handler)
+    {
+        write_data = data;
+        write_size = size;
+        write_done = 0;
+        write_handler = handler;
+        if (closed || fd < 0)
+            abort(write_handler);
+        else
+            send();
+    }
+
+    // The socket is shut down and whatever the kernel still has of it
+    // cancelled right away; the descriptor itself closes with the transport.
+    void close()
+    {
+        if (closed)
+            return;
+        closed = true;
+        resolver.cancel();
+        if (connect_handler) {
+            io_service.post(boost::bind(connect_handler, boost::asio::error::operation_aborted));
+            connect_handler.clear();
+        }
+        abort(read_handler);
+        abort(write_handler);
+        for (; !chunks.empty(); chunks.pop_front())
+            service.recycle(chunks.front().bid);
+        if (fd < 0)
+            return;
+        ::shutdown(fd, SHUT_RDWR);
+        io_uring_sqe* sqe = in_flight ? service.get_sqe() : NULL;
+        if (sqe) {
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->fd = fd;
+            sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+            service.flush();
+        }
+    }
+
+    void complete(unsigned op, int res, unsigned flags)
+    {
+        boost::shared_ptr<UringTransport> self = shared_this();
+        bool more = op == Recv && (flags & IORING_CQE_F_MORE);
+        if (!more && --in_flight == 0)
+            service.release(this);
+        switch (op) {
+        case Connect:
+            on_connect(res);
+            break;
+        case Recv:
+            on_recv(res, flags, more);
+            break;
+        case Send:
+            on_send(res);
+            break;
+        }
+    }
+
+    void arm_recv()
+    {
+        if (closed)
+            return;
+        io_uring_sqe* sqe = service.get_sqe();
+        if (!sqe) {
+            read_error = boost::asio::error::no_buffer_space;
+            deliver();
+            return;
+        }
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = fd;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = UringService::BufferGroup;
+        sqe->user_data = tag(Recv);
+        started();
+    }
+
+private:
+    // A received buffer not yet handed to the reader.
+    struct Chunk
+    {
+        uint16_t bid;
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    boost::shared_ptr<UringTransport> shared_this()
+    {
+        return boost::static_pointer_cast<UringTransport>(shared_from_this());
+    }
+
+    uint64_t tag(Op op) const
+    {
+        return reinterpret_cast<uintptr_t>(this) | op;
+    }
+
+    void started()
+    {
+        if (in_flight++ == 0)
+            service.hold(shared_this());
+    }
+
+    void abort(IoHandler& handler)
+    {
+        if (!handler)
+            return;
+        io_service.post(boost::bind(handler, boost::asio::error::operation_aborted, 0));
+        handler.clear();
+    }
+
+    void resolve_cb(const boost::system::error_code& error, boost::asio::ip::tcp::resolver::iterator i)
+    {
+        if (closed)
+            return;
+        if (error) {
+            finish_connect(error);
+            return;
+        }
+        addresses = i;
+        connect_next();
+    }
+
+    void connect_next()
+    {
+        if (addresses == boost::asio::ip::tcp::resolver::iterator()) {
+            finish_connect(connect_error ? connect_error : boost::asio::error::host_not_found);
+            return;
+        }
+        boost::asio::ip::tcp::endpoint peer = *addresses++;
+        memcpy(&peer_address, peer.data(), peer.size());
+        if (fd >= 0)
+            ::close(fd);
+        fd = ::socket(peer.protocol().family(), SOCK_STREAM | SOCK_CLOEXEC, 0);
+        io_uring_sqe* sqe = fd < 0 ? NULL : service.get_sqe();
+        if (!sqe) {
+            finish_connect(fd < 0 ? boost::system::error_code(errno, boost::system::system_category())
+                                  : boost::asio::error::no_buffer_space);
+            return;
+        }
+        sqe->opcode = IORING_OP_CONNECT;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uintptr_t>(&peer_address);
+        sqe->off = peer.size();
+        sqe->user_data = tag(Connect);
+        started();
+    }
+
+    void finish_connect(const boost::system::error_code& error)
+    {
+        ConnectHandler handler;
+        handler.swap(connect_handler);
+        if (handler)
+            handler(error);
+    }
+
+    void on_connect(int res)
+    {
+        if (closed)
+            return;
+        if (res < 0) {
+            connect_error = boost::system::error_code(-res, boost::system::system_category());
+            connect_next();
+            return;
+        }
+        set_tcp_options(fd, endpoint.address);
+        arm_recv();
+        finish_connect(boost::system::error_code());
+    }
+
+    void on_recv(int res, unsigned flags, bool more)
+    {
+        if (flags & IORING_CQE_F_BUFFER) {
+            uint16_t bid = static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+            if (closed || res <= 0) {
+                service.recycle(bid);
+            } else {
+                Chunk chunk = { bid, 0, static_cast<uint32_t>(res) };
+                chunks.push_back(chunk);
+            }
+        }
+        if (closed)
+            return;
+        if (res == 0)
+            read_error = boost::asio::error::eof;
+        else if (res == -ENOBUFS)
+            service.starving(shared_this());
+        else if (res < 0)
+            read_error = boost::system::error_code(-res, boost::system::system_category());
+        else if (!more)
+            arm_recv();
+        deliver();
+    }
+
+    // Copies as much as is there into the reader's buffer; the read
+    // completes with an error only once the data before it is consumed.
+    void deliver()
+    {
+        if (!read_handler)
+            return;
+        std::size_t n = 0;
+        while (n < read_size && !chunks.empty()) {
+            Chunk& chunk = chunks.front();
+            std::size_t take = std::min<std::size_t>(read_size - n, chunk.size - chunk.offset);
+            memcpy(read_data + n, service.buffer(chunk.bid) + chunk.offset, take);
+            n += take;
+            chunk.offset += take;
+            if (chunk.offset == chunk.size) {
+                service.recycle(chunk.bid);
+                chunks.pop_front();
+            }
+        }
+        if (!n && !read_error)
+            return;
+        IoHandler handler;
+        handler.swap(read_handler);
+        handler(n ? boost::system::error_code() : read_error, n);
+    }
+
+    void send()
+    {
+        io_uring_sqe* sqe = service.get_sqe();
+        if (!sqe) {
+            io_service.post(boost::bind(write_handler, boost::asio::error::no_buffer_space, write_done));
+            write_handler.clear();
+            return;
+        }
+        sqe->opcode = IORING_OP_SEND;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uintptr_t>(write_data + write_done);
+        sqe->len = static_cast<uint32_t>(write_size - write_done);
+        sqe->msg_flags = MSG_NOSIGNAL;
+        sqe->user_data = tag(Send);
+        started();
+    }
+
+    void on_send(int res)
+    {
+        if (!write_handler)
+            return;
+        if (res > 0) {
+            write_done += res;
+            if (write_done < write_size) {
+                send();
+                return;
+            }
+        }
+        IoHandler handler;
+        handler.swap(write_handler);
+        if (res > 0)
+            handler(boost::system::error_code(), write_done);
+        else
+            handler(res ? boost::system::error_code(-res, boost::system::system_category())
+                        : boost::asio::error::broken_pipe, write_done);
+    }
+
+    boost::asio::io_service& io_service;
+    UringService& service;
+    boost::asio::ip::tcp::resolver resolver;
+    boost::asio::ip::tcp::resolver::iterator addresses;
+    Endpoint endpoint;
+    sockaddr_storage peer_address;
+    boost::system::error_code connect_error;
+    int fd;
+    unsigned in_flight;
+    bool closed;
+
+    ConnectHandler connect_handler;
+    uint8_t* read_data;
+    std::size_t read_size;
+    IoHandler read_handler;
+    std::deque<Chunk> chunks;
+    boost::system::error_code read_error;
+    const uint8_t* write_data;
+    std::size_t write_size;
+    std::size_t write_done;
+    IoHandler write_handler;
+};
+
+UringService::UringService(boost::asio::io_service &_io_service) :
+    boost::asio::io_service::service(_io_service),
+    io_service(_io_service),
+    notifier(_io_service),
+    buf_ring(static_cast<io_uring_buf*>(MAP_FAILED)),
+    buffers(static_cast<uint8_t*>(MAP_FAILED)),
+    buf_tail(0),
+    flush_pending(false),
+    ok(false)
+{
+    if (!uring_available() || !ring.setup(Entries))
+        return;
+    int event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (event_fd < 0)
+        return;
+    boost::system::error_code error;
+    notifier.assign(event_fd, error);
+    if (error) {
+        ::close(event_fd);
+        return;
+    }
+    if (ring.register_op(IORING_REGISTER_EVENTFD, &event_fd, 1) < 0)
+        return;
+
+    void* ring_memory = mmap(NULL, BufferCount * sizeof(io_uring_buf), PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    void* buffer_memory = mmap(NULL, std::size_t(BufferCount) * BufferSize, PROT_READ | PROT_WRITE,
+                               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    buf_ring = static_cast<io_uring_buf*>(ring_memory);
+    buffers = static_cast<uint8_t*>(buffer_memory);
+    if (ring_memory == MAP_FAILED || buffer_memory == MAP_FAILED)
+        return;
+    io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = reinterpret_cast<uintptr_t>(buf_ring);
+    reg.ring_entries = BufferCount;
+    reg.bgid = BufferGroup;
+    if (ring.register_op(IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        qWarning("Paradox: io_uring buffer ring registration failed (%s)\n", strerror(errno));
+        return;
+    }
+    for (unsigned bid = 0; bid < BufferCount; ++bid)
+        recycle(bid);
+    ok = true;
+    wait();
+}
+
+UringService::~UringService()
+{
+    // the kernel lets go of the buffers with the ring
+    ring.close();
+    if (buffers != MAP_FAILED)
+        munmap(buffers, std::size_t(BufferCount) * BufferSize);
+    if (buf_ring != MAP_FAILED)
+        munmap(buf_ring, BufferCount * sizeof(io_uring_buf));
+}
+
+void UringService::shutdown()
+{
+    ok = false;
+    boost::system::error_code ignored;
+    notifier.close(ignored);
+    starved.clear();
+    std::unordered_map<UringTransport*, boost::shared_ptr<UringTransport> > transports;
+    transports.swap(held);
+}
+
+io_uring_sqe* UringService::get_sqe()
+{
+    io_uring_sqe* sqe = ring.get_sqe();
+    if (!sqe) {
+        ring.submit();
+        sqe = ring.get_sqe();
+    }
+    if (sqe && !flush_pending) {
+        flush_pending = true;
+        io_service.post(boost::bind(&UringService::flush, this));
+    }
+    return sqe;
+}
+
+void UringService::flush()
+{
+    flush_pending = false;
+    if (ring.submit() < 0 && errno != EAGAIN && errno != EBUSY)
+        qWarning("Paradox: io_uring submit failed (%s)\n", strerror(errno));
+}
+
+void UringService::recycle(unsigned bid)
+{
+    io_uring_buf* buf = &buf_ring[buf_tail & (BufferCount - 1)];
+    buf->addr = reinterpret_cast<uintptr_t>(buffer(bid));
+    buf->len = BufferSize;
+    buf->bid = static_cast<uint16_t>(bid);
+    ++buf_tail;
+    __atomic_store_n(&buf_ring[0].resv, buf_tail, __ATOMIC_RELEASE);
+
+    if (!starved.empty()) {
+        std::vector<boost::shared_ptr<UringTransport> > rearm;
+        rearm.swap(starved);
+        for (std::size_t i = 0; i < rearm.size(); ++i)
+            rearm[i]->arm_recv();
+    }
+}
+
+// Waits for readiness only: the eventfd is never read, epoll reports every
+// signal to it anyway, and completions that arrive between two waits are
+// reaped after the next wait is armed.
+void UringService::wait()
+{
+    notifier.async_wait(boost::asio::posix::stream_descriptor::wait_read,
+                        boost::bind(&UringService::on_ready, this, boost::asio::placeholders::error));
+}
+
+void UringService::on_ready(const boost::system::error_code& error)
+{
+    if (error || !ok)
+        return;
+    wait();
+    ring.reap([this](const io_uring_cqe& cqe) { complete(cqe); });
+    flush();
+}
+
+void UringService::complete(const io_uring_cqe& cqe)
+{
+    // cancellations carry no transport
+    if (!cqe.user_data)
+        return;
+    UringTransport* transport = reinterpret_cast<UringTransport*>(uintptr_t(cqe.user_data & ~uint64_t(OpMask)));
+    transport->complete(unsigned(cqe.user_data & OpMask), cqe.res, cqe.flags);
+}
+
+}
+
+bool uring_available()
+{
+    static const bool available = probe();
+    return available;
+}
+
+boost::shared_ptr<Transport> create_uring_transport(boost::asio::io_service& io_service, const Endpoint& endpoint)
+{
+    if (!uring_available())
+        return boost::shared_ptr<Transport>();
+    UringService& service = boost::asio::use_service<UringService>(io_service);
+    if (!service.ready())
+        return boost::shared_ptr<Transport>();
+    return boost::shared_ptr<Transport>(new UringTransport(io_service, service, endpoint));
+}
+
+#endif
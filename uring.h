@@ -0,0 +1,22 @@
+#ifndef URING_H
+#define URING_H
+
+#include "transport.h"
+
+// io_uring backend for tcp+uring:// endpoints (Linux 6.0 and later).
+//
+// Every io_service gets one ring. Receives are multishot into a ring of
+// provided buffers registered with the kernel, so an idle connection holds
+// no receive buffer and one recv request serves a connection for its whole
+// life. Sends from all connections are queued and submitted together once
+// per io_service turn. Completions are reaped when the ring's eventfd turns
+// readable, which keeps the ring inside the io_service's epoll loop.
+
+// Whether this build and the running kernel support the backend.
+bool uring_available();
+
+// NULL when the backend isn't available for io_service; the caller falls
+// back to the epoll reactor.
+boost::shared_ptr<Transport> create_uring_transport(boost::asio::io_service& io_service, const Endpoint& endpoint);
+
+#endif // URING_H
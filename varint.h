@@ -0,0 +1,37 @@
+#ifndef VARINT_H
+#define VARINT_H
+
+#include <stdint.h>
+#include <vector>
+
+// LEB128 varints, with zigzag mapping for signed values, as used by the
+// snapshot, time-series and report encodings. The writers append to any
+// byte vector, arena-backed ones included.
+
+inline uint64_t zigzag_encode(int64_t value)
+{
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+inline int64_t zigzag_decode(uint64_t value)
+{
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+template <class Bytes>
+inline void put_varint(Bytes& out, uint64_t value)
+{
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+template <class Bytes>
+inline void put_svarint(Bytes& out, int64_t value)
+{
+    put_varint(out, zigzag_encode(value));
+}
+
+#endif // VARINT_H
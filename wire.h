@@ -0,0 +1,479 @@
+#ifndef WIRE_H
+#define WIRE_H
+
+#include "varint.h"
+#include <cassert>
+#include <cstring>
+#include <limits>
+#include <stdint.h>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Payload layouts as types. A message is its command id and a list of field
+// codecs; encode() and decode() are generated from the list, take one
+// argument of the field's type per field and compile down to the codecs'
+// inline code. decode() reads the payload where it lies, Text fields
+// pointing into it, and fails on anything that doesn't follow the layout,
+// bytes left over included.
+//
+//   typedef wire::Message<cmd_type_amount, wire::Dec<uint32_t, '/'>, wire::Dec<int32_t> > Amount;
+//   wire::Buffer<Amount::max_size> payload;
+//   Amount::encode(payload, id, amount);            // "17/250"
+//   if (Amount::decode(data, size, id, amount)) ...
+//
+// The messages of the protocol are declared in protocol.h.
+namespace wire {
+
+// Bytes of a payload; valid as long as the buffer they were decoded from.
+struct Text
+{
+    const char* data;
+    uint32_t size;
+
+    Text() : data(""), size(0) { }
+    Text(const char* _data, uint32_t _size) : data(_data), size(_size) { }
+    Text(const std::string& s) : data(s.data()), size(static_cast<uint32_t>(s.size())) { }
+    template <std::size_t N>
+    Text(const char (&literal)[N]) : data(literal), size(N - 1) { }
+
+    bool empty() const { return !size; }
+    std::string str() const { return std::string(data, size); }
+
+    bool operator==(const Text& other) const
+    {
+        return size == other.size && !memcmp(data, other.data, size);
+    }
+    bool operator!=(const Text& other) const { return !(*this == other); }
+};
+
+struct Reader
+{
+    const uint8_t* p;
+    const uint8_t* end;
+};
+
+// Payload storage for messages whose fields are all bounded, sized with
+// Message::max_size; a message with an unbounded field doesn't compile.
+template <std::size_t N>
+class Buffer
+{
+public:
+    typedef uint8_t value_type;
+    typedef uint8_t* iterator;
+
+    static_assert(N > 0, "the message has an unbounded field");
+
+    Buffer() : used(0) { }
+
+    void push_back(uint8_t byte)
+    {
+        assert(used < N);
+        bytes[used++] = byte;
+    }
+
+    template <class It>
+    void insert(iterator, It first, It last)
+    {
+        for (; first != last; ++first)
+            push_back(static_cast<uint8_t>(*first));
+    }
+
+    iterator end() { return bytes + used; }
+    const uint8_t* data() const { return bytes; }
+    uint32_t size() const { return static_cast<uint32_t>(used); }
+    void clear() { used = 0; }
+
+private:
+    uint8_t bytes[N];
+    std::size_t used;
+};
+
+// Field codecs. Each has the C++ type it encodes, the least and the most
+// bytes it takes (max_size 0: unbounded), put() and get().
+
+// uint32 in host order, as the frame header has it.
+struct U32
+{
+    typedef uint32_t type;
+    enum { min_size = 4, max_size = 4 };
+
+    template <class Bytes>
+    static void put(Bytes& out, uint32_t value)
+    {
+        uint8_t bytes[4];
+        memcpy(bytes, &value, 4);
+        out.insert(out.end(), bytes, bytes + 4);
+    }
+
+    static bool get(Reader& in, uint32_t& value)
+    {
+        if (in.end - in.p < 4)
+            return false;
+        memcpy(&value, in.p, 4);
+        in.p += 4;
+        return true;
+    }
+};
+
+namespace detail {
+
+inline bool get_varint(Reader& in, uint64_t& value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (in.p == in.end)
+            return false;
+        uint8_t byte = *in.p++;
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+template <class T>
+inline bool is_negative(T value, std::true_type) { return value < 0; }
+
+template <class T>
+inline bool is_negative(T, std::false_type) { return false; }
+
+template <int... Sizes>
+struct Sum;
+
+template <>
+struct Sum<>
+{
+    enum { value = 0 };
+};
+
+template <int Size, int... Sizes>
+struct Sum<Size, Sizes...>
+{
+    enum { value = Size + Sum<Sizes...>::value };
+};
+
+// The sum of the sizes, 0 if any of them is 0.
+template <int... Sizes>
+struct Bound;
+
+template <>
+struct Bound<>
+{
+    enum { value = 0 };
+};
+
+template <int Size>
+struct Bound<Size>
+{
+    enum { value = Size };
+};
+
+template <int Size, int Next, int... Sizes>
+struct Bound<Size, Next, Sizes...>
+{
+    enum { rest = Bound<Next, Sizes...>::value, value = Size != 0 && rest != 0 ? Size + rest : 0 };
+};
+
+}
+
+// LEB128 varint of an unsigned T.
+template <class T>
+struct Varint
+{
+    typedef T type;
+    enum { min_size = 1, max_size = (std::numeric_limits<T>::digits + 6) / 7 };
+
+    template <class Bytes>
+    static void put(Bytes& out, T value)
+    {
+        put_varint(out, value);
+    }
+
+    static bool get(Reader& in, T& value)
+    {
+        uint64_t raw;
+        if (!detail::get_varint(in, raw) || raw > std::numeric_limits<T>::max())
+            return false;
+        value = static_cast<T>(raw);
+        return true;
+    }
+};
+
+// Zigzag varint of a signed T.
+template <class T>
+struct SVarint
+{
+    typedef T type;
+    enum { min_size = 1, max_size = (std::numeric_limits<T>::digits + 7) / 7 };
+
+    template <class Bytes>
+    static void put(Bytes& out, T value)
+    {
+        put_svarint(out, value);
+    }
+
+    static bool get(Reader& in, T& value)
+    {
+        uint64_t raw;
+        if (!detail::get_varint(in, raw))
+            return false;
+        int64_t decoded = zigzag_decode(raw);
+        if (decoded < std::numeric_limits<T>::min() || decoded > std::numeric_limits<T>::max())
+            return false;
+        value = static_cast<T>(decoded);
+        return true;
+    }
+};
+
+// Decimal text of a T, then Sep unless it is 0. Alt is accepted in place
+// of Sep when decoding, and the end of the payload is too.
+template <class T, char Sep = 0, char Alt = Sep>
+struct Dec
+{
+    typedef T type;
+    enum {
+        min_size = 1,
+        max_size = std::numeric_limits<T>::digits10 + 1 + std::numeric_limits<T>::is_signed + (Sep != 0)
+    };
+
+    template <class Bytes>
+    static void put(Bytes& out, T value)
+    {
+        bool negative = detail::is_negative(value, std::is_signed<T>());
+        uint64_t magnitude = negative ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+        char digits[24];
+        char* first = digits + sizeof(digits);
+        do {
+            *--first = static_cast<char>('0' + magnitude % 10);
+            magnitude /= 10;
+        } while (magnitude);
+        if (negative)
+            *--first = '-';
+        out.insert(out.end(), first, digits + sizeof(digits));
+        if (Sep)
+            out.push_back(static_cast<uint8_t>(Sep));
+    }
+
+    static bool get(Reader& in, T& value)
+    {
+        bool negative = std::numeric_limits<T>::is_signed && in.p != in.end && *in.p == '-';
+        if (negative)
+            ++in.p;
+        uint64_t limit = static_cast<uint64_t>(std::numeric_limits<T>::max()) + negative;
+        uint64_t magnitude = 0;
+        const uint8_t* first = in.p;
+        for (; in.p != in.end && *in.p >= '0' && *in.p <= '9'; ++in.p) {
+            unsigned digit = *in.p - '0';
+            if (magnitude > (limit - digit) / 10)
+                return false;
+            magnitude = magnitude * 10 + digit;
+        }
+        if (in.p == first)
+            return false;
+        value = static_cast<T>(negative ? 0 - magnitude : magnitude);
+        if (Sep && in.p != in.end) {
+            char next = static_cast<char>(*in.p);
+            if (next != Sep && next != Alt)
+                return false;
+            ++in.p;
+        }
+        return true;
+    }
+};
+
+// Dec of a signed T that may not be negative, for counts and prices kept in
+// signed fields: decodes 0 up to T's maximum and refuses a '-'.
+template <class T, char Sep = 0, char Alt = Sep>
+struct UDec : Dec<T, Sep, Alt>
+{
+    static bool get(Reader& in, T& value)
+    {
+        return in.p != in.end && *in.p != '-' && Dec<T, Sep, Alt>::get(in, value);
+    }
+};
+
+// Text up to Sep, which it must not contain, then Sep; decoding also takes
+// the rest of the payload when there is no Sep.
+template <char Sep>
+struct Token
+{
+    typedef Text type;
+    enum { min_size = 0, max_size = 0 };
+
+    template <class Bytes>
+    static void put(Bytes& out, const Text& value)
+    {
+        out.insert(out.end(), value.data, value.data + value.size);
+        out.push_back(static_cast<uint8_t>(Sep));
+    }
+
+    static bool get(Reader& in, Text& value)
+    {
+        const uint8_t* sep = in.p != in.end ? static_cast<const uint8_t*>(memchr(in.p, Sep, in.end - in.p)) : NULL;
+        const uint8_t* last = sep ? sep : in.end;
+        value = Text(reinterpret_cast<const char*>(in.p), static_cast<uint32_t>(last - in.p));
+        in.p = sep ? sep + 1 : in.end;
+        return true;
+    }
+};
+
+// Text up to Sep, which it must not contain, or up to the end of the
+// payload. Sep is left to the field after it, e.g. Prefixed<Sep>.
+template <char Sep>
+struct Until
+{
+    typedef Text type;
+    enum { min_size = 0, max_size = 0 };
+
+    template <class Bytes>
+    static void put(Bytes& out, const Text& value)
+    {
+        out.insert(out.end(), value.data, value.data + value.size);
+    }
+
+    static bool get(Reader& in, Text& value)
+    {
+        const uint8_t* sep = in.p != in.end ? static_cast<const uint8_t*>(memchr(in.p, Sep, in.end - in.p)) : NULL;
+        const uint8_t* last = sep ? sep : in.end;
+        value = Text(reinterpret_cast<const char*>(in.p), static_cast<uint32_t>(last - in.p));
+        in.p = last;
+        return true;
+    }
+};
+
+// Any number of Token<Sep>: "a/b/". The last one may lack its Sep.
+template <char Sep>
+struct Tokens
+{
+    typedef std::vector<Text> type;
+    enum { min_size = 0, max_size = 0 };
+
+    template <class Bytes>
+    static void put(Bytes& out, const std::vector<Text>& values)
+    {
+        for (std::size_t i = 0; i < values.size(); ++i)
+            Token<Sep>::put(out, values[i]);
+    }
+
+    static bool get(Reader& in, std::vector<Text>& values)
+    {
+        values.clear();
+        while (in.p != in.end) {
+            values.push_back(Text());
+            Token<Sep>::get(in, values.back());
+        }
+        return true;
+    }
+};
+
+// Any number of texts, each after a Sep they must not contain:
+// "\nproto=2\nresume".
+template <char Sep>
+struct Prefixed
+{
+    typedef std::vector<Text> type;
+    enum { min_size = 0, max_size = 0 };
+
+    template <class Bytes>
+    static void put(Bytes& out, const std::vector<Text>& values)
+    {
+        for (std::size_t i = 0; i < values.size(); ++i) {
+            out.push_back(static_cast<uint8_t>(Sep));
+            Until<Sep>::put(out, values[i]);
+        }
+    }
+
+    static bool get(Reader& in, std::vector<Text>& values)
+    {
+        values.clear();
+        while (in.p != in.end) {
+            if (*in.p++ != Sep)
+                return false;
+            values.push_back(Text());
+            Until<Sep>::get(in, values.back());
+        }
+        return true;
+    }
+};
+
+// Whatever is left of the payload.
+struct Rest
+{
+    typedef Text type;
+    enum { min_size = 0, max_size = 0 };
+
+    template <class Bytes>
+    static void put(Bytes& out, const Text& value)
+    {
+        out.insert(out.end(), value.data, value.data + value.size);
+    }
+
+    static bool get(Reader& in, Text& value)
+    {
+        value = Text(reinterpret_cast<const char*>(in.p), static_cast<uint32_t>(in.end - in.p));
+        in.p = in.end;
+        return true;
+    }
+};
+
+// Varint length, then the bytes.
+struct Str
+{
+    typedef Text type;
+    enum { min_size = 1, max_size = 0 };
+
+    template <class Bytes>
+    static void put(Bytes& out, const Text& value)
+    {
+        put_varint(out, value.size);
+        out.insert(out.end(), value.data, value.data + value.size);
+    }
+
+    static bool get(Reader& in, Text& value)
+    {
+        uint64_t size;
+        if (!detail::get_varint(in, size) || size > static_cast<uint64_t>(in.end - in.p))
+            return false;
+        value = Text(reinterpret_cast<const char*>(in.p), static_cast<uint32_t>(size));
+        in.p += size;
+        return true;
+    }
+};
+
+template <uint8_t Cmd, class... Fields>
+struct Message
+{
+    enum {
+        cmd = Cmd,
+        min_size = detail::Sum<Fields::min_size...>::value,
+        max_size = detail::Bound<Fields::max_size...>::value    // 0: unbounded
+    };
+
+    template <class Bytes>
+    static void encode(Bytes& out, const typename Fields::type&... values)
+    {
+        int in_order[] = { 0, (Fields::put(out, values), 0)... };
+        (void) in_order;
+    }
+
+    static bool decode(const uint8_t* data, std::size_t size, typename Fields::type&... values)
+    {
+        if (size < static_cast<std::size_t>(min_size))
+            return false;
+        Reader in = { data, data + size };
+        bool ok = true;
+        int in_order[] = { 0, (ok = ok && Fields::get(in, values), 0)... };
+        (void) in_order;
+        return ok && in.p == in.end;
+    }
+
+    static bool decode(const char* data, std::size_t size, typename Fields::type&... values)
+    {
+        return decode(reinterpret_cast<const uint8_t*>(data), size, values...);
+    }
+};
+
+}
+
+#endif // WIRE_H